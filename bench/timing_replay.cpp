@@ -0,0 +1,468 @@
+// Host replay and benchmark harness for the firmware timing core (src/timing_core.h).
+//
+// Runs the unmodified core against a simulated oscillator and PPS receiver (or a recorded PPS
+// trace), drives it the way loop() does, and reports timestamp error, PPS grid phase error,
+// convergence time and per-call cost. Build and run on the desktop:
+//
+//   g++ -O2 -std=gnu++11 -Isrc bench/timing_replay.cpp -o timing_replay
+//   ./timing_replay                              # all built-in scenarios
+//   ./timing_replay --scenario pps-loss --ppm 40 --rate 250
+//   ./timing_replay --trace pps_edges.txt        # recorded PPS edges
+//
+// A trace holds one PPS edge per line: the raw 32-bit micros() value captured at the edge
+// ('#' starts a comment). Gaps of two or more seconds count as lost pulses, and the
+// oscillator is interpolated linearly between recorded edges.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// ---------------------------------------------------------------------------------------------
+// Stand-ins for what main.cpp provides to the timing core
+
+#define PPS_INPUT_PIN 4
+const uint32_t PPS_TIMER_CLOCK_HZ = 48000000;
+bool streaming = false;
+float stream_rate = 100.0;
+
+#define PROFILE_BEGIN(stage) do {} while (0)
+#define PROFILE_END(stage) do {} while (0)
+
+struct HostSerial {  // Collects firmware output lines; --verbose echoes them
+  bool echo;
+  uint32_t lines;
+  uint32_t warnings;
+  char line[256];
+  size_t length;
+
+  void put(const char* text) {
+    size_t n = strlen(text);
+    if (length + n >= sizeof(line)) n = sizeof(line) - 1 - length;
+    memcpy(line + length, text, n);
+    length += n;
+    line[length] = '\0';
+  }
+  void print(const char* text) { put(text); }
+  void print(char c) { char text[2] = {c, '\0'}; put(text); }
+  void print(int v) { print((long long)v); }
+  void print(unsigned int v) { print((unsigned long long)v); }
+  void print(long v) { print((long long)v); }
+  void print(unsigned long v) { print((unsigned long long)v); }
+  void print(long long v) { char text[24]; snprintf(text, sizeof(text), "%lld", v); put(text); }
+  void print(unsigned long long v) { char text[24]; snprintf(text, sizeof(text), "%llu", v); put(text); }
+  void print(double v, int digits = 2) { char text[40]; snprintf(text, sizeof(text), "%.*f", digits, v); put(text); }
+  template <typename T> void println(T v) { print(v); println(); }
+  void println() {
+    lines++;
+    if (strncmp(line, "WARNING:", 8) == 0) warnings++;
+    if (echo) printf("    | %s\n", line);
+    length = 0;
+    line[0] = '\0';
+  }
+} SerialTx;
+
+#include "logging.h"
+
+static uint64_t sim_mcu_us = 0;  // 64-bit timebase count of the simulated MCU
+
+static inline uint64_t timingMicros() { return sim_mcu_us; }
+static inline uint32_t timingMillis() { return (uint32_t)(sim_mcu_us / 1000); }
+static inline void timingEnterCritical() {}
+static inline void timingExitCritical() {}
+
+const uint8_t EVENT_CODE_COUNT = 7;
+uint32_t event_counts[EVENT_CODE_COUNT];
+const char* const EVENT_NAMES[EVENT_CODE_COUNT] = {"UNKNOWN", "PPS_LOCK_ADJUST", "PPS_PHASE_NUDGE", "CLOCK_RESET",
+                                                   "SLOTS_SKIPPED", "REFERENCE_UPDATE", "MICROS_WRAP"};
+
+void sendEvent(uint8_t code, int32_t a, int32_t b) {
+  event_counts[code < EVENT_CODE_COUNT ? code : 0]++;
+  if (SerialTx.echo) printf("    | EVENT:%s,%llu,%d,%d\n", EVENT_NAMES[code < EVENT_CODE_COUNT ? code : 0], (unsigned long long)timingMicros(), a, b);
+}
+
+void startStreamingAtPps() { streaming = true; }
+
+#include "timing_core.h"
+
+// ---------------------------------------------------------------------------------------------
+// Oscillator and PPS models
+
+struct Scenario {
+  const char* name;
+  double seconds;            // Simulated run time
+  float rate_hz;             // Stream rate
+  double ppm;                // Oscillator error (micros() runs fast for positive values)
+  double drift_ppm_per_hour; // Linear frequency drift
+  uint64_t start_micros;     // micros() at simulation start (near 2^32 to force an early wrap)
+  double pps_offset_us;      // PPS edge phase relative to simulation start
+  double pps_loss_start_s;   // PPS missing in [start, end); negative = never
+  double pps_loss_end_s;
+  double stream_start_s;     // START_STREAM time
+  double stall_every_s;      // One loop() stall of stall_ms every N seconds (0 = none)
+  double stall_ms;
+  uint64_t reference_interval; // reference_update_interval override (0 = firmware default)
+};
+
+struct TraceEdges {  // Recorded PPS edges, unwrapped, with their true second index
+  uint64_t* mcu_us;
+  int64_t* second;
+  size_t count;
+};
+
+static TraceEdges trace = {nullptr, nullptr, 0};
+static const Scenario* model = nullptr;
+
+double mcuAtTrue(double t_us) {
+  // Unwrapped micros() value at true time t_us
+  if (trace.count >= 2) {
+    static size_t k = 1;  // Segment of the previous lookup; time moves mostly forward
+    double t0 = (double)trace.second[0] * 1e6;
+    if (k >= trace.count) k = 1;
+    while (k > 1 && (double)trace.second[k - 1] * 1e6 > t_us + t0) k--;
+    while (k + 1 < trace.count && (double)trace.second[k] * 1e6 < t_us + t0) k++;
+    double ta = (double)trace.second[k - 1] * 1e6 - t0, tb = (double)trace.second[k] * 1e6 - t0;
+    double ma = (double)trace.mcu_us[k - 1], mb = (double)trace.mcu_us[k];
+    return ma + (t_us - ta) * (mb - ma) / (tb - ta);
+  }
+  double drift_per_us = model->drift_ppm_per_hour / 3.6e9;
+  return (double)model->start_micros + t_us + 1e-6 * (model->ppm * t_us + 0.5 * drift_per_us * t_us * t_us);
+}
+
+double trueAtMcu(double mcu_us, double guess_us) {
+  // Inverse of mcuAtTrue (the oscillator runs within 0.1% of real time)
+  double t = guess_us;
+  for (int i = 0; i < 4; i++) t += mcu_us - mcuAtTrue(t);
+  return t;
+}
+
+static uint32_t rng_state = 0x2545F491;
+static inline uint32_t nextRandom() {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Metrics
+
+struct ErrorStats {
+  uint64_t count;
+  double sum;
+  double sum_sq;
+  double max_abs;
+  double last_exceed_s;  // Last time |error| exceeded the threshold (-1 = never)
+
+  void add(double error, double t_s, double threshold) {
+    count++;
+    sum += error;
+    sum_sq += error * error;
+    if (fabs(error) > max_abs) max_abs = fabs(error);
+    if (fabs(error) > threshold) last_exceed_s = t_s;
+  }
+  void print(const char* label, double threshold, double since_s, double end_s) const {
+    if (count == 0) {
+      printf("  %-22s no samples\n", label);
+      return;
+    }
+    printf("  %-22s mean %8.2f us, rms %8.2f us, max %9.2f us, ", label, sum / count, sqrt(sum_sq / count), max_abs);
+    if (last_exceed_s < since_s) printf("within %.0f us throughout\n", threshold);
+    else if (last_exceed_s > end_s - 1.0) printf("not settled (< %.0f us) by the end\n", threshold);
+    else printf("settled (< %.0f us) %.1f s after %.1f s\n", threshold, last_exceed_s - since_s, since_s);
+  }
+};
+
+struct CallCost {
+  double total_ns;
+  uint64_t calls;
+  double max_ns;
+};
+
+static inline double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+double threshold_ts_us = 10.0;
+double threshold_phase_us = 50.0;
+
+// ---------------------------------------------------------------------------------------------
+
+void runScenario(const Scenario& sc) {
+  model = &sc;
+  memset(event_counts, 0, sizeof(event_counts));
+  SerialTx.lines = 0;
+  SerialTx.warnings = 0;
+  streaming = false;
+  stream_rate = sc.rate_hz;
+
+  double t = 0.0;  // True time since simulation start, us
+  sim_mcu_us = (uint64_t)mcuAtTrue(t);
+  initTimingCore();
+  advanced_timing.pps_capture_hw = false;
+  if (sc.reference_interval > 0) advanced_timing.reference_update_interval = sc.reference_interval;
+
+  // PPS edges in true time; trace edges are re-based so the first one is at pps_offset_us
+  double pps_next_t = sc.pps_offset_us;
+  size_t trace_index = 0;
+  double end_t = sc.seconds * 1e6;
+  if (trace.count >= 2) {
+    end_t = (double)(trace.second[trace.count - 1] - trace.second[0]) * 1e6 + 0.5e6;
+    pps_next_t = 0.0;
+  }
+
+  ErrorStats ts_error = {0, 0, 0, 0, -1}, phase_error = {0, 0, 0, 0, -1};
+  ErrorStats ts_after_loss = {0, 0, 0, 0, -1}, phase_after_loss = {0, 0, 0, 0, -1};
+  CallCost pps_cost = {0, 0, 0};
+  bool have_reference = false;
+  double ref_virtual = 0, ref_true = 0, last_edge_true = 0;
+  uint32_t ref_stamp_count = 0;
+  double next_stall_s = sc.stall_every_s;
+  double interval_us = 1e6 / sc.rate_hz;
+  const double loop_us = 30.0;  // loop() pass period when idle
+
+  while (t < end_t) {
+    // Next wake-up: the due sample slot, the next PPS edge or an idle pass
+    double wake = t + 5000.0;
+    if (streaming && advanced_timing.timing_established) {
+      uint64_t virtual_now = sim_mcu_us;
+      double delta = (double)(int64_t)(advanced_timing.next_sample_micros - virtual_now);
+      double due = trueAtMcu((double)sim_mcu_us + (delta > 0 ? delta : 0), t);
+      if (due < wake) wake = due;
+    }
+    if (pps_next_t < wake) wake = pps_next_t;
+    wake += (double)(nextRandom() % (uint32_t)loop_us);
+    if (wake <= t) wake = t + 1.0;
+    if (next_stall_s > 0 && wake >= next_stall_s * 1e6) {
+      wake += sc.stall_ms * 1000.0;
+      next_stall_s += sc.stall_every_s;
+    }
+    t = wake;
+
+    // PPS interrupts that fired since the last pass (the latest edge wins, as on the MCU)
+    while (pps_next_t <= t) {
+      double edge_t = pps_next_t;
+      bool present = true;
+      uint64_t edge_mcu;
+      if (trace.count >= 2) {
+        edge_mcu = trace.mcu_us[trace_index];
+        trace_index++;
+        pps_next_t = trace_index < trace.count
+                       ? (double)(trace.second[trace_index] - trace.second[0]) * 1e6 : 1e300;
+      } else {
+        double edge_s = edge_t / 1e6;
+        present = !(edge_s >= sc.pps_loss_start_s && edge_s < sc.pps_loss_end_s);
+        edge_mcu = (uint64_t)mcuAtTrue(edge_t) + 2 + nextRandom() % 3;  // ISR latency
+        pps_next_t += 1e6;
+      }
+      if (present) {
+        advanced_timing.pps_micros = edge_mcu;
+        advanced_timing.pps_received = true;
+        last_edge_true = edge_t;
+      }
+    }
+    sim_mcu_us = (uint64_t)mcuAtTrue(t);
+
+    // loop(): timing source first, then the stream
+    if (!streaming && t >= sc.stream_start_s * 1e6) {
+      advanced_timing.sample_interval_us = (uint64_t)(1000000.0 / sc.rate_hz);
+      establishSamplingTiming();
+      streaming = true;
+    }
+
+    bool pps_pending = advanced_timing.pps_received;
+    double call_start = pps_pending ? nowNs() : 0;
+    updateTimingSource();
+    if (pps_pending) {
+      double ns = nowNs() - call_start;
+      pps_cost.total_ns += ns;
+      pps_cost.calls++;
+      if (ns > pps_cost.max_ns) pps_cost.max_ns = ns;
+    }
+
+    if (!have_reference && advanced_timing.cal_base_initialized) {
+      // Timestamps are calibrated relative to the base PPS edge: compare elapsed time since it
+      have_reference = true;
+      ref_virtual = (double)advanced_timing.cal_base_micros;
+      ref_true = last_edge_true;
+    }
+
+    if (streaming && advanced_timing.timing_established) {
+      refreshTimingScales();
+      uint64_t now_virtual = getVirtualMicros();
+      long long late_us = (long long)now_virtual - (long long)advanced_timing.next_sample_micros;
+      if (late_us >= 0) {
+        if (advanced_timing.sample_index >= advanced_timing.reference_update_interval) {
+          updateTimingReference();
+        }
+        uint64_t stamp = getPreciseTimestamp();
+        double t_s = t / 1e6;
+        bool after_loss = sc.pps_loss_start_s >= 0 && t_s >= sc.pps_loss_end_s;
+        if (have_reference) {
+          double error = ((double)stamp - ref_virtual) - (t - ref_true);
+          ts_error.add(error, t_s, threshold_ts_us);
+          if (after_loss) ts_after_loss.add(error, t_s, threshold_ts_us);
+          ref_stamp_count++;
+        }
+        double phase = fmod(t - fmod(sc.pps_offset_us, interval_us), interval_us);
+        if (phase < 0) phase += interval_us;
+        if (phase > interval_us / 2) phase -= interval_us;
+        phase_error.add(phase, t_s, threshold_phase_us);
+        if (after_loss) phase_after_loss.add(phase, t_s, threshold_phase_us);
+        countEmittedSample();
+        advanceSampleSchedule(late_us);
+      }
+    }
+  }
+
+  double true_ppm = trace.count >= 2
+    ? ((double)(trace.mcu_us[trace.count - 1] - trace.mcu_us[0]) /
+       ((double)(trace.second[trace.count - 1] - trace.second[0]) * 1e6) - 1.0) * 1e6
+    : sc.ppm + sc.drift_ppm_per_hour * sc.seconds / 3600.0;
+  printf("scenario %s: %.0f s at %.0f Hz, oscillator %+.2f ppm", sc.name, end_t / 1e6, sc.rate_hz, true_ppm);
+  if (sc.pps_loss_start_s >= 0) printf(", PPS lost %.0f-%.0f s", sc.pps_loss_start_s, sc.pps_loss_end_s);
+  printf("\n");
+  printf("  samples %lu, timebase low-word wraps %u, reference updates %u, warnings %u\n",
+         (unsigned long)advanced_timing.samples_generated, advanced_timing.micros_wraparound_count,
+         advanced_timing.reference_updates_count, SerialTx.warnings);
+  printf("  events:");
+  for (uint8_t code = 1; code < EVENT_CODE_COUNT; code++) printf(" %s=%u", EVENT_NAMES[code], event_counts[code]);
+  printf("\n");
+  printf("  calibration %+.3f ppm (true correction %+.3f ppm), source %s, accuracy %.1f us\n",
+         advanced_timing.oscillator_calibration_ppm, -true_ppm,
+         getTimingSourceName(advanced_timing.current_source), advanced_timing.timing_accuracy_us);
+  double end_s = end_t / 1e6;
+  ts_error.print("timestamp error", threshold_ts_us, ref_true / 1e6, end_s);
+  phase_error.print("grid phase error", threshold_phase_us, sc.stream_start_s, end_s);
+  if (sc.pps_loss_start_s >= 0) {
+    ts_after_loss.print("  after PPS return", threshold_ts_us, sc.pps_loss_end_s, end_s);
+    phase_after_loss.print("  after PPS return", threshold_phase_us, sc.pps_loss_end_s, end_s);
+  }
+
+  // Per-call cost on the final state; the simulated clock advances 1 us per call
+  const uint32_t iterations = 2000000;
+  volatile uint64_t sink = 0;
+  double start = nowNs();
+  for (uint32_t i = 0; i < iterations; i++) { sim_mcu_us++; sink += getVirtualMicros(); }
+  double virtual_ns = (nowNs() - start) / iterations;
+  start = nowNs();
+  for (uint32_t i = 0; i < iterations; i++) { sim_mcu_us++; sink += getPreciseTimestamp(); }
+  double stamp_ns = (nowNs() - start) / iterations;
+  start = nowNs();
+  for (uint32_t i = 0; i < iterations; i++) { sim_mcu_us++; updateTimingSource(); }
+  double source_ns = (nowNs() - start) / iterations;
+  start = nowNs();
+  for (uint32_t i = 0; i < iterations; i++) { refreshTimingScales(); advanceSampleSchedule(0); }
+  double schedule_ns = (nowNs() - start) / iterations;
+  (void)sink;
+  printf("  cost (host ns/call): getVirtualMicros %.1f, getPreciseTimestamp %.1f, updateTimingSource %.1f, "
+         "advanceSampleSchedule %.1f, processPPS %.0f (max %.0f)\n\n",
+         virtual_ns, stamp_ns, source_ns, schedule_ns,
+         pps_cost.calls ? pps_cost.total_ns / pps_cost.calls : 0.0, pps_cost.max_ns);
+}
+
+bool loadTrace(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  size_t capacity = 1024;
+  trace.mcu_us = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+  trace.second = (int64_t*)malloc(capacity * sizeof(int64_t));
+  char line[128];
+  uint64_t wraps = 0;
+  uint32_t last_raw = 0;
+  while (fgets(line, sizeof(line), f)) {
+    char* p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') continue;
+    uint32_t raw = (uint32_t)strtoul(p, nullptr, 10);
+    if (trace.count > 0 && raw < last_raw) wraps++;
+    last_raw = raw;
+    uint64_t mcu = (wraps << 32) + raw;
+    int64_t second = 0;
+    if (trace.count > 0) {
+      double gap_s = (double)(mcu - trace.mcu_us[trace.count - 1]) / 1e6;
+      second = trace.second[trace.count - 1] + (int64_t)(gap_s + 0.5);
+      if (second == trace.second[trace.count - 1]) continue;  // Glitch within the same second
+    }
+    if (trace.count == capacity) {
+      capacity *= 2;
+      trace.mcu_us = (uint64_t*)realloc(trace.mcu_us, capacity * sizeof(uint64_t));
+      trace.second = (int64_t*)realloc(trace.second, capacity * sizeof(int64_t));
+    }
+    trace.mcu_us[trace.count] = mcu;
+    trace.second[trace.count] = second;
+    trace.count++;
+  }
+  fclose(f);
+  if (trace.count < 3) {
+    fprintf(stderr, "%s: need at least 3 PPS edges\n", path);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  //                   name        s     Hz     ppm     drift  start micros        pps offset  loss          start  stall        ref
+  Scenario scenarios[] = {
+    {"steady",       600,  100, -276.27, 0.0, 5000000ULL,           400000.0, -1, -1,    3.0, 0, 0,           0},
+    {"wrap",        1200,  100, -276.27, 0.0, 4294967296ULL - 600000000ULL, 400000.0, -1, -1, 3.0, 0, 0,   0},
+    {"reference",   1100, 1000,   35.00, 0.0, 5000000ULL,           400000.0, -1, -1,    3.0, 0, 0,           0},
+    {"pps-loss",    1200,  100, -276.27, 2.0, 5000000ULL,           400000.0, 300, 660,  3.0, 0, 0,           0},
+    {"stalls",       300,  100, -276.27, 0.0, 5000000ULL,           400000.0, -1, -1,    3.0, 20, 25.0,       0},
+  };
+  const size_t scenario_count = sizeof(scenarios) / sizeof(scenarios[0]);
+  const char* selected = "all";
+  const char* trace_path = nullptr;
+  double ppm = NAN, rate = NAN, seconds = NAN;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(arg, "--scenario") == 0 && value) { selected = value; i++; }
+    else if (strcmp(arg, "--trace") == 0 && value) { trace_path = value; i++; }
+    else if (strcmp(arg, "--ppm") == 0 && value) { ppm = atof(value); i++; }
+    else if (strcmp(arg, "--rate") == 0 && value) { rate = atof(value); i++; }
+    else if (strcmp(arg, "--seconds") == 0 && value) { seconds = atof(value); i++; }
+    else if (strcmp(arg, "--ts-threshold") == 0 && value) { threshold_ts_us = atof(value); i++; }
+    else if (strcmp(arg, "--phase-threshold") == 0 && value) { threshold_phase_us = atof(value); i++; }
+    else if (strcmp(arg, "--seed") == 0 && value) { rng_state = (uint32_t)strtoul(value, nullptr, 0) | 1; i++; }
+    else if (strcmp(arg, "--verbose") == 0) { SerialTx.echo = true; }
+    else {
+      printf("usage: %s [--scenario all|steady|wrap|reference|pps-loss|stalls] [--trace FILE]\n"
+             "       [--ppm X] [--rate HZ] [--seconds N] [--ts-threshold US] [--phase-threshold US]\n"
+             "       [--seed N] [--verbose]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (trace_path) {
+    if (!loadTrace(trace_path)) return 1;
+    Scenario replay = {trace_path, 0, 100, 0.0, 0.0, 0, 0.0, -1, -1, 2.0, 0, 0, 0};
+    if (!isnan(rate)) replay.rate_hz = (float)rate;
+    runScenario(replay);
+    return 0;
+  }
+
+  bool matched = false;
+  for (size_t i = 0; i < scenario_count; i++) {
+    Scenario sc = scenarios[i];
+    if (strcmp(selected, "all") != 0 && strcmp(selected, sc.name) != 0) continue;
+    if (!isnan(ppm)) sc.ppm = ppm;
+    if (!isnan(rate)) sc.rate_hz = (float)rate;
+    if (!isnan(seconds)) sc.seconds = seconds;
+    runScenario(sc);
+    matched = true;
+  }
+  if (!matched) {
+    fprintf(stderr, "unknown scenario %s\n", selected);
+    return 2;
+  }
+  return 0;
+}
@@ -30,6 +30,13 @@ class DataSaver:
         self.csv_fields = csv_fields or ['timestamp', 'datetime', 'sequence', 'channel1', 'channel2', 'channel3', 'thingsboard_status']
         self.common_tags = common_tags or {}
         
+        # Event trigger windows (full-rate samples around a detection) go to their own CSV file
+        self.event_csv_filename = None
+        self.event_csv_fields = self.csv_fields + ['trigger_event']
+        if csv_filename:
+            base, ext = os.path.splitext(csv_filename)
+            self.event_csv_filename = f"{base}_events{ext or '.csv'}"
+        
         # Initialize CSV
         if csv_filename:
             self._init_csv()
@@ -60,6 +67,7 @@ class DataSaver:
         # Statistics
         self.stats = {
             'csv_samples': 0,
+            'event_samples': 0,
             'influx_samples': 0,
             'thingsboard_queued': 0,
             'thingsboard_sent_batches': 0,
@@ -99,7 +107,8 @@ class DataSaver:
                 batch_size=config.get('batch_size', 100),
                 tags=config.get('tags', {}),
                 fields=config.get('fields', {}),
-                buffer_on_error=config.get('buffer_on_error', True)
+                buffer_on_error=config.get('buffer_on_error', True),
+                event_measurement=config.get('event_measurement')
             )
             
             if self.influx_writer.test_connection():
@@ -168,7 +177,8 @@ class DataSaver:
                     # Re-queue if not connected and retry later? Or handle in tb_client.connect
                     # For now, items are lost if client is disconnected during this send attempt.
 
-    def save_seismic_sample(self, timestamp, sequence, channel_values, sample_tags=None, sample_fields=None):
+    def save_seismic_sample(self, timestamp, sequence, channel_values, sample_tags=None, sample_fields=None,
+                            stream=None, trigger_event=None):
         """
         Queue for ThingsBoard, then save a seismic data sample to other configured outputs.
         
@@ -178,8 +188,16 @@ class DataSaver:
             channel_values: List of ADC values [ch1, ch2, ch3]
             sample_tags: Additional tags for this sample
             sample_fields: Additional fields for this sample
+            stream: timing_info['stream_kind'] in event trigger mode: 'event' samples (full-rate trigger
+                    windows) go to the events CSV and InfluxDB measurement and skip ThingsBoard;
+                    None or 'continuous' is the normal path
+            trigger_event: timing_info['trigger_event'], the window id (sample index of its first sample)
         """
+        is_event = stream == 'event'
         thingsboard_status = "tb_disabled" # Default if TB not configured/enabled
+        if is_event:
+            sample_tags = dict(sample_tags or {}, trigger_event=trigger_event)
+            self.stats['event_samples'] += 1
         
         # FIXED: Remove redundant quantization - timestamps are already perfectly quantized
         # The SimplifiedTimestampGenerator provides exact configurable quantization boundaries
@@ -194,8 +212,10 @@ class DataSaver:
         
         datetime_str = dt_obj.strftime('%Y-%m-%d %H:%M:%S.%f')[:-3]
 
-        # 1. Queue for ThingsBoard if enabled and client connected
-        if self.tb_client and self.tb_buffer is not None: # Check tb_buffer for sender thread
+        # 1. Queue for ThingsBoard if enabled and client connected (dashboards get the continuous stream only)
+        if is_event:
+            thingsboard_status = "tb_event_skipped"
+        elif self.tb_client and self.tb_buffer is not None: # Check tb_buffer for sender thread
             telemetry_values = {
                 "count_z": float(channel_values[0]),
                 "count_x": float(channel_values[1]) if len(channel_values) > 1 else 0.0,
@@ -241,14 +261,20 @@ class DataSaver:
 
         # 2. Save to CSV
         if self.csv_filename:
-            if self._save_csv(sample_for_csv_influx):
+            if is_event:
+                sample_for_csv_influx['trigger_event'] = trigger_event
+                saved = self._save_csv(sample_for_csv_influx, self.event_csv_filename, self.event_csv_fields)
+            else:
+                saved = self._save_csv(sample_for_csv_influx)
+            if saved:
                 self.stats['csv_samples'] += 1
             else:
                 self.stats['csv_errors'] += 1
         
         # 3. Save to InfluxDB (no thingsboard_status saved anymore)
         if self.influx_writer:
-            if self.influx_writer.write_seismic_sample(timestamp, sequence, channel_values, sample_tags, sample_fields):
+            if self.influx_writer.write_seismic_sample(timestamp, sequence, channel_values, sample_tags, sample_fields,
+                                                       stream=stream):
                 self.stats['influx_samples'] += 1
             else:
                 self.stats['influx_errors'] += 1
@@ -276,13 +302,15 @@ class DataSaver:
             
         return self.save_seismic_sample(timestamp, sequence, channel_values, sample_tags=tags, sample_fields=fields)
 
-    def _save_csv(self, sample):
-        """Save sample to CSV file"""
+    def _save_csv(self, sample, filename=None, fields=None):
+        """Save sample to CSV file (the main file unless another one is given)"""
+        filename = filename or self.csv_filename
+        fields = fields or self.csv_fields
         try:
-            complete_sample = {field: sample.get(field) for field in self.csv_fields}
+            complete_sample = {field: sample.get(field) for field in fields}
 
-            with open(self.csv_filename, 'a', newline='') as f:
-                writer = csv.DictWriter(f, fieldnames=self.csv_fields)
+            with open(filename, 'a', newline='') as f:
+                writer = csv.DictWriter(f, fieldnames=fields)
                 if f.tell() == 0:
                     writer.writeheader()
                 writer.writerow(complete_sample)
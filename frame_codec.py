@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""
+Native frame decoder binding for gVsense
+Loads native/libframe_decoder.so (built from src/protocol_codec.h, see native/frame_decoder.cpp)
+and decodes whole serial reads into text lines, frame payloads and sample column buffers
+"""
+
+import ctypes
+import os
+import logging
+from typing import Optional
+
+try:
+    import numpy as np
+except ImportError:  # Columns fall back to plain lists
+    np = None
+
+logger = logging.getLogger(__name__)
+
+LIBRARY_ENV = 'GVSENSE_FRAME_DECODER'
+LIBRARY_NAMES = ('libframe_decoder.so', 'libframe_decoder.dylib', 'frame_decoder.dll')
+
+ITEM_LINE = 0
+ITEM_FRAME = 1
+ITEM_SAMPLES = 2
+
+
+class _Item(ctypes.Structure):
+    _fields_ = [('kind', ctypes.c_uint8), ('frame_type', ctypes.c_uint8), ('reserved', ctypes.c_uint16),
+                ('offset', ctypes.c_uint32), ('length', ctypes.c_uint32), ('first_row', ctypes.c_uint32),
+                ('rows', ctypes.c_uint32)]
+
+
+class _Columns(ctypes.Structure):
+    _fields_ = [('rows', ctypes.c_uint32), ('value_stride', ctypes.c_uint32),
+                ('stream_id', ctypes.POINTER(ctypes.c_uint32)), ('sample_index', ctypes.POINTER(ctypes.c_uint32)),
+                ('stamp', ctypes.POINTER(ctypes.c_uint64)), ('timing_source', ctypes.POINTER(ctypes.c_uint8)),
+                ('accuracy_q', ctypes.POINTER(ctypes.c_uint16)), ('flags', ctypes.POINTER(ctypes.c_uint8)),
+                ('channels', ctypes.POINTER(ctypes.c_uint8)), ('values', ctypes.POINTER(ctypes.c_int32))]
+
+
+class _Stats(ctypes.Structure):
+    _fields_ = [('frames_received', ctypes.c_uint32), ('frames_valid', ctypes.c_uint32),
+                ('crc_errors', ctypes.c_uint32), ('sync_losses', ctypes.c_uint32),
+                ('records_invalid', ctypes.c_uint32), ('rows_decoded', ctypes.c_uint32)]
+
+
+COLUMN_NAMES = ('stream_id', 'sample_index', 'stamp', 'timing_source', 'accuracy_q', 'flags', 'channels')
+
+
+def _load_library():
+    """Find the shared library: $GVSENSE_FRAME_DECODER, then native/ next to this file"""
+    candidates = []
+    if os.environ.get(LIBRARY_ENV):
+        candidates.append(os.environ[LIBRARY_ENV])
+    native_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'native')
+    candidates.extend(os.path.join(native_dir, name) for name in LIBRARY_NAMES)
+
+    for path in candidates:
+        if not os.path.exists(path):
+            continue
+        try:
+            lib = ctypes.CDLL(path)
+        except OSError as e:
+            logger.warning(f"Failed to load frame decoder {path}: {e}")
+            continue
+        lib.frame_decoder_create.restype = ctypes.c_void_p
+        lib.frame_decoder_destroy.argtypes = [ctypes.c_void_p]
+        lib.frame_decoder_reset.argtypes = [ctypes.c_void_p]
+        lib.frame_decoder_decode.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint32]
+        lib.frame_decoder_decode.restype = ctypes.c_int32
+        lib.frame_decoder_items.argtypes = [ctypes.c_void_p]
+        lib.frame_decoder_items.restype = ctypes.POINTER(_Item)
+        lib.frame_decoder_arena.argtypes = [ctypes.c_void_p]
+        lib.frame_decoder_arena.restype = ctypes.POINTER(ctypes.c_uint8)
+        lib.frame_decoder_columns.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Columns)]
+        lib.frame_decoder_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Stats)]
+        lib.frame_decoder_pending.argtypes = [ctypes.c_void_p]
+        lib.frame_decoder_pending.restype = ctypes.c_uint32
+        logger.info(f"Native frame decoder loaded from {path}")
+        return lib
+    return None
+
+
+_library = None
+_library_checked = False
+
+
+def native_decoder_available() -> bool:
+    global _library, _library_checked
+    if not _library_checked:
+        _library = _load_library()
+        _library_checked = True
+    return _library is not None
+
+
+class NativeFrameDecoder:
+    """Stateful mixed text/frame splitter and sample decoder (same contract as BinaryFrameParser.add_mixed_data)
+
+    decode() returns (items, columns) for one read. items are, in arrival order:
+        ('line', str), ('frame', payload bytes), ('samples', (payload bytes, first_row, rows))
+    columns maps COLUMN_NAMES to one entry per decoded sample, plus 'values' (rows x value_stride int32;
+    the first `channels` entries of a row are used). With NumPy these are arrays, otherwise lists.
+    """
+
+    def __init__(self):
+        if not native_decoder_available():
+            raise RuntimeError("Native frame decoder library not found")
+        self._lib = _library
+        self._handle = self._lib.frame_decoder_create()
+        if not self._handle:
+            raise MemoryError("frame_decoder_create failed")
+
+    def __del__(self):
+        handle = getattr(self, '_handle', None)
+        if handle:
+            self._lib.frame_decoder_destroy(handle)
+            self._handle = None
+
+    def reset(self):
+        self._lib.frame_decoder_reset(self._handle)
+
+    def decode(self, data: bytes):
+        count = self._lib.frame_decoder_decode(self._handle, bytes(data), len(data))
+        if count < 0:
+            raise MemoryError("Native frame decoder ran out of memory (state reset)")
+        items_ptr = self._lib.frame_decoder_items(self._handle)
+        arena_ptr = self._lib.frame_decoder_arena(self._handle)
+        arena_size = max((items_ptr[i].offset + items_ptr[i].length for i in range(count)), default=0)
+        arena = ctypes.string_at(arena_ptr, arena_size) if arena_size else b''
+
+        items = []
+        for i in range(count):
+            item = items_ptr[i]
+            chunk = arena[item.offset:item.offset + item.length]
+            if item.kind == ITEM_LINE:
+                items.append(('line', chunk.decode('utf-8', errors='ignore')))
+            elif item.kind == ITEM_SAMPLES:
+                items.append(('samples', (chunk, item.first_row, item.rows)))
+            else:
+                items.append(('frame', chunk))
+        return items, self._columns()
+
+    def _columns(self) -> dict:
+        """Copy the column buffers out (the library reuses them on the next decode)"""
+        cols = _Columns()
+        self._lib.frame_decoder_columns(self._handle, ctypes.byref(cols))
+        rows, stride = cols.rows, cols.value_stride
+        columns = {'rows': rows, 'value_stride': stride}
+        for name in COLUMN_NAMES:
+            columns[name] = self._copy(getattr(cols, name), rows)
+        values = self._copy(cols.values, rows * stride)
+        if np is not None:
+            columns['values'] = values.reshape(rows, stride)
+        else:
+            columns['values'] = [values[r * stride:(r + 1) * stride] for r in range(rows)]
+        return columns
+
+    @staticmethod
+    def _copy(pointer, count):
+        if count == 0:
+            # Buffers may not be allocated yet
+            return np.zeros(0, dtype=np.dtype(pointer._type_)) if np is not None else []
+        if np is not None:
+            return np.ctypeslib.as_array(pointer, shape=(count,)).copy()
+        return pointer[:count]
+
+    def get_stats(self) -> dict:
+        stats = _Stats()
+        self._lib.frame_decoder_stats(self._handle, ctypes.byref(stats))
+        result = {name: getattr(stats, name) for name, _ in _Stats._fields_}
+        result['buffer_size'] = self._lib.frame_decoder_pending(self._handle)
+        return result
+
+
+def create_native_decoder() -> Optional[NativeFrameDecoder]:
+    """NativeFrameDecoder, or None when the library is not built (callers fall back to BinaryFrameParser)"""
+    if not native_decoder_available():
+        return None
+    try:
+        return NativeFrameDecoder()
+    except (RuntimeError, MemoryError, OSError) as e:
+        logger.warning(f"Native frame decoder unavailable: {e}")
+        return None
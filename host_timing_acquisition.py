@@ -25,6 +25,9 @@ from typing import Optional, Dict, Any, Callable, Tuple
 # Import the unified timing system
 from timing_fix import UnifiedTimingManager, SimplifiedTimestampGenerator, TimingAdapter
 
+# Native frame decoder (native/frame_decoder.cpp); BinaryFrameParser is used when it is not built
+from frame_codec import create_native_decoder
+
 # Calibration storage for persistent calibration data
 class CalibrationStorage:
     """Persistent calibration storage for MCU oscillator calibration"""
@@ -102,6 +105,36 @@ class BinaryFrameParser:
     
     SYNC_WORD = b'\xAA\x55\xCC\x33'  # 4-byte sync word
     FRAME_HEADER_SIZE = 8  # sync(4) + length(2) + crc(2)
+    MAX_FRAME_PAYLOAD = 4096  # Larger lengths are treated as corruption
+    MAX_TEXT_LINE = 4096  # Larger unterminated text is treated as corruption
+    
+    # Payload record types (first payload byte) - must match src/protocol_codec.h
+    FRAME_TYPE_SAMPLE = 0x01
+    FRAME_TYPE_BATCH = 0x02
+    FRAME_TYPE_COMPRESSED = 0x03
+    FRAME_TYPE_EVENT = 0x10
+    FRAME_TYPE_STAT = 0x11
+    FRAME_TYPE_CORRECTION = 0x12
+    EVENT_NAMES = {1: 'PPS_LOCK_ADJUST', 2: 'PPS_PHASE_NUDGE', 3: 'CLOCK_RESET',
+                   4: 'SLOTS_SKIPPED', 5: 'REFERENCE_UPDATE', 6: 'MICROS_WRAP', 7: 'TRIGGER_ON',
+                   8: 'TRIGGER_OFF', 9: 'PPS_EPOCH_LOST'}
+    BATCH_FLAG_WIDE_DELTAS = 0x01
+    BATCH_FLAG_SLOT_STAMPS = 0x02  # EPOCH timestamp mode: anchor/deltas count grid slots
+    BATCH_FLAG_DECIMATED = 0x04    # Event trigger mode: continuous stream at rate / decimation
+    BATCH_FLAG_EVENT = 0x08        # Event trigger mode: full-rate trigger window samples
+    CORRECTION_REASONS = {0: 'STREAM_START', 0x80: 'SOURCE_CHANGE', 0x81: 'CALIBRATION_CHANGE',
+                          0x82: 'PHASE_ALIGNED'}  # 1-0x7F: the EVENT_NAMES code that moved the grid
+    # STAT record fields in StatField (mask bit) order: (key, struct format)
+    STAT_FIELDS = [('timing_source', 'B'), ('accuracy_q', 'H'), ('calibration_ppb', 'i'), ('flags', 'B'),
+                   ('pps_age_ms', 'I'), ('micros_wraps', 'I'), ('buffer_overflows', 'I'),
+                   ('samples_skipped', 'I'), ('boot_id', 'I'), ('stream_id', 'I'), ('deadline_misses', 'I'),
+                   ('sample_index', 'I'), ('reference_updates', 'I'), ('tx_ring_hwm', 'H'),
+                   ('checksum_errors', 'I'), ('sample_acquisition_us', 'I'), ('high_rate_overruns', 'I'),
+                   ('timer_overruns', 'I'), ('events_sent', 'I'), ('profile_loop_max_us', 'I'),
+                   ('profile_sample_max_us', 'I')]
+    STAT_MASK_KEYFRAME = 0x80000000
+    TIMING_SOURCE_NAMES = {0: 'PPS_ACTIVE', 1: 'PPS_HOLDOVER', 2: 'INTERNAL_CAL', 3: 'INTERNAL_RAW'}
+    CALIBRATION_SOURCE_NAMES = {0: 'NONE', 1: 'PPS_LIVE', 2: 'PI_PUSHED', 3: 'FLASH'}
     
     def __init__(self):
         self.buffer = bytearray()
@@ -168,6 +201,69 @@ class BinaryFrameParser:
         
         return frames
     
+    def add_mixed_data(self, data: bytes) -> list:
+        """Split a stream carrying both ASCII lines and binary frames.
+
+        Returns ('line', str) and ('frame', payload) items in arrival order.
+        ASCII lines never contain the sync word, so bytes before a sync word are text.
+        """
+        self.buffer.extend(data)
+        items = []
+        
+        while self.buffer:
+            sync_pos = self.buffer.find(self.SYNC_WORD)
+            text_end = sync_pos if sync_pos != -1 else len(self.buffer)
+            newline_pos = self.buffer.find(b'\n', 0, text_end)
+            
+            if newline_pos != -1:
+                # Complete text line ahead of any frame
+                line = self.buffer[:newline_pos].decode('utf-8', errors='ignore').strip()
+                del self.buffer[:newline_pos + 1]
+                if line:
+                    items.append(('line', line))
+                continue
+            
+            if sync_pos == -1:
+                # Partial text line (or partial sync word) - wait for more data
+                if len(self.buffer) > self.MAX_TEXT_LINE:
+                    self.stats['sync_losses'] += 1
+                    self.buffer.clear()
+                break
+            
+            if sync_pos > 0:
+                # Unterminated text before a frame is line noise
+                del self.buffer[:sync_pos]
+            
+            if len(self.buffer) < self.FRAME_HEADER_SIZE:
+                break
+            
+            self.frame_length = struct.unpack('<H', self.buffer[4:6])[0]
+            self.crc_expected = struct.unpack('<H', self.buffer[6:8])[0]
+            if self.frame_length > self.MAX_FRAME_PAYLOAD:
+                # Corrupt length - skip this sync word and rescan
+                self.stats['sync_losses'] += 1
+                del self.buffer[:len(self.SYNC_WORD)]
+                continue
+            
+            total_frame_size = self.FRAME_HEADER_SIZE + self.frame_length
+            if len(self.buffer) < total_frame_size:
+                break
+            
+            payload = bytes(self.buffer[self.FRAME_HEADER_SIZE:total_frame_size])
+            self.stats['frames_received'] += 1
+            if self._verify_crc(payload, self.crc_expected):
+                items.append(('frame', payload))
+                self.stats['frames_valid'] += 1
+                del self.buffer[:total_frame_size]
+            else:
+                self.logger.warning("Binary frame CRC mismatch")
+                self.stats['frames_invalid'] += 1
+                self.stats['crc_errors'] += 1
+                # Only drop the sync word: a bad length must not swallow following data
+                del self.buffer[:len(self.SYNC_WORD)]
+        
+        return items
+    
     def _verify_crc(self, data: bytes, expected_crc: int) -> bool:
         """Verify CRC-16 of frame data"""
         try:
@@ -921,6 +1017,11 @@ class RobustTimestampGenerator:
 
 
 class HostTimingSeismicAcquisition:
+    RELIABLE_ACK_INTERVAL_S = 0.25   # Cumulative ACK cadence
+    RELIABLE_NACK_INTERVAL_S = 0.5   # Repeat a NACK at most this often while its gap is open
+    RELIABLE_GAP_TIMEOUT_S = 5.0     # Then accept the loss (the MCU window holds ~8 s at 100 Hz)
+    RELIABLE_MAX_PENDING_FRAMES = 256
+    
     def __init__(self, port=None, baudrate=115200, device_id="XIAO-1234"):
         self.port = port
         self.baudrate = baudrate
@@ -941,6 +1042,7 @@ class HostTimingSeismicAcquisition:
         self.data_callback = None
         self.error_callback = None
         self.status_callback = None
+        self.sample_block_callback = None
         self.running = False
         self.rx_thread = None
         self.streaming = False
@@ -996,7 +1098,15 @@ class HostTimingSeismicAcquisition:
         # NEW: Enhanced MCU communication features
         self.calibration_storage = CalibrationStorage()
         self.binary_parser = BinaryFrameParser()
+        self.native_decoder = create_native_decoder()  # None: frames are split and decoded in Python
         self.binary_mode_enabled = False
+        
+        # SELFTEST sweep: its streams are load only, samples are not delivered while it runs
+        self.selftest_running = False
+        self.selftest_saved_binary_mode = False
+        self.selftest_columns = []
+        self.selftest_results = []
+        self.selftest_limits = {}
         self.binary_frame_stats = {
             'frames_received': 0,
             'frames_valid': 0,
@@ -1004,6 +1114,19 @@ class HostTimingSeismicAcquisition:
             'crc_errors': 0,
             'sync_losses': 0
         }
+        self.mcu_events = deque(maxlen=100)  # Recent EVENT records (binary frames or EVENT: lines)
+        self.stat_record_fields = None  # Raw STAT frame fields; None until a keyframe arrives
+        self.stat_record_seq = None
+        self.epoch_correction = None  # Latest slot -> MCU time correction record (EPOCH timestamp mode)
+        self.trigger_event_id = None  # Sample index of the open trigger window (TRIGGER_ON event), or None
+        self.stream_index_state = None  # stream_id, last 32-bit sample index and unwrapped count (binary frames)
+        # Reliable delivery (SET_RELIABLE:ON): sample frames are put back in index order and
+        # acknowledged; gaps are NACKed until the MCU resends them or they age out
+        self.reliable_mode_enabled = False
+        self.reliable_state = {'stream_id': None, 'next_index': None, 'pending': {}, 'gap_since': None,
+                               'last_nack': 0.0, 'last_ack': 0.0}
+        self.reliable_stats = {'frames_in_order': 0, 'frames_reordered': 0, 'duplicates': 0,
+                               'nacks_sent': 0, 'acks_sent': 0, 'samples_abandoned': 0}
         
         # MCU status tracking
         self.mcu_status = {
@@ -1043,6 +1166,7 @@ class HostTimingSeismicAcquisition:
             'stream_id': None,
             'start_time': None,
             'pps_locked_start': False,
+            'pps_epoch_start': None,  # START_STREAM_EPOCH second: sample n is at pps_epoch_start + n / rate
             'session_header_received': False,
             'session_id': None,  # Unique session identifier
             'session_start_timestamp': None,  # UTC timestamp of session start
@@ -1303,6 +1427,10 @@ class HostTimingSeismicAcquisition:
                         self._process_line(data_item['data'])
                     elif data_item['type'] == 'binary':
                         self._process_binary_data(data_item['data'])
+                    elif data_item['type'] == 'frame':
+                        self._process_binary_frame(data_item['data'])
+                    elif data_item['type'] == 'decoded':
+                        self._process_decoded_block(*data_item['data'])
                     
                     # Mark task as done
                     self.parsing_queue.task_done()
@@ -1321,6 +1449,10 @@ class HostTimingSeismicAcquisition:
     
     def _process_buffer_lines(self):
         """Process complete lines from the serial read buffer"""
+        if self.binary_mode_enabled:
+            self._process_buffer_mixed()
+            return
+        
         try:
             # Convert buffer to string for line processing
             buffer_str = self.serial_read_buffer.decode('utf-8', errors='ignore')
@@ -1357,6 +1489,35 @@ class HostTimingSeismicAcquisition:
             # Clear buffer on error
             self.serial_read_buffer.clear()
             
+    def _process_buffer_mixed(self):
+        """Split the serial read buffer into text lines and binary frames (binary output mode)"""
+        if self.native_decoder is not None:
+            # One call splits and decodes the whole read; the block keeps arrival order
+            try:
+                block = self.native_decoder.decode(bytes(self.serial_read_buffer))
+            except MemoryError as e:
+                self.logger.error(f"Native frame decoder: {e}")
+                block = None
+            self.serial_read_buffer.clear()
+            if block and block[0]:
+                try:
+                    self.parsing_queue.put_nowait({'type': 'decoded', 'data': block})
+                except queue.Full:
+                    self.logger.warning("Parsing queue full, dropping decoded block")
+            return
+        
+        items = self.binary_parser.add_mixed_data(bytes(self.serial_read_buffer))
+        self.serial_read_buffer.clear()
+        
+        for item_type, item_data in items:
+            try:
+                self.parsing_queue.put_nowait({
+                    'type': item_type,
+                    'data': item_data
+                })
+            except queue.Full:
+                self.logger.warning(f"Parsing queue full, dropping {item_type}")
+            
     def _receiver_thread(self):
         """Enhanced receiver thread"""
         while self.running:
@@ -1514,6 +1675,18 @@ class HostTimingSeismicAcquisition:
                     self._reset_sample_tracking()
                 elif "Streaming stopped" in data:
                     self.streaming = False
+                elif "Output format set to" in data:
+                    # Frames interleave with text in BINARY and BATCH; demux accordingly
+                    self.binary_mode_enabled = "BINARY" in data or "BATCH" in data or "COMPRESSED" in data
+                elif data.startswith("SELFTEST started"):
+                    # Steps switch among FULL, BINARY and BATCH without an output format response
+                    self.selftest_running = True
+                    self.selftest_saved_binary_mode = self.binary_mode_enabled
+                    self.binary_mode_enabled = True
+                    self.selftest_results = []
+                elif data.startswith("SELFTEST complete") or data.startswith("SELFTEST aborted"):
+                    self.selftest_running = False
+                    self.binary_mode_enabled = self.selftest_saved_binary_mode
                 elif "filter" in data.lower() or "sinc" in data.lower():
                     # Handle filter-related OK responses
                     print(f"✅ Filter command acknowledged: {data}")
@@ -1531,8 +1704,18 @@ class HostTimingSeismicAcquisition:
                 # Deliver as command response for callers waiting on GET_TIMING_STATUS
                 self.command_response = (True, data)
                 self.command_event.set()
+            elif prefix in ("SELFTEST", "SELFTEST_COLUMNS", "SELFTEST_LIMITS", "SELFTEST_LIMIT"):
+                self._handle_selftest_line(prefix, data)
             elif prefix == "DEBUG":
                 print(f"MCU Debug: {data}")
+            elif prefix == "EVENT":
+                # Text form of an event record: name,us,a,b
+                fields = data.split(",")
+                if len(fields) == 4:
+                    try:
+                        self._handle_mcu_event(fields[0], int(fields[1]), int(fields[2]), int(fields[3]))
+                    except ValueError:
+                        pass
             elif prefix == "FILTER":
                 # Handle filter response from MCU (simple, like other responses)
                 print(f"MCU Filter: {data}")
@@ -1588,8 +1771,39 @@ class HostTimingSeismicAcquisition:
         # UPDATED: Reset timestamp generator
         print("Sample tracking reset for new stream. Timestamp generator maintains its primed start time.")
     
+    def _handle_selftest_line(self, prefix, data):
+        """SELFTEST rows (one per step) and the cached limit table (after the sweep and on GET_SELFTEST)"""
+        if prefix == "SELFTEST_COLUMNS":
+            self.selftest_columns = data.split(",")
+        elif prefix == "SELFTEST":
+            row = dict(zip(self.selftest_columns, data.split(",")))
+            for key, value in row.items():
+                if key not in ("format", "result"):
+                    try:
+                        row[key] = int(value)
+                    except ValueError:
+                        pass
+            self.selftest_results.append(row)
+            print(f"MCU SELFTEST: {data}")
+        elif prefix == "SELFTEST_LIMITS":
+            self.selftest_limits = {'config': dict(item.split("=", 1) for item in data.split(",") if "=" in item),
+                                    'cells': {}}
+            # Header line answers GET_SELFTEST; the per-cell lines follow it
+            self.command_response = (True, f"SELFTEST_LIMITS:{data}")
+            self.command_event.set()
+        elif prefix == "SELFTEST_LIMIT":
+            fields = dict(item.split("=", 1) for item in data.split(",") if "=" in item)
+            channels = int(fields.pop('channels', 0))
+            reads = int(fields.pop('reads', 0))
+            cells = self.selftest_limits.setdefault('cells', {})
+            for output_format, limit in fields.items():
+                pass_hz, _, fail_hz = limit.partition("/")
+                cells[(channels, reads, output_format)] = {'pass_hz': int(pass_hz), 'fail_hz': int(fail_hz or 0)}
+    
     def _process_data_line(self, line):
         """Process enhanced data lines from MCU (sequence,mcu_micros,timing_source,accuracy_us,value1,value2,value3)"""
+        if self.selftest_running:
+            return
         try:
             parts = line.split(",")
             if len(parts) >= 6:  # sequence,mcu_micros,timing_source,accuracy_us,value1[,value2,value3]
@@ -1598,72 +1812,7 @@ class HostTimingSeismicAcquisition:
                 timing_source = int(parts[2].strip())
                 accuracy_us = float(parts[3].strip())
                 values = [int(parts[i].strip()) for i in range(4, len(parts))]
-                
-                # CRITICAL FIX: Global wraparound detection in data pipeline
-                if hasattr(self, '_last_processed_sequence') and self._last_processed_sequence is not None:
-                    if self._last_processed_sequence == 65535 and sequence == 0:
-                        print(f"🚨 GLOBAL WRAPAROUND DETECTION IN DATA PIPELINE: {self._last_processed_sequence} -> {sequence}")
-                        print(f"   Forcing timestamp generator recovery to prevent data loss")
-                        
-                        # Force wraparound recovery in timestamp generator
-                        if hasattr(self.timing_adapter, 'timestamp_generator'):
-                            self.timing_adapter.timestamp_generator.force_wraparound_recovery(sequence)
-                            print(f"   Timestamp generator recovery completed")
-                
-                self._last_processed_sequence = sequence
-                
-                # CRITICAL: Generate host timestamp using MCU timestamp as primary time axis
-                host_timestamp = self.timing_adapter.generate_timestamp(
-                    sequence, 
-                    mcu_timestamp_us=mcu_micros
-                )
-                
-                # VERIFY: Timestamp is quantized (should end with 0 for proper quantization)
-                quantization_ms = getattr(self.timing_adapter.timestamp_generator, 'quantization_ms', 10)
-                if host_timestamp % quantization_ms != 0:
-                    print(f"🚨 WARNING: Non-quantized timestamp detected: {host_timestamp}ms (ends with {host_timestamp % quantization_ms})")
-                    print(f"   This indicates a timestamp generation bypass!")
-                    print(f"   Expected: All timestamps should end with 0")
-                    print(f"   Sequence: {sequence}")
-                
-                # Analyze MCU timing quality
-                self._analyze_mcu_timing_quality(sequence, mcu_micros, timing_source, accuracy_us)
-                
-                # Update stats
-                self.connection_stats['data_packets_received'] += 1
-                self.connection_stats['last_data_time'] = time.time()
-                self.sample_tracking['sample_count'] += 1
-                
-                # Track sequence for gap detection
-                if self.sample_tracking['last_sequence'] is not None:
-                    expected_sequence = (self.sample_tracking['last_sequence'] + 1) % 65536
-                    if sequence != expected_sequence:
-                        gap = self._calculate_sequence_gap(self.sample_tracking['last_sequence'], sequence)
-                        self.sample_tracking['sequence_gaps'] += gap
-                        print(f"Sequence gap detected: expected {expected_sequence}, got {sequence} (gap: {gap})")
-                
-                self.sample_tracking['last_sequence'] = sequence
-                
-                # Store enhanced sample for timing analysis
-                timing_info = {
-                    'mcu_micros': mcu_micros,
-                    'timing_source': timing_source,
-                    'accuracy_us': accuracy_us,
-                    'source_name': self._get_timing_source_name(timing_source)
-                }
-                
-                sample_info = {
-                    'sequence': sequence,
-                    'timestamp': host_timestamp,
-                    'arrival_time': time.time(),
-                    'values': values,
-                    'timing_info': timing_info
-                }
-                self.sample_tracking['sample_buffer'].append(sample_info)
-                
-                # Call data callback with enhanced timing info
-                if self.data_callback:
-                    self.data_callback(host_timestamp, sequence, values, timing_info)
+                self._handle_sample(sequence, mcu_micros, timing_source, accuracy_us, values)
             else:
                 # Fallback to simple format for backward compatibility
                 if len(parts) >= 2:  # At least sequence and one value
@@ -1726,6 +1875,116 @@ class HostTimingSeismicAcquisition:
             print(f"Error parsing enhanced data line: {line} - {e}")
             self.connection_stats['total_errors'] += 1
 
+    def _track_stream_index(self, stream_id, sample_index):
+        """Unwrapped sample count of a binary-frame sample; a gap is one modulo-2^32 subtraction"""
+        state = self.stream_index_state
+        if state is None or state['stream_id'] != stream_id:
+            if state is not None:
+                # New MCU stream: its index restarts, so the generator's sequence reference does too
+                self.logger.info(f"MCU stream {state['stream_id']} -> {stream_id}, sample index restarts at {sample_index}")
+                self.timing_adapter.timestamp_generator.reset_for_restart()
+            self.stream_index_state = {'stream_id': stream_id, 'last_index': sample_index, 'count': sample_index}
+            return sample_index
+        gap = (sample_index - state['last_index'] - 1) & 0xFFFFFFFF
+        if gap:
+            self.sample_tracking['sequence_gaps'] += gap
+            print(f"Sample index gap detected: expected {(state['last_index'] + 1) & 0xFFFFFFFF}, "
+                  f"got {sample_index} (gap: {gap})")
+        state['last_index'] = sample_index
+        state['count'] += gap + 1
+        return state['count']
+
+    def _handle_sample(self, sequence, mcu_micros, timing_source, accuracy_us, values, epoch_index=None,
+                       stream_index=None, stream_kind=None):
+        """Timestamp, track and dispatch one MCU sample (shared by ASCII and binary paths)
+
+        stream_index: (stream_id, 32-bit sample index) from binary frames. When present the unwrapped
+        count drives gap detection and the timestamp generator, so the 16-bit wrap/restart heuristics
+        below are skipped; sequence stays the 16-bit view for callbacks.
+        stream_kind: 'continuous' or 'event' for event trigger mode frames (SET_TRIGGER), else None.
+        """
+        if self.selftest_running:
+            return  # SELFTEST load stream, not acquisition data
+        sample_count = None
+        if stream_index is not None:
+            sample_count = self._track_stream_index(*stream_index)
+            self._last_processed_sequence = None
+        elif hasattr(self, '_last_processed_sequence') and self._last_processed_sequence is not None:
+            # CRITICAL FIX: Global wraparound detection in data pipeline
+            if self._last_processed_sequence == 65535 and sequence == 0:
+                print(f"🚨 GLOBAL WRAPAROUND DETECTION IN DATA PIPELINE: {self._last_processed_sequence} -> {sequence}")
+                print(f"   Forcing timestamp generator recovery to prevent data loss")
+                
+                # Force wraparound recovery in timestamp generator
+                if hasattr(self.timing_adapter, 'timestamp_generator'):
+                    self.timing_adapter.timestamp_generator.force_wraparound_recovery(sequence)
+                    print(f"   Timestamp generator recovery completed")
+        
+        if sample_count is None:
+            self._last_processed_sequence = sequence
+        
+        # CRITICAL: Generate host timestamp using MCU timestamp as primary time axis
+        host_timestamp = self.timing_adapter.generate_timestamp(
+            sequence if sample_count is None else sample_count,
+            mcu_timestamp_us=mcu_micros
+        )
+        
+        # VERIFY: Timestamp is quantized (should end with 0 for proper quantization)
+        quantization_ms = getattr(self.timing_adapter.timestamp_generator, 'quantization_ms', 10)
+        if host_timestamp % quantization_ms != 0:
+            print(f"🚨 WARNING: Non-quantized timestamp detected: {host_timestamp}ms (ends with {host_timestamp % quantization_ms})")
+            print(f"   This indicates a timestamp generation bypass!")
+            print(f"   Expected: All timestamps should end with 0")
+            print(f"   Sequence: {sequence}")
+        
+        # Analyze MCU timing quality
+        self._analyze_mcu_timing_quality(sequence, mcu_micros, timing_source, accuracy_us)
+        
+        # Update stats
+        self.connection_stats['data_packets_received'] += 1
+        self.connection_stats['last_data_time'] = time.time()
+        self.sample_tracking['sample_count'] += 1
+        
+        # Track sequence for gap detection (binary frames already did it in _track_stream_index)
+        if sample_count is None and self.sample_tracking['last_sequence'] is not None:
+            expected_sequence = (self.sample_tracking['last_sequence'] + 1) % 65536
+            if sequence != expected_sequence:
+                gap = self._calculate_sequence_gap(self.sample_tracking['last_sequence'], sequence)
+                self.sample_tracking['sequence_gaps'] += gap
+                print(f"Sequence gap detected: expected {expected_sequence}, got {sequence} (gap: {gap})")
+        
+        self.sample_tracking['last_sequence'] = sequence
+        
+        # Store enhanced sample for timing analysis
+        timing_info = {
+            'mcu_micros': mcu_micros,
+            'timing_source': timing_source,
+            'accuracy_us': accuracy_us,
+            'source_name': self._get_timing_source_name(timing_source)
+        }
+        if epoch_index is not None:
+            timing_info['pps_epoch'], timing_info['epoch_index'] = epoch_index
+        if stream_index is not None:
+            timing_info['stream_id'] = stream_index[0]
+            timing_info['sample_index'] = sample_count
+        if stream_kind is not None:
+            timing_info['stream_kind'] = stream_kind
+            if stream_kind == 'event':
+                timing_info['trigger_event'] = self.trigger_event_id
+        
+        sample_info = {
+            'sequence': sequence,
+            'timestamp': host_timestamp,
+            'arrival_time': time.time(),
+            'values': values,
+            'timing_info': timing_info
+        }
+        self.sample_tracking['sample_buffer'].append(sample_info)
+        
+        # Call data callback with enhanced timing info
+        if self.data_callback:
+            self.data_callback(host_timestamp, sequence, values, timing_info)
+
     def _get_timing_source_name(self, source):
         """Get human-readable timing source name"""
         sources = {
@@ -1906,15 +2165,29 @@ class HostTimingSeismicAcquisition:
         return result
         
     def set_channels(self, num_channels):
-        """Set number of channels (1-3)"""
-        if num_channels < 1 or num_channels > 3:
-            raise ValueError("Number of channels must be between 1 and 3")
+        """Set number of channels (1-5)"""
+        if num_channels < 1 or num_channels > 5:
+            raise ValueError("Number of channels must be between 1 and 5")
             
         result = self._send_command(f"SET_CHANNELS:{num_channels}")
         if result and not result[0]:
             raise RuntimeError(f"Failed to set channels: {result[1]}")
         return result
         
+    def set_channel_map(self, pairs):
+        """Set the differential input pairs, e.g. [(0, 1), (2, 10)]; 10 = AINCOM. Also sets the channel count."""
+        if len(pairs) < 1 or len(pairs) > 5:
+            raise ValueError("Channel map must have between 1 and 5 pairs")
+        for pos, neg in pairs:
+            if not (0 <= pos <= 10 and 0 <= neg <= 10) or pos == neg:
+                raise ValueError(f"Invalid input pair {pos}-{neg} (inputs 0-10, pos != neg)")
+            
+        mapping = ",".join(f"{pos}-{neg}" for pos, neg in pairs)
+        result = self._send_command(f"SET_CHANNEL_MAP:{mapping}")
+        if result and not result[0]:
+            raise RuntimeError(f"Failed to set channel map: {result[1]}")
+        return result
+        
     def set_filter(self, filter_index):
         """Set ADC digital filter (1-5)"""
         if filter_index < 1 or filter_index > 5:
@@ -1954,6 +2227,53 @@ class HostTimingSeismicAcquisition:
             
         return result
         
+    def set_decimation(self, ratio):
+        """Set MCU CIC + FIR decimation ratio (0=off uses dithering average, else 4, 8, 16, 32 or 64 reads per sample)"""
+        if ratio not in (0, 4, 8, 16, 32, 64):
+            raise ValueError("Decimation ratio must be 0 (off), 4, 8, 16, 32 or 64")
+        
+        result = self._send_command(f"SET_DECIMATION:{ratio}")
+        if result and not result[0]:
+            raise RuntimeError(f"Failed to set decimation: {result[1]}")
+        return result
+        
+    def set_acquisition_mode(self, mode):
+        """Select MCU acquisition engine ('POLLED' busy-wait, 'DMA' DRDY-interrupt driven, 'SCAN' pipelined DMA)"""
+        mode = mode.upper()
+        if mode not in ("POLLED", "DMA", "SCAN"):
+            raise ValueError("Acquisition mode must be POLLED, DMA or SCAN")
+        
+        result = self._send_command(f"SET_ACQUISITION:{mode}")
+        if result and not result[0]:
+            raise RuntimeError(f"Failed to set acquisition mode: {result[1]}")
+        return result
+        
+    def set_scheduler_mode(self, mode):
+        """Select MCU sample scheduler ('LOOP' polled in loop() or 'TIMER' hardware TCC tick)"""
+        mode = mode.upper()
+        if mode not in ("LOOP", "TIMER"):
+            raise ValueError("Scheduler mode must be LOOP or TIMER")
+        
+        result = self._send_command(f"SET_SCHEDULER:{mode}")
+        if result and not result[0]:
+            raise RuntimeError(f"Failed to set scheduler mode: {result[1]}")
+        return result
+
+    def set_event_trigger(self, sta_s=None, lta_s=30.0, on_ratio=3.0, off_ratio=1.5, channel=1,
+                          pre_samples=100, post_samples=200, decimation=10):
+        """Configure the MCU STA/LTA trigger (BATCH/COMPRESSED output); sta_s=None turns it off"""
+        if sta_s is None:
+            commands = ["SET_TRIGGER:OFF"]
+        else:
+            commands = [f"SET_TRIGGER_WINDOW:{int(pre_samples)},{int(post_samples)},{int(decimation)}",
+                        f"SET_TRIGGER:{sta_s},{lta_s},{on_ratio},{off_ratio},{int(channel)}"]
+        result = None
+        for command in commands:
+            result = self._send_command(command)
+            if not (result and result[0] and result[1].startswith("OK:")):
+                raise RuntimeError(f"Failed to configure event trigger: {result[1] if result else 'timeout'}")
+        return result
+
     def get_dithering(self):
         """Get current dithering setting"""
         result = self._send_command("GET_DITHERING")
@@ -2007,8 +2327,8 @@ class HostTimingSeismicAcquisition:
         timing_status = self.timing_manager.get_status()
         host_pps_available = timing_status['reference_source'] == 'GPS+PPS'
 
-        # If PPS is present on both sides, prefer PPS-locked start
-        if mcu_pps_available and host_pps_available:
+        # If PPS is present on both sides, prefer PPS-locked start (MCU high-rate mode starts via SYNC)
+        if mcu_pps_available and host_pps_available and (rate is None or rate <= 1000):
             pps_wait = 2  # wait for 2 edges for safety
             rate_to_use = int(rate) if rate is not None else 100
             if rate is not None:
@@ -2061,8 +2381,9 @@ class HostTimingSeismicAcquisition:
 
         cmd = "START_STREAM_SYNC"
         if rate is not None:
-            if rate < 1 or rate > 1000:
-                raise ValueError("Streaming rate must be between 1 and 1000 Hz")
+            # Above 1000 Hz the MCU runs its high-rate mode and validates the rate itself
+            if rate < 1 or rate > 19200:
+                raise ValueError("Streaming rate must be between 1 and 19200 Hz")
             cmd += f":{rate},{delay_ms}"
             self.sample_tracking['expected_rate'] = rate
             self.timestamp_generator.update_rate(rate)
@@ -2129,6 +2450,24 @@ class HostTimingSeismicAcquisition:
         time.sleep(0.5)
         return result
         
+    def run_selftest(self, seconds_per_step=2):
+        """Start the on-device SELFTEST sweep; rows collect in selftest_results, limits in selftest_limits"""
+        if seconds_per_step < 1 or seconds_per_step > 10:
+            raise ValueError("Seconds per step must be between 1 and 10")
+            
+        result = self._send_command(f"SELFTEST:{seconds_per_step}")
+        if result and not result[0]:
+            raise RuntimeError(f"Failed to start SELFTEST: {result[1]}")
+        return result
+        
+    def abort_selftest(self):
+        """Stop a running SELFTEST sweep; the device restores its stream settings and drops the limits"""
+        return self._send_command("SELFTEST:ABORT")
+        
+    def get_selftest_limits(self):
+        """Request the cached SELFTEST limits (parsed into selftest_limits)"""
+        return self._send_command("GET_SELFTEST:", timeout=5.0)
+        
     def get_status(self):
         """Request system status"""
         return self._send_command("GET_STATUS", timeout=5.0)
@@ -2197,6 +2536,16 @@ class HostTimingSeismicAcquisition:
         """Register callback for sample data"""
         self.data_callback = callback
         
+    def register_sample_block_callback(self, callback):
+        """Register callback for natively decoded sample columns, one call per serial read.
+
+        Receives the frame_codec column dict (NumPy arrays when available): stream_id, sample_index,
+        stamp (us, or grid slot in EPOCH mode), timing_source, accuracy_q (0.1 us), flags, channels and
+        values (rows x value_stride). Only called when the native decoder is loaded and reliable
+        delivery is off; per-sample callbacks still run.
+        """
+        self.sample_block_callback = callback
+        
     def register_error_callback(self, callback):
         """Register callback for errors"""
         self.error_callback = callback
@@ -2507,41 +2856,81 @@ class HostTimingSeismicAcquisition:
                     'temperature_c': float(parts[11]),
                     'firmware_version': parts[12] if len(parts) > 12 else 'unknown'
                 }
+                if len(parts) >= 16:
+                    # Appended by firmware with the DMA TX ring: peak ring occupancy in bytes
+                    stat_info['tx_ring_hwm'] = int(parts[15])
                 
-                # Update MCU status
-                self.mcu_status.update(stat_info)
-                
-                # Check for stream_id changes (session gap detection)
-                if 'stream_id' in stat_info:
-                    new_stream_id = stat_info['stream_id']
-                    old_stream_id = self.session_info.get('stream_id')
-                    
-                    if old_stream_id is not None and new_stream_id != old_stream_id:
-                        self.detect_session_gap(self.session_info.get('boot_id', 0), new_stream_id)
-                    
-                    self.session_info['stream_id'] = new_stream_id
-                
-                # Update timing adapter with MCU status
-                if hasattr(self, 'timing_adapter'):
-                    self.timing_adapter.update_mcu_status(stat_info)
-                
-                # Log comprehensive STAT line information
-                self.logger.info(f"MCU STAT: source={stat_info['timing_source']}, "
-                               f"accuracy={stat_info['accuracy_us']}μs, "
-                               f"calibration={stat_info['calibration_ppm']}ppm, "
-                               f"calibration_valid={stat_info['calibration_valid']}, "
-                               f"pps_valid={stat_info['pps_valid']}, "
-                               f"pps_age={stat_info['pps_age_ms']}ms, "
-                               f"calibration_source={stat_info['calibration_source']}, "
-                               f"boot_id={stat_info['boot_id']}, "
-                               f"stream_id={stat_info['stream_id']}, "
-                               f"overflows={stat_info['buffer_overflows']}, "
-                               f"skipped={stat_info['samples_skipped']}, "
-                               f"temp={stat_info['temperature_c']}°C")
+                self._apply_stat_info(stat_info)
                 
         except Exception as e:
             self.logger.error(f"Failed to parse STAT message: {e}")
     
+    def _apply_stat_info(self, stat_info):
+        """Apply one health beacon (STAT line or STAT frame) to MCU status and session tracking"""
+        # Update MCU status
+        self.mcu_status.update(stat_info)
+        
+        # Check for stream_id changes (session gap detection)
+        if 'stream_id' in stat_info:
+            new_stream_id = stat_info['stream_id']
+            old_stream_id = self.session_info.get('stream_id')
+            
+            if old_stream_id is not None and new_stream_id != old_stream_id:
+                self.detect_session_gap(self.session_info.get('boot_id', 0), new_stream_id)
+            
+            self.session_info['stream_id'] = new_stream_id
+        
+        # Update timing adapter with MCU status
+        if hasattr(self, 'timing_adapter'):
+            self.timing_adapter.update_mcu_status(stat_info)
+        
+        # Log comprehensive STAT information
+        self.logger.info(f"MCU STAT: source={stat_info['timing_source']}, "
+                       f"accuracy={stat_info['accuracy_us']}μs, "
+                       f"calibration={stat_info['calibration_ppm']}ppm, "
+                       f"calibration_valid={stat_info['calibration_valid']}, "
+                       f"pps_valid={stat_info['pps_valid']}, "
+                       f"pps_age={stat_info['pps_age_ms']}ms, "
+                       f"calibration_source={stat_info['calibration_source']}, "
+                       f"boot_id={stat_info['boot_id']}, "
+                       f"stream_id={stat_info['stream_id']}, "
+                       f"overflows={stat_info['buffer_overflows']}, "
+                       f"skipped={stat_info['samples_skipped']}, "
+                       f"temp={stat_info.get('temperature_c')}°C")
+    
+    def _process_stat_frame(self, frame: bytes):
+        """Decode a binary STAT record: change mask plus the fields that changed since the last record"""
+        # type(1) seq(1) mask(4), then each flagged field in StatField order
+        _, seq, mask = struct.unpack_from('<BBI', frame, 0)
+        keyframe = bool(mask & BinaryFrameParser.STAT_MASK_KEYFRAME)
+        if not keyframe and (self.stat_record_fields is None or seq != (self.stat_record_seq + 1) & 0xFF):
+            # A lost delta record leaves unflagged fields unknown until the next keyframe
+            self.stat_record_fields = None
+            self.stat_record_seq = seq
+            self.binary_frame_stats['frames_valid'] += 1
+            return
+        
+        fields = {} if keyframe else dict(self.stat_record_fields)
+        offset = 6
+        for bit, (key, fmt) in enumerate(BinaryFrameParser.STAT_FIELDS):
+            if keyframe or mask & (1 << bit):
+                fields[key] = struct.unpack_from('<' + fmt, frame, offset)[0]
+                offset += struct.calcsize(fmt)
+        self.stat_record_fields = fields
+        self.stat_record_seq = seq
+        self.binary_frame_stats['frames_valid'] += 1
+        
+        stat_info = dict(fields)
+        stat_info.update({
+            'timing_source': BinaryFrameParser.TIMING_SOURCE_NAMES.get(fields['timing_source'], 'UNKNOWN'),
+            'accuracy_us': fields['accuracy_q'] / 10.0,
+            'calibration_ppm': fields['calibration_ppb'] / 1000.0,
+            'pps_valid': bool(fields['flags'] & 0x01),
+            'calibration_valid': bool(fields['flags'] & 0x02),
+            'calibration_source': BinaryFrameParser.CALIBRATION_SOURCE_NAMES.get(fields['flags'] >> 2, 'UNKNOWN'),
+        })
+        self._apply_stat_info(stat_info)
+    
     def _handle_overflow_message(self, data):
         """Handle OFLOW message from MCU"""
         try:
@@ -2722,6 +3111,7 @@ class HostTimingSeismicAcquisition:
                 'start_timestamp_utc': current_time.isoformat() + 'Z',
                 'start_timestamp_unix': current_time.timestamp(),
                 'pps_locked_start': self.session_info.get('pps_locked_start', False),
+                'pps_epoch_start': self.session_info.get('pps_epoch_start'),
                 'firmware_version': self.mcu_status.get('firmware_version', 'unknown'),
                 'calibration_ppm': self.mcu_status.get('calibration_ppm', 0.0),
                 'timing_source': self.mcu_status.get('timing_source', 'UNKNOWN'),
@@ -2898,47 +3288,354 @@ class HostTimingSeismicAcquisition:
         return {
             'enabled': self.binary_mode_enabled,
             'stats': self.binary_frame_stats,
-            'parser_stats': self.binary_parser.get_stats()
+            'parser_stats': (self.native_decoder.get_stats() if self.native_decoder is not None
+                             else self.binary_parser.get_stats()),
+            'native_decoder': self.native_decoder is not None
         }
     
     def _process_binary_data(self, data: bytes):
-        """Process binary data frames"""
+        """Process raw bytes carrying binary frames interleaved with ASCII lines"""
         try:
-            frames = self.binary_parser.add_data(data)
-            self.binary_frame_stats['frames_received'] += len(frames)
-            
-            for frame in frames:
-                # Parse binary frame payload
-                if len(frame) >= 8:  # Minimum frame size
-                    # Extract frame data (sequence, timestamp, values)
-                    sequence = struct.unpack('<H', frame[0:2])[0]
-                    mcu_timestamp_us = struct.unpack('<Q', frame[2:10])[0]  # 64-bit timestamp
-                    
-                    # Extract sensor values (assuming 3 channels, 4 bytes each)
-                    values = []
-                    for i in range(3):
-                        if len(frame) >= 10 + (i+1)*4:
-                            value = struct.unpack('<f', frame[10+i*4:14+i*4])[0]
-                            values.append(value)
-                    
-                    # Generate timestamp using MCU timestamp
-                    host_timestamp = self.timing_adapter.generate_timestamp(
-                        sequence, 
-                        mcu_timestamp_us=mcu_timestamp_us
-                    )
-                    
-                    # Call data callback
-                    if self.data_callback:
-                        self.data_callback(host_timestamp, sequence, values)
-                    
-                    self.binary_frame_stats['frames_valid'] += 1
+            for item_type, item_data in self.binary_parser.add_mixed_data(data):
+                if item_type == 'line':
+                    self._process_line(item_data)
                 else:
-                    self.binary_frame_stats['frames_invalid'] += 1
-                    
+                    self._process_binary_frame(item_data)
         except Exception as e:
             self.logger.error(f"Error processing binary data: {e}")
             self.binary_frame_stats['frames_invalid'] += 1
     
+    def _process_decoded_block(self, items, columns):
+        """Dispatch one native decoder result: lines and other frames as usual, sample records from columns"""
+        rows = None
+        for item_type, item_data in items:
+            if item_type == 'line':
+                self._process_line(item_data)
+            elif item_type == 'frame':
+                self._process_binary_frame(item_data)
+            elif self.reliable_mode_enabled:
+                # Reordering works on whole frames; the payload takes the Python path
+                self._process_binary_frame(item_data[0])
+            else:
+                if rows is None:
+                    rows = self._decoded_column_lists(columns)
+                self._process_decoded_samples(item_data[1], item_data[2], rows)
+        
+        if self.sample_block_callback and columns['rows'] and not (self.selftest_running or
+                                                                   self.reliable_mode_enabled):
+            try:
+                self.sample_block_callback(columns)
+            except Exception as e:
+                self.logger.error(f"Sample block callback error: {e}")
+    
+    @staticmethod
+    def _decoded_column_lists(columns):
+        """Columns as Python lists for per-sample dispatch (one C-level conversion per column)"""
+        return {name: (value.tolist() if hasattr(value, 'tolist') else value)
+                for name, value in columns.items() if name not in ('rows', 'value_stride')}
+    
+    def _process_decoded_samples(self, first_row: int, count: int, rows: dict):
+        """Dispatch the samples of one natively decoded SAMPLE/BATCH/COMPRESSED record"""
+        self.last_any_activity = time.time()
+        self.binary_frame_stats['frames_received'] += 1
+        slot_flag = BinaryFrameParser.BATCH_FLAG_SLOT_STAMPS
+        for row in range(first_row, first_row + count):
+            flags = rows['flags'][row]
+            self._handle_batch_sample((rows['stream_id'][row], rows['sample_index'][row]), rows['stamp'][row],
+                                      bool(flags & slot_flag), rows['timing_source'][row],
+                                      rows['accuracy_q'][row] / 10.0, rows['values'][row][:rows['channels'][row]],
+                                      self._batch_stream_kind(flags))
+        self.binary_frame_stats['frames_valid'] += 1
+    
+    def _process_binary_frame(self, frame: bytes):
+        """Decode one CRC-verified frame payload (record layouts documented in src/protocol_codec.h)"""
+        self.last_any_activity = time.time()
+        self.binary_frame_stats['frames_received'] += 1
+        try:
+            frame_type = frame[0] if frame else None
+            
+            if frame_type == BinaryFrameParser.FRAME_TYPE_SAMPLE and len(frame) >= 16:
+                if self.reliable_mode_enabled:
+                    self._reliable_receive(frame, struct.unpack_from('<I', frame, 5)[0],
+                                           struct.unpack_from('<I', frame, 1)[0], 1)
+                else:
+                    self._process_sample_frame(frame)
+            elif frame_type in (BinaryFrameParser.FRAME_TYPE_BATCH,
+                                BinaryFrameParser.FRAME_TYPE_COMPRESSED) and len(frame) >= 22:
+                if self.reliable_mode_enabled:
+                    self._reliable_receive(frame, struct.unpack_from('<I', frame, 5)[0],
+                                           struct.unpack_from('<I', frame, 1)[0], frame[9])
+                else:
+                    self._process_sample_frame(frame)
+            elif frame_type == BinaryFrameParser.FRAME_TYPE_EVENT and len(frame) >= 18:
+                # type(1) code(1) virtual_us(8) a(4) b(4)
+                _, code, mcu_micros, arg_a, arg_b = struct.unpack_from('<BBQii', frame, 0)
+                name = BinaryFrameParser.EVENT_NAMES.get(code, f'EVENT_{code}')
+                self._handle_mcu_event(name, mcu_micros, arg_a, arg_b)
+                self.binary_frame_stats['frames_valid'] += 1
+            elif frame_type == BinaryFrameParser.FRAME_TYPE_STAT and len(frame) >= 6:
+                self._process_stat_frame(frame)
+            elif frame_type == BinaryFrameParser.FRAME_TYPE_CORRECTION and len(frame) >= 31:
+                self._process_correction_frame(frame)
+            else:
+                self.binary_frame_stats['frames_invalid'] += 1
+                    
+        except Exception as e:
+            self.logger.error(f"Error processing binary frame: {e}")
+            self.binary_frame_stats['frames_invalid'] += 1
+    
+    def _process_sample_frame(self, frame: bytes):
+        """Decode a SAMPLE, BATCH or COMPRESSED payload"""
+        frame_type = frame[0]
+        if frame_type == BinaryFrameParser.FRAME_TYPE_BATCH:
+            self._process_batch_frame(frame)
+            return
+        if frame_type == BinaryFrameParser.FRAME_TYPE_COMPRESSED:
+            self._process_compressed_frame(frame)
+            return
+        # type(1) sample_index(4) stream_id(4) timestamp_us(4) source|channels<<4 (1) accuracy_0.1us(2)
+        # int32 x channels
+        _, sample_index, stream_id, mcu_micros, source_channels, accuracy_q = \
+            struct.unpack_from('<BIIIBH', frame, 0)
+        channels = source_channels >> 4
+        if len(frame) < 16 + 4 * channels:
+            self.binary_frame_stats['frames_invalid'] += 1
+            return
+        values = list(struct.unpack_from(f'<{channels}i', frame, 16))
+        self._handle_sample(sample_index & 0xFFFF, mcu_micros, source_channels & 0x0F, accuracy_q / 10.0,
+                            values, stream_index=(stream_id, sample_index))
+        self.binary_frame_stats['frames_valid'] += 1
+    
+    def enable_reliable_mode(self, enabled: bool = True) -> bool:
+        """Enable/disable acknowledged delivery with MCU-side retransmission (binary formats)"""
+        command = "SET_RELIABLE:ON" if enabled else "SET_RELIABLE:OFF"
+        result = self._send_command(command, timeout=2.0)
+        if not (result and result[0] and result[1].startswith("OK:")):
+            self.logger.warning(f"MCU rejected {command}: {result[1] if result else 'timeout'}")
+            return False
+        self.reliable_mode_enabled = enabled
+        self.reliable_state.update(stream_id=None, next_index=None, gap_since=None)
+        self.reliable_state['pending'].clear()
+        self.logger.info(f"Reliable delivery {'enabled' if enabled else 'disabled'}")
+        return True
+    
+    def get_reliable_status(self):
+        """Receive-side reliable delivery statistics"""
+        state = self.reliable_state
+        return dict(self.reliable_stats, enabled=self.reliable_mode_enabled, next_index=state['next_index'],
+                    frames_pending=len(state['pending']))
+    
+    def _send_link_command(self, cmd: str):
+        """Fire-and-forget link command (ACK/NACK): no response is expected, nothing is printed"""
+        try:
+            with self.connection_lock:
+                if self.ser and self.ser.is_open:
+                    self.ser.write(f"{cmd}\n".encode('ascii'))
+        except (OSError, serial.SerialException) as e:
+            self.logger.warning(f"Failed to send {cmd}: {e}")
+    
+    def _reliable_receive(self, frame: bytes, stream_id: int, first_index: int, count: int):
+        """Deliver sample frames in index order, holding early ones until the gap before them is resent"""
+        state = self.reliable_state
+        pending = state['pending']
+        if stream_id != state['stream_id']:
+            # New stream: the MCU has dropped the old window, so nothing before this frame can come back
+            state.update(stream_id=stream_id, next_index=first_index, gap_since=None)
+            pending.clear()
+        
+        offset = (first_index - state['next_index']) & 0xFFFFFFFF
+        if offset >= 0x80000000 or first_index in pending:
+            self.reliable_stats['duplicates'] += 1
+        elif offset > 0:
+            pending[first_index] = (frame, count)
+        else:
+            self._process_sample_frame(frame)
+            state['next_index'] = (first_index + count) & 0xFFFFFFFF
+            self.reliable_stats['frames_in_order'] += 1
+            self._drain_reliable_pending()
+        self._service_reliable_link()
+    
+    def _drain_reliable_pending(self):
+        state = self.reliable_state
+        pending = state['pending']
+        while state['next_index'] in pending:
+            frame, count = pending.pop(state['next_index'])
+            self._process_sample_frame(frame)
+            state['next_index'] = (state['next_index'] + count) & 0xFFFFFFFF
+            self.reliable_stats['frames_reordered'] += 1
+        # Resends that overlap already delivered samples
+        for index in [i for i in pending if ((i - state['next_index']) & 0xFFFFFFFF) >= 0x80000000]:
+            del pending[index]
+            self.reliable_stats['duplicates'] += 1
+    
+    def _service_reliable_link(self):
+        """Periodic cumulative ACK; NACK the gap before the oldest held frame, give up on it eventually"""
+        state = self.reliable_state
+        now = time.time()
+        if state['pending']:
+            next_index = state['next_index']
+            gap_end = min(state['pending'], key=lambda i: (i - next_index) & 0xFFFFFFFF)
+            gap = (gap_end - next_index) & 0xFFFFFFFF
+            if state['gap_since'] is None:
+                state['gap_since'] = now
+            if now - state['gap_since'] > self.RELIABLE_GAP_TIMEOUT_S or \
+                    len(state['pending']) > self.RELIABLE_MAX_PENDING_FRAMES:
+                # Evicted on the MCU, or the link is too lossy to catch up: accept the loss
+                self.logger.warning(f"Reliable delivery: giving up on {gap} samples from index {next_index}")
+                self.reliable_stats['samples_abandoned'] += gap
+                state['next_index'] = gap_end
+                state['gap_since'] = None
+                self._drain_reliable_pending()
+            elif now - state['last_nack'] >= self.RELIABLE_NACK_INTERVAL_S:
+                self._send_link_command(f"NACK:{next_index},{gap}")
+                state['last_nack'] = now
+                self.reliable_stats['nacks_sent'] += 1
+        else:
+            state['gap_since'] = None
+        
+        if now - state['last_ack'] >= self.RELIABLE_ACK_INTERVAL_S:
+            self._send_link_command(f"ACK:{state['next_index']}")
+            state['last_ack'] = now
+            self.reliable_stats['acks_sent'] += 1
+    
+    def _handle_mcu_event(self, name: str, mcu_micros: int, arg_a: int, arg_b: int):
+        """Record a firmware timing event (PPS lock adjust, clock reset, skipped slots, ...)"""
+        self.mcu_events.append({'time': time.time(), 'event': name, 'mcu_micros': mcu_micros,
+                                'a': arg_a, 'b': arg_b})
+        if name == 'TRIGGER_ON':
+            # Window frames follow their announcement; they are tagged with its first sample index
+            self.trigger_event_id = arg_a & 0xFFFFFFFF
+        self.logger.info(f"MCU event {name}: us={mcu_micros} a={arg_a} b={arg_b}")
+    
+    def _process_correction_frame(self, frame: bytes):
+        """Latch the slot -> time mapping sent by the MCU when its sample grid moved"""
+        # type(1) reason(1) source(1) accuracy_0.1us(2) epoch0(4) slots_per_epoch(2) slot(8) timestamp_us(8) ppb(4)
+        _, reason, timing_source, accuracy_q, epoch0, slots_per_epoch, slot, timestamp_us, calibration_ppb = \
+            struct.unpack_from('<BBBHIHQQi', frame, 0)
+        if reason in BinaryFrameParser.CORRECTION_REASONS:
+            reason_name = BinaryFrameParser.CORRECTION_REASONS[reason]
+        else:
+            reason_name = BinaryFrameParser.EVENT_NAMES.get(reason, f'REASON_{reason}')
+        self.epoch_correction = {'reason': reason_name, 'timing_source': timing_source,
+                                 'accuracy_us': accuracy_q / 10.0, 'epoch0': epoch0,
+                                 'slots_per_epoch': max(slots_per_epoch, 1), 'slot': slot,
+                                 'mcu_micros': timestamp_us, 'calibration_ppm': calibration_ppb / 1000.0}
+        self.binary_frame_stats['frames_valid'] += 1
+        self.logger.info(f"MCU timestamp correction {reason_name}: slot={slot} us={timestamp_us} "
+                         f"epoch0={epoch0} rate={slots_per_epoch}")
+    
+    @staticmethod
+    def _batch_stream_kind(flags):
+        """Event trigger mode tags every batch frame as continuous (decimated) or event (full rate)"""
+        if flags & BinaryFrameParser.BATCH_FLAG_EVENT:
+            return 'event'
+        if flags & BinaryFrameParser.BATCH_FLAG_DECIMATED:
+            return 'continuous'
+        return None
+    
+    def _handle_batch_sample(self, stream_index, stamp, slot_stamps, timing_source, accuracy_us, values,
+                             stream_kind=None):
+        """Dispatch one batch/compressed sample; EPOCH-mode slots are mapped through the correction record"""
+        sequence = stream_index[1] & 0xFFFF
+        if not slot_stamps:
+            self._handle_sample(sequence, stamp, timing_source, accuracy_us, values, stream_index=stream_index,
+                                stream_kind=stream_kind)
+            return
+        correction = self.epoch_correction
+        if correction is None:
+            # Records precede the samples they cover; none yet means the stream start was missed
+            self.binary_frame_stats['frames_invalid'] += 1
+            return
+        # Slots are 1/rate s apart in true time (the grid is PPS-disciplined); no host-side drift model
+        rate = correction['slots_per_epoch']
+        mcu_micros = correction['mcu_micros'] + ((stamp - correction['slot']) * 1000000) // rate
+        epoch_index = (correction['epoch0'] + stamp // rate, stamp % rate)
+        self._handle_sample(sequence, mcu_micros, timing_source, accuracy_us, values, epoch_index, stream_index,
+                            stream_kind)
+    
+    def _process_batch_frame(self, frame: bytes):
+        """Decode a batch frame: one 64-bit anchor timestamp plus per-sample deltas"""
+        # type(1) first_index(4) stream_id(4) count(1) source|channels<<4 (1) flags(1) accuracy_0.1us(2)
+        # anchor_us(8)
+        _, first_index, stream_id, count, source_channels, flags, accuracy_q, anchor_us = \
+            struct.unpack_from('<BIIBBBHQ', frame, 0)
+        channels = source_channels >> 4
+        timing_source = source_channels & 0x0F
+        accuracy_us = accuracy_q / 10.0
+        delta_fmt = 'I' if flags & BinaryFrameParser.BATCH_FLAG_WIDE_DELTAS else 'H'
+        entry = struct.Struct(f'<{delta_fmt}{channels}i')
+        
+        if len(frame) < 22 + count * entry.size:
+            self.binary_frame_stats['frames_invalid'] += 1
+            return
+        
+        slot_stamps = bool(flags & BinaryFrameParser.BATCH_FLAG_SLOT_STAMPS)
+        stream_kind = self._batch_stream_kind(flags)
+        mcu_micros = anchor_us
+        offset = 22
+        for i in range(count):
+            fields = entry.unpack_from(frame, offset)
+            offset += entry.size
+            mcu_micros += fields[0]
+            self._handle_batch_sample((stream_id, (first_index + i) & 0xFFFFFFFF), mcu_micros, slot_stamps,
+                                      timing_source, accuracy_us, list(fields[1:]), stream_kind)
+        self.binary_frame_stats['frames_valid'] += 1
+    
+    @staticmethod
+    def decode_compressed_items(frame: bytes, offset: int, item_count: int) -> list:
+        """Unpack the Steim-2 style word stream of a compressed frame into signed 32-bit items"""
+        word_count = frame[offset]
+        words_start = offset + 1
+        codes_start = words_start + 4 * word_count
+        if len(frame) < codes_start + (word_count + 1) // 2:
+            raise ValueError("Compressed frame truncated")
+        
+        items = []
+        for w in range(word_count):
+            word = struct.unpack_from('<I', frame, words_start + 4 * w)[0]
+            code = (frame[codes_start + w // 2] >> (4 * (w & 1))) & 0x0F
+            if code < 1 or code > 7:
+                raise ValueError(f"Invalid packing code {code}")
+            bits = 32 // code
+            for j in range(code):
+                item = (word >> (32 - (j + 1) * bits)) & ((1 << bits) - 1)
+                if item & (1 << (bits - 1)):
+                    item -= 1 << bits
+                items.append(item)
+        if len(items) != item_count:
+            raise ValueError(f"Compressed frame holds {len(items)} items, expected {item_count}")
+        return items
+    
+    def _process_compressed_frame(self, frame: bytes):
+        """Decode a compressed batch: first sample in full, then packed first differences"""
+        # Same 22-byte header as a batch frame; see compressBatchRecord() in src/protocol_codec.h
+        _, first_index, stream_id, count, source_channels, flags, accuracy_q, anchor_us = \
+            struct.unpack_from('<BIIBBBHQ', frame, 0)
+        channels = source_channels >> 4
+        timing_source = source_channels & 0x0F
+        accuracy_us = accuracy_q / 10.0
+        slot_stamps = bool(flags & BinaryFrameParser.BATCH_FLAG_SLOT_STAMPS)
+        stream_kind = self._batch_stream_kind(flags)
+        
+        values = list(struct.unpack_from(f'<{channels}i', frame, 22))
+        items = self.decode_compressed_items(frame, 22 + 4 * channels, (count - 1) * (1 + channels))
+        
+        mcu_micros = anchor_us
+        delta = 0
+        self._handle_batch_sample((stream_id, first_index), mcu_micros, slot_stamps, timing_source, accuracy_us,
+                                  list(values), stream_kind)
+        for i in range(1, count):
+            base = (i - 1) * (1 + channels)
+            delta = (delta + items[base]) & 0xFFFFFFFF
+            mcu_micros += delta
+            for ch in range(channels):
+                # Differences are modulo 2^32; wrap back into int32
+                value = (values[ch] + items[base + 1 + ch]) & 0xFFFFFFFF
+                values[ch] = value - (1 << 32) if value & 0x80000000 else value
+            self._handle_batch_sample((stream_id, (first_index + i) & 0xFFFFFFFF), mcu_micros, slot_stamps,
+                                      timing_source, accuracy_us, list(values), stream_kind)
+        self.binary_frame_stats['frames_valid'] += 1
+    
     def start_streaming_pps(self, rate: float, pps_wait: int = 2) -> Tuple[bool, str]:
         """Start streaming with PPS-locked synchronization and session header logging"""
         try:
@@ -2982,6 +3679,68 @@ class HostTimingSeismicAcquisition:
             self.logger.error(f"Failed to start PPS streaming: {e}")
             return False, str(e)
 
+    def set_pps_epoch(self, second: Optional[int] = None) -> Tuple[bool, str]:
+        """Label the MCU's next PPS edge (SET_PPS_EPOCH), by default with the next Unix second.
+
+        Needs the host clock within ~100ms of GPS time (NTP or the same PPS). The command is sent
+        between 0.2s and 0.8s past the second so every node labels the same edge.
+        """
+        while not 0.2 <= time.time() % 1.0 <= 0.8:
+            time.sleep(0.05)
+        if second is None:
+            second = int(time.time()) + 1
+        result = self._send_command(f"SET_PPS_EPOCH:{int(second)}", timeout=2.0)
+        if result and result[0]:
+            self.logger.info(f"PPS epoch label: next edge = {int(second)}")
+            return True, f"Next PPS edge labelled {int(second)}"
+        return False, result[1] if result else "Command timeout"
+
+    def start_streaming_epoch(self, gps_second: int, rate: int, label_next_edge: bool = True) -> Tuple[bool, str]:
+        """Start on the PPS edge labelled gps_second (START_STREAM_EPOCH).
+
+        Every node given the same gps_second and rate takes sample n at gps_second + n / rate, so
+        streams from several nodes merge by sample index. With SET_TIMESTAMP_MODE:EPOCH the
+        (pps_epoch, epoch_index) pair of each sample is that absolute second and slot.
+        """
+        try:
+            if self.streaming:
+                return False, "Already streaming"
+
+            if int(rate) != rate or rate < 1 or rate > 1000:
+                return False, "Epoch start needs an integer rate between 1 and 1000 Hz"
+
+            if label_next_edge:
+                ok, message = self.set_pps_epoch()
+                if not ok:
+                    return False, f"PPS epoch label failed: {message}"
+                # The label is applied on the next edge, before which the MCU cannot check the lead
+                time.sleep(max(0.0, 1.1 - time.time() % 1.0))
+
+            session_header = self.generate_session_header()
+            if session_header:
+                self.logger.info(f"📋 EPOCH SESSION HEADER: {session_header['session_id']}")
+
+            self.sample_tracking['expected_rate'] = rate
+            self.timestamp_generator.update_rate(rate)
+
+            result = self._send_command(f"START_STREAM_EPOCH:{int(gps_second)},{int(rate)}", timeout=5.0)
+
+            if result and result[0]:
+                self.streaming = True
+                self.pps_started = True
+                self.session_info['pps_locked_start'] = True
+                self.session_info['pps_epoch_start'] = int(gps_second)
+                self.session_info['start_time'] = float(gps_second)
+
+                self.logger.info(f"Epoch-aligned streaming armed: {int(rate)}Hz from PPS epoch {int(gps_second)}")
+                return True, f"Streaming starts at PPS epoch {int(gps_second)}"
+            else:
+                return False, result[1] if result else "Command timeout"
+
+        except Exception as e:
+            self.logger.error(f"Failed to start epoch streaming: {e}")
+            return False, str(e)
+
 
 class HostTimingManager:
     """DEPRECATED: Manages high-precision timing on the host side with advanced PLL and Kalman filtering
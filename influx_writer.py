@@ -13,7 +13,8 @@ import logging
 from datetime import datetime
 
 class InfluxWriter:
-    def __init__(self, url, token, org, bucket, measurement="seismic", batch_size=100, tags=None, fields=None, buffer_on_error=True):
+    def __init__(self, url, token, org, bucket, measurement="seismic", batch_size=100, tags=None, fields=None, buffer_on_error=True,
+                 event_measurement=None):
         """
         Initialize InfluxDB writer
         
@@ -27,12 +28,14 @@ class InfluxWriter:
             tags: Common tags to apply to all points
             fields: Common fields to include with all points
             buffer_on_error: Whether to use background buffering
+            event_measurement: Measurement for event trigger windows (default: "<measurement>_events")
         """
         self.url = url
         self.token = token
         self.org = org
         self.bucket = bucket
         self.measurement = measurement
+        self.event_measurement = event_measurement or f"{measurement}_events"
         self.common_tags = tags if tags else {}
         self.common_fields = fields if fields else {}
         self.buffer_on_error = buffer_on_error
@@ -41,6 +44,7 @@ class InfluxWriter:
         # Statistics
         self.stats = {
             'points_written': 0,
+            'event_points_written': 0,
             'write_errors': 0,
             'connection_errors': 0,
             'last_write_time': None,
@@ -93,7 +97,8 @@ class InfluxWriter:
             self.logger.error(f"InfluxDB connection test failed: {e}")
             return False
 
-    def write_seismic_sample(self, timestamp, sequence, channel_values, tags=None, fields=None, thingsboard_status=None):
+    def write_seismic_sample(self, timestamp, sequence, channel_values, tags=None, fields=None, thingsboard_status=None,
+                             stream=None):
         """
         Write a seismic data sample to InfluxDB
         
@@ -104,6 +109,8 @@ class InfluxWriter:
             tags: Additional tags for this sample
             fields: Additional fields for this sample (e.g., calibrated g values)
             thingsboard_status: Legacy parameter (not used anymore)
+            stream: 'event' routes trigger window samples to event_measurement; anything else
+                    (None, 'continuous') goes to the main measurement
         """
         if not self.connected:
             return False
@@ -145,11 +152,12 @@ class InfluxWriter:
             if fields:
                 sample_fields.update(fields)
             
+            measurement = self.event_measurement if stream == 'event' else self.measurement
             if self.buffer_on_error:
-                self.q.put((ts_ns, sample_fields, tags))
+                self.q.put((ts_ns, sample_fields, tags, measurement))
                 self.stats['buffer_size'] = self.q.qsize()
             else:
-                self._do_write_sample(ts_ns, sample_fields, tags)
+                self._do_write_sample(ts_ns, sample_fields, tags, measurement)
             
             return True
             
@@ -176,16 +184,16 @@ class InfluxWriter:
         #     fields['thingsboard_status'] = str(thingsboard_status)
             
         if self.buffer_on_error:
-            self.q.put((timestamp, fields, tags))
+            self.q.put((timestamp, fields, tags, self.measurement))
             self.stats['buffer_size'] = self.q.qsize()
         else:
             self._do_write_sample(timestamp, fields, tags)
         return True
 
-    def _do_write_sample(self, timestamp, fields, tags=None):
+    def _do_write_sample(self, timestamp, fields, tags=None, measurement=None):
         """Internal method to write sample to InfluxDB"""
         try:
-            point = Point(self.measurement).time(timestamp)
+            point = Point(measurement or self.measurement).time(timestamp)
             
             # Add fields (combine common fields with sample-specific fields)
             all_fields = dict(self.common_fields)
@@ -234,6 +242,8 @@ class InfluxWriter:
             # Write to InfluxDB
             self.write_api.write(bucket=self.bucket, org=self.org, record=point)
             self.stats['points_written'] += 1
+            if measurement == self.event_measurement:
+                self.stats['event_points_written'] += 1
             self.stats['last_write_time'] = datetime.now()
             
         except Exception as e:
@@ -248,10 +258,10 @@ class InfluxWriter:
             try:
                 # Get item from queue with timeout
                 item = self.q.get(timeout=0.5)
-                timestamp, fields, tags = item
+                timestamp, fields, tags, measurement = item
                 
                 # Write the sample
-                self._do_write_sample(timestamp, fields, tags)
+                self._do_write_sample(timestamp, fields, tags, measurement)
                 self.q.task_done()
                 
                 # Update buffer size stat
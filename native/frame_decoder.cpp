@@ -0,0 +1,324 @@
+// Native host decoder for the firmware's binary output (src/protocol_codec.h).
+//
+// Splits whole serial reads into ASCII lines and CRC-checked frames the way
+// BinaryFrameParser.add_mixed_data() in host_timing_acquisition.py does, and decodes SAMPLE,
+// BATCH and COMPRESSED records straight into column buffers with the same code the firmware
+// encodes with. frame_codec.py loads it through ctypes; build it on the host:
+//
+//   g++ -O2 -std=gnu++11 -shared -fPIC -Isrc native/frame_decoder.cpp -o native/libframe_decoder.so
+//
+// One frame_decoder_decode() call returns the items found in that read, in arrival order:
+//   FRAME_ITEM_LINE     text line (trailing CR stripped), bytes in the arena
+//   FRAME_ITEM_FRAME    CRC-valid payload that is not a decodable sample record, bytes in the arena
+//   FRAME_ITEM_SAMPLES  decoded sample record: rows [first_row, first_row + rows) of the columns,
+//                       payload also kept in the arena (reliable delivery reorders whole frames)
+// Items, arena and columns stay valid until the next decode or reset call.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "protocol_codec.h"
+
+#if defined(_WIN32)
+#define FRAME_DECODER_API extern "C" __declspec(dllexport)
+#else
+#define FRAME_DECODER_API extern "C" __attribute__((visibility("default")))
+#endif
+
+const uint32_t MAX_FRAME_PAYLOAD = 4096;  // Larger lengths are treated as corruption (as on the Python side)
+const uint32_t MAX_TEXT_LINE = 4096;      // Larger unterminated text is treated as corruption
+
+enum FrameItemKind : uint8_t {
+  FRAME_ITEM_LINE = 0,
+  FRAME_ITEM_FRAME = 1,
+  FRAME_ITEM_SAMPLES = 2
+};
+
+struct FrameDecoderItem {
+  uint8_t kind;                 // FrameItemKind
+  uint8_t frame_type;           // First payload byte (frames and sample records)
+  uint16_t reserved;
+  uint32_t offset;              // Bytes in the arena
+  uint32_t length;
+  uint32_t first_row;           // FRAME_ITEM_SAMPLES only
+  uint32_t rows;
+};
+
+// Column buffers, one entry per decoded sample; values is rows x value_stride int32
+struct FrameDecoderColumns {
+  uint32_t rows;
+  uint32_t value_stride;
+  const uint32_t* stream_id;
+  const uint32_t* sample_index;
+  const uint64_t* stamp;        // us, or grid slot when flags has BATCH_FLAG_SLOT_STAMPS
+  const uint8_t* timing_source;
+  const uint16_t* accuracy_q;   // 0.1 us units
+  const uint8_t* flags;         // BATCH_FLAG_* of the record (0 for SAMPLE records)
+  const uint8_t* channels;
+  const int32_t* values;
+};
+
+struct FrameDecoderStats {
+  uint32_t frames_received;     // Complete frames whatever their CRC
+  uint32_t frames_valid;
+  uint32_t crc_errors;
+  uint32_t sync_losses;         // Corrupt lengths and overlong unterminated text
+  uint32_t records_invalid;     // CRC-valid sample records that failed to decode (passed on as frames)
+  uint32_t rows_decoded;
+};
+
+template <typename T>
+struct Buffer {
+  T* data;
+  uint32_t size;
+  uint32_t capacity;
+
+  bool reserve(uint32_t needed) {
+    if (needed <= capacity) return true;
+    uint32_t grown = capacity ? capacity : 256;
+    while (grown < needed) grown *= 2;
+    T* moved = (T*)realloc(data, (size_t)grown * sizeof(T));
+    if (!moved) return false;
+    data = moved;
+    capacity = grown;
+    return true;
+  }
+  bool append(const T* items, uint32_t count) {
+    if (!reserve(size + count)) return false;
+    memcpy(data + size, items, (size_t)count * sizeof(T));
+    size += count;
+    return true;
+  }
+  void release() {
+    free(data);
+    data = 0;
+    size = capacity = 0;
+  }
+};
+
+struct FrameDecoder {
+  Buffer<uint8_t> pending;      // Bytes not yet consumed (partial line or frame)
+  Buffer<uint8_t> arena;
+  Buffer<FrameDecoderItem> items;
+  Buffer<uint32_t> stream_id;
+  Buffer<uint32_t> sample_index;
+  Buffer<uint64_t> stamp;
+  Buffer<uint8_t> timing_source;
+  Buffer<uint16_t> accuracy_q;
+  Buffer<uint8_t> flags;
+  Buffer<uint8_t> channels;
+  Buffer<int32_t> values;
+  FrameDecoderStats stats;
+};
+
+static void clearOutputs(FrameDecoder* d) {
+  d->arena.size = 0;
+  d->items.size = 0;
+  d->stream_id.size = d->sample_index.size = 0;
+  d->stamp.size = 0;
+  d->timing_source.size = d->flags.size = d->channels.size = 0;
+  d->accuracy_q.size = 0;
+  d->values.size = 0;
+}
+
+static bool addItem(FrameDecoder* d, uint8_t kind, const uint8_t* bytes, uint32_t length, uint32_t first_row,
+                    uint32_t rows) {
+  FrameDecoderItem item;
+  item.kind = kind;
+  item.frame_type = (kind != FRAME_ITEM_LINE && length > 0) ? bytes[0] : 0;
+  item.reserved = 0;
+  item.offset = d->arena.size;
+  item.length = length;
+  item.first_row = first_row;
+  item.rows = rows;
+  return d->arena.append(bytes, length) && d->items.append(&item, 1);
+}
+
+// Appends one row per decoded sample
+struct ColumnSink {
+  FrameDecoder* d;
+  const SampleRecordHeader* h;
+  bool ok;
+
+  void operator()(uint8_t i, uint64_t stamp, const int32_t* values) {
+    FrameDecoder* dec = d;
+    uint32_t index = h->first_index + i;
+    int32_t row[PROTOCOL_MAX_CHANNELS] = {0};
+    memcpy(row, values, 4 * h->channels);
+    ok = ok && dec->stream_id.append(&h->stream_id, 1) && dec->sample_index.append(&index, 1) &&
+         dec->stamp.append(&stamp, 1) && dec->timing_source.append(&h->timing_source, 1) &&
+         dec->accuracy_q.append(&h->accuracy_q, 1) && dec->flags.append(&h->flags, 1) &&
+         dec->channels.append(&h->channels, 1) && dec->values.append(row, PROTOCOL_MAX_CHANNELS);
+  }
+};
+
+static bool addFrame(FrameDecoder* d, const uint8_t* payload, uint16_t length) {
+  SampleRecordHeader h;
+  if (!parseSampleRecordHeader(payload, length, h)) {
+    if (length > 0 && (payload[0] == FRAME_TYPE_SAMPLE || payload[0] == FRAME_TYPE_BATCH ||
+                       payload[0] == FRAME_TYPE_COMPRESSED)) {
+      d->stats.records_invalid++;
+    }
+    return addItem(d, FRAME_ITEM_FRAME, payload, length, 0, 0);
+  }
+
+  uint32_t first_row = d->stamp.size;
+  ColumnSink sink = {d, &h, true};
+  if (!decodeSampleRecord(payload, length, h, sink)) {
+    // Nothing was emitted; the Python decoder counts it as invalid
+    d->stats.records_invalid++;
+    return addItem(d, FRAME_ITEM_FRAME, payload, length, 0, 0);
+  }
+  if (!sink.ok) return false;
+  uint32_t rows = d->stamp.size - first_row;
+  d->stats.rows_decoded += rows;
+  return addItem(d, FRAME_ITEM_SAMPLES, payload, length, first_row, rows);
+}
+
+static bool addLine(FrameDecoder* d, const uint8_t* text, uint32_t length) {
+  // Python strips the decoded line; firmware lines only ever carry a trailing CR or spaces
+  while (length > 0 && (text[0] == ' ' || text[0] == '\t' || text[0] == '\r')) {
+    text++;
+    length--;
+  }
+  while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t' || text[length - 1] == '\r')) {
+    length--;
+  }
+  if (length == 0) return true;
+  return addItem(d, FRAME_ITEM_LINE, text, length, 0, 0);
+}
+
+static const uint8_t* findSync(const uint8_t* p, const uint8_t* end) {
+  while (end - p >= (long)sizeof(FRAME_SYNC)) {
+    const uint8_t* hit = (const uint8_t*)memchr(p, FRAME_SYNC[0], end - p - (sizeof(FRAME_SYNC) - 1));
+    if (!hit) return 0;
+    if (memcmp(hit, FRAME_SYNC, sizeof(FRAME_SYNC)) == 0) return hit;
+    p = hit + 1;
+  }
+  return 0;
+}
+
+FRAME_DECODER_API FrameDecoder* frame_decoder_create() {
+  return (FrameDecoder*)calloc(1, sizeof(FrameDecoder));
+}
+
+FRAME_DECODER_API void frame_decoder_destroy(FrameDecoder* d) {
+  if (!d) return;
+  d->pending.release();
+  d->arena.release();
+  d->items.release();
+  d->stream_id.release();
+  d->sample_index.release();
+  d->stamp.release();
+  d->timing_source.release();
+  d->accuracy_q.release();
+  d->flags.release();
+  d->channels.release();
+  d->values.release();
+  free(d);
+}
+
+FRAME_DECODER_API void frame_decoder_reset(FrameDecoder* d) {
+  d->pending.size = 0;
+  clearOutputs(d);
+  memset(&d->stats, 0, sizeof(d->stats));
+}
+
+FRAME_DECODER_API int32_t frame_decoder_decode(FrameDecoder* d, const uint8_t* data, uint32_t length) {
+  // Returns the item count, or -1 when out of memory (the decoder is reset)
+  clearOutputs(d);
+  if (!d->pending.append(data, length)) {
+    frame_decoder_reset(d);
+    return -1;
+  }
+
+  const uint8_t* start = d->pending.data;
+  const uint8_t* p = start;
+  const uint8_t* end = start + d->pending.size;
+  bool ok = true;
+  while (ok && p < end) {
+    const uint8_t* sync = findSync(p, end);
+    const uint8_t* text_end = sync ? sync : end;
+    const uint8_t* newline = (const uint8_t*)memchr(p, '\n', text_end - p);
+
+    if (newline) {
+      // Complete text line ahead of any frame
+      ok = addLine(d, p, (uint32_t)(newline - p));
+      p = newline + 1;
+      continue;
+    }
+
+    if (!sync) {
+      // Partial text line (or partial sync word) - wait for more data
+      if ((uint32_t)(end - p) > MAX_TEXT_LINE) {
+        d->stats.sync_losses++;
+        p = end;
+      }
+      break;
+    }
+
+    // Unterminated text before a frame is line noise
+    p = sync;
+    if (end - p < FRAME_HEADER_SIZE) break;
+
+    uint16_t payload_length = getU16LE(p + 4);
+    uint16_t crc_expected = getU16LE(p + 6);
+    if (payload_length > MAX_FRAME_PAYLOAD) {
+      // Corrupt length - skip this sync word and rescan
+      d->stats.sync_losses++;
+      p += sizeof(FRAME_SYNC);
+      continue;
+    }
+    if ((uint32_t)(end - p) < (uint32_t)FRAME_HEADER_SIZE + payload_length) break;
+
+    const uint8_t* payload = p + FRAME_HEADER_SIZE;
+    d->stats.frames_received++;
+    if (crc16Ccitt(payload, payload_length) == crc_expected) {
+      d->stats.frames_valid++;
+      ok = addFrame(d, payload, payload_length);
+      p = payload + payload_length;
+    } else {
+      // Only drop the sync word: a bad length must not swallow following data
+      d->stats.crc_errors++;
+      p += sizeof(FRAME_SYNC);
+    }
+  }
+
+  if (!ok) {
+    frame_decoder_reset(d);
+    return -1;
+  }
+  uint32_t consumed = (uint32_t)(p - start);
+  memmove(d->pending.data, p, d->pending.size - consumed);
+  d->pending.size -= consumed;
+  return (int32_t)d->items.size;
+}
+
+FRAME_DECODER_API const FrameDecoderItem* frame_decoder_items(const FrameDecoder* d) {
+  return d->items.data;
+}
+
+FRAME_DECODER_API const uint8_t* frame_decoder_arena(const FrameDecoder* d) {
+  return d->arena.data;
+}
+
+FRAME_DECODER_API void frame_decoder_columns(const FrameDecoder* d, FrameDecoderColumns* out) {
+  out->rows = d->stamp.size;
+  out->value_stride = PROTOCOL_MAX_CHANNELS;
+  out->stream_id = d->stream_id.data;
+  out->sample_index = d->sample_index.data;
+  out->stamp = d->stamp.data;
+  out->timing_source = d->timing_source.data;
+  out->accuracy_q = d->accuracy_q.data;
+  out->flags = d->flags.data;
+  out->channels = d->channels.data;
+  out->values = d->values.data;
+}
+
+FRAME_DECODER_API void frame_decoder_stats(const FrameDecoder* d, FrameDecoderStats* out) {
+  *out = d->stats;
+}
+
+FRAME_DECODER_API uint32_t frame_decoder_pending(const FrameDecoder* d) {
+  return d->pending.size;
+}
@@ -0,0 +1,45 @@
+// Compile-time log levels on top of SerialTx, shared by main.cpp and the host replay harness.
+// Included after the includer has declared a SerialTx with Print-style print()/println().
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <stdint.h>
+
+// DEBUG/TRACE lines above LOG_LEVEL are compiled out together with their arguments.
+// Production builds use -DLOG_LEVEL=LOG_LEVEL_OFF; the events still wanted there
+// (PPS lock adjustments, clock resets, ...) go out as records via sendEvent().
+#define LOG_LEVEL_OFF 0
+#define LOG_LEVEL_DEBUG 1    // State changes and periodic calibration reports
+#define LOG_LEVEL_TRACE 2    // Per-PPS traces and the text behind each event record
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+struct LogFloat {  // Float field with explicit decimals: LOG_DEBUG("ppm=", LogFloat(ppm, 2))
+  double value;
+  uint8_t digits;
+  LogFloat(double v, uint8_t d) : value(v), digits(d) {}
+};
+inline void logFields() {}
+template <typename T, typename... Rest>
+inline void logFields(const T& first, const Rest&... rest) {
+  SerialTx.print(first);
+  logFields(rest...);
+}
+template <typename... Rest>
+inline void logFields(const LogFloat& first, const Rest&... rest) {
+  SerialTx.print(first.value, first.digits);
+  logFields(rest...);
+}
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) do { SerialTx.print("DEBUG:"); logFields(__VA_ARGS__); SerialTx.println(); } while (0)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(...) do { SerialTx.print("DEBUG:"); logFields(__VA_ARGS__); SerialTx.println(); } while (0)
+#else
+#define LOG_TRACE(...) do {} while (0)
+#endif
+
+#endif  // LOGGING_H
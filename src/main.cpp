@@ -2,6 +2,7 @@
 #include <math.h>
 #include <ADS126X.h>
 #include <SPI.h>
+#include <wiring_private.h>
 
 // Global variables
 ADS126X adc;
@@ -14,6 +15,7 @@ uint8_t current_adc_rate = ADS126X_RATE_19200;
 uint8_t current_adc_gain = ADS126X_GAIN_1;
 uint8_t current_adc_filter = ADS126X_SINC3;  // Default to SINC3 filter
 uint8_t current_dithering = 4;               // Default to 4x oversampling
+uint8_t decimation_ratio = 0;                // CIC decimation ratio (0 = boxcar dithering path)
 int num_channels = 3;
 
 // ADC throughput verification
@@ -23,12 +25,354 @@ struct ADCThroughputMonitor {
   uint32_t min_conversion_time_us;
   uint32_t total_conversions;
   bool throughput_warning_sent;
+  uint32_t checksum_errors;       // ADS1263 data checksum mismatches (DMA engine)
+  uint32_t sample_acquisition_us; // Smoothed time to complete all reads of one sample (measured)
 } adc_monitor;
 
+// Hot-path profiler: SysTick-derived cycle stamps around each stage of loop() and the sample
+// path, kept as fixed power-of-two latency histograms (GET_PROFILE / RESET_PROFILE).
+// Build with -DPROFILE_HOT_PATH=0 to compile out every probe and both commands.
+#ifndef PROFILE_HOT_PATH
+#define PROFILE_HOT_PATH 1
+#endif
+#if PROFILE_HOT_PATH
+enum ProfileStage : uint8_t {
+  PROFILE_LOOP = 0,       // One loop() pass, start to start (includes early returns)
+  PROFILE_COMMAND,        // processLine(): parse and execute one command
+  PROFILE_PPS,            // processPPS()
+  PROFILE_SAMPLE,         // acquireSample(): polled reads + output, or arming the DMA engine
+  PROFILE_DRDY_WAIT,      // readADC(): busy-wait for DRDY
+  PROFILE_SPI_READ,       // readADC(): blocking RDATA1 read
+  PROFILE_TIMESTAMP,      // Calibrated timestamp math for a sample slot
+  PROFILE_OUTPUT,         // outputDataWithOverflowProtection(): formatting and TX ring writes
+  PROFILE_DMA_ISR,        // SPI DMA completion interrupt (DMA/SCAN/high-rate engines)
+  PROFILE_STAGE_COUNT
+};
+const char* const PROFILE_STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+  "loop", "command", "pps", "sample", "drdy_wait", "spi_read", "timestamp", "output", "dma_isr"
+};
+const uint8_t PROFILE_BUCKETS = 16;  // Bucket 0: < 1 us, k: < 2^k us, last: everything longer
+struct HotPathProfile {
+  uint32_t histogram[PROFILE_STAGE_COUNT][PROFILE_BUCKETS];
+  uint32_t count[PROFILE_STAGE_COUNT];
+  uint64_t total_cycles[PROFILE_STAGE_COUNT];
+  uint32_t max_cycles[PROFILE_STAGE_COUNT];
+  uint32_t last_loop_cycles;      // Start of the previous loop() pass
+} hot_path_profile;
+
+static inline uint32_t profileCycles() {
+  // F_CPU cycle count: SysTick counts LOAD..0 once per millisecond (Arduino core). Like micros(),
+  // a reload whose interrupt is still pending (we are in an ISR) is added by hand.
+  uint32_t ticks, ms;
+  bool pending;
+  do {
+    ms = millis();
+    ticks = SysTick->VAL;
+    pending = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+  } while (ms != millis());
+  if (pending && ticks > (SysTick->LOAD >> 1)) {
+    ms++;  // VAL already reloaded, tick count not yet incremented
+  }
+  return ms * (SysTick->LOAD + 1) + (SysTick->LOAD - ticks);
+}
+
+void profileRecord(uint8_t stage, uint32_t cycles);
+#define PROFILE_BEGIN(stage) uint32_t profile_start_##stage = profileCycles()
+#define PROFILE_END(stage) profileRecord(stage, profileCycles() - profile_start_##stage)
+#else
+#define PROFILE_BEGIN(stage)
+#define PROFILE_END(stage)
+#endif
+
+// Acquisition engine selection
+enum AcquisitionMode : uint8_t {
+  ACQ_POLLED = 0,    // readADC(): busy-wait on DRDY, blocking SPI read per channel
+  ACQ_DRDY_DMA = 1,  // DRDY interrupt starts a DMAC SPI read and advances the mux
+  ACQ_SCAN = 2       // DMA engine with the next mux write pipelined into each read transfer
+};
+uint8_t acquisition_mode = ACQ_POLLED;
+bool scan_adc2_enabled = false;  // SCAN: last channel converts on ADC2 in parallel with ADC1
+
+// DMAC channel allocation (descriptors must be 16-byte aligned in SRAM)
+enum DmacChannel : uint8_t {
+  DMAC_CH_SPI_RX = 0,
+  DMAC_CH_SPI_TX = 1,
+  DMAC_CH_UART_TX = 2,
+  DMAC_CHANNELS_USED = 3
+};
+__attribute__((aligned(16))) DmacDescriptor dmac_descriptors[DMAC_CHANNELS_USED];
+__attribute__((aligned(16))) volatile DmacDescriptor dmac_writeback[DMAC_CHANNELS_USED];
+bool dmac_initialized = false;
+
+// Host link: Serial1 (SERCOM4 UART at 921600 baud) or the native USB CDC port (SerialUSB,
+// 12 Mbit/s full speed). Build with -DSERIAL_TRANSPORT=0 (UART), 1 (USB) or 2 (strap: the
+// TRANSPORT_STRAP_PIN pulled low at boot selects USB). Framing and the TX ring are shared.
+#define TRANSPORT_UART 0
+#define TRANSPORT_USB 1
+#define TRANSPORT_STRAP 2
+#ifndef SERIAL_TRANSPORT
+#define SERIAL_TRANSPORT TRANSPORT_UART
+#endif
+#ifndef TRANSPORT_STRAP_PIN
+#define TRANSPORT_STRAP_PIN 0
+#endif
+bool transport_usb = false;             // Selected once in setup()
+Stream* transport_port = &Serial1;      // Command input (and output when TX_RING_DMA is 0)
+
+// Serial TX ring: all output goes through SerialTx, drained into the UART by the DMAC, or
+// into SerialUSB from the main loop in bulk-sized writes.
+// Set TX_RING_DMA to 0 to fall back to the Arduino driver of the selected port.
+#ifndef TX_RING_DMA
+#define TX_RING_DMA 1
+#endif
+#define TX_UART_SERCOM SERCOM4            // XIAO SAMD21: Serial1 is SERCOM4
+#define TX_UART_DMAC_TRIGGER SERCOM4_DMAC_ID_TX
+const uint16_t TX_RING_SIZE = 4096;       // Power of two; ~44 ms of line time at 921600 baud
+const uint16_t TX_RING_RESERVE = 256;     // Kept free for status/response lines when dropping samples
+const uint16_t USB_TX_BULK_SIZE = 512;    // Bytes per SerialUSB write (8 full-speed packets)
+
+class DmaTxRing : public Print {
+ public:
+  void begin();
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* data, size_t length) override;
+  using Print::write;
+  int availableForWrite() override;
+  uint16_t used() const { return (uint16_t)((head - tail) & (TX_RING_SIZE - 1)); }
+  uint16_t highWaterMark() const { return high_water_mark; }
+  void resetHighWaterMark() { high_water_mark = used(); }
+  void onDmaComplete();
+  void poll();                      // Main loop: flush a partial bulk to SerialUSB
+ private:
+  void kick();
+  void drainUsb(uint16_t min_bytes);
+  uint8_t buffer[TX_RING_SIZE];
+  volatile uint16_t head = 0;       // Producer index (main loop)
+  volatile uint16_t tail = 0;       // Consumer index (advanced when a DMA chunk completes)
+  volatile uint16_t dma_length = 0; // Bytes in the transfer currently in flight
+  volatile bool dma_active = false;
+  uint16_t high_water_mark = 0;
+};
+DmaTxRing SerialTx;
+
+#include "logging.h"
+
+// ADS1263 SPI access used by the DMA engine (XIAO SAMD21: SPI is SERCOM0)
+#define ADC_SPI_SERCOM SERCOM0
+#define ADC_SPI_DMAC_RX_TRIGGER SERCOM0_DMAC_ID_RX
+#define ADC_SPI_DMAC_TX_TRIGGER SERCOM0_DMAC_ID_TX
+const uint8_t ADS126X_CMD_START2 = 0x0C;
+const uint8_t ADS126X_CMD_STOP2 = 0x0E;
+const uint8_t ADS126X_CMD_RDATA1 = 0x12;
+const uint8_t ADS126X_CMD_RDATA2 = 0x14;
+const uint8_t ADS126X_CMD_WREG = 0x40;
+const uint8_t ADS126X_REG_INPMUX = 0x06;
+const uint8_t ADS126X_REG_ADC2CFG = 0x15;
+const uint8_t ADS126X_REG_ADC2MUX = 0x16;
+const uint8_t ADS126X_ADC2CFG_800SPS = 0xC0;   // DR2 = 800 SPS, internal 2.5 V reference, gain 1
+const uint8_t ADS126X_READ_LENGTH = 7;   // RDATA1 + status + 4 data bytes + checksum (RDATA2: 3 data + pad)
+const uint8_t ADS126X_SCAN_FRAME_LENGTH = ADS126X_READ_LENGTH + 3;  // RDATA1 read + INPMUX write
+const uint8_t MAX_ACQ_CHANNELS = 5;   // Differential pairs in the channel table (ADS1263: 10 inputs + AINCOM)
+
+// Interrupt-driven acquisition: DRDY edge -> DMA read -> mux advance -> next DRDY.
+// The main loop arms one sample per scheduler slot and consumes it once all reads finished.
+struct DrdyDmaAcquisition {
+  enum State : uint8_t {
+    STATE_IDLE = 0,       // Not armed; DRDY edges are ignored
+    STATE_MUXING = 1,     // INPMUX write in flight (conversion restarts when it lands)
+    STATE_WAIT_DRDY = 2,  // Waiting for the conversion of the current channel
+    STATE_READING = 3,    // RDATA1 transfer in flight (SCAN: followed by the next INPMUX write)
+    STATE_READING_ADC2 = 4  // RDATA2 transfer in flight (SCAN with ADC2, once per sample)
+  };
+  volatile uint8_t state;
+  volatile uint16_t step;             // Read index within the current sample
+  uint16_t step_count;                // adc1_channels x oversample reads per sample (5 x 64 max)
+  uint8_t channels;
+  uint8_t adc1_channels;              // Channels converted on ADC1 (channels - 1 with ADC2)
+  uint8_t oversample;
+  bool scan;                          // Pipeline the next INPMUX write into each read
+  bool adc2;                          // Last channel is read from ADC2 at the end of the sample
+  volatile uint8_t read_length;       // Length of the transfer in flight
+  uint8_t mux[MAX_ACQ_CHANNELS];      // INPMUX value per channel (MUXP << 4 | MUXN)
+  volatile int64_t sum[MAX_ACQ_CHANNELS];
+  volatile bool sample_ready;         // All reads for the armed sample are done
+  volatile uint32_t conversion_start_us;
+  bool pending;                       // A sample is armed and not yet emitted
+  uint32_t armed_at_us;
+  volatile uint32_t ready_at_us;      // When the last read of the sample completed
+  uint64_t pending_timestamp;         // Timestamp taken at the scheduler slot
+  uint8_t tx[ADS126X_SCAN_FRAME_LENGTH];
+  volatile uint8_t rx[ADS126X_SCAN_FRAME_LENGTH];
+  uint8_t tx_adc2[ADS126X_READ_LENGTH];
+  uint8_t mux_tx[3];
+  volatile uint8_t rx_discard;
+  volatile bool abort_requested;      // Finish the in-flight transfer, then go idle
+} drdy_acq;
+
+// Integer decimation chain, used instead of the boxcar average when decimation_ratio is set:
+// every read of a channel enters an order-3 CIC (integrators per read, combs once per sample),
+// then a 7-tap symmetric Q15 FIR flattens the CIC passband droop at the output rate.
+const uint8_t CIC_ORDER = 3;
+const uint8_t COMP_FIR_TAPS = 7;
+const uint8_t DECIMATION_MIN_LOG2 = 2;  // Ratio 4
+const uint8_t DECIMATION_MAX_LOG2 = 6;  // Ratio 64
+
+// Compensation taps per ratio (row = log2(ratio) - 2), fixed at build time: least-squares fit of
+// 1/|H_cic| over 0-0.25 fs_out with the band above 0.45 fs_out pulled to zero, DC gain exactly 32768.
+// Combined response is flat within +0.4/-2.4 % to 0.2 fs_out and -13 dB at 0.4 fs_out.
+const int16_t COMP_FIR_Q15[DECIMATION_MAX_LOG2 - DECIMATION_MIN_LOG2 + 1][COMP_FIR_TAPS] = {
+  {2270, -6598, 6330, 28764, 6330, -6598, 2270},  // R = 4
+  {2336, -6744, 6273, 29038, 6273, -6744, 2336},  // R = 8
+  {2352, -6781, 6259, 29108, 6259, -6781, 2352},  // R = 16
+  {2356, -6790, 6255, 29126, 6255, -6790, 2356},  // R = 32
+  {2357, -6792, 6254, 29130, 6254, -6792, 2357}   // R = 64
+};
+
+struct DecimationChannel {
+  uint64_t integrator[CIC_ORDER];       // Modular arithmetic: wraps harmlessly, combs recover the output
+  uint64_t comb_delay[CIC_ORDER];       // Previous comb inputs
+  int32_t fir_history[COMP_FIR_TAPS];   // Circular buffer of CIC outputs
+};
+
+struct DecimationFilter {
+  uint8_t ratio_log2;                   // 0 = chain disabled
+  uint8_t fir_head;                     // Slot of the newest CIC output in fir_history
+  uint8_t warmup;                       // Samples still emitted as boxcar while the state fills
+  DecimationChannel ch[MAX_ACQ_CHANNELS];
+} decimator;
+
+static inline void cicIntegrate(DecimationChannel& c, int32_t value) {
+  // Called per read from the acquisition ISR or the polled loop
+  c.integrator[0] += (uint64_t)(int64_t)value;
+  c.integrator[1] += c.integrator[0];
+  c.integrator[2] += c.integrator[1];
+}
+
+// High-rate streaming (> 1000 Hz): channel 1 only, the ADC free-runs and every DRDY is read;
+// each reads_per_sample reads form one sample, queued for loop() to pack into batch frames.
+// Timestamps: one anchor per frame (DRDY edge of its first sample) plus interval arithmetic.
+const uint8_t HIGH_RATE_QUEUE_SIZE = 64;                 // Power of two; 16 ms at 4 kHz
+const uint32_t HIGH_RATE_MAX_READS_PER_SEC = 19200;      // DRDY ISR + DMA read budget
+const uint32_t HIGH_RATE_UART_BUDGET_BPS = 921600 / 10 * 8 / 10;  // 80 % of the line, rest for status
+const uint32_t HIGH_RATE_USB_BUDGET_BPS = 600000;        // ~half of full-speed bulk through the CDC driver
+struct HighRateStream {
+  bool enabled;                         // Current stream runs in high-rate mode
+  bool running;                         // Free-running reads are being queued
+  uint32_t rate_hz;
+  uint8_t reads_per_sample;             // ADC data rate / stream rate (boxcar average)
+  uint64_t interval_q32;                // Nominal sample interval, Q32.32 us
+  volatile uint32_t last_drdy_us;       // Timebase low word at the latest DRDY edge (ISR)
+  uint32_t group_drdy_us;               // DRDY edge of the first read of the sample being summed (ISR)
+  int64_t group_sum;                    // ISR-only accumulation
+  uint8_t group_reads;
+  int64_t sum[HIGH_RATE_QUEUE_SIZE];
+  uint32_t drdy_us[HIGH_RATE_QUEUE_SIZE];
+  volatile uint8_t head;                // Written by the ISR
+  volatile uint8_t tail;                // Written by loop()
+  volatile uint32_t overruns;           // Samples dropped because loop() fell behind
+  uint32_t overruns_reported;
+  uint64_t anchor_timestamp;            // Timestamp of the current frame's first sample
+  uint32_t anchor_index;                // Samples emitted since the anchor
+} high_rate;
+
+// Sample scheduler selection
+enum SchedulerMode : uint8_t {
+  SCHED_LOOP = 0,    // loop() polls getVirtualMicros() against next_sample_micros
+  SCHED_TIMER = 1    // TCC1 period match generates the sample tick in hardware
+};
+uint8_t scheduler_mode = SCHED_LOOP;
+
+// Monotonic timebase: TC4+TC5 chained as one 32-bit counter at 1 MHz from GCLK4 (DFLL48M / 48),
+// extended to 64 bits by the overflow interrupt. Every timeline read (getVirtualMicros(), PPS and
+// tick stamps) comes from here; micros() is left for short durations. TC5 is the COUNT32 slave,
+// so tone() (which claims TC5) cannot be used alongside it.
+#define TIMEBASE_TC TC4
+const uint8_t TIMEBASE_GCLK = 4;
+const uint32_t TIMEBASE_HALF = 0x80000000UL;
+struct HardwareTimebase {
+  volatile uint32_t high;             // Upper 32 bits, advanced by TC4_Handler
+  volatile uint32_t seq;              // Odd while TC4_Handler is updating high
+} timebase;
+
+// Idle sleep: a loop() pass with nothing left to do ends in WFI instead of a delay spin, so the
+// core is asleep (IDLE mode: clocks, DMA and peripherals keep running) when PPS, DRDY, TCC1, DMAC
+// or UART RX fire, and answers each with the same wake-up latency. SysTick (millis()) wakes it
+// every 1 ms for the periodic work; nearer deadlines arm TC4 CC0 as a one-shot wake timer.
+#ifndef IDLE_SLEEP
+#define IDLE_SLEEP 1                        // 0: idle paths spin instead of sleeping
+#endif
+const uint32_t IDLE_WAKE_MARGIN_US = 30;    // Wake this early for a deadline, then spin to it
+struct IdleSleep {
+  uint32_t last_tick_ms;                    // millis() of the last periodic work pass
+  uint32_t sleeps;
+  volatile uint32_t timer_wakes;            // Wake timer matches (TC4_Handler)
+  uint64_t slept_us;
+} idle_sleep;
+
+// Low word only: for ISR stamps widened later against a full read (COUNT is kept
+// synchronized by RCONT, so this is a single bus read)
+static inline uint32_t timebaseMicros32() { return TIMEBASE_TC->COUNT32.COUNT.reg; }
+
+// Seqlock read, safe from any priority: a reader preempted by TC4_Handler sees seq move and
+// retries; a reader the handler cannot preempt (same priority or interrupts masked) applies
+// the still-pending overflow itself once COUNT has visibly wrapped.
+static inline uint64_t timebaseMicros() {
+  uint32_t seq, high, low;
+  do {
+    seq = timebase.seq;
+    high = timebase.high;
+    low = timebaseMicros32();
+    if ((TIMEBASE_TC->COUNT32.INTFLAG.reg & TC_INTFLAG_OVF) && low < TIMEBASE_HALF) high++;
+  } while ((seq & 1) || seq != timebase.seq);
+  return ((uint64_t)high << 32) | low;
+}
+
+// Hardware sample timer: TCC1 (24-bit) clocked from GCLK0 (48 MHz, same DFLL as the timebase)
+#define SAMPLE_TIMER TCC1
+const uint32_t SAMPLE_TIMER_CLOCK_HZ = 48000000;
+const uint32_t SAMPLE_TIMER_MAX_COUNT = 0xFFFFFF;
+const uint8_t SAMPLE_TICK_QUEUE_SIZE = 8;     // Ticks buffered while the main loop is busy
+
+// Each tick reloads PERB with the integer part of a Q32.32 period; the carried
+// fraction dithers between N and N+1 counts so the long-term rate is exact.
+struct SampleTimerScheduler {
+  bool running;
+  uint8_t prescaler;                  // TCC_CTRLA_PRESCALER index (DIV1..DIV1024)
+  uint8_t prescaler_shift;            // log2 of the divider (all TCC dividers are powers of two)
+  uint16_t prescaler_div;
+  volatile uint64_t period_q32;       // Timer counts per sample (Q32.32)
+  volatile int64_t adjust_q32;        // Phase adjustment added per tick (Q32.32 counts)
+  volatile uint32_t adjust_remaining; // Ticks left to apply adjust_q32
+  uint32_t frac_acc;                  // Fractional counts carried into the next period
+  float applied_ppm;                  // Calibration the period was computed for
+  uint64_t applied_interval_us;
+  volatile uint32_t tick_micros[SAMPLE_TICK_QUEUE_SIZE];  // Timebase low word at each period match
+  volatile uint32_t tick_slot[SAMPLE_TICK_QUEUE_SIZE];    // Period matches since start, dropped ones included
+  volatile uint32_t slots_fired;
+  volatile uint8_t tick_head;         // Written by TCC1_Handler
+  volatile uint8_t tick_tail;         // Advanced by the main loop
+  volatile uint32_t ticks;
+  volatile uint32_t overruns;         // Ticks dropped because the queue was full
+} sample_timer;
+
+// PPS edge capture: EIC -> EVSYS -> TCC0 CC0 capture, TCC0 free-running at 48 MHz.
+// D4 (PA08) is the EIC NMI line, which has no event output; wire PPS to another
+// EXTINT pin (e.g. D5/PA09) and build with -DPPS_INPUT_PIN=5 to use the capture path.
+#ifndef PPS_INPUT_PIN
+#define PPS_INPUT_PIN 4
+#endif
+#ifndef PPS_HW_CAPTURE
+#define PPS_HW_CAPTURE 1
+#endif
+#define PPS_TIMER TCC0
+const uint32_t PPS_TIMER_CLOCK_HZ = 48000000;
+const uint32_t PPS_TIMER_MAX_COUNT = 0xFFFFFF;
+const uint8_t PPS_EVSYS_CHANNEL = 0;
+
 // Streaming settings
 volatile bool streaming = false;
 float stream_rate = 100.0;
-uint16_t sequence = 0;  // 16-bit sequence (0-65535)
+uint32_t sequence = 0;  // Samples emitted since stream start (binary frames: full 32 bits, ASCII lines: low 16)
 
 // Session tracking for stitching
 struct SessionTracker {
@@ -54,7 +398,257 @@ struct SerialBufferMonitor {
 } serial_monitor;
 
 // Output format options
-bool compact_output = false;  // Use compact format to reduce buffer usage
+enum OutputFormat : uint8_t {
+  OUTPUT_FULL = 0,     // ASCII: seq,timestamp,source,accuracy,v1,v2,v3
+  OUTPUT_COMPACT = 1,  // ASCII: seq,timestamp,v1,v2,v3
+  OUTPUT_BINARY = 2,   // Framed little-endian sample records (see writeBinarySample)
+  OUTPUT_BATCH = 3,    // N samples per frame with delta-encoded timestamps (see appendBatchSample)
+  OUTPUT_COMPRESSED = 4  // Batches packed as Steim-2 style first differences (see compressSampleBatch)
+};
+uint8_t output_format = OUTPUT_FULL;
+
+// Binary framing: envelope and record layouts live in protocol_codec.h, shared with the native
+// host decoder (native/frame_decoder.cpp) and mirrored by BinaryFrameParser in host_timing_acquisition.py
+#include "protocol_codec.h"
+const uint8_t MAX_FRAME_PAYLOAD = 64;
+uint8_t frame_buffer[FRAME_HEADER_SIZE + MAX_FRAME_PAYLOAD];
+
+// Event record names, indexed by EventCode (timing_core.h)
+const char* const EVENT_NAMES[] = {"UNKNOWN", "PPS_LOCK_ADJUST", "PPS_PHASE_NUDGE", "CLOCK_RESET",
+                                   "SLOTS_SKIPPED", "REFERENCE_UPDATE", "MICROS_WRAP", "TRIGGER_ON",
+                                   "TRIGGER_OFF", "PPS_EPOCH_LOST"};
+uint8_t event_frame_buffer[FRAME_HEADER_SIZE + EVENT_PAYLOAD_SIZE];  // Separate: events can fire mid-batch
+uint32_t events_sent = 0;
+
+// Binary health beacon (FRAME_TYPE_STAT, field ids in protocol_codec.h)
+const uint8_t STAT_KEYFRAME_INTERVAL = 10;               // Records between full keyframes
+uint8_t stat_frame_buffer[FRAME_HEADER_SIZE + STAT_MAX_PAYLOAD];
+struct StatBeacon {
+  uint32_t last_values[STAT_FIELD_COUNT];  // Values as of the previous record
+  uint8_t seq;                             // Lets the host detect a lost delta record
+  uint8_t records_since_keyframe;          // 0 forces the next record to be a keyframe
+  uint32_t frames_sent;
+} stat_beacon;
+
+// Sample-slot timestamps (SET_TIMESTAMP_MODE:EPOCH with BATCH/COMPRESSED output): samples carry
+// their scheduler grid slot instead of a calibrated time, so the hot path does no timing math.
+// Slot n is sample (n % slots_per_epoch) of PPS epoch epoch0 + n / slots_per_epoch. The time of a
+// slot goes out in a correction record at stream start and whenever the slot-to-time mapping moves
+// (PPS lock/phase adjustments, reference updates, skips, source or calibration changes).
+enum TimestampMode : uint8_t {
+  TIMESTAMP_MICROS = 0,   // Calibrated virtual us per sample
+  TIMESTAMP_EPOCH = 1     // Grid slot per sample + correction records
+};
+uint8_t timestamp_mode = TIMESTAMP_MICROS;
+const uint8_t CORRECTION_NONE = 0xFF;             // No correction pending (wire reasons: protocol_codec.h)
+uint8_t correction_frame_buffer[FRAME_HEADER_SIZE + CORRECTION_PAYLOAD_SIZE];
+struct EpochStamps {
+  bool active;                    // Current stream carries slots (decided at stream start)
+  bool started;                   // epoch0 latched at the first slot
+  uint32_t epoch0;                // PPS epoch of slot 0: the START_STREAM_EPOCH second, else pps_count
+  uint16_t slots_per_epoch;       // Integer stream rate
+  uint8_t pending_reason;         // Why the next slot needs a correction record, or CORRECTION_NONE
+  uint8_t last_source;
+  uint8_t last_calibration_source;
+  bool last_phase_adjusting;
+  uint32_t corrections_sent;
+} epoch_stamps;
+
+// Batched output: one anchor timestamp + per-sample deltas amortize header, sync and CRC
+const uint8_t MAX_BATCH_SAMPLES = 50;
+struct SampleBatch {
+  uint8_t size;                 // Samples per frame (SET_BATCH_SIZE)
+  uint8_t count;                // Samples currently buffered
+  uint8_t flags;
+  uint8_t timing_source;        // Shared by every sample in the frame
+  float accuracy;
+  uint32_t first_sequence;
+  uint64_t last_timestamp;      // For delta encoding
+  uint16_t payload_length;
+  uint32_t frames_sent;
+  uint32_t raw_bytes;           // COMPRESSED: frame bytes a plain batch would have sent
+  uint32_t packed_bytes;        // COMPRESSED: frame bytes actually sent
+} sample_batch;
+uint8_t batch_frame_buffer[FRAME_HEADER_SIZE + BATCH_HEADER_SIZE + MAX_BATCH_SAMPLES * (4 + 4 * MAX_ACQ_CHANNELS)];
+// Packed copy of the batch; only sent when smaller, so it never outgrows the raw frame
+uint8_t compressed_frame_buffer[sizeof(batch_frame_buffer)];
+
+// Reliable delivery (SET_RELIABLE:ON, binary formats): every sample frame is kept in an SRAM
+// window until the host acknowledges it. ACK:<index> is cumulative - frames whose samples all
+// precede index are released; NACK:<index>,<count> asks again for the frames holding those
+// samples. Frames the TX ring had no room for stay in the window and are resent the same way.
+// Resends only go out while the ring is at least half empty, so live frames keep priority.
+#ifndef RELIABLE_WINDOW_BYTES
+#define RELIABLE_WINDOW_BYTES 8192    // ~8 s of 3-channel 100 Hz batches of 10
+#endif
+const uint8_t RELIABLE_MAX_FRAMES = 128;  // Power of two
+struct ReliableFrame {
+  uint32_t first_index;         // Sample index of the frame's first sample
+  uint16_t offset;              // Position in the byte window (frames never straddle its end)
+  uint16_t length;              // Whole frame, header included
+  uint8_t count;                // Samples in the frame
+};
+struct ReliableWindow {
+  bool enabled;
+  uint8_t head;                 // Next descriptor to fill
+  uint8_t tail;                 // Oldest unacknowledged frame
+  uint8_t stored;
+  bool resend_pending;
+  uint32_t resend_from;         // Sample range still to resend: [resend_from, resend_to)
+  uint32_t resend_to;
+  uint32_t acked_index;         // Last cumulative ACK
+  uint32_t frames_stored;
+  uint32_t frames_resent;
+  uint32_t frames_deferred;     // Live sends the TX ring had no room for
+  uint32_t frames_evicted;      // Dropped unacknowledged to make room - permanent loss
+  uint32_t nacks_received;
+  ReliableFrame frames[RELIABLE_MAX_FRAMES];
+  uint8_t bytes[RELIABLE_WINDOW_BYTES];
+} reliable;
+
+// STA/LTA event trigger (SET_TRIGGER, BATCH/COMPRESSED output): a recursive STA/LTA detector
+// runs on every sample of one channel. While it is quiet the stream carries one boxcar-averaged
+// sample per `decimation` samples (BATCH_FLAG_DECIMATED); a trigger switches it to full-rate
+// frames (BATCH_FLAG_EVENT) that start with the buffered pre-trigger samples and end
+// `post_samples` after the ratio falls below the off threshold. Both kinds share one sample
+// index sequence, so gap checks and reliable delivery work unchanged.
+#ifndef TRIGGER_PRE_RING_SIZE
+#define TRIGGER_PRE_RING_SIZE 128     // Power of two; most pre-trigger samples a window can carry
+#endif
+const uint8_t BATCH_STREAM_FLAGS = BATCH_FLAG_DECIMATED | BATCH_FLAG_EVENT;
+enum TriggerState : uint8_t {
+  TRIGGER_IDLE = 0,   // Decimated output, LTA tracking the background
+  TRIGGER_EVENT,      // STA/LTA above the on threshold; LTA frozen
+  TRIGGER_POST        // Below the off threshold, counting down post_samples
+};
+struct TriggerSample {
+  uint64_t timestamp;
+  long values[MAX_ACQ_CHANNELS];
+  float accuracy;
+  uint8_t timing_source;
+};
+struct EventTrigger {
+  bool configured;              // SET_TRIGGER armed a detector; stream start decides if it runs
+  bool active;                  // Running for the current stream
+  uint8_t channel;              // Detector input (0-based)
+  float sta_s;
+  float lta_s;
+  float on_ratio;
+  float off_ratio;
+  uint16_t pre_samples;
+  uint16_t post_samples;
+  uint16_t decimation;
+  // Per stream (beginEventTrigger)
+  uint32_t sta_alpha_q32;       // 2^32 / window length in samples, rounded
+  uint32_t lta_alpha_q32;
+  uint32_t on_q8;               // Thresholds, Q8
+  uint32_t off_q8;
+  int64_t sta_q24;              // Recursive averages of |first difference|, counts Q24
+  int64_t lta_q24;
+  int32_t last_value;
+  bool primed;                  // last_value holds a sample
+  uint32_t warmup;              // Samples until the LTA is trusted
+  uint8_t state;
+  uint16_t post_remaining;
+  uint32_t event_samples;       // Full-rate samples in the current window
+  uint8_t frame_flags;          // Kind of the samples being output (appendBatchSample)
+  int64_t group_sum[MAX_ACQ_CHANNELS];
+  uint16_t group_count;
+  uint64_t group_timestamp;     // Decimated samples are stamped at their group's first sample
+  float group_accuracy;
+  uint8_t group_source;
+  TriggerSample ring[TRIGGER_PRE_RING_SIZE];
+  uint16_t ring_head;
+  uint16_t ring_count;
+  uint32_t events;
+} event_trigger;
+
+// Calibration persistence: the settled oscillator calibration is logged to 64-byte page
+// records in a flash area inside the sketch image. Each save writes the next page and a row
+// is erased only when the log reaches it, so CAL_FLASH_ROWS rows share the wear. At boot
+// setupAdvancedTiming() loads the newest record with a good CRC as CAL_FLASH, so a node
+// rebooting without PPS starts in INTERNAL_CAL. Flash reads stall for a whole erase or write,
+// so each step only runs when it can finish before the next sample is due.
+#ifndef CAL_FLASH_ROWS
+#define CAL_FLASH_ROWS 4                  // 256-byte rows, 4 records each
+#endif
+#ifndef CAL_FLASH_MIN_INTERVAL_S
+#define CAL_FLASH_MIN_INTERVAL_S 900      // Shortest spacing of automatic saves (the first counts from boot)
+#endif
+const uint16_t CAL_FLASH_ROW_BYTES = 256;
+const uint8_t CAL_FLASH_PAGE_BYTES = 64;
+const uint8_t CAL_FLASH_PAGES_PER_ROW = CAL_FLASH_ROW_BYTES / CAL_FLASH_PAGE_BYTES;
+const uint8_t CAL_FLASH_PAGES = CAL_FLASH_ROWS * CAL_FLASH_PAGES_PER_ROW;
+const uint32_t CAL_FLASH_MAGIC = 0x314C4143;    // "CAL1"
+const uint8_t CAL_FLASH_FLAG_TEMP_COMP = 0x01;  // temp_compensation_enabled
+const uint32_t CAL_FLASH_MIN_PPS = 120;         // PPS_LIVE pulses before the estimate is worth saving
+const float CAL_FLASH_MIN_CHANGE_PPM = 0.05f;   // Smaller drifts do not earn a write
+const uint32_t CAL_FLASH_ERASE_US = 7000;       // Row erase stall (6 ms max) with margin
+const uint32_t CAL_FLASH_WRITE_US = 3000;       // Page write stall (2.5 ms max) with margin
+struct CalFlashRecord {
+  uint32_t magic;
+  uint32_t sequence;            // Newest valid record wins
+  float ppm;
+  float temp_coefficient_ppm_per_c;
+  float reference_temp_c;
+  uint32_t confidence_pps;      // PPS pulses behind the estimate (0: pushed by the Pi)
+  uint8_t source;               // CalibrationSource the value came from
+  uint8_t flags;                // CAL_FLASH_FLAG_*
+  uint8_t reserved[36];         // Left erased
+  uint16_t crc;                 // crc16Ccitt of the preceding bytes
+};
+__attribute__((aligned(256))) const uint8_t cal_flash_area[CAL_FLASH_ROWS * CAL_FLASH_ROW_BYTES] = {};
+struct CalibrationStore {
+  int16_t newest_page;          // -1: no valid record
+  CalFlashRecord newest;        // Copy of the newest record (rate limiting compares against it)
+  bool restored;                // Boot calibration came from flash
+  bool save_requested;          // SAVE_CAL: skip the rate limits once
+  bool write_pending;           // target_page chosen; erase (if needed) then write
+  bool erase_pending;
+  uint8_t target_page;
+  uint32_t last_save_ms;
+  uint32_t saves;
+  uint32_t erases;
+  uint32_t verify_failures;
+} cal_store;
+
+// Temperature compensation: the MCU's ADC temperature channel is read on a slow background
+// schedule (one non-blocking conversion every TEMP_READ_INTERVAL_MS) and, while PPS is locked,
+// the live calibration is averaged into 2 °C bins. Each new value re-derives the table's
+// interpolated curve and slope, so holdover only looks the correction up:
+// ppm = ppm at holdover entry + curve(T) - curve(T at entry).
+#ifndef TEMP_READ_INTERVAL_MS
+#define TEMP_READ_INTERVAL_MS 2000
+#endif
+#define TEMP_COMP_BINS 40                   // -20 °C .. +60 °C
+const float TEMP_COMP_MIN_C = -20.0f;
+const float TEMP_COMP_BIN_C = 2.0f;
+const uint16_t TEMP_COMP_MIN_SAMPLES = 30;  // Reads before a bin counts (1 minute)
+const uint16_t TEMP_COMP_MAX_WEIGHT = 256;  // Bin average turns into an EWMA (tracks aging)
+const float TEMP_COMP_MIN_STEP_PPM = 0.01f; // Smaller holdover changes are not applied
+const float TEMP_FILTER_ALPHA = 0.25f;      // EWMA on the conversions (~8 s at 2 s reads)
+struct TemperatureSensor {
+  bool available;               // ADC owned and configured
+  bool converting;              // Conversion started, RESRDY not yet seen
+  bool discard_next;            // First conversion after the reference switch is invalid
+  uint32_t last_start_ms;
+  uint32_t reads;
+  // NVM temperature log (factory two-point calibration)
+  float room_temp_c, hot_temp_c;
+  float room_int1v, hot_int1v;
+  float room_adc, hot_adc;
+} temp_sensor;
+struct TempCompTable {
+  float ppm[TEMP_COMP_BINS];        // Mean locked PPS calibration per bin
+  uint16_t samples[TEMP_COMP_BINS];
+  float curve[TEMP_COMP_BINS];      // Precomputed: qualified bins, gaps interpolated, ends on the slope
+  uint8_t qualified;                // Bins with TEMP_COMP_MIN_SAMPLES
+  bool holdover_active;             // Base below taken at the last PPS_ACTIVE -> holdover transition
+  float holdover_base_ppm;
+  float holdover_base_temp_c;
+  float applied_correction_ppm;     // Last correction relative to holdover_base_ppm
+  uint32_t learned;
+} temp_comp;
 
 // Sequence validation and recovery
 struct SequenceValidator {
@@ -65,148 +659,209 @@ struct SequenceValidator {
   bool validation_enabled;
 } seq_validator;
 
-// Advanced timing system with PPS support
-struct AdvancedTiming {
-    // PPS Management
-    const int PPS_PIN = 4;  // PPS input pin
-    volatile bool pps_received;
-    volatile unsigned long pps_micros;
-    unsigned long last_pps_micros;  // Track previous PPS time for interval calculation
-    unsigned long last_pps_time;
-    uint32_t pps_count;
-    bool pps_valid;
-    unsigned long pps_timeout_ms;
-    
-    // Timing Sources
-    enum TimingSource {
-        TIMING_PPS_ACTIVE = 0,      // GPS PPS working (±1μs)
-        TIMING_PPS_HOLDOVER = 1,    // Recent PPS, using prediction (±10μs)
-        TIMING_INTERNAL_CAL = 2,    // Internal osc with PPS calibration (±100μs)
-        TIMING_INTERNAL_RAW = 3     // Raw internal (±1ms, emergency)
-    } current_source;
-    
-    // Calibration Data
-    enum CalibrationSource {
-        CAL_NONE = 0,           // No calibration applied
-        CAL_PPS_LIVE = 1,       // Calibration from active PPS measurements
-        CAL_PI_PUSHED = 2      // Calibration pushed from Pi
-    } calibration_source;
-    
-    float oscillator_calibration_ppm;   // PPM correction (from PPS or Pi)
-    uint64_t cal_base_micros;          // MCU micros() when calibration established (64-bit)
-    unsigned long cal_base_millis;      // millis() when calibration established
-    uint32_t cal_sample_count;          // Samples since calibration
-    bool calibration_valid;
-    bool cal_base_initialized;          // Track if cal_base_micros has been permanently set
-    unsigned long cal_applied_at_ms;    // When calibration was applied (for diagnostics)
-    
-    // Clock Reset Detection and Handling
-    unsigned long last_micros;          // Last micros() reading for reset detection
-    unsigned long last_millis;          // Last millis() reading
-    uint32_t micros_wraparound_count;   // Count of micros() wraparounds
-    // NOTE: sequence_wraparounds calculated as (samples_generated >> 16) to avoid hot-path overhead
-    uint64_t virtual_micros_offset;     // Offset to create continuous virtual time
-    bool clock_reset_detected;          // Flag for recent reset
-    unsigned long reset_detection_time; // When reset was detected
-    
-    // Enhanced Reset Recovery
-    uint64_t pre_reset_virtual_time;    // Virtual time before reset
-    unsigned long reset_recovery_samples; // Samples since reset
-    bool timing_continuity_maintained;  // Whether we maintained timing through reset
-    
-    // Overflow Protection - NEW
-    uint64_t reference_update_interval; // How often to update timing reference (samples)
-    uint64_t last_reference_update_sample; // Sample index of last reference update
-    uint64_t timing_base_virtual_micros; // Virtual micros when timing was established
-    uint32_t reference_updates_count;    // Number of reference updates performed
-    
-    // Precision State (Modified for overflow protection)
-  uint64_t sample_interval_us;        // Sample interval in microseconds
-  double   effective_interval_us;     // PPS-disciplined effective interval (fractional)
-  double   phase_acc_us;              // Fractional microsecond accumulator
-  uint64_t next_sample_micros;        // Next scheduled sample time (virtual micros)
-    uint64_t timing_base_micros;        // Timing base for sampling (now 64-bit)
-  bool timing_established;
-    unsigned long samples_generated;
-    uint64_t sample_index;
-    
-    // Phase alignment (gentle nudge) to PPS after start
-    bool started_on_pps;                 // Whether streaming started exactly at a PPS edge
-    bool phase_nudge_applied;            // Whether we've already nudged once after PPS became available
-    bool phase_alignment_active;         // Currently applying per-sample phase adjustment
-    double phase_error_us;               // Total phase error to correct (signed)
-    double per_sample_phase_adjust_us;   // Adjustment added per sample (signed)
-    uint32_t phase_adjust_samples_remaining; // How many samples left to apply adjustment
-    bool pps_phase_lock_enabled;          // Continuously lock phase to PPS when available
-    
-    // Synchronized start support
-    bool sync_start_enabled;
-    unsigned long sync_delay_ms;
-    unsigned long sync_start_time;
-    bool waiting_for_sync_start;
-    uint64_t sync_start_target_us;   // Absolute virtual micros target for start
-    // PPS-locked start support
-    bool sync_on_pps;
-    uint8_t pps_countdown;
-    
-    // Quality Metrics
-    float timing_accuracy_us;       // Current estimated accuracy
-    uint32_t pps_miss_count;       // Consecutive missed PPS
-    unsigned long last_sync_time;   // Last successful sync
-    uint32_t clock_resets_detected; // Total clock resets detected
-    
-    // Health beacon (1 Hz STAT line)
-    unsigned long last_stat_time;   // Last STAT line sent
-    uint32_t stat_interval_ms;      // STAT line interval (1000ms = 1Hz)
-    
-    // Temperature-aware calibration
-    float temp_coefficient_ppm_per_c;  // PPM change per degree C
-    float reference_temp_c;            // Reference temperature for calibration
-    float current_temp_c;              // Current temperature
-    bool temp_compensation_enabled;    // Enable temperature compensation
-} advanced_timing;
+// Channel table: the first num_channels pairs are acquired in order (SET_CHANNEL_MAP)
+struct ChannelPair {
+  uint8_t pos;   // ADS1263 input: 0-9 = AIN0-AIN9, 10 = AINCOM
+  uint8_t neg;
+};
+const uint8_t ADS126X_INPUT_AINCOM = 10;
+ChannelPair channel_table[MAX_ACQ_CHANNELS] = {{0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}};
 
-// Channel definitions
-int pos_pin1 = 0, neg_pin1 = 1;
-int pos_pin2 = 2, neg_pin2 = 3;
-int pos_pin3 = 4, neg_pin3 = 5;
+// Polled acquisition kernels, one per channel count and reads per channel (acquireBoxcar,
+// acquireDecimated), chosen once per stream so the per-sample path has no channel or
+// dithering branches and averages by a constant
+typedef void (*AcquisitionKernel)(long* values);
+AcquisitionKernel acquisition_kernel = nullptr;
+
+// SELFTEST sweep: each step streams one configuration through the real scheduler, acquisition
+// and output paths for a few seconds, measuring period jitter, DRDY wait, TX ring peak and
+// drops. The highest passing and lowest failing rate of every cell are kept, and the start
+// commands reject rates at or above a measured failure. Cell = channels x reads x format.
+const uint16_t SELFTEST_RATES_HZ[] = {100, 250, 500, 1000};
+const uint8_t SELFTEST_RATE_COUNT = sizeof(SELFTEST_RATES_HZ) / sizeof(SELFTEST_RATES_HZ[0]);
+const uint8_t SELFTEST_CHANNELS[] = {1, 3, 5};
+const uint8_t SELFTEST_CHANNEL_COUNT = sizeof(SELFTEST_CHANNELS);
+struct SelfTestReads {
+  uint8_t dithering;
+  uint8_t decimation;
+  uint8_t reads;                        // Reads per channel per sample
+};
+const SelfTestReads SELFTEST_READS[] = {{0, 0, 1}, {4, 0, 4}, {0, 16, 16}};
+const uint8_t SELFTEST_READS_COUNT = sizeof(SELFTEST_READS) / sizeof(SELFTEST_READS[0]);
+const uint8_t SELFTEST_FORMATS[] = {OUTPUT_FULL, OUTPUT_BINARY, OUTPUT_BATCH};  // COMPACT/COMPRESSED use FULL/BATCH
+const uint8_t SELFTEST_FORMAT_COUNT = sizeof(SELFTEST_FORMATS);
+const uint8_t SELFTEST_CELLS = SELFTEST_CHANNEL_COUNT * SELFTEST_READS_COUNT * SELFTEST_FORMAT_COUNT;
+const uint32_t SELFTEST_SETTLE_MS = 250;        // Start of each step is not measured (timer start, first frame)
+const uint32_t SELFTEST_DRAIN_TIMEOUT_MS = 500; // TX ring must empty between steps
+const uint16_t SELFTEST_DEFAULT_STEP_MS = 2000;
+enum SelfTestPhase : uint8_t {
+  SELFTEST_IDLE = 0,
+  SELFTEST_RUNNING,     // A step's stream is running
+  SELFTEST_DRAINING     // Between steps: waiting for the TX ring to empty
+};
+struct SelfTestCell {
+  uint16_t pass_hz;     // Highest rate that sustained (0 = none)
+  uint16_t fail_hz;     // Lowest rate that overran (0 = none)
+};
+struct SelfTest {
+  uint8_t phase;
+  bool measuring;                       // Past the settle time of the running step
+  bool valid;                           // limits[] hold a completed sweep
+  uint8_t cell;
+  uint8_t rate_index;
+  uint16_t steps;
+  uint16_t step_ms;
+  uint32_t step_start_ms;
+  
+  // Current step
+  uint64_t last_instant_us;
+  bool have_instant;
+  uint32_t jitter_max_us;               // |sample period - interval|, skipped slots excluded
+  uint64_t jitter_total_us;
+  uint32_t jitter_count;
+  uint32_t drdy_max_us;                 // POLLED readADC() busy-wait (0 for the DMA engines)
+  uint64_t drdy_total_us;
+  uint32_t drdy_count;
+  uint64_t start_slot;
+  uint32_t start_emitted;
+  uint32_t start_skipped;
+  uint32_t start_misses;
+  
+  // Configuration restored when the sweep ends
+  float saved_rate;
+  uint64_t saved_interval_us;
+  int saved_channels;
+  uint8_t saved_dithering;
+  uint8_t saved_decimation;
+  uint8_t saved_format;
+  bool saved_trigger;
+  
+  // Settings the limits were measured with; any change leaves the start commands unchecked
+  uint8_t adc_rate;
+  uint8_t adc_filter;
+  uint8_t acquisition;
+  uint8_t scheduler;
+  bool usb;
+  SelfTestCell limits[SELFTEST_CELLS];
+} selftest;
 
-// Command buffer
-String cmdBuffer = "";
+// Command buffer: fixed-size line filled in place by loop(), no heap use
+const uint8_t CMD_LINE_SIZE = 96;
+char cmd_line[CMD_LINE_SIZE];
+uint8_t cmd_length = 0;
+bool cmd_overflow = false;  // Line exceeded the buffer; rejected at its newline
 
 // Function declarations
-void processLine(String line);
+void processLine(char* line);
+char* splitParam(char* params, char separator);
 long readADC(int pos_pin, int neg_pin);
+void dmacInit();
+void dmacConfigureChannel(uint8_t channel, uint8_t trigger_source);
+void startSpiDma(const uint8_t* tx, volatile uint8_t* rx, uint8_t length);
+void drdy_interrupt();
+void startDrdyAcquisition();
+void stopDrdyAcquisition();
+void armDrdySample(uint64_t timestamp);
+void serviceDrdyAcquisition();
+void completeDrdySample();
+void startSampleTimer();
+void stopSampleTimer();
+void serviceSampleTimer();
+void acquireSample(uint64_t precise_timestamp);
+void emitSample(uint64_t timestamp, const long* values);
+void outputSample(uint64_t timestamp, int timing_source, float accuracy, const long* values);
+void beginEventTrigger();
+void processTriggerSample(uint64_t timestamp, const long* values);
+void recordConversionTime(uint32_t conversion_time);
+void recordSampleAcquisitionTime(uint32_t acquisition_us);
+void resetDecimation();
+void applyDecimation(long* values, uint8_t channels);
+uint8_t getReadsPerChannel();
+bool prepareHighRateStream(float rate);
+void startHighRateAcquisition();
+void serviceHighRateStream();
+uint32_t getHighRateLimitHz();
+uint32_t getAdcRateSps();
+const char* getAcquisitionModeName();
+void setupTimebase();
 void setupAdvancedTiming();
 void pps_interrupt();
-void updateTimingSource();
-void processPPS();
-uint64_t getPreciseTimestamp();
-uint64_t calculateCalibratedTimestamp(uint64_t current_micros);
-void establishSamplingTiming();
+bool setupPpsCapture();
 void generatePreciseSample();
+void selectAcquisitionKernel();
+void idleUntilEvent(uint64_t deadline_us);
+void stopStreaming();
+void serviceSelfTest();
+void beginSelfTest(uint16_t step_ms);
+void finishSelfTest(bool completed);
+void recordSelfTestInstant();
+bool checkSelfTestLimits(float rate);
 bool checkSyncStartTime();
-const char* getTimingSourceName(int source);
-bool detectClockReset();  // NEW: Clock reset detection
-uint64_t getVirtualMicros();  // NEW: Continuous virtual time
-void handleClockReset();  // NEW: Clock reset recovery
-void updateTimingReference();
-bool checkSerialBufferOverflow();
-void outputDataWithOverflowProtection(uint16_t seq, uint64_t timestamp, int timing_source, float accuracy, long v1, long v2, long v3);
+bool checkSerialBufferOverflow(uint16_t required_bytes);
+void outputDataWithOverflowProtection(uint32_t seq, uint64_t timestamp, int timing_source, float accuracy, const long* values);
+void sendEvent(uint8_t code, int32_t a, int32_t b);
+void reportSkippedSamples(uint32_t count);
+void appendBatchSample(uint32_t seq, uint64_t timestamp, int timing_source, float accuracy, const long* values);
+void flushSampleBatch();
+uint16_t compressSampleBatch();
+uint16_t writeBinarySample(uint32_t seq, uint64_t timestamp, int timing_source, float accuracy, const long* values);
+uint16_t sendSampleFrame(const uint8_t* frame, uint16_t frame_length, uint32_t first_index, uint8_t count);
+void resetReliableWindow();
+void retainFrame(const uint8_t* frame, uint16_t frame_length, uint32_t first_index, uint8_t count);
+void releaseFrames(uint32_t index);
+void requestResend(uint32_t index, uint32_t count);
+void serviceReliableResend();
+uint16_t getBytesPerSample();
+uint8_t getAsciiValueColumns();
 bool validateAndCorrectSequence(uint16_t& seq);
 bool verifyADCThroughput();
 void sendSessionHeader();
-void clampOscillatorCalibration();
 void sendHealthBeacon();
+void sendStatFrame(uint32_t pps_age_ms);
+void beginEpochStamps();
+uint64_t stampEpochSlot(uint64_t slot_virtual);
+void sendCorrection(uint8_t reason, uint64_t slot, uint64_t timestamp);
 bool isRateChangeAllowed(float new_rate);
-float readInternalTemperature();
+void setupTemperatureSensor();
+void serviceTemperatureSensor();
+void resetTempCompTable();
 void updateTemperatureCompensation();
 void sendBootHeader();
 const char* getCalibrationSourceName(int source);
+bool restoreFlashCalibration();
+void serviceCalibrationStore();
+void eraseCalibrationFlash();
+void startStreamingAtPps();
+
+// Clock hooks for the timing core (bench/timing_replay.cpp supplies replayed ones)
+static inline uint64_t timingMicros() { return timebaseMicros(); }
+static inline uint32_t timingMillis() { return millis(); }
+static inline void timingEnterCritical() { noInterrupts(); }
+static inline void timingExitCritical() { interrupts(); }
+
+#include "timing_core.h"
 
 void setup() {
-  Serial1.begin(921600);  // INCREASED from 115200 to prevent buffer overflow (8x faster)
-  Serial1.println("DEBUG:Starting Advanced ADS1263 with PPS Timing...");
+  setupTimebase();  // First: every timeline read below depends on it
+  // WFI stops only the CPU clock (IDLE0): timers, DMA, USB and SERCOMs keep running
+  PM->SLEEP.reg = PM_SLEEP_IDLE_CPU;
+  SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+  
+#if SERIAL_TRANSPORT == TRANSPORT_STRAP
+  pinMode(TRANSPORT_STRAP_PIN, INPUT_PULLUP);
+  transport_usb = digitalRead(TRANSPORT_STRAP_PIN) == LOW;
+#else
+  transport_usb = SERIAL_TRANSPORT == TRANSPORT_USB;
+#endif
+  if (transport_usb) {
+    SerialUSB.begin(0);     // Baud rate is ignored by CDC
+    transport_port = &SerialUSB;
+  } else {
+    Serial1.begin(921600);  // INCREASED from 115200 to prevent buffer overflow (8x faster)
+    transport_port = &Serial1;
+  }
+  SerialTx.begin();
+  LOG_DEBUG("Starting Advanced ADS1263 with PPS Timing...");
   
   // Initialize serial buffer monitor
   serial_monitor.buffer_overflows = 0;
@@ -218,6 +873,33 @@ void setup() {
   serial_monitor.last_oflow_message_time = 0;
   serial_monitor.oflow_report_interval_ms = 1000;  // Report OFLOW every 1 second
   
+  // Initialize batched output
+  sample_batch.size = 10;
+  sample_batch.count = 0;
+  sample_batch.flags = 0;
+  sample_batch.payload_length = 0;
+  sample_batch.frames_sent = 0;
+  sample_batch.raw_bytes = 0;
+  sample_batch.packed_bytes = 0;
+  
+  // Event trigger is opt-in (SET_TRIGGER); defaults for a 100 Hz stream
+  event_trigger.configured = false;
+  event_trigger.active = false;
+  event_trigger.frame_flags = 0;
+  event_trigger.channel = 0;
+  event_trigger.sta_s = 1.0f;
+  event_trigger.lta_s = 30.0f;
+  event_trigger.on_ratio = 3.0f;
+  event_trigger.off_ratio = 1.5f;
+  event_trigger.pre_samples = 100;
+  event_trigger.post_samples = 200;
+  event_trigger.decimation = 10;
+  event_trigger.events = 0;
+  
+  // Reliable delivery is opt-in (SET_RELIABLE:ON)
+  reliable.enabled = false;
+  resetReliableWindow();
+  
   // Initialize sequence validator
   seq_validator.expected_sequence = 0;
   seq_validator.sequence_gaps_detected = 0;
@@ -231,6 +913,9 @@ void setup() {
   adc_monitor.min_conversion_time_us = 0;
   adc_monitor.total_conversions = 0;
   adc_monitor.throughput_warning_sent = false;
+  adc_monitor.checksum_errors = 0;
+  adc_monitor.sample_acquisition_us = 0;
+  resetDecimation();
   
   // Initialize session tracker
   session_tracker.boot_id = millis();  // Use boot time as boot_id
@@ -263,919 +948,744 @@ void setup() {
   adc.setFilter(current_adc_filter);  // Set default SINC3 filter
   adc.startADC1();
   
-  Serial1.println("READY:Advanced ADS1263 with PPS timing ready");
-  Serial1.println("DEBUG:PPS on pin 4, scientific-grade timing when GPS available");
+  // DMA acquisition engine is configured lazily on the first armed sample
+  drdy_acq.state = DrdyDmaAcquisition::STATE_IDLE;
+  drdy_acq.channels = 0;
+  drdy_acq.pending = false;
+  drdy_acq.sample_ready = false;
+  drdy_acq.abort_requested = false;
+  
+  // Hardware sample timer is started at the first scheduler slot of a stream
+  sample_timer.running = false;
+  sample_timer.ticks = 0;
+  sample_timer.overruns = 0;
+  
+  SerialTx.println("READY:Advanced ADS1263 with PPS timing ready");
+  LOG_DEBUG("PPS on pin ", advanced_timing.PPS_PIN,
+            advanced_timing.pps_capture_hw ? " (TCC0 capture), scientific-grade timing when GPS available"
+                                           : ", scientific-grade timing when GPS available");
 }
 
 void loop() {
-  // Update timing source status
-  updateTimingSource();
+#if PROFILE_HOT_PATH
+  uint32_t loop_cycles = profileCycles();
+  if (hot_path_profile.last_loop_cycles != 0) {
+    profileRecord(PROFILE_LOOP, loop_cycles - hot_path_profile.last_loop_cycles);
+  }
+  hot_path_profile.last_loop_cycles = loop_cycles;
+#endif
   
-  // Send health beacon (1 Hz STAT line)
-  sendHealthBeacon();
+  // USB: hand the partial bulk left by the previous pass to SerialUSB
+  SerialTx.poll();
   
-  // Update temperature compensation (if enabled)
-  updateTemperatureCompensation();
+  // Periodic work runs once per SysTick millisecond, and at once for a new PPS edge
+  uint32_t now_ms = millis();
+  if (now_ms != idle_sleep.last_tick_ms || advanced_timing.pps_received) {
+    idle_sleep.last_tick_ms = now_ms;
+    
+    // Update timing source status
+    updateTimingSource();
+    
+    // Send health beacon (STAT line, or a binary STAT frame in binary output formats)
+    sendHealthBeacon();
+    
+    // Background temperature read; learns the table (PPS locked) or compensates holdover
+    serviceTemperatureSensor();
+    
+    // Persist a settled calibration to flash (rate limited, between samples)
+    serviceCalibrationStore();
+    
+    // Send boot header once
+    sendBootHeader();
+  }
   
-  // Send boot header once
-  sendBootHeader();
+  // Resend unacknowledged frames the host asked for (SET_RELIABLE:ON)
+  serviceReliableResend();
   
   // Process serial commands
-  while (Serial1.available()) {
-    char inChar = (char)Serial1.read();
+  while (transport_port->available()) {
+    char inChar = (char)transport_port->read();
     
     if (inChar == '\n') {
-      processLine(cmdBuffer);
-      cmdBuffer = "";
+      if (cmd_overflow) {
+        SerialTx.println("ERROR:Command too long");
+      } else {
+        cmd_line[cmd_length] = '\0';
+        PROFILE_BEGIN(PROFILE_COMMAND);
+        processLine(cmd_line);
+        PROFILE_END(PROFILE_COMMAND);
+      }
+      cmd_length = 0;
+      cmd_overflow = false;
     } else if (inChar != '\r') {
-      cmdBuffer += inChar;
+      if (cmd_length < CMD_LINE_SIZE - 1) {
+        cmd_line[cmd_length++] = inChar;
+      } else {
+        cmd_overflow = true;
+      }
     }
   }
   
+  // SELFTEST sweep: starts, measures and stops its own streams
+  serviceSelfTest();
+  
   // Handle synchronized start waiting
   if (advanced_timing.waiting_for_sync_start) {
-    // If we're waiting to start on PPS, do NOT use strict target; just yield
+    // If we're waiting to start on PPS, do NOT use strict target; the PPS interrupt wakes us
     if (advanced_timing.sync_on_pps) {
-      delayMicroseconds(200);
+      idleUntilEvent(0);
       return;
     }
-    // Otherwise, strict microsecond target start
+    // Otherwise, strict microsecond target start: sleep to just before it, then spin the last
+    // few us on the timebase so the start edge does not depend on where a loop pass falls
     uint64_t now_us = getVirtualMicros();
-    if ((long long)(now_us - advanced_timing.sync_start_target_us) >= 0) {
-      advanced_timing.timing_base_micros = now_us;
-      advanced_timing.next_sample_micros = advanced_timing.timing_base_micros; // align scheduler
-      advanced_timing.timing_established = true;
-      advanced_timing.waiting_for_sync_start = false;
-      advanced_timing.samples_generated = 0;
-      advanced_timing.sample_index = 0;
-
-      Serial1.print("OK:Streaming started at ");
-      Serial1.print(stream_rate);
-      Serial1.print("Hz with ");
-      Serial1.print(getTimingSourceName(advanced_timing.current_source));
-      Serial1.println(" timing (strict target)");
-    } else {
-      long long early = (long long)advanced_timing.sync_start_target_us - (long long)now_us;
-      if (early > 3000) {
-        delayMicroseconds(200);
-      } else if (early > 50) {
-        delayMicroseconds(early - 50);
-      }
+    long long early = (long long)advanced_timing.sync_start_target_us - (long long)now_us;
+    if (early > (long long)(2 * IDLE_WAKE_MARGIN_US)) {
+      idleUntilEvent(advanced_timing.sync_start_target_us);
+      return;
     }
+    while (early > 0) {
+      now_us = getVirtualMicros();
+      early = (long long)advanced_timing.sync_start_target_us - (long long)now_us;
+    }
+    advanced_timing.timing_base_micros = now_us;
+    advanced_timing.next_sample_micros = advanced_timing.timing_base_micros; // align scheduler
+    advanced_timing.grid_slot = 0;
+    advanced_timing.timing_established = true;
+    advanced_timing.waiting_for_sync_start = false;
+    advanced_timing.samples_generated = 0;
+    advanced_timing.sample_index = 0;
+
+    SerialTx.print("OK:Streaming started at ");
+    SerialTx.print(stream_rate);
+    SerialTx.print("Hz with ");
+    SerialTx.print(getTimingSourceName(advanced_timing.current_source));
+    SerialTx.println(" timing (strict target)");
+    return;
+  }
+  
+  // High-rate streaming: the free-running ADC, not the scheduler, paces samples
+  if (streaming && high_rate.enabled) {
+    if (!high_rate.running) {
+      startHighRateAcquisition();
+    }
+    serviceHighRateStream();
     return;
   }
   
+  // Emit samples whose DMA acquisition finished in the background
+  if (drdy_acq.pending) {
+    serviceDrdyAcquisition();
+  }
+  
+  // Hardware-timed streaming: TCC1 ticks are queued in the ISR and consumed here
+  if (streaming && advanced_timing.timing_established && scheduler_mode == SCHED_TIMER) {
+    serviceSampleTimer();
+    idleUntilEvent(0);  // The next TCC1 tick (or DRDY/DMA completion) wakes the loop
+  }
+  
   // Handle precision streaming (PPS-disciplined fractional scheduler)
-  if (streaming && advanced_timing.timing_established) {
+  else if (streaming && advanced_timing.timing_established) {
     // Initialize next_sample_micros on first entry
     if (advanced_timing.next_sample_micros == 0) {
       advanced_timing.next_sample_micros = advanced_timing.timing_base_micros;
     }
 
-    // Update effective interval using PPS-derived calibration (fractional)
-    // effective = nominal * (1 + ppm/1e6)
-    // Convert calibration (ppm) into a scaling from micros-domain to real time.
-    // If micros() runs fast (error_ppm > 0), calibration_ppm is negative.
-    // We need more micros ticks per real 10 ms, so multiply by (1 - calibration_ppm/1e6).
-    advanced_timing.effective_interval_us = (double)advanced_timing.sample_interval_us *
-      (1.0 - (advanced_timing.oscillator_calibration_ppm / 1e6));
+    // Update effective interval using PPS-derived calibration (Q32.32, only re-derived when it changes)
+    // effective = nominal * (1 - ppm/1e6): if micros() runs fast, calibration_ppm is negative
+    // and we need more micros ticks per real sample interval.
+    refreshTimingScales();
 
     // Single-shot scheduler: emit max 1 sample per loop, skip over missed slots
     uint64_t now_virtual = getVirtualMicros();
-    if ((long long)now_virtual - (long long)advanced_timing.next_sample_micros >= 0) {
+    long long late_us = (long long)now_virtual - (long long)advanced_timing.next_sample_micros;
+    if (late_us >= 0) {
       generatePreciseSample();
-
-      // Skip-ahead: calculate how many slots we missed and jump over them
-      long long missed_slots = ((long long)now_virtual - (long long)advanced_timing.next_sample_micros) / 
-                               (long long)advanced_timing.effective_interval_us;
-      
-      if (missed_slots > 0) {
-        // Jump over missed slots to prevent burst catch-up
-        advanced_timing.next_sample_micros += (uint64_t)(missed_slots * (long long)advanced_timing.effective_interval_us);
-        Serial1.print("DEBUG:Skipped ");
-        Serial1.print((unsigned long)missed_slots);
-        Serial1.println(" missed slots");
-      }
-
-      // Advance next time with fractional accumulator to keep long-term average exact
-      double step = advanced_timing.effective_interval_us + advanced_timing.phase_acc_us;
-      // Apply gentle phase alignment if active
-      if (advanced_timing.phase_alignment_active && advanced_timing.phase_adjust_samples_remaining > 0) {
-        step += advanced_timing.per_sample_phase_adjust_us;
-        if (advanced_timing.phase_adjust_samples_remaining > 0) {
-          advanced_timing.phase_adjust_samples_remaining--;
-        }
-        if (advanced_timing.phase_adjust_samples_remaining == 0) {
-          advanced_timing.phase_alignment_active = false;
-          advanced_timing.per_sample_phase_adjust_us = 0.0;
-          advanced_timing.phase_error_us = 0.0;
-          Serial1.println("DEBUG:Phase alignment completed");
-        }
-      }
-      long long whole_us = (long long)step;
-      advanced_timing.phase_acc_us = step - (double)whole_us; // keep fractional part
-      advanced_timing.next_sample_micros += (uint64_t)whole_us;
+      advanceSampleSchedule(late_us);
+    } else {
+      idleUntilEvent(advanced_timing.next_sample_micros);
     }
   }
   
-  // Minimal delay when not streaming
+  // Not streaming: sleep until a command, PPS edge or the next millisecond tick
   if (!streaming) {
-    delayMicroseconds(100);
+    idleUntilEvent(0);
   }
 }
 
-void setupAdvancedTiming() {
-  // Initialize PPS interrupt
-  pinMode(advanced_timing.PPS_PIN, INPUT_PULLUP);
-  attachInterrupt(digitalPinToInterrupt(advanced_timing.PPS_PIN), pps_interrupt, RISING);
-  
-  // Initialize timing state
-  advanced_timing.pps_received = false;
-  advanced_timing.pps_valid = false;
-  advanced_timing.last_pps_micros = 0;
-  advanced_timing.last_pps_time = 0;  // ✅ CRITICAL: Initialize to prevent garbage value
-  advanced_timing.pps_timeout_ms = 2000;  // 2 second PPS timeout
-  advanced_timing.current_source = AdvancedTiming::TIMING_INTERNAL_RAW;
-  advanced_timing.oscillator_calibration_ppm = 0.0;
-  advanced_timing.timing_accuracy_us = 1000.0;   // 1ms initial accuracy
-  advanced_timing.pps_miss_count = 0;
-  advanced_timing.pps_count = 0;
-  advanced_timing.calibration_valid = false;
-  advanced_timing.cal_base_initialized = false;  // FIXED: Initialize calibration base flag
-  advanced_timing.calibration_source = AdvancedTiming::CAL_NONE;
-  advanced_timing.cal_applied_at_ms = 0;
+void setupTimebase() {
+  // GCLK4 = DFLL48M / 48 = 1 MHz, routed to the TC4/TC5 pair
+  GCLK->GENDIV.reg = GCLK_GENDIV_ID(TIMEBASE_GCLK) | GCLK_GENDIV_DIV(48);
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(TIMEBASE_GCLK) | GCLK_GENCTRL_SRC_DFLL48M | GCLK_GENCTRL_GENEN;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID_TC4_TC5 | GCLK_CLKCTRL_GEN_GCLK4 | GCLK_CLKCTRL_CLKEN;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  PM->APBCMASK.reg |= PM_APBCMASK_TC4 | PM_APBCMASK_TC5;
   
-  // Initialize clock reset detection
-  advanced_timing.last_micros = micros();
-  advanced_timing.last_millis = millis();
-  advanced_timing.micros_wraparound_count = 0;
-  // NOTE: sequence_wraparounds calculated on-demand from samples_generated
-  advanced_timing.virtual_micros_offset = 0;
-  advanced_timing.clock_reset_detected = false;
-  advanced_timing.reset_detection_time = 0;
-  advanced_timing.pre_reset_virtual_time = 0;
-  advanced_timing.reset_recovery_samples = 0;
-  advanced_timing.timing_continuity_maintained = false;
-  advanced_timing.clock_resets_detected = 0;
-  
-  // Initialize overflow protection - NEW
-  advanced_timing.reference_update_interval = 1000000ULL;  // Update every 1M samples (~2.8 hours at 100Hz)
-  advanced_timing.last_reference_update_sample = 0;
-  advanced_timing.timing_base_virtual_micros = 0;
-  advanced_timing.reference_updates_count = 0;
-  
-  // Initialize precision timing
-  advanced_timing.sample_interval_us = 10000; // 100Hz default
-  advanced_timing.effective_interval_us = (double)advanced_timing.sample_interval_us;
-  advanced_timing.phase_acc_us = 0.0;
-  advanced_timing.timing_base_micros = 0;
-  advanced_timing.timing_established = false;
-  advanced_timing.samples_generated = 0;
-  advanced_timing.sample_index = 0;
-  advanced_timing.next_sample_micros = 0;
-  
-  // Initialize synchronized start
-  advanced_timing.sync_start_enabled = false;
-  advanced_timing.sync_delay_ms = 0;
-  advanced_timing.sync_start_time = 0;
-  advanced_timing.waiting_for_sync_start = false;
-  advanced_timing.sync_start_target_us = 0;
-  advanced_timing.sync_on_pps = false;
-  advanced_timing.pps_countdown = 0;
+  timebase.high = 0;
+  timebase.seq = 0;
+  TIMEBASE_TC->COUNT32.CTRLA.reg = TC_CTRLA_SWRST;
+  while (TIMEBASE_TC->COUNT32.STATUS.bit.SYNCBUSY);
+  TIMEBASE_TC->COUNT32.CTRLA.reg = TC_CTRLA_MODE_COUNT32 | TC_CTRLA_WAVEGEN_NFRQ | TC_CTRLA_PRESCALER_DIV1;
+  while (TIMEBASE_TC->COUNT32.STATUS.bit.SYNCBUSY);
+  // Continuous read synchronization: COUNT reads need no READREQ round trip
+  TIMEBASE_TC->COUNT32.READREQ.reg = TC_READREQ_RCONT | TC_READREQ_ADDR(TC_COUNT32_COUNT_OFFSET);
+  while (TIMEBASE_TC->COUNT32.STATUS.bit.SYNCBUSY);
+  TIMEBASE_TC->COUNT32.INTENSET.reg = TC_INTENSET_OVF;
   
-  // Initialize PPS alignment state
-  advanced_timing.started_on_pps = false;
-  advanced_timing.phase_nudge_applied = false;
-  advanced_timing.phase_alignment_active = false;
-  advanced_timing.phase_error_us = 0.0;
-  advanced_timing.per_sample_phase_adjust_us = 0.0;
-  advanced_timing.phase_adjust_samples_remaining = 0;
-  advanced_timing.pps_phase_lock_enabled = true;
-  
-  // Initialize health beacon
-  advanced_timing.last_stat_time = 0;
-  advanced_timing.stat_interval_ms = 1000;  // 1 Hz
-  
-  // Initialize temperature-aware calibration
-  advanced_timing.temp_coefficient_ppm_per_c = 0.0;  // Will be learned from PPS
-  advanced_timing.reference_temp_c = 25.0;            // Reference temperature
-  advanced_timing.current_temp_c = 25.0;              // Current temperature
-  advanced_timing.temp_compensation_enabled = false;  // Disabled until learned
-  
-  Serial1.println("DEBUG:Advanced timing system initialized with overflow protection");
-}
-
-void pps_interrupt() {
-  advanced_timing.pps_received = true;
-  advanced_timing.pps_micros = micros();
-  // NOTE: last_pps_time is now updated in processPPS() for proper interval tracking
+  // Highest priority: no reader runs inside a half-finished update except by masking it
+  NVIC_ClearPendingIRQ(TC4_IRQn);
+  NVIC_SetPriority(TC4_IRQn, 0);
+  NVIC_EnableIRQ(TC4_IRQn);
+  TIMEBASE_TC->COUNT32.CTRLA.reg |= TC_CTRLA_ENABLE;
+  while (TIMEBASE_TC->COUNT32.STATUS.bit.SYNCBUSY);
 }
 
-void updateTimingSource() {
-  unsigned long current_millis = millis();
-  
-  // FIRST: Check for clock reset
-  if (detectClockReset()) {
-    handleClockReset();
-  }
-  
-  // Check for new PPS
-  if (advanced_timing.pps_received) {
-    processPPS();
-    advanced_timing.pps_received = false;
-  }
-  
-  // If we recently detected a reset, be more conservative
-  unsigned long time_since_reset = current_millis - advanced_timing.reset_detection_time;
-  bool recent_reset = advanced_timing.clock_reset_detected && (time_since_reset < 30000); // 30 seconds
-  
-  // Determine current timing source based on explicit thresholds
-  unsigned long time_since_pps = current_millis - advanced_timing.last_pps_time;
-  
-  // Explicit state machine thresholds as specified
-  if (advanced_timing.pps_valid && time_since_pps < 1500 && !recent_reset) {
-    // ACTIVE: last_pps_age < 1.5s
-    advanced_timing.current_source = AdvancedTiming::TIMING_PPS_ACTIVE;
-    advanced_timing.timing_accuracy_us = 1.0;  // ±1μs with active PPS
-    advanced_timing.pps_miss_count = 0;
-  }
-  else if (advanced_timing.pps_valid && time_since_pps < 60000 && !recent_reset) {
-    // HOLDOVER: 1.5s < last_pps_age < 60s (no PPS but have oscillator_calibration_ppm)
-    advanced_timing.current_source = AdvancedTiming::TIMING_PPS_HOLDOVER;
-    // Freeze ppm in holdover, slowly increase accuracy_us
-    // oscillator_calibration_ppm remains frozen at last good value
-    advanced_timing.timing_accuracy_us = 1.0 + (time_since_pps / 1000.0) * 0.1;  // +0.1μs per second
-    advanced_timing.pps_miss_count++;
-  }
-  else if (advanced_timing.calibration_valid && time_since_pps < 300000 && !recent_reset) {
-    // CAL: 60s < last_pps_age < 300s (or if temp change > threshold)
-    advanced_timing.current_source = AdvancedTiming::TIMING_INTERNAL_CAL;
-    // Keep the last ppm and slowly increase accuracy_us
-    advanced_timing.timing_accuracy_us = 10.0 + (time_since_pps / 1000.0) * 0.3;  // +0.3μs per second
-  }
-  else {
-    // RAW: last_pps_age > 300s (or if temp change > threshold)
-    advanced_timing.current_source = AdvancedTiming::TIMING_INTERNAL_RAW;
-    advanced_timing.timing_accuracy_us = recent_reset ? 2000.0 : 1000.0;  // Worse accuracy after reset
-    
-    // Alert about timing degradation (only once per event)
-    static bool degradation_warned = false;
-    static bool reset_warned = false;
-    
-    if (recent_reset && !reset_warned) {
-      Serial1.println("WARNING:Using raw timing due to recent clock reset");
-      reset_warned = true;
-      degradation_warned = false;  // Reset PPS warning
-    } else if (advanced_timing.pps_valid && !degradation_warned && !recent_reset) {
-      Serial1.print("WARNING:GPS PPS lost for ");
-      Serial1.print(time_since_pps / 1000);
-      Serial1.println("s - timing accuracy degraded");
-      advanced_timing.pps_valid = false;
-      degradation_warned = true;
-      reset_warned = false;  // Reset reset warning
-    }
+extern "C" void TC4_Handler(void) {
+  if (TIMEBASE_TC->COUNT32.INTFLAG.reg & TIMEBASE_TC->COUNT32.INTENSET.reg & TC_INTFLAG_MC0) {
+    // Idle wake timer: waking loop() is the whole job
+    TIMEBASE_TC->COUNT32.INTENCLR.reg = TC_INTENCLR_MC0;
+    TIMEBASE_TC->COUNT32.INTFLAG.reg = TC_INTFLAG_MC0;
+    idle_sleep.timer_wakes++;
   }
-  
-  // Clear reset flag after recovery period
-  if (recent_reset && time_since_reset > 30000) {
-    advanced_timing.clock_reset_detected = false;
-    Serial1.println("DEBUG:Clock reset recovery period completed");
+  if (!(TIMEBASE_TC->COUNT32.INTFLAG.reg & TC_INTFLAG_OVF)) {
+    return;
   }
+  // Hold off until the synchronized COUNT shows the wrap, so no reader can pair the new
+  // high word with a count from before it
+  while (timebaseMicros32() >= TIMEBASE_HALF);
+  timebase.seq++;
+  timebase.high++;
+  TIMEBASE_TC->COUNT32.INTFLAG.reg = TC_INTFLAG_OVF;
+  timebase.seq++;
 }
 
-bool detectClockReset() {
-  unsigned long current_micros = micros();
-  unsigned long current_millis = millis();
-  
-  // Check for micros() going backward (reset or wraparound)
-  if (current_micros < advanced_timing.last_micros) {
-    // First, check if this was the regular 32-bit wraparound (expected every ~71.6 min)
-    if (advanced_timing.last_micros > 4000000000UL && current_micros < 300000000UL) {
-      advanced_timing.micros_wraparound_count++;
-      advanced_timing.virtual_micros_offset += 4294967296ULL;  // Add 2^32
-      Serial1.print("DEBUG:micros() wraparound detected (#");
-      Serial1.print(advanced_timing.micros_wraparound_count);
-      Serial1.println(")");
-      
-      // Update last readings and continue without flagging a reset
-      advanced_timing.last_micros = current_micros;
-      advanced_timing.last_millis = current_millis;
-      return false;
-    }
-    
-    // Otherwise, calculate how much it went backward and treat as reset only if substantial
-    unsigned long backward_jump = advanced_timing.last_micros - current_micros;
-    if (backward_jump > 1000000) {  // > 1 second backward = likely reset
-      Serial1.print("WARNING:Large backward micros() jump detected: ");
-      Serial1.print(backward_jump);
-      Serial1.println("us - MCU reset suspected");
-      return true;
+void armIdleWakeTimer(uint64_t wake_us) {
+  // One-shot CC0 match on the timebase low word (callers keep wake_us well under a wrap away)
+  TIMEBASE_TC->COUNT32.INTENCLR.reg = TC_INTENCLR_MC0;
+  TIMEBASE_TC->COUNT32.CC[0].reg = (uint32_t)wake_us;
+  while (TIMEBASE_TC->COUNT32.STATUS.bit.SYNCBUSY);
+  TIMEBASE_TC->COUNT32.INTFLAG.reg = TC_INTFLAG_MC0;
+  TIMEBASE_TC->COUNT32.INTENSET.reg = TC_INTENSET_MC0;
+}
+
+static inline bool idleWorkPending() {
+  // Work an interrupt has already queued for loop(); checked with interrupts masked
+  return advanced_timing.pps_received || sample_timer.tick_head != sample_timer.tick_tail ||
+         (drdy_acq.pending && drdy_acq.sample_ready) || (transport_usb && SerialTx.used() > 0);
+}
+
+void idleUntilEvent(uint64_t deadline_us) {
+  // Sleep until the next interrupt. deadline_us (timebase, 0 = none) also wakes the core
+  // IDLE_WAKE_MARGIN_US early; closer than twice that it returns at once and the caller spins.
+  // USB output is moved by loop() (SerialTx.poll), so the core stays awake while any is queued.
+#if IDLE_SLEEP
+  uint64_t start_us = getVirtualMicros();
+  if (deadline_us != 0) {
+    if ((long long)(deadline_us - start_us) <= (long long)(2 * IDLE_WAKE_MARGIN_US) ||
+        deadline_us - start_us >= TIMEBASE_HALF) {
+      return;
     }
+    armIdleWakeTimer(deadline_us - IDLE_WAKE_MARGIN_US);
   }
-  
-  // Check for millis() going backward (definite reset)
-  if (current_millis < advanced_timing.last_millis) {
-    unsigned long millis_backward = advanced_timing.last_millis - current_millis;
-    
-    if (millis_backward > 1000) {  // > 1 second backward
-      Serial1.print("WARNING:millis() went backward by ");
-      Serial1.print(millis_backward);
-      Serial1.println("ms - MCU reset detected");
-      return true;
-    }
+  __disable_irq();
+  if (!idleWorkPending()) {
+    __DSB();
+    __WFI();  // A pending interrupt ends it even while masked; it runs as soon as we unmask
+    idle_sleep.sleeps++;
   }
-  
-  // Check for both micros() and millis() being very small (recent reset)
-  if (current_micros < 5000000 && current_millis < 5000) {  // < 5 seconds since boot
-    if (advanced_timing.last_micros > 10000000 || advanced_timing.last_millis > 10000) {
-      Serial1.println("WARNING:Clock values suggest recent MCU reset");
-      return true;
-    }
+  __enable_irq();
+  if (deadline_us != 0) {
+    TIMEBASE_TC->COUNT32.INTENCLR.reg = TC_INTENCLR_MC0;  // Something else may have woken us first
   }
-  
-  // Update last readings
-  advanced_timing.last_micros = current_micros;
-  advanced_timing.last_millis = current_millis;
-  
-  return false;
+  idle_sleep.slept_us += getVirtualMicros() - start_us;
+#if PROFILE_HOT_PATH
+  hot_path_profile.last_loop_cycles = profileCycles();  // The loop period profile leaves out sleep
+#endif
+#else
+  (void)deadline_us;
+#endif
 }
 
-uint64_t getVirtualMicros() {
-  // Get current micros() and add offset for continuous time
-  unsigned long current_micros = micros();
-  
-  // Handle case where micros() wrapped but we haven't detected it yet
-  if (current_micros < advanced_timing.last_micros) {
-    unsigned long backward_jump = advanced_timing.last_micros - current_micros;
-    
-    // If it's a large backward jump, it's likely a wraparound we missed
-    if (backward_jump > 1000000000UL) {  // > 1 billion microseconds
-      advanced_timing.micros_wraparound_count++;
-      advanced_timing.virtual_micros_offset += 4294967296ULL;
-      Serial1.println("DEBUG:Late wraparound detection in getVirtualMicros()");
-    }
+void setupAdvancedTiming() {
+  // Initialize PPS capture (hardware timer capture when the pin supports events)
+  pinMode(advanced_timing.PPS_PIN, INPUT_PULLUP);
+  advanced_timing.pps_capture_hw = false;
+#if PPS_HW_CAPTURE
+  advanced_timing.pps_capture_hw = setupPpsCapture();
+#endif
+  if (!advanced_timing.pps_capture_hw) {
+    attachInterrupt(digitalPinToInterrupt(advanced_timing.PPS_PIN), pps_interrupt, RISING);
   }
   
-  advanced_timing.last_micros = current_micros;
-  return advanced_timing.virtual_micros_offset + current_micros;
-}
-
-void handleClockReset() {
-  Serial1.println("DEBUG:Handling clock reset - attempting to maintain timing continuity");
-  
-  advanced_timing.clock_reset_detected = true;
-  advanced_timing.reset_detection_time = millis();
-  advanced_timing.clock_resets_detected++;
-  advanced_timing.reset_recovery_samples = 0;
+  initTimingCore();
+  setupTemperatureSensor();
+  resetTempCompTable();
   
-  // Store virtual time before reset for continuity
-  advanced_timing.pre_reset_virtual_time = advanced_timing.virtual_micros_offset + advanced_timing.last_micros;
-  
-  // Reset virtual time tracking
-  advanced_timing.virtual_micros_offset = advanced_timing.pre_reset_virtual_time;
-  advanced_timing.last_micros = micros();
-  advanced_timing.last_millis = millis();
-  
-  // Invalidate calibration temporarily
-  advanced_timing.calibration_valid = false;
-  
-  // Increase timing uncertainty
-  advanced_timing.timing_accuracy_us = 1000.0;  // Back to 1ms accuracy
-  advanced_timing.current_source = AdvancedTiming::TIMING_INTERNAL_RAW;
-  
-  // Try to maintain timing continuity for sampling
-  if (advanced_timing.timing_established && streaming) {
-    // Calculate where we should be in the sampling sequence
-    uint64_t virtual_time = getVirtualMicros();
-    uint64_t time_since_start = virtual_time - (advanced_timing.timing_base_micros + advanced_timing.virtual_micros_offset);
-    uint64_t expected_sample_index = time_since_start / advanced_timing.sample_interval_us;
-    
-    // Update sample index to maintain continuity
-    advanced_timing.sample_index = expected_sample_index;
-    advanced_timing.timing_continuity_maintained = true;
-    
-    Serial1.print("DEBUG:Timing continuity maintained - adjusted to sample index ");
-    Serial1.println((unsigned long)expected_sample_index);
+  // Warm start: the last saved calibration holds INTERNAL_CAL until PPS or the Pi replaces it
+  if (restoreFlashCalibration()) {
+    LOG_DEBUG("Calibration restored from flash: ", LogFloat(advanced_timing.oscillator_calibration_ppm, 3), " ppm");
   }
   
-  Serial1.print("DEBUG:Clock reset #");
-  Serial1.print(advanced_timing.clock_resets_detected);
-  Serial1.println(" handled");
+  LOG_DEBUG("Advanced timing system initialized with overflow protection");
 }
 
-uint64_t getPreciseTimestamp() {
-  // Use virtual micros for continuous time across resets
-  uint64_t virtual_micros = getVirtualMicros();
-  
-  switch (advanced_timing.current_source) {
-    case AdvancedTiming::TIMING_PPS_ACTIVE:
-    case AdvancedTiming::TIMING_PPS_HOLDOVER:
-    case AdvancedTiming::TIMING_INTERNAL_CAL:
-      // Use calibrated timestamp with virtual time
-      return calculateCalibratedTimestamp(virtual_micros);
-      
-    case AdvancedTiming::TIMING_INTERNAL_RAW:
-    default:
-      // Return virtual micros for continuity
-      return virtual_micros;
-  }
+void pps_interrupt() {
+  advanced_timing.pps_received = true;
+  advanced_timing.pps_micros = timebaseMicros();
+  // NOTE: last_pps_time is now updated in processPPS() for proper interval tracking
 }
 
-void processPPS() {
-  unsigned long pps_micros = advanced_timing.pps_micros;
-  unsigned long current_millis = millis();
-  
-  advanced_timing.pps_count++;
-  
-  // Debug: Confirm processPPS is called
-  if (advanced_timing.pps_count % 20 == 0) {
-    Serial1.print("DEBUG:processPPS called, count=");
-    Serial1.println(advanced_timing.pps_count);
-  }
-
-  // ===================================================================
-  // CRITICAL FIX: Initialize state FIRST (before any early returns)
-  // This ensures calibration learning can start on the next PPS
-  // ===================================================================
-  bool first_pps = !advanced_timing.pps_valid;
-  
-  // Debug trace
-  if (advanced_timing.pps_count % 20 == 0) {
-    Serial1.println("DEBUG:After first_pps check");
-  }
-  
-  // CRITICAL: Save old last_pps_time BEFORE updating for interval validation
-  unsigned long previous_pps_time = advanced_timing.last_pps_time;
-  
-  // Update last_pps_micros BEFORE any early returns
-  advanced_timing.last_pps_micros = pps_micros;
-  advanced_timing.last_pps_time = current_millis;
-  
-  // Debug trace
-  if (advanced_timing.pps_count % 20 == 0) {
-    Serial1.println("DEBUG:After time update");
-  }
-  
-  // Mark PPS as valid after first successful pulse
-  if (first_pps) {
-    advanced_timing.pps_valid = true;
-    advanced_timing.calibration_valid = true;  // Enable calibration learning
-    Serial1.print("DEBUG:GPS PPS acquired - count: ");
-    Serial1.println(advanced_timing.pps_count);
+bool setupPpsCapture() {
+  uint8_t line = (uint8_t)g_APinDescription[advanced_timing.PPS_PIN].ulExtInt;
+  if (line == EXTERNAL_INT_NMI) {
+    LOG_DEBUG("PPS pin is the EIC NMI line (no event output) - using interrupt capture");
+    return false;
   }
+  advanced_timing.pps_timer_overflows = 0;
+  advanced_timing.pps_edge_count = 0;
+  advanced_timing.pps_capture_latency = 0;
   
-  // Debug trace
-  if (advanced_timing.pps_count % 20 == 0) {
-    Serial1.println("DEBUG:After pps_valid update");
-  }
+  // TCC0: free-running 24-bit counter at 48 MHz, CC0 captures on the event input
+  PM->APBCMASK.reg |= PM_APBCMASK_TCC0 | PM_APBCMASK_EVSYS;
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID_TCC0_TCC1 | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_CLKEN;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  PPS_TIMER->CTRLA.reg = TCC_CTRLA_SWRST;
+  while (PPS_TIMER->SYNCBUSY.bit.SWRST);
+  PPS_TIMER->CTRLA.reg = TCC_CTRLA_PRESCALER_DIV1 | TCC_CTRLA_CPTEN0;
+  PPS_TIMER->EVCTRL.reg = TCC_EVCTRL_MCEI0;
+  PPS_TIMER->WAVE.reg = TCC_WAVE_WAVEGEN_NFRQ;
+  while (PPS_TIMER->SYNCBUSY.bit.WAVE);
+  PPS_TIMER->PER.reg = PPS_TIMER_MAX_COUNT;
+  while (PPS_TIMER->SYNCBUSY.bit.PER);
+  PPS_TIMER->INTENSET.reg = TCC_INTENSET_OVF | TCC_INTENSET_MC0;
   
-  // ===================================================================
-  // Handle PPS-locked start countdown (can return early now)
-  // ===================================================================
-  if (advanced_timing.sync_on_pps && advanced_timing.pps_countdown > 0) {
-    if (--advanced_timing.pps_countdown == 0) {
-      // Begin streaming exactly at this PPS edge
-      advanced_timing.timing_base_micros = pps_micros;
-      advanced_timing.next_sample_micros = pps_micros;
-      advanced_timing.timing_established = true;
-      advanced_timing.waiting_for_sync_start = false;
-      advanced_timing.sync_on_pps = false;
-      advanced_timing.started_on_pps = true;
-      sequence = 0;
-      streaming = true;
-      sendSessionHeader();
-      Serial1.print("OK:Streaming started at PPS with ");
-      Serial1.print(stream_rate);
-      Serial1.println("Hz");
-      return;  // ✅ Safe to return - state already updated
-    }
-  }
+  // EIC: rising edge on the PPS line generates an event only (no EIC interrupt)
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID_EIC | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_CLKEN;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  EIC->CTRL.reg &= ~EIC_CTRL_ENABLE;
+  while (EIC->STATUS.reg & EIC_STATUS_SYNCBUSY);
+  uint8_t shift = (line % 8) * 4;
+  EIC->CONFIG[line / 8].reg = (EIC->CONFIG[line / 8].reg & ~(0xFu << shift)) |
+                              (EIC_CONFIG_SENSE0_RISE_Val << shift);
+  EIC->INTENCLR.reg = 1u << line;
+  EIC->EVCTRL.reg |= EIC_EVCTRL_EXTINTEO(line);
+  EIC->CTRL.reg |= EIC_CTRL_ENABLE;
+  while (EIC->STATUS.reg & EIC_STATUS_SYNCBUSY);
+  pinPeripheral(advanced_timing.PPS_PIN, PIO_EXTINT);
   
-  // Debug trace
-  if (advanced_timing.pps_count % 20 == 0) {
-    Serial1.println("DEBUG:After PPS countdown check");
-  }
+  // EVSYS: EXTINT[line] -> TCC0 MC0 on the asynchronous path (no resynchronization delay)
+  EVSYS->USER.reg = EVSYS_USER_CHANNEL(PPS_EVSYS_CHANNEL + 1) | EVSYS_USER_USER(EVSYS_ID_USER_TCC0_MC_0);
+  EVSYS->CHANNEL.reg = EVSYS_CHANNEL_CHANNEL(PPS_EVSYS_CHANNEL) | EVSYS_CHANNEL_EDGSEL_NO_EVT_OUTPUT |
+                       EVSYS_CHANNEL_PATH_ASYNCHRONOUS | EVSYS_CHANNEL_EVGEN(EVSYS_ID_GEN_EIC_EXTINT_0 + line);
   
-  // ===================================================================
-  // Skip processing if in clock reset recovery period
-  // ===================================================================
-  if (advanced_timing.clock_reset_detected && 
-      (current_millis - advanced_timing.reset_detection_time) < 5000) {
-    Serial1.println("DEBUG:Ignoring PPS during reset recovery period");
-    return;  // ✅ Safe to return - state already updated
-  }
+  // Below the sample timer: capture latency is measured and removed, tick latency is not
+  NVIC_ClearPendingIRQ(TCC0_IRQn);
+  NVIC_SetPriority(TCC0_IRQn, 1);
+  NVIC_EnableIRQ(TCC0_IRQn);
+  PPS_TIMER->CTRLA.reg |= TCC_CTRLA_ENABLE;
+  while (PPS_TIMER->SYNCBUSY.bit.ENABLE);
   
-  // Debug trace
-  if (advanced_timing.pps_count % 20 == 0) {
-    Serial1.println("DEBUG:After reset check");
-  }
+  LOG_DEBUG("PPS hardware capture on EXTINT", line, " -> EVSYS -> TCC0 (48 MHz)");
+  return true;
+}
+
+static uint32_t readPpsTimerCount() {
+  PPS_TIMER->CTRLBSET.reg = TCC_CTRLBSET_CMD_READSYNC;
+  while (PPS_TIMER->SYNCBUSY.bit.CTRLB);
+  while (PPS_TIMER->SYNCBUSY.bit.COUNT);
+  return PPS_TIMER->COUNT.reg;
+}
+
+extern "C" void TCC0_Handler(void) {
+  uint32_t flags = PPS_TIMER->INTFLAG.reg;
   
-  // ===================================================================
-  // Validate PPS interval (should be ~1 second)
-  // Skip validation for first TWO pulses (need 2 pulses to measure 1 interval)
-  // ===================================================================
-  if (advanced_timing.pps_count > 2) {  // Changed from !first_pps to > 2
-    unsigned long pps_interval = current_millis - previous_pps_time;  // Use OLD time!
+  if (flags & TCC_INTFLAG_MC0) {
+    uint32_t captured = PPS_TIMER->CC[0].reg;
+    PPS_TIMER->INTFLAG.reg = TCC_INTFLAG_MC0;
     
-    // Debug trace
-    if (advanced_timing.pps_count % 20 == 0) {
-      Serial1.print("DEBUG:PPS interval=");
-      Serial1.print(pps_interval);
-      Serial1.println("ms");
+    // A wrap still pending with a small capture value happened before the edge
+    uint32_t overflows = advanced_timing.pps_timer_overflows;
+    if ((PPS_TIMER->INTFLAG.reg & TCC_INTFLAG_OVF) && captured < (PPS_TIMER_MAX_COUNT >> 1)) {
+      overflows++;
     }
+    advanced_timing.pps_edge_count = ((uint64_t)overflows << 24) | captured;
     
-    if (pps_interval < 900 || pps_interval > 1100) {
-      Serial1.print("WARNING:Invalid PPS interval: ");
-      Serial1.print(pps_interval);
-      Serial1.println("ms - ignoring calibration for this pulse");
-      return;  // ✅ Safe to return - state already updated
-    }
-  }
-  
-  // Debug trace
-  if (advanced_timing.pps_count % 20 == 0) {
-    Serial1.println("DEBUG:After interval validation");
-  }
-  
-  // ===================================================================
-  // FIXED: Calculate oscillator calibration from CUMULATIVE elapsed time
-  // Use RAW micros for learning (pps_micros is captured in interrupt)
-  // ===================================================================
-  
-  // DEBUG: Log calibration status periodically
-  if (advanced_timing.pps_count % 20 == 0) {
-    Serial1.print("DEBUG:Calibration check: count=");
-    Serial1.print(advanced_timing.pps_count);
-    Serial1.print(", valid=");
-    Serial1.print(advanced_timing.calibration_valid);
-    Serial1.print(", reset=");
-    Serial1.print(advanced_timing.clock_reset_detected);
-    Serial1.print(", base_init=");
-    Serial1.print(advanced_timing.cal_base_initialized);
-    Serial1.print(", current_ppm=");
-    Serial1.println(advanced_timing.oscillator_calibration_ppm, 2);
-  }
-  
-  if (advanced_timing.pps_count > 1 && 
-      advanced_timing.calibration_valid && 
-      !advanced_timing.clock_reset_detected &&
-      advanced_timing.cal_base_initialized) {
-    
-    // Calculate TOTAL elapsed time since FIRST PPS (cumulative)
-    // Use raw micros - both pps_micros and cal_base_micros are in raw domain
-    uint64_t actual_elapsed_us = (uint64_t)pps_micros - advanced_timing.cal_base_micros;
-    
-    // Expected elapsed time = number of PPS intervals * 1 second
-    uint64_t expected_elapsed_us = (uint64_t)(advanced_timing.pps_count - 1) * 1000000UL;
-    
-    // Calculate cumulative PPM error from TOTAL time
-    float error_ppm = ((float)actual_elapsed_us - (float)expected_elapsed_us) / 
-                      (float)expected_elapsed_us * 1e6;
-    
-    // Sanity check: reject unreasonable errors
-    if (abs(error_ppm) < 1000) {  // < 1000 ppm (0.1% error)
-      if (advanced_timing.pps_count < 10) {
-        // Initial calibration - use direct measurement
-        advanced_timing.oscillator_calibration_ppm = -error_ppm;
-        advanced_timing.calibration_source = AdvancedTiming::CAL_PPS_LIVE;
-        advanced_timing.cal_applied_at_ms = millis();
-        
-        Serial1.print("DEBUG:Initial PPS calibration: ");
-        Serial1.print(advanced_timing.oscillator_calibration_ppm, 2);
-        Serial1.print(" ppm (cumulative: ");
-        Serial1.print((unsigned long)actual_elapsed_us);
-        Serial1.println(" μs)");
-      } else {
-        // Smooth calibration updates (10% new, 90% old)
-        float old_cal = advanced_timing.oscillator_calibration_ppm;
-        advanced_timing.oscillator_calibration_ppm = 
-          0.9 * old_cal + 0.1 * (-error_ppm);
-        
-        // Apply hard limits
-        clampOscillatorCalibration();
-        
-        advanced_timing.calibration_source = AdvancedTiming::CAL_PPS_LIVE;
-        
-        // Report calibration periodically
-        if (advanced_timing.pps_count % 10 == 0) {
-          Serial1.print("DEBUG:PPS calibration: ");
-          Serial1.print(advanced_timing.oscillator_calibration_ppm, 2);
-          Serial1.print(" ppm, cumulative_elapsed: ");
-          Serial1.print((unsigned long)actual_elapsed_us);
-          Serial1.print(" us, expected: ");
-          Serial1.print((unsigned long)expected_elapsed_us);
-          Serial1.println(" us");
-        }
-      }
-      
-      // Learn temperature coefficient if enough data
-      if (advanced_timing.pps_count > 100 && advanced_timing.pps_count % 50 == 0) {
-        float current_temp = readInternalTemperature();
-        float temp_change = current_temp - advanced_timing.reference_temp_c;
-        
-        if (abs(temp_change) > 1.0) {
-          float ppm_change = advanced_timing.oscillator_calibration_ppm - 0.0;
-          advanced_timing.temp_coefficient_ppm_per_c = ppm_change / temp_change;
-          advanced_timing.temp_compensation_enabled = true;
-          
-          Serial1.print("DEBUG:Learned temperature coefficient: ");
-          Serial1.print(advanced_timing.temp_coefficient_ppm_per_c, 3);
-          Serial1.println(" ppm/°C");
-        }
-      }
-    } else {
-      Serial1.print("WARNING:PPS calibration error too large: ");
-      Serial1.print(error_ppm, 1);
-      Serial1.println(" ppm - ignoring");
-    }
-  }
-  
-  // ============================================================================
-  // FIXED: Only set cal_base_micros on FIRST PPS, never reset it
-  // Use RAW micros (not virtual) since pps_micros is captured in interrupt
-  // ============================================================================
-  if (!advanced_timing.cal_base_initialized) {
-    // Establish PERMANENT calibration base on first PPS
-    // Use raw pps_micros directly (captured in interrupt)
-    advanced_timing.cal_base_micros = (uint64_t)pps_micros;
-    advanced_timing.cal_base_millis = current_millis;
-    advanced_timing.cal_base_initialized = true;
-    
-    Serial1.print("DEBUG:PPS calibration base established at ");
-    Serial1.print((unsigned long)pps_micros);
-    Serial1.println("us (raw) - FIXED at this value permanently");
-  }
-
-  // First PPS or reacquisition
-  if (!advanced_timing.pps_valid) {
-    Serial1.print("DEBUG:GPS PPS acquired - count: ");
-    Serial1.println(advanced_timing.pps_count);
+    // The timebase-domain consumers get the edge time with the ISR latency removed
+    uint32_t latency = (readPpsTimerCount() - captured) & PPS_TIMER_MAX_COUNT;
+    uint64_t now_us = timebaseMicros();
+    advanced_timing.pps_capture_latency = latency;
+    advanced_timing.pps_micros = now_us - latency / (PPS_TIMER_CLOCK_HZ / 1000000UL);
+    advanced_timing.pps_received = true;
   }
   
-  // Always update these (but NOT cal_base_micros anymore!)
-  advanced_timing.pps_valid = true;
-  advanced_timing.calibration_valid = true;
-  advanced_timing.last_pps_time = current_millis;
-
-  // If we are already streaming (not started on PPS) and this is the first time PPS becomes valid,
-  // gently nudge sampling phase to align with PPS without changing long-term rate.
-  if (streaming && advanced_timing.timing_established && !advanced_timing.started_on_pps && !advanced_timing.phase_nudge_applied) {
-    // Compute PPS time in virtual domain to compare with timing_base_micros
-    uint64_t pps_virtual = advanced_timing.virtual_micros_offset + (uint64_t)pps_micros;
-    uint64_t interval = advanced_timing.sample_interval_us;
-    if (interval > 0) {
-      // Calculate signed phase error in range [-interval/2, +interval/2]
-      long long delta = (long long)pps_virtual - (long long)advanced_timing.timing_base_micros;
-      long long imod = (long long)interval;
-      long long phase_mod = ((delta % imod) + imod) % imod; // normalized to [0, interval)
-      long long signed_phase = (phase_mod <= (long long)(interval / 2))
-        ? phase_mod
-        : (phase_mod - (long long)interval);
-
-      // If small (< 20us), ignore
-      if (signed_phase > 20 || signed_phase < -20) {
-        // Spread correction over up to 200 samples, but cap per-sample adjust to +/-50us
-        uint32_t planned_samples = 200;
-        double per_sample = (double)signed_phase / (double)planned_samples;
-        // Cap per-sample adjustment to ±20 μs/sample clamp
-        if (per_sample > 20.0) per_sample = 20.0;
-        if (per_sample < -20.0) per_sample = -20.0;
-        // Recompute number of samples to achieve full correction with capped per-sample
-        uint32_t samples_needed = (uint32_t)( (fabs((double)signed_phase) / (fabs(per_sample) > 0.0 ? fabs(per_sample) : 1.0)) + 0.5 );
-        if (samples_needed == 0) samples_needed = 1;
-
-        advanced_timing.phase_error_us = (double)signed_phase;
-        advanced_timing.per_sample_phase_adjust_us = per_sample;
-        advanced_timing.phase_adjust_samples_remaining = samples_needed;
-        advanced_timing.phase_alignment_active = true;
-        advanced_timing.phase_nudge_applied = true; // only once
-
-        Serial1.print("DEBUG:Applying phase nudge to PPS: error=");
-        Serial1.print((long)signed_phase);
-        Serial1.print("us over ");
-        Serial1.print((unsigned long)samples_needed);
-        Serial1.print(" samples (~");
-        Serial1.print( (double)samples_needed * (double)interval / 1000.0, 1);
-        Serial1.println(" ms)");
-      }
-    }
-  }
-
-  // Continuous PPS phase lock: at each PPS, compute current phase error and correct it gradually
-  if (streaming && advanced_timing.timing_established && advanced_timing.pps_phase_lock_enabled) {
-    uint64_t pps_virtual2 = advanced_timing.virtual_micros_offset + (uint64_t)pps_micros;
-    uint64_t interval2 = advanced_timing.sample_interval_us;
-    if (interval2 > 0) {
-      long long delta2 = (long long)pps_virtual2 - (long long)advanced_timing.timing_base_micros;
-      long long imod2 = (long long)interval2;
-      long long phase_mod2 = ((delta2 % imod2) + imod2) % imod2;
-      long long signed_phase2 = (phase_mod2 <= (long long)(interval2 / 2)) ? phase_mod2 : (phase_mod2 - (long long)interval2);
-
-      // Small hysteresis to avoid chattering
-      if (signed_phase2 > 5 || signed_phase2 < -5) {
-        // Spread over approximately one second worth of samples
-        uint32_t samples_per_second = (uint32_t)(stream_rate + 0.5f);
-        if (samples_per_second == 0) samples_per_second = 1;
-
-        double per_sample2 = (double)signed_phase2 / (double)samples_per_second;
-        // Tight clamp for continuous lock
-        if (per_sample2 > 20.0) per_sample2 = 20.0;
-        if (per_sample2 < -20.0) per_sample2 = -20.0;
-        uint32_t samples_needed2 = (uint32_t)( (fabs((double)signed_phase2) / (fabs(per_sample2) > 0.0 ? fabs(per_sample2) : 1.0)) + 0.5 );
-        if (samples_needed2 == 0) samples_needed2 = 1;
-
-        advanced_timing.phase_error_us = (double)signed_phase2;
-        advanced_timing.per_sample_phase_adjust_us = per_sample2;
-        advanced_timing.phase_adjust_samples_remaining = samples_needed2;
-        advanced_timing.phase_alignment_active = true;
-
-        Serial1.print("DEBUG:PPS lock adjust: phase=");
-        Serial1.print((long)signed_phase2);
-        Serial1.print("us over ");
-        Serial1.print((unsigned long)samples_needed2);
-        Serial1.println(" samples");
-      }
-    }
-  }
-
-  // Clear reset flag if PPS is working again
-  if (advanced_timing.clock_reset_detected) {
-    Serial1.println("DEBUG:PPS reacquired after reset - timing stabilizing");
-  }
-}
-
-uint64_t calculateCalibratedTimestamp(uint64_t virtual_micros) {
-  if (!advanced_timing.calibration_valid) {
-    return virtual_micros;
+  if (PPS_TIMER->INTFLAG.reg & TCC_INTFLAG_OVF) {
+    PPS_TIMER->INTFLAG.reg = TCC_INTFLAG_OVF;
+    advanced_timing.pps_timer_overflows++;
   }
-  
-  // Extract raw micros from virtual (remove wraparound offset)
-  uint64_t raw_micros = virtual_micros - advanced_timing.virtual_micros_offset;
-  
-  // Calculate elapsed time in raw domain (where calibration was learned)
-  uint64_t elapsed_micros = raw_micros - (unsigned long)advanced_timing.cal_base_micros;
-  
-  // Apply PPM correction using 64-bit math
-  double corrected_elapsed = (double)elapsed_micros * (1.0 + advanced_timing.oscillator_calibration_ppm / 1e6);
-  
-  // Convert back to virtual domain
-  uint64_t calibrated_raw = (unsigned long)advanced_timing.cal_base_micros + (uint64_t)corrected_elapsed;
-  return advanced_timing.virtual_micros_offset + calibrated_raw;
-}
-
-void establishSamplingTiming() {
-  // Establish timing base for precise sampling intervals using virtual time
-  uint64_t current_virtual_micros = getVirtualMicros();
-  
-  // Start sampling at next interval boundary
-  unsigned long offset_us = (unsigned long)(current_virtual_micros % advanced_timing.sample_interval_us);
-  uint64_t next_boundary_micros = current_virtual_micros + (advanced_timing.sample_interval_us - offset_us);
-  
-  // Store both the 32-bit base and the full virtual time for overflow protection
-  advanced_timing.timing_base_micros = next_boundary_micros;
-  advanced_timing.timing_base_virtual_micros = next_boundary_micros;
-  advanced_timing.timing_established = true;
-  advanced_timing.samples_generated = 0;
-  advanced_timing.sample_index = 0;
-  advanced_timing.next_sample_micros = next_boundary_micros;
-  advanced_timing.last_reference_update_sample = 0;
-  
-  Serial1.print("DEBUG:Sampling established at ");
-  Serial1.print(stream_rate);
-  Serial1.print("Hz with ");
-  Serial1.print(getTimingSourceName(advanced_timing.current_source));
-  Serial1.print(" timing (±");
-  Serial1.print(advanced_timing.timing_accuracy_us, 1);
-  Serial1.println("μs) - overflow protected");
 }
 
-void updateTimingReference() {
-  // Periodic reference update to prevent overflow
-  // This resets the sample_index and timing_base to prevent arithmetic overflow
-  
-  uint64_t current_virtual_micros = getVirtualMicros();
-  
-  // Calculate the new timing base (where we are now in the sampling grid)
-  uint64_t samples_since_start = advanced_timing.sample_index;
+bool checkSerialBufferOverflow(uint16_t required_bytes) {
+  // Backpressure is measured as TX ring occupancy: drop a sample only when it would
+  // eat into the space reserved for status and command-response lines
+  int available_space = SerialTx.availableForWrite();
   
-  // CRITICAL FIX: Update calibration base to maintain calibration continuity
-  // This prevents the growing offset issue by keeping cal_base_micros current
-  if (advanced_timing.calibration_valid) {
-    // Calculate what the calibrated timestamp should be at this point
-    uint64_t current_calibrated_time = calculateCalibratedTimestamp(current_virtual_micros);
-    
-    // Update calibration base to current position to maintain continuity
-    advanced_timing.cal_base_micros = current_virtual_micros;
-    advanced_timing.cal_base_millis = millis();
-    
-    Serial1.print("DEBUG:Calibration base updated to maintain continuity (calibrated_time=");
-    Serial1.print((unsigned long)current_calibrated_time);
-    Serial1.println(")");
-  }
-  
-  // Update the timing base to current position
-  advanced_timing.timing_base_micros = current_virtual_micros;
-  advanced_timing.timing_base_virtual_micros = current_virtual_micros;
-  advanced_timing.sample_index = 0;  // Reset sample index
-  advanced_timing.next_sample_micros = current_virtual_micros; // keep scheduler aligned
-  advanced_timing.last_reference_update_sample = samples_since_start;
-  advanced_timing.reference_updates_count++;
-  
-  Serial1.print("DEBUG:Timing reference updated (#");
-  Serial1.print(advanced_timing.reference_updates_count);
-  Serial1.print(") after ");
-  Serial1.print((unsigned long)samples_since_start);
-  Serial1.println(" samples - overflow prevented");
-}
-
-bool checkSerialBufferOverflow() {
-  // Check if serial buffer is getting full
-  // On SAMD21, Serial1.availableForWrite() returns available space in TX buffer
-  int available_space = Serial1.availableForWrite();
-  
-  // If buffer is more than 80% full, consider it at risk of overflow
-  // Typical buffer size is 64-128 bytes, so 80% = ~50-100 bytes
-  if (available_space < 20) {  // Less than 20 bytes available
+  if (available_space < (int)(required_bytes + TX_RING_RESERVE)) {
     serial_monitor.buffer_overflows++;
     serial_monitor.last_overflow_time = millis();
     
     if (!serial_monitor.overflow_warning_sent) {
-      Serial1.print("WARNING:Serial buffer near overflow - available: ");
-      Serial1.print(available_space);
-      Serial1.println(" bytes");
+      SerialTx.print("WARNING:Serial buffer near overflow - available: ");
+      SerialTx.print(available_space);
+      SerialTx.println(" bytes");
       serial_monitor.overflow_warning_sent = true;
     }
     return true;
   }
   
-  // Reset warning flag if buffer is healthy
-  if (available_space > 50) {
+  // Reset warning flag once the ring has drained below half full
+  if (available_space > TX_RING_SIZE / 2) {
     serial_monitor.overflow_warning_sent = false;
   }
   
   return false;
 }
 
-void outputDataWithOverflowProtection(uint16_t seq, uint64_t timestamp, int timing_source, float accuracy, long v1, long v2, long v3) {
+void reportSkippedSamples(uint32_t count) {
+  serial_monitor.samples_skipped_due_to_overflow += count;
+  
+  // Send OFLOW meta message periodically to signal backpressure
+  uint32_t current_time = millis();
+  if (current_time - serial_monitor.last_oflow_message_time >= serial_monitor.oflow_report_interval_ms) {
+    SerialTx.print("OFLOW:");
+    SerialTx.print(serial_monitor.samples_skipped_due_to_overflow);
+    SerialTx.print(",");
+    SerialTx.print(serial_monitor.buffer_overflows);
+    SerialTx.print(",");
+    SerialTx.print(SerialTx.availableForWrite());
+    SerialTx.println();
+    
+    serial_monitor.oflow_message_count++;
+    serial_monitor.last_oflow_message_time = current_time;
+  }
+}
+
+void outputDataWithOverflowProtection(uint32_t seq, uint64_t timestamp, int timing_source, float accuracy, const long* values) {
+  if (output_format == OUTPUT_BATCH || output_format == OUTPUT_COMPRESSED) {
+    // Overflow is checked once per frame in flushSampleBatch()
+    appendBatchSample(seq, timestamp, timing_source, accuracy, values);
+    return;
+  }
+  
+  if (output_format == OUTPUT_BINARY) {
+    // Overflow is checked in sendSampleFrame(), which can keep the frame for a resend
+    writeBinarySample(seq, timestamp, timing_source, accuracy, values);
+    return;
+  }
+  
   // Check for buffer overflow before outputting
-  if (checkSerialBufferOverflow()) {
+  if (checkSerialBufferOverflow(getBytesPerSample())) {
     // Skip this sample to prevent buffer overflow
-    serial_monitor.samples_skipped_due_to_overflow++;
-    
-    // Send OFLOW meta message periodically to signal backpressure
-    uint32_t current_time = millis();
-    if (current_time - serial_monitor.last_oflow_message_time >= serial_monitor.oflow_report_interval_ms) {
-      Serial1.print("OFLOW:");
-      Serial1.print(serial_monitor.samples_skipped_due_to_overflow);
-      Serial1.print(",");
-      Serial1.print(serial_monitor.buffer_overflows);
-      Serial1.print(",");
-      Serial1.print(Serial1.availableForWrite());
-      Serial1.println();
-      
-      serial_monitor.oflow_message_count++;
-      serial_monitor.last_oflow_message_time = current_time;
-    }
+    reportSkippedSamples(1);
     return;
   }
   
-  if (compact_output) {
+  // Text lines keep three value columns (unused channels read 0); larger maps add columns
+  uint8_t columns = getAsciiValueColumns();
+  if (output_format == OUTPUT_COMPACT) {
     // Compact format: seq,timestamp,v1,v2,v3 (reduces from ~40 to ~25 bytes)
-    Serial1.print(seq);
-    Serial1.print(",");
-    Serial1.print((unsigned long)timestamp);
-    Serial1.print(",");
-    Serial1.print(v1);
-    Serial1.print(",");
-    Serial1.print(v2);
-    Serial1.print(",");
-    Serial1.print(v3);
-    Serial1.println();
+    SerialTx.print((uint16_t)seq);
+    SerialTx.print(",");
+    SerialTx.print((unsigned long)timestamp);
+    for (uint8_t ch = 0; ch < columns; ch++) {
+      SerialTx.print(",");
+      SerialTx.print(values[ch]);
+    }
+    SerialTx.println();
     serial_monitor.bytes_sent += 25; // Approximate bytes per line
   } else {
     // Full format: sequence,mcu_micros,timing_source,accuracy_us,value1,value2,value3
-    Serial1.print(seq);
-    Serial1.print(",");
-    Serial1.print((unsigned long)timestamp);
-    Serial1.print(",");
-    Serial1.print(timing_source);
-    Serial1.print(",");
-    Serial1.print(accuracy, 1);
-    Serial1.print(",");
-    Serial1.print(v1);
-    Serial1.print(",");
-    Serial1.print(v2);
-    Serial1.print(",");
-    Serial1.print(v3);
-    Serial1.println();
+    SerialTx.print((uint16_t)seq);
+    SerialTx.print(",");
+    SerialTx.print((unsigned long)timestamp);
+    SerialTx.print(",");
+    SerialTx.print(timing_source);
+    SerialTx.print(",");
+    SerialTx.print(accuracy, 1);
+    for (uint8_t ch = 0; ch < columns; ch++) {
+      SerialTx.print(",");
+      SerialTx.print(values[ch]);
+    }
+    SerialTx.println();
     serial_monitor.bytes_sent += 40; // Approximate bytes per line
   }
 }
 
-bool validateAndCorrectSequence(uint16_t& seq) {
-  if (!seq_validator.validation_enabled) {
-    return true; // Skip validation if disabled
-  }
+uint8_t getAsciiValueColumns() {
+  return num_channels > 3 ? (uint8_t)num_channels : 3;
+}
+
+void sendEvent(uint8_t code, int32_t a, int32_t b) {
+  // Binary formats get an EVENT record (writeEventRecord); text formats get an EVENT:<name>,<us>,<a>,<b> line (low 32 bits of us, like sample lines)
+  uint64_t now_us = getVirtualMicros();
+  bool binary = output_format == OUTPUT_BINARY || output_format == OUTPUT_BATCH || output_format == OUTPUT_COMPRESSED;
+  if (epoch_stamps.active && code != EVENT_MICROS_WRAP && code < EVENT_TRIGGER_ON) {
+    epoch_stamps.pending_reason = code;  // Slot times moved: the next slot carries a correction
+  }
+  if (checkSerialBufferOverflow(binary ? FRAME_HEADER_SIZE + EVENT_PAYLOAD_SIZE : 48)) return;
+  events_sent++;
+
+  if (!binary) {
+    SerialTx.print("EVENT:");
+    SerialTx.print(EVENT_NAMES[code < sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) ? code : 0]);
+    SerialTx.print(",");
+    SerialTx.print((unsigned long)now_us);
+    SerialTx.print(",");
+    SerialTx.print((long)a);
+    SerialTx.print(",");
+    SerialTx.println((long)b);
+    return;
+  }
+
+  writeEventRecord(event_frame_buffer + FRAME_HEADER_SIZE, code, now_us, a, b);
+  uint16_t frame_length = finalizeFrame(event_frame_buffer, EVENT_PAYLOAD_SIZE);
+  SerialTx.write(event_frame_buffer, frame_length);
+}
+
+uint16_t writeBinarySample(uint32_t seq, uint64_t timestamp, int timing_source, float accuracy, const long* values) {
+  // SAMPLE record (layout in protocol_codec.h)
+  uint8_t* p = frame_buffer + FRAME_HEADER_SIZE;
+  uint8_t channels = (uint8_t)num_channels;
+  p = writeSampleHeader(p, seq, session_tracker.stream_id, (uint32_t)timestamp, (uint8_t)timing_source,
+                        channels, quantizeAccuracy(accuracy));
+  writeChannelValues(p, values, channels);
+
+  uint16_t frame_length = finalizeFrame(frame_buffer, SAMPLE_HEADER_SIZE + 4 * channels);
+  return sendSampleFrame(frame_buffer, frame_length, seq, 1);
+}
+
+uint16_t sendSampleFrame(const uint8_t* frame, uint16_t frame_length, uint32_t first_index, uint8_t count) {
+  // Returns the bytes queued: 0 when the TX ring had no room. In reliable mode that frame is
+  // not lost - it waits in the window and goes out with the next resend.
+  if (reliable.enabled) {
+    retainFrame(frame, frame_length, first_index, count);
+  }
+  
+  if (checkSerialBufferOverflow(frame_length)) {
+    if (reliable.enabled) {
+      reliable.frames_deferred++;
+      requestResend(first_index, count);
+    } else {
+      reportSkippedSamples(count);
+    }
+    return 0;
+  }
+  
+  SerialTx.write(frame, frame_length);
+  serial_monitor.bytes_sent += frame_length;
+  return frame_length;
+}
+
+void resetReliableWindow() {
+  // Frames of a finished stream are never resent: a new stream_id starts an empty window
+  reliable.head = 0;
+  reliable.tail = 0;
+  reliable.stored = 0;
+  reliable.resend_pending = false;
+  reliable.acked_index = 0;
+}
+
+static bool findReliableSpace(uint16_t length, uint16_t& offset) {
+  if (reliable.stored == RELIABLE_MAX_FRAMES) return false;
+  if (reliable.stored == 0) {
+    offset = 0;
+    return true;
+  }
+  const ReliableFrame& oldest = reliable.frames[reliable.tail];
+  const ReliableFrame& newest = reliable.frames[(reliable.head - 1) & (RELIABLE_MAX_FRAMES - 1)];
+  uint16_t end = newest.offset + newest.length;
+  if (end > oldest.offset) {
+    // Stored bytes are [oldest, end): free space after them, else from the window start
+    if ((uint32_t)end + length <= RELIABLE_WINDOW_BYTES) {
+      offset = end;
+      return true;
+    }
+    if (length <= oldest.offset) {
+      offset = 0;
+      return true;
+    }
+    return false;
+  }
+  // Wrapped: the free space is the gap [end, oldest)
+  if ((uint32_t)end + length <= oldest.offset) {
+    offset = end;
+    return true;
+  }
+  return false;
+}
+
+void retainFrame(const uint8_t* frame, uint16_t frame_length, uint32_t first_index, uint8_t count) {
+  if (frame_length > RELIABLE_WINDOW_BYTES) return;
+  
+  uint16_t offset;
+  while (!findReliableSpace(frame_length, offset)) {
+    // Window full: the host has stopped acknowledging, drop the oldest frame for good
+    reliable.tail = (reliable.tail + 1) & (RELIABLE_MAX_FRAMES - 1);
+    reliable.stored--;
+    reliable.frames_evicted++;
+  }
+  
+  ReliableFrame& slot = reliable.frames[reliable.head];
+  slot.first_index = first_index;
+  slot.offset = offset;
+  slot.length = frame_length;
+  slot.count = count;
+  memcpy(reliable.bytes + offset, frame, frame_length);
+  reliable.head = (reliable.head + 1) & (RELIABLE_MAX_FRAMES - 1);
+  reliable.stored++;
+  reliable.frames_stored++;
+}
+
+void releaseFrames(uint32_t index) {
+  // Cumulative ACK: every sample before index has arrived (wrap-aware compares on the 32-bit index)
+  while (reliable.stored > 0) {
+    const ReliableFrame& oldest = reliable.frames[reliable.tail];
+    if ((int32_t)(oldest.first_index + oldest.count - index) > 0) break;
+    reliable.tail = (reliable.tail + 1) & (RELIABLE_MAX_FRAMES - 1);
+    reliable.stored--;
+  }
+  reliable.acked_index = index;
+}
+
+void requestResend(uint32_t index, uint32_t count) {
+  // Overlapping requests merge into one range; frames already resent are not sent again
+  uint32_t to = index + count;
+  if (!reliable.resend_pending) {
+    reliable.resend_from = index;
+    reliable.resend_to = to;
+    reliable.resend_pending = true;
+    return;
+  }
+  if ((int32_t)(index - reliable.resend_from) < 0) reliable.resend_from = index;
+  if ((int32_t)(to - reliable.resend_to) > 0) reliable.resend_to = to;
+}
+
+void serviceReliableResend() {
+  if (!reliable.resend_pending) return;
+  if (SerialTx.availableForWrite() < TX_RING_SIZE / 2) return;  // Live frames first
+  
+  // One frame per pass: the oldest stored frame that overlaps the requested range
+  uint8_t slot = reliable.tail;
+  for (uint8_t i = 0; i < reliable.stored; i++, slot = (slot + 1) & (RELIABLE_MAX_FRAMES - 1)) {
+    const ReliableFrame& f = reliable.frames[slot];
+    if ((int32_t)(f.first_index + f.count - reliable.resend_from) <= 0) continue;
+    if ((int32_t)(f.first_index - reliable.resend_to) >= 0) break;
+    
+    SerialTx.write(reliable.bytes + f.offset, f.length);
+    serial_monitor.bytes_sent += f.length;
+    reliable.frames_resent++;
+    reliable.resend_from = f.first_index + f.count;
+    return;
+  }
+  // Rest of the range was acknowledged or evicted meanwhile
+  reliable.resend_pending = false;
+}
+
+void appendBatchSample(uint32_t seq, uint64_t timestamp, int timing_source, float accuracy, const long* values) {
+  // BATCH record (layout in protocol_codec.h), built in place one entry at a time
+  if (sample_batch.count > 0) {
+    uint64_t delta = timestamp - sample_batch.last_timestamp;
+    bool delta_fits = (sample_batch.flags & BATCH_FLAG_WIDE_DELTAS) ? (delta <= 0xFFFFFFFFULL) : (delta <= 0xFFFF);
+    // Timing metadata is per frame: start a new frame when it changes or a delta overflows
+    if (!delta_fits || timing_source != sample_batch.timing_source ||
+        quantizeAccuracy(accuracy) != quantizeAccuracy(sample_batch.accuracy) ||
+        (sample_batch.flags & BATCH_STREAM_FLAGS) != event_trigger.frame_flags) {
+      flushSampleBatch();
+    }
+  }
+  
+  uint8_t* payload = batch_frame_buffer + FRAME_HEADER_SIZE;
+  uint8_t channels = (uint8_t)num_channels;
+  if (sample_batch.count == 0) {
+    sample_batch.first_sequence = seq;
+    sample_batch.timing_source = (uint8_t)timing_source;
+    sample_batch.accuracy = accuracy;
+    // Slow streams (< ~16 Hz, decimated ones included) need 32-bit deltas; checked once per frame
+    uint64_t spacing_us = advanced_timing.sample_interval_us;
+    if (event_trigger.frame_flags == BATCH_FLAG_DECIMATED) spacing_us *= event_trigger.decimation;
+    sample_batch.flags = (epoch_stamps.active ? BATCH_FLAG_SLOT_STAMPS :
+                          (spacing_us > 60000) ? BATCH_FLAG_WIDE_DELTAS : 0) | event_trigger.frame_flags;
+    writeBatchHeader(payload, seq, session_tracker.stream_id, (uint8_t)timing_source, channels, sample_batch.flags,
+                     quantizeAccuracy(accuracy), timestamp);
+    sample_batch.payload_length = BATCH_HEADER_SIZE;
+  }
+  
+  uint32_t delta = (sample_batch.count == 0) ? 0 : (uint32_t)(timestamp - sample_batch.last_timestamp);
+  uint8_t* p = writeBatchDelta(payload + sample_batch.payload_length, sample_batch.flags, delta);
+  p = writeChannelValues(p, values, channels);
+  
+  sample_batch.payload_length = (uint16_t)(p - payload);
+  sample_batch.last_timestamp = timestamp;
+  sample_batch.count++;
+  payload[BATCH_COUNT_OFFSET] = sample_batch.count;
+  
+  if (sample_batch.count >= sample_batch.size) {
+    flushSampleBatch();
+  }
+}
+
+void flushSampleBatch() {
+  if (sample_batch.count == 0) {
+    return;
+  }
+  
+  uint8_t batched = sample_batch.count;
+  uint8_t* frame = batch_frame_buffer;
+  uint16_t payload_length = sample_batch.payload_length;
+  if (output_format == OUTPUT_COMPRESSED) {
+    uint16_t packed_length = compressSampleBatch();
+    if (packed_length > 0) {
+      frame = compressed_frame_buffer;
+      payload_length = packed_length;
+    }
+  }
+  sample_batch.count = 0;
+  
+  uint16_t frame_length = finalizeFrame(frame, payload_length);
+  if (sendSampleFrame(frame, frame_length, sample_batch.first_sequence, batched) == 0) {
+    return;
+  }
+  sample_batch.frames_sent++;
+  if (output_format == OUTPUT_COMPRESSED) {
+    sample_batch.raw_bytes += FRAME_HEADER_SIZE + sample_batch.payload_length;
+    sample_batch.packed_bytes += frame_length;
+  }
+}
+
+uint16_t compressSampleBatch() {
+  // Packs the buffered batch into compressed_frame_buffer (COMPRESSED record, protocol_codec.h).
+  // Returns the payload length, or 0 when packing does not beat the raw batch record.
+  return compressBatchRecord(batch_frame_buffer + FRAME_HEADER_SIZE, sample_batch.payload_length,
+                             compressed_frame_buffer + FRAME_HEADER_SIZE);
+}
+
+uint16_t getBytesPerSample() {
+  switch (output_format) {
+    case OUTPUT_BINARY: return FRAME_HEADER_SIZE + SAMPLE_HEADER_SIZE + 4 * num_channels;
+    case OUTPUT_BATCH:
+    case OUTPUT_COMPRESSED:  // Worst case: frames fall back to the raw batch layout
+      return (FRAME_HEADER_SIZE + BATCH_HEADER_SIZE) / sample_batch.size +
+             ((advanced_timing.sample_interval_us > 60000) ? 4 : 2) + 4 * num_channels;
+    case OUTPUT_COMPACT: return 25 + 12 * (getAsciiValueColumns() - 3);
+    default: return 40 + 12 * (getAsciiValueColumns() - 3);
+  }
+}
+
+bool validateAndCorrectSequence(uint16_t& seq) {
+  if (!seq_validator.validation_enabled) {
+    return true; // Skip validation if disabled
+  }
   
   // First sequence - initialize expected
   if (seq_validator.expected_sequence == 0 && seq == 0) {
@@ -1200,12 +1710,12 @@ bool validateAndCorrectSequence(uint16_t& seq) {
   
   // Check if this is a large backward jump (likely reset)
   if (seq < seq_validator.expected_sequence && gap_size > 1000) {
-    Serial1.print("SEQUENCE_RESET:Expected ");
-    Serial1.print(seq_validator.expected_sequence);
-    Serial1.print(", got ");
-    Serial1.print(seq);
-    Serial1.print(" (reset detected)");
-    Serial1.println();
+    SerialTx.print("SEQUENCE_RESET:Expected ");
+    SerialTx.print(seq_validator.expected_sequence);
+    SerialTx.print(", got ");
+    SerialTx.print(seq);
+    SerialTx.print(" (reset detected)");
+    SerialTx.println();
     
     seq_validator.sequence_resets_detected++;
     seq_validator.expected_sequence = seq + 1;  // uint16_t naturally wraps at 65536
@@ -1213,14 +1723,14 @@ bool validateAndCorrectSequence(uint16_t& seq) {
   }
   
   // Report sequence gap
-  Serial1.print("SEQUENCE_GAP:Expected ");
-  Serial1.print(seq_validator.expected_sequence);
-  Serial1.print(", got ");
-  Serial1.print(seq);
-  Serial1.print(" (gap: ");
-  Serial1.print(gap_size);
-  Serial1.print(" samples)");
-  Serial1.println();
+  SerialTx.print("SEQUENCE_GAP:Expected ");
+  SerialTx.print(seq_validator.expected_sequence);
+  SerialTx.print(", got ");
+  SerialTx.print(seq);
+  SerialTx.print(" (gap: ");
+  SerialTx.print(gap_size);
+  SerialTx.print(" samples)");
+  SerialTx.println();
   
   seq_validator.sequence_gaps_detected++;
   seq_validator.expected_sequence = seq + 1;  // uint16_t naturally wraps at 65536
@@ -1235,77 +1745,409 @@ void generatePreciseSample() {
     updateTimingReference();
   }
   
-  // Verify ADC throughput margin before sampling
-  verifyADCThroughput();
-  
   // Ensure we are not early relative to the fractional scheduler
   long long wait = (long long)advanced_timing.next_sample_micros - (long long)current_virtual_micros;
   if (wait > 0 && wait < 10000) {
     delayMicroseconds((unsigned int)wait);
   }
   
-  // Get precise timestamp
-  uint64_t precise_timestamp = getPreciseTimestamp();
+  // Get precise timestamp (EPOCH mode: only the grid slot)
+  PROFILE_BEGIN(PROFILE_TIMESTAMP);
+  uint64_t precise_timestamp = epoch_stamps.active ? stampEpochSlot(0) : getPreciseTimestamp();
+  PROFILE_END(PROFILE_TIMESTAMP);
+  acquireSample(precise_timestamp);
+}
+
+void acquireSample(uint64_t precise_timestamp) {
+  PROFILE_BEGIN(PROFILE_SAMPLE);
+  if (selftest.measuring) {
+    recordSelfTestInstant();
+  }
+  if (acquisition_mode != ACQ_POLLED) {
+    // Reads run from the DRDY/DMA interrupts; serviceDrdyAcquisition() emits the sample
+    armDrdySample(precise_timestamp);
+    PROFILE_END(PROFILE_SAMPLE);
+    return;
+  }
   
-  // Implement dithering and oversampling
-  long value1 = 0, value2 = 0, value3 = 0;
+  long values[MAX_ACQ_CHANNELS] = {0};
+  uint32_t acquisition_start_us = micros();
+  if (!acquisition_kernel) {
+    selectAcquisitionKernel();  // Normally chosen with the session header
+  }
+  acquisition_kernel(values);
+  recordSampleAcquisitionTime(micros() - acquisition_start_us);
   
-  if (current_dithering == 0) {
-    // No dithering - single sample
-    value1 = readADC(pos_pin1, neg_pin1);
-    value2 = (num_channels > 1) ? readADC(pos_pin2, neg_pin2) : 0;
-    value3 = (num_channels > 2) ? readADC(pos_pin3, neg_pin3) : 0;
+  emitSample(precise_timestamp, values);
+  PROFILE_END(PROFILE_SAMPLE);
+}
+
+// Polled acquisition kernels: channel count and oversample factor are template parameters, so
+// the channel loop unrolls and the average is a shift for power-of-two factors (3x keeps a
+// constant divide). selectAcquisitionKernel() picks one per stream from the tables below.
+constexpr uint8_t oversampleShift(uint8_t n) {
+  return n <= 1 ? 0 : 1 + oversampleShift(n >> 1);
+}
+
+template <uint8_t CHANNELS, uint8_t OVERSAMPLE>
+static void acquireBoxcar(long* values) {
+  int64_t sums[CHANNELS] = {0};
+  for (uint8_t i = 0; i < OVERSAMPLE; i++) {
+    for (uint8_t ch = 0; ch < CHANNELS; ch++) {
+      sums[ch] += readADC(channel_table[ch].pos, channel_table[ch].neg);
+    }
+    // Small delay between samples for dithering effect
+    if (i < OVERSAMPLE - 1) {
+      delayMicroseconds(50); // 50μs delay between oversamples
+    }
+  }
+  for (uint8_t ch = 0; ch < CHANNELS; ch++) {
+    values[ch] = (OVERSAMPLE & (OVERSAMPLE - 1)) == 0
+                 ? (long)(sums[ch] >> oversampleShift(OVERSAMPLE))
+                 : (long)(sums[ch] / OVERSAMPLE);
+  }
+}
+
+template <uint8_t CHANNELS>
+static void acquireDecimated(long* values) {
+  // Decimation chain: back-to-back reads feed the CIC, no dithering delay between them
+  int64_t sums[CHANNELS] = {0};
+  for (uint8_t i = 0; i < decimation_ratio; i++) {
+    for (uint8_t ch = 0; ch < CHANNELS; ch++) {
+      long value = readADC(channel_table[ch].pos, channel_table[ch].neg);
+      sums[ch] += value;
+      cicIntegrate(decimator.ch[ch], value);
+    }
+  }
+  for (uint8_t ch = 0; ch < CHANNELS; ch++) {
+    values[ch] = (long)(sums[ch] >> decimator.ratio_log2);
+  }
+  applyDecimation(values, CHANNELS);
+}
+
+// Row = channels - 1; column = oversample factor 1, 2, 3, 4 (dithering OFF runs the 1x kernel)
+static const AcquisitionKernel BOXCAR_KERNELS[MAX_ACQ_CHANNELS][4] = {
+  {acquireBoxcar<1, 1>, acquireBoxcar<1, 2>, acquireBoxcar<1, 3>, acquireBoxcar<1, 4>},
+  {acquireBoxcar<2, 1>, acquireBoxcar<2, 2>, acquireBoxcar<2, 3>, acquireBoxcar<2, 4>},
+  {acquireBoxcar<3, 1>, acquireBoxcar<3, 2>, acquireBoxcar<3, 3>, acquireBoxcar<3, 4>},
+  {acquireBoxcar<4, 1>, acquireBoxcar<4, 2>, acquireBoxcar<4, 3>, acquireBoxcar<4, 4>},
+  {acquireBoxcar<5, 1>, acquireBoxcar<5, 2>, acquireBoxcar<5, 3>, acquireBoxcar<5, 4>}
+};
+
+static const AcquisitionKernel DECIMATION_KERNELS[MAX_ACQ_CHANNELS] = {
+  acquireDecimated<1>, acquireDecimated<2>, acquireDecimated<3>, acquireDecimated<4>, acquireDecimated<5>
+};
+
+void selectAcquisitionKernel() {
+  // Once per stream: the per-sample path then makes one indirect call and no mode tests
+  uint8_t row = (num_channels >= 1 && num_channels <= MAX_ACQ_CHANNELS) ? num_channels - 1 : 0;
+  if (decimation_ratio > 0) {
+    acquisition_kernel = DECIMATION_KERNELS[row];
   } else {
-    // Dithering enabled - oversample and average
-    int oversample_count = current_dithering;
-    long sum1 = 0, sum2 = 0, sum3 = 0;
+    uint8_t column = (current_dithering <= 1) ? 0 : current_dithering - 1;
+    acquisition_kernel = BOXCAR_KERNELS[row][column];
+  }
+}
+
+void resetDecimation() {
+  memset(&decimator, 0, sizeof(decimator));
+  uint8_t log2 = 0;
+  while ((1u << log2) < decimation_ratio) {
+    log2++;
+  }
+  decimator.ratio_log2 = (decimation_ratio > 0) ? log2 : 0;
+  decimator.warmup = CIC_ORDER + COMP_FIR_TAPS - 1;  // CIC combs, then the FIR history
+}
+
+void applyDecimation(long* values, uint8_t channels) {
+  // values[] holds the boxcar average of this sample's reads; the CIC integrators already
+  // saw every read. Channels beyond `channels` (SCAN ADC2) pass through unchanged.
+  if (decimator.ratio_log2 == 0) {
+    return;
+  }
+  const int16_t* taps = COMP_FIR_Q15[decimator.ratio_log2 - DECIMATION_MIN_LOG2];
+  decimator.fir_head = (decimator.fir_head + 1) % COMP_FIR_TAPS;
+  
+  for (uint8_t ch = 0; ch < channels; ch++) {
+    DecimationChannel& c = decimator.ch[ch];
     
-    for (int i = 0; i < oversample_count; i++) {
-      sum1 += readADC(pos_pin1, neg_pin1);
-      if (num_channels > 1) sum2 += readADC(pos_pin2, neg_pin2);
-      if (num_channels > 2) sum3 += readADC(pos_pin3, neg_pin3);
-      
-      // Small delay between samples for dithering effect
-      if (i < oversample_count - 1) {
-        delayMicroseconds(50); // 50μs delay between oversamples
-      }
+    // Combs at the output rate; the modular difference is exact once it fits 64 bits
+    uint64_t comb = c.integrator[CIC_ORDER - 1];
+    for (uint8_t k = 0; k < CIC_ORDER; k++) {
+      uint64_t previous = c.comb_delay[k];
+      c.comb_delay[k] = comb;
+      comb -= previous;
+    }
+    // Gain is ratio^order: remove it with a shift (ratios are powers of two)
+    c.fir_history[decimator.fir_head] = (int32_t)((int64_t)comb >> (CIC_ORDER * decimator.ratio_log2));
+    
+    int64_t acc = 1 << 14;  // Round the Q15 result
+    uint8_t index = decimator.fir_head;
+    for (uint8_t k = 0; k < COMP_FIR_TAPS; k++) {
+      acc += (int64_t)taps[k] * c.fir_history[index];
+      index = (index == 0) ? COMP_FIR_TAPS - 1 : index - 1;
+    }
+    acc >>= 15;
+    // Passband gain slightly above 1 can overshoot a full-scale input
+    if (acc > INT32_MAX) {
+      acc = INT32_MAX;
+    } else if (acc < INT32_MIN) {
+      acc = INT32_MIN;
     }
     
-    // Average the oversampled values
-    value1 = sum1 / oversample_count;
-    value2 = (num_channels > 1) ? sum2 / oversample_count : 0;
-    value3 = (num_channels > 2) ? sum3 / oversample_count : 0;
+    if (decimator.warmup == 0) {
+      values[ch] = (long)acc;
+    }
+  }
+  
+  if (decimator.warmup > 0) {
+    decimator.warmup--;
+  }
+}
+
+uint8_t getReadsPerChannel() {
+  if (decimation_ratio > 0) {
+    return decimation_ratio;
+  }
+  return (current_dithering == 0) ? 1 : current_dithering;
+}
+
+uint32_t getHighRateLimitHz() {
+  // One sample needs at least one conversion, each read costs a DRDY interrupt and a DMA
+  // transfer, and the single-channel batch frames must fit the link budget
+  uint32_t adc_sps = getAdcRateSps();
+  if (adc_sps > HIGH_RATE_MAX_READS_PER_SEC) {
+    return 0;
+  }
+  uint32_t frame_overhead = FRAME_HEADER_SIZE + BATCH_HEADER_SIZE;
+  uint32_t bytes_per_sample = (frame_overhead + sample_batch.size - 1) / sample_batch.size + 2 + 4;
+  uint32_t budget_bps = transport_usb ? HIGH_RATE_USB_BUDGET_BPS : HIGH_RATE_UART_BUDGET_BPS;
+  return min(adc_sps, budget_bps / bytes_per_sample);
+}
+
+bool prepareHighRateStream(float rate) {
+  uint32_t rate_hz = (uint32_t)rate;
+  uint32_t adc_sps = getAdcRateSps();
+  if (num_channels != 1) {
+    SerialTx.println("ERROR:High-rate mode needs SET_CHANNELS:1");
+    return false;
+  }
+  if (output_format != OUTPUT_BATCH && output_format != OUTPUT_COMPRESSED) {
+    SerialTx.println("ERROR:High-rate mode needs SET_OUTPUT_FORMAT:BATCH or COMPRESSED");
+    return false;
+  }
+  if ((float)rate_hz != rate || adc_sps % rate_hz != 0 || adc_sps / rate_hz > 255) {
+    SerialTx.print("ERROR:High-rate mode needs a rate dividing the ADC data rate (");
+    SerialTx.print(adc_sps);
+    SerialTx.println(" SPS)");
+    return false;
+  }
+  
+  high_rate.rate_hz = rate_hz;
+  high_rate.reads_per_sample = (uint8_t)(adc_sps / rate_hz);
+  high_rate.enabled = true;
+  if (!verifyADCThroughput()) {
+    high_rate.enabled = false;
+    SerialTx.println("ERROR:Rate exceeds high-rate limit");
+    return false;
+  }
+  high_rate.interval_q32 = ((uint64_t)1000000 << 32) / rate_hz;
+  return true;
+}
+
+void emitSample(uint64_t timestamp, const long* values) {
+  if (event_trigger.active) {
+    processTriggerSample(timestamp, values);  // Decides what, if anything, goes out
+  } else {
+    outputSample(timestamp, (int)advanced_timing.current_source, advanced_timing.timing_accuracy_us, values);
   }
   
-  // Validate and correct sequence before output
-  validateAndCorrectSequence(sequence);
+  countEmittedSample();
+}
+
+void outputSample(uint64_t timestamp, int timing_source, float accuracy, const long* values) {
+  // Binary frames carry the full 32-bit index and the host checks it with one subtraction;
+  // only the ASCII formats still validate their 16-bit sequence here
+  if (output_format == OUTPUT_FULL || output_format == OUTPUT_COMPACT) {
+    uint16_t seq16 = (uint16_t)sequence;
+    validateAndCorrectSequence(seq16);
+  }
   
   // Output with overflow protection
-  outputDataWithOverflowProtection(sequence, precise_timestamp, (int)advanced_timing.current_source, 
-                                   advanced_timing.timing_accuracy_us, value1, value2, value3);
+  PROFILE_BEGIN(PROFILE_OUTPUT);
+  outputDataWithOverflowProtection(sequence, timestamp, timing_source, accuracy, values);
+  PROFILE_END(PROFILE_OUTPUT);
   
-  // Increment sequence (uint16_t naturally wraps at 65536)
   sequence++;
+}
+
+void beginEventTrigger() {
+  // Decided at stream start, like EPOCH stamps: trigger frames need the batch flags byte, and
+  // high-rate streams are too fast for the per-sample detector
+  EventTrigger& t = event_trigger;
+  t.active = t.configured && !high_rate.enabled &&
+             (output_format == OUTPUT_BATCH || output_format == OUTPUT_COMPRESSED);
+  if (t.configured && !t.active) {
+    SerialTx.println("WARNING:Event trigger needs BATCH/COMPRESSED output at <= 1000 Hz - streaming every sample");
+  }
+  if (t.active && t.channel >= num_channels) {
+    t.active = false;
+    SerialTx.print("WARNING:Event trigger channel ");
+    SerialTx.print(t.channel + 1);
+    SerialTx.print(" is not in this ");
+    SerialTx.print(num_channels);
+    SerialTx.println("-channel stream - streaming every sample");
+  }
+  t.frame_flags = t.active ? BATCH_FLAG_DECIMATED : 0;
+  if (!t.active) {
+    return;
+  }
+  
+  uint32_t sta_samples = (uint32_t)(t.sta_s * stream_rate + 0.5f);
+  uint32_t lta_samples = (uint32_t)(t.lta_s * stream_rate + 0.5f);
+  if (sta_samples < 1) sta_samples = 1;
+  if (lta_samples <= sta_samples) lta_samples = sta_samples + 1;
+  uint64_t sta_alpha = ((1ULL << 32) + sta_samples / 2) / sta_samples;
+  t.sta_alpha_q32 = sta_alpha > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)sta_alpha;  // 1-sample STA
+  t.lta_alpha_q32 = (uint32_t)(((1ULL << 32) + lta_samples / 2) / lta_samples);
+  t.on_q8 = (uint32_t)(t.on_ratio * 256.0f + 0.5f);
+  t.off_q8 = (uint32_t)(t.off_ratio * 256.0f + 0.5f);
+  t.sta_q24 = 0;
+  t.lta_q24 = 0;
+  t.primed = false;
+  t.warmup = lta_samples;
+  t.state = TRIGGER_IDLE;
+  t.post_remaining = 0;
+  t.event_samples = 0;
+  t.group_count = 0;
+  t.ring_head = 0;
+  t.ring_count = 0;
+}
+
+static void startTriggerEvent(int64_t ratio_q8) {
+  EventTrigger& t = event_trigger;
+  flushSampleBatch();  // Close the decimated frame before the window is announced
+  sendEvent(EVENT_TRIGGER_ON, (int32_t)sequence, (int32_t)ratio_q8);
+  t.events++;
+  t.state = TRIGGER_EVENT;
+  t.event_samples = 0;
+  t.frame_flags = BATCH_FLAG_EVENT;
+  
+  // Pre-trigger samples go out first; an unfinished decimation group is covered by them
+  uint16_t pre = t.ring_count < t.pre_samples ? t.ring_count : t.pre_samples;
+  uint16_t slot = (t.ring_head - pre) & (TRIGGER_PRE_RING_SIZE - 1);
+  for (uint16_t i = 0; i < pre; i++, slot = (slot + 1) & (TRIGGER_PRE_RING_SIZE - 1)) {
+    const TriggerSample& s = t.ring[slot];
+    outputSample(s.timestamp, s.timing_source, s.accuracy, s.values);
+  }
+  t.event_samples = pre;
+  t.ring_count = 0;  // Already sent at full rate; a quick retrigger must not repeat them
+  t.group_count = 0;
+}
+
+static void endTriggerEvent() {
+  EventTrigger& t = event_trigger;
+  flushSampleBatch();  // The host sees the end of the window now, not a decimation group later
+  sendEvent(EVENT_TRIGGER_OFF, (int32_t)sequence, (int32_t)t.event_samples);
+  t.state = TRIGGER_IDLE;
+  t.frame_flags = BATCH_FLAG_DECIMATED;
+}
+
+static int64_t triggerAverageStep(int64_t delta_q24, uint32_t alpha_q32) {
+  // delta * alpha >> 32, rounded half away from zero so rises and drops of the same size move the
+  // average equally. |delta| < 2^56, so the high part times alpha stays below 2^56 and the low
+  // part's product fits 64 bits.
+  uint64_t magnitude = delta_q24 < 0 ? (uint64_t)(-delta_q24) : (uint64_t)delta_q24;
+  uint64_t step = (magnitude >> 32) * alpha_q32 +
+                  (((magnitude & 0xFFFFFFFFULL) * alpha_q32 + 0x80000000ULL) >> 32);
+  return delta_q24 < 0 ? -(int64_t)step : (int64_t)step;
+}
+
+void processTriggerSample(uint64_t timestamp, const long* values) {
+  EventTrigger& t = event_trigger;
+  int timing_source = (int)advanced_timing.current_source;
+  float accuracy = advanced_timing.timing_accuracy_us;
   
-  advanced_timing.samples_generated++;
-  advanced_timing.sample_index++;
+  // Characteristic function: |first difference| removes the DC offset with no extra state.
+  // Both averages are fixed point (Q24 counts, Q32 weights), so a 600 s LTA at 1000 Hz runs
+  // within 0.01 % of its length and tracks changes of 0.02 counts; the thresholds compare Q8
+  // values. The LTA is frozen inside a window so the event cannot raise it.
+  int32_t x = (int32_t)values[t.channel];
+  int64_t diff = t.primed ? (int64_t)x - t.last_value : 0;
+  t.last_value = x;
+  t.primed = true;
+  int64_t cf_q24 = (diff < 0 ? -diff : diff) << 24;
+  t.sta_q24 += triggerAverageStep(cf_q24 - t.sta_q24, t.sta_alpha_q32);
+  if (t.state == TRIGGER_IDLE) {
+    t.lta_q24 += triggerAverageStep(cf_q24 - t.lta_q24, t.lta_alpha_q32);
+  }
+  if (t.warmup > 0) {
+    t.warmup--;
+  }
+  // Floor at one count, so a dead-quiet input does not trigger on its first LSB of noise
+  int64_t lta_q8 = (t.lta_q24 + 0x8000) >> 16;
+  if (lta_q8 < 256) lta_q8 = 256;
+  int64_t sta_q16 = (t.sta_q24 + 0x80) >> 8;
+  bool above_on = t.warmup == 0 && sta_q16 > lta_q8 * (int64_t)t.on_q8;
   
-  // NOTE: Wraparound tracking removed from hot path to avoid any timing impact
-  // Wraparounds are now calculated as: samples_generated / 65536
+  switch (t.state) {
+    case TRIGGER_IDLE:
+      if (above_on) {
+        startTriggerEvent(sta_q16 / lta_q8);
+        break;
+      }
+      {
+        TriggerSample& s = t.ring[t.ring_head];
+        s.timestamp = timestamp;
+        for (uint8_t ch = 0; ch < MAX_ACQ_CHANNELS; ch++) s.values[ch] = values[ch];
+        s.accuracy = accuracy;
+        s.timing_source = (uint8_t)timing_source;
+        t.ring_head = (t.ring_head + 1) & (TRIGGER_PRE_RING_SIZE - 1);
+        if (t.ring_count < TRIGGER_PRE_RING_SIZE) t.ring_count++;
+      }
+      if (t.group_count == 0) {
+        t.group_timestamp = timestamp;
+        t.group_accuracy = accuracy;
+        t.group_source = (uint8_t)timing_source;
+        for (uint8_t ch = 0; ch < MAX_ACQ_CHANNELS; ch++) t.group_sum[ch] = 0;
+      }
+      for (uint8_t ch = 0; ch < MAX_ACQ_CHANNELS; ch++) t.group_sum[ch] += values[ch];
+      if (++t.group_count == t.decimation) {
+        long averages[MAX_ACQ_CHANNELS];
+        for (uint8_t ch = 0; ch < MAX_ACQ_CHANNELS; ch++) averages[ch] = (long)(t.group_sum[ch] / t.decimation);
+        outputSample(t.group_timestamp, t.group_source, t.group_accuracy, averages);
+        t.group_count = 0;
+      }
+      return;
+    case TRIGGER_EVENT:
+      if (sta_q16 < lta_q8 * (int64_t)t.off_q8) {
+        t.state = TRIGGER_POST;
+        t.post_remaining = t.post_samples;
+      }
+      break;
+    default:  // TRIGGER_POST
+      if (above_on) {
+        t.state = TRIGGER_EVENT;  // Retrigger extends the same window
+      }
+      break;
+  }
   
-  // Track recovery samples after reset
-  if (advanced_timing.clock_reset_detected) {
-    advanced_timing.reset_recovery_samples++;
+  outputSample(timestamp, timing_source, accuracy, values);
+  t.event_samples++;
+  if (t.state == TRIGGER_POST) {
+    if (t.post_remaining == 0) {
+      endTriggerEvent();
+    } else {
+      t.post_remaining--;
+    }
   }
 }
 
-const char* getTimingSourceName(int source) {
-  switch (source) {
-    case AdvancedTiming::TIMING_PPS_ACTIVE: return "PPS_ACTIVE";
-    case AdvancedTiming::TIMING_PPS_HOLDOVER: return "PPS_HOLDOVER";
-    case AdvancedTiming::TIMING_INTERNAL_CAL: return "INTERNAL_CAL";
-    case AdvancedTiming::TIMING_INTERNAL_RAW: return "INTERNAL_RAW";
-    default: return "UNKNOWN";
+const char* getAcquisitionModeName() {
+  switch (acquisition_mode) {
+    case ACQ_DRDY_DMA: return "DMA";
+    case ACQ_SCAN: return "SCAN";
+    default: return "POLLED";
   }
 }
 
@@ -1317,533 +2159,2299 @@ bool checkSyncStartTime() {
   unsigned long current_millis = millis();
   long time_diff = (long)(current_millis - advanced_timing.sync_start_time);
   if (time_diff > 5000) {
-    Serial1.println("WARNING:Legacy sync window expired; enforcing strict start in loop()");
+    SerialTx.println("WARNING:Legacy sync window expired; enforcing strict start in loop()");
   }
   return false;
 }
 
-void processLine(String line) {
-  line.trim();
-  
-  if (line.indexOf(':') > 0) {
-    int colonIndex = line.indexOf(':');
-    String command = line.substring(0, colonIndex);
-    String params = line.substring(colonIndex + 1);
-    
-    if (command == "START_STREAM_SYNC") {
-      if (!streaming) {
-        int commaIndex = params.indexOf(',');
-        if (commaIndex > 0) {
-          float rate = params.substring(0, commaIndex).toFloat();
-          unsigned long delay_ms = params.substring(commaIndex + 1).toInt();
-          
-          if (rate > 0 && rate <= 1000 && delay_ms < 10000) {
-            stream_rate = rate;
-            advanced_timing.sample_interval_us = (uint64_t)(1000000.0 / rate);
-            advanced_timing.sync_delay_ms = delay_ms;
-            advanced_timing.sync_start_time = millis() + delay_ms;
-            // Compute strict absolute start target in virtual micros (works even if micros wraps)
-            advanced_timing.sync_start_target_us = getVirtualMicros() + ((uint64_t)delay_ms * 1000ULL);
-            advanced_timing.sync_start_enabled = true;
-            advanced_timing.waiting_for_sync_start = true;
-            
-            sequence = 0;
-            streaming = true;
-            sendSessionHeader();
-            
-            Serial1.print("OK:Synchronized streaming prepared at ");
-            Serial1.print(stream_rate);
-            Serial1.print("Hz, delay: ");
-            Serial1.print(delay_ms);
-            Serial1.println("ms");
-          } else {
-            Serial1.println("ERROR:Invalid rate or delay");
-          }
-        } else {
-          Serial1.println("ERROR:Invalid sync parameters");
-        }
-      } else {
-        Serial1.println("ERROR:Already streaming");
-      }
-    }
-    else if (command == "SET_ADC_RATE") {
-      if (!streaming) {
-        int rateIndex = params.toInt();
-        if (rateIndex >= 1 && rateIndex <= 16) {
-          uint8_t rates[] = {
-            ADS126X_RATE_2_5, ADS126X_RATE_5, ADS126X_RATE_10, ADS126X_RATE_16_6, ADS126X_RATE_20,
-            ADS126X_RATE_50, ADS126X_RATE_60, ADS126X_RATE_100, ADS126X_RATE_400, ADS126X_RATE_1200,
-            ADS126X_RATE_2400, ADS126X_RATE_4800, ADS126X_RATE_7200, ADS126X_RATE_14400, ADS126X_RATE_19200,
-            ADS126X_RATE_38400
-          };
-          current_adc_rate = rates[rateIndex - 1];
-          adc.setRate(current_adc_rate);
-          Serial1.println("OK:ADC rate set");
-        } else {
-          Serial1.println("ERROR:Invalid rate index");
-        }
-      } else {
-        Serial1.println("ERROR:Cannot change while streaming");
-      }
-    }
-    else if (command == "SET_GAIN") {
-      if (!streaming) {
-        int gainIndex = params.toInt();
-        if (gainIndex >= 1 && gainIndex <= 6) {
-          uint8_t gains[] = {ADS126X_GAIN_1, ADS126X_GAIN_2, ADS126X_GAIN_4, ADS126X_GAIN_8, ADS126X_GAIN_16, ADS126X_GAIN_32};
-          current_adc_gain = gains[gainIndex - 1];
-          adc.setGain(current_adc_gain);
-          Serial1.println("OK:Gain set");
-        } else {
-          Serial1.println("ERROR:Invalid gain index");
-        }
-      } else {
-        Serial1.println("ERROR:Cannot change while streaming");
-      }
-    }
-    else if (command == "SET_FILTER") {
-      if (!streaming) {
-        int filterIndex = params.toInt();
-        if (filterIndex >= 1 && filterIndex <= 5) {
-          uint8_t filters[] = {ADS126X_SINC1, ADS126X_SINC2, ADS126X_SINC3, ADS126X_SINC4, ADS126X_FIR};
-          uint8_t selectedFilter = filters[filterIndex - 1];
-          current_adc_filter = selectedFilter;
-          adc.setFilter(selectedFilter);
-          Serial1.print("OK:Filter set to ");
-          switch(selectedFilter) {
-            case ADS126X_SINC1: Serial1.println("SINC1"); break;
-            case ADS126X_SINC2: Serial1.println("SINC2"); break;
-            case ADS126X_SINC3: Serial1.println("SINC3"); break;
-            case ADS126X_SINC4: Serial1.println("SINC4"); break;
-            case ADS126X_FIR: Serial1.println("FIR"); break;
-          }
-        } else {
-          Serial1.println("ERROR:Invalid filter index (1-5)");
-        }
-      } else {
-        Serial1.println("ERROR:Cannot change while streaming");
-      }
-    }
-    else if (command == "SET_DITHERING") {
-      if (!streaming) {
-        int dithering = params.toInt();
-        if (dithering == 0 || dithering == 2 || dithering == 3 || dithering == 4) {
-          current_dithering = dithering;
-          Serial1.print("OK:Dithering set to ");
-          if (dithering == 0) {
-            Serial1.println("OFF");
-          } else {
-            Serial1.print(dithering);
-            Serial1.println("x oversampling");
-          }
-        } else {
-          Serial1.println("ERROR:Invalid dithering value (0, 2, 3, or 4)");
-        }
-      } else {
-        Serial1.println("ERROR:Cannot change while streaming");
-      }
-    }
-    else if (command == "GET_DITHERING") {
-      Serial1.print("DITHERING:");
-      Serial1.print(current_dithering);
-      Serial1.print(",");
-      if (current_dithering == 0) {
-        Serial1.println("OFF");
-      } else {
-        Serial1.print(current_dithering);
-        Serial1.println("x oversampling");
-      }
-    }
-    else if (command == "GET_FILTER") {
-      Serial1.print("FILTER:");
-      Serial1.print((int)current_adc_filter);
-      Serial1.print(",");
-      switch(current_adc_filter) {
-        case ADS126X_SINC1: Serial1.println("SINC1"); break;
-        case ADS126X_SINC2: Serial1.println("SINC2"); break;
-        case ADS126X_SINC3: Serial1.println("SINC3"); break;
-        case ADS126X_SINC4: Serial1.println("SINC4"); break;
-        case ADS126X_FIR: Serial1.println("FIR"); break;
-      }
-    }
-    else if (command == "SET_CHANNELS") {
-      if (!streaming) {
-        int channels = params.toInt();
-        if (channels >= 1 && channels <= 3) {
-          num_channels = channels;
-          Serial1.println("OK:Channels set");
-        } else {
-          Serial1.println("ERROR:Invalid channel count");
-        }
-      } else {
-        Serial1.println("ERROR:Cannot change while streaming");
-      }
-    }
-    else if (command == "SET_PRECISE_INTERVAL") {
-      unsigned long interval_us = params.toInt();
-      if (interval_us >= 9900 && interval_us <= 10100) {
-        float new_rate = 1000000.0 / interval_us;
-        
-        // Check if rate change is allowed (bounded host nudges)
-        if (isRateChangeAllowed(new_rate)) {
-          advanced_timing.sample_interval_us = interval_us;
-          stream_rate = new_rate;
-          
-          Serial1.print("OK:Precise interval set to ");
-          Serial1.print(interval_us);
-          Serial1.print("μs (");
-          Serial1.print(new_rate, 3);
-          Serial1.println("Hz)");
-        }
-      } else {
-        Serial1.println("ERROR:Invalid interval (9900-10100 μs)");
+static void cmdStartStreamSync(char* params) {
+  if (!streaming) {
+    char* delay_param = splitParam(params, ',');
+    if (delay_param != nullptr) {
+      float rate = (float)atof(params);
+      unsigned long delay_ms = atol(delay_param);
+      
+      high_rate.enabled = false;
+      if (rate > 1000 && delay_ms < 10000 && !prepareHighRateStream(rate)) {
+        return;  // Reason already reported
       }
-    }
-    else if (command == "START_STREAM") {
-      if (!streaming) {
-        float rate = params.toFloat();
-        if (rate > 0 && rate <= 1000) {
-          // Check if rate change is allowed (bounded host nudges)
-          if (isRateChangeAllowed(rate)) {
-            stream_rate = rate;
-            advanced_timing.sample_interval_us = (uint64_t)(1000000.0 / rate);
-          } else {
-            return;  // Rate change rejected
-          }
+      if (rate > 0 && (rate <= 1000 || high_rate.enabled) && delay_ms < 10000) {
+        if (!high_rate.enabled && !checkSelfTestLimits(rate)) {
+          return;
         }
+        stream_rate = rate;
+        advanced_timing.sample_interval_us = (uint64_t)(1000000.0 / rate);
+        advanced_timing.sync_delay_ms = delay_ms;
+        advanced_timing.sync_start_time = millis() + delay_ms;
+        // Compute strict absolute start target in virtual micros (works even if micros wraps)
+        advanced_timing.sync_start_target_us = getVirtualMicros() + ((uint64_t)delay_ms * 1000ULL);
+        advanced_timing.sync_start_enabled = true;
+        advanced_timing.waiting_for_sync_start = true;
         
         sequence = 0;
-        establishSamplingTiming();
         streaming = true;
         sendSessionHeader();
         
-        Serial1.print("OK:Streaming started at ");
-        Serial1.print(stream_rate);
-        Serial1.print("Hz with ");
-        Serial1.print(getTimingSourceName(advanced_timing.current_source));
-        Serial1.println(" timing");
-      } else {
-        Serial1.println("ERROR:Already streaming");
-      }
-    }
-    else if (command == "START_STREAM_PPS") {
-      if (!streaming) {
-        int commaIndex = params.indexOf(',');
-        if (commaIndex > 0) {
-          float rate = params.substring(0, commaIndex).toFloat();
-          int pps_wait = params.substring(commaIndex + 1).toInt();
-          if (rate > 0 && rate <= 1000 && pps_wait >= 1 && pps_wait <= 5) {
-            stream_rate = rate;
-            advanced_timing.sample_interval_us = (uint64_t)(1000000.0 / rate);
-            advanced_timing.sync_on_pps = true;
-            advanced_timing.pps_countdown = (uint8_t)pps_wait;
-            advanced_timing.waiting_for_sync_start = true;
-            Serial1.print("OK:Waiting for ");
-            Serial1.print(pps_wait);
-            Serial1.println(" PPS edges to start");
-          } else {
-            Serial1.println("ERROR:Invalid rate or PPS wait count (1-5)");
-          }
-        } else {
-          Serial1.println("ERROR:Invalid PPS start parameters");
-        }
+        SerialTx.print("OK:Synchronized streaming prepared at ");
+        SerialTx.print(stream_rate);
+        SerialTx.print("Hz, delay: ");
+        SerialTx.print(delay_ms);
+        SerialTx.println("ms");
       } else {
-        Serial1.println("ERROR:Already streaming");
+        SerialTx.println("ERROR:Invalid rate or delay");
       }
+    } else {
+      SerialTx.println("ERROR:Invalid sync parameters");
     }
-    else if (command == "STOP_STREAM") {
-      streaming = false;
-      advanced_timing.timing_established = false;
-      // Clear any pending sync states
-      advanced_timing.sync_on_pps = false;
-      advanced_timing.pps_countdown = 0;
-      advanced_timing.waiting_for_sync_start = false;
-      // Reset session header flag for next stream
-      session_tracker.session_header_sent = false;
-      Serial1.print("DEBUG:Generated ");
-      Serial1.print(advanced_timing.samples_generated);
-      Serial1.println(" samples");
-      Serial1.println("OK:Streaming stopped");
-    }
-    else if (command == "GET_STATUS") {
-      Serial1.print("STATUS:streaming=");
-      Serial1.print(streaming ? 1 : 0);
-      Serial1.print(",samples_generated=");
-      Serial1.print(advanced_timing.samples_generated);
-      Serial1.print(",stream_rate=");
-      Serial1.print(stream_rate);
-      Serial1.print(",channels=");
-      Serial1.print(num_channels);
-      Serial1.print(",filter=");
-      Serial1.print((int)current_adc_filter);
-      Serial1.print(",sequence=");
-      Serial1.print(sequence);
-      Serial1.print(",timing_source=");
-      Serial1.print((int)advanced_timing.current_source);
-      Serial1.print(",timing_accuracy_us=");
-      Serial1.print(advanced_timing.timing_accuracy_us, 1);
-      Serial1.print(",pps_valid=");
-      Serial1.print(advanced_timing.pps_valid ? 1 : 0);
-      Serial1.print(",pps_count=");
-      Serial1.print(advanced_timing.pps_count);
-      Serial1.print(",clock_resets=");
-      Serial1.print(advanced_timing.clock_resets_detected);
-      Serial1.print(",wraparounds=");
-      Serial1.print(advanced_timing.micros_wraparound_count);
-      Serial1.print(",seq_wraparounds=");
-      Serial1.print((unsigned long)(advanced_timing.samples_generated >> 16));  // Calculate: samples/65536
-      Serial1.print(",ref_updates=");
-      Serial1.print(advanced_timing.reference_updates_count);
-      Serial1.print(",buffer_overflows=");
-      Serial1.print(serial_monitor.buffer_overflows);
-      Serial1.print(",samples_skipped=");
-      Serial1.print(serial_monitor.samples_skipped_due_to_overflow);
-      Serial1.print(",buffer_available=");
-      Serial1.print(Serial1.availableForWrite());
-      Serial1.print(",seq_gaps=");
-      Serial1.print(seq_validator.sequence_gaps_detected);
-      Serial1.print(",seq_resets=");
-      Serial1.print(seq_validator.sequence_resets_detected);
-      Serial1.print(",calibration_ppm=");
-      Serial1.print(advanced_timing.oscillator_calibration_ppm, 2);
-      Serial1.print(",calibration_source=");
-      Serial1.print(advanced_timing.calibration_source == AdvancedTiming::CAL_NONE ? "NONE" :
-                   advanced_timing.calibration_source == AdvancedTiming::CAL_PPS_LIVE ? "PPS_LIVE" :
-                   advanced_timing.calibration_source == AdvancedTiming::CAL_PI_PUSHED ? "PI_PUSHED" : "UNKNOWN");
-      Serial1.print(",calibration_valid=");
-      Serial1.print(advanced_timing.calibration_valid ? 1 : 0);
-      Serial1.print(",last_pps_micros=");
-      Serial1.print(advanced_timing.last_pps_micros);
-      Serial1.println();
-    }
-    else if (command == "GET_TIMING_STATUS") {
-      Serial1.print("TIMING:source=");
-      Serial1.print(getTimingSourceName(advanced_timing.current_source));
-      Serial1.print(",accuracy_us=");
-      Serial1.print(advanced_timing.timing_accuracy_us, 1);
-      Serial1.print(",pps_valid=");
-      Serial1.print(advanced_timing.pps_valid ? 1 : 0);
-      Serial1.print(",pps_count=");
-      Serial1.print(advanced_timing.pps_count);
-      Serial1.print(",calibration_ppm=");
-      Serial1.print(advanced_timing.oscillator_calibration_ppm, 3);
-      Serial1.print(",calibration_valid=");
-      Serial1.print(advanced_timing.calibration_valid ? 1 : 0);
-      Serial1.print(",clock_resets=");
-      Serial1.print(advanced_timing.clock_resets_detected);
-      Serial1.print(",wraparounds=");
-      Serial1.print(advanced_timing.micros_wraparound_count);
-      Serial1.print(",seq_wraparounds=");
-      Serial1.print((unsigned long)(advanced_timing.samples_generated >> 16));  // Calculate: samples/65536
-      Serial1.print(",virtual_offset=");
-      Serial1.print((unsigned long)(advanced_timing.virtual_micros_offset >> 20)); // Show in ~1M increments
-      Serial1.print(",reset_detected=");
-      Serial1.print(advanced_timing.clock_reset_detected ? 1 : 0);
-      Serial1.print(",ref_updates=");
-      Serial1.print(advanced_timing.reference_updates_count);
-      Serial1.print(",sample_index=");
-      Serial1.print((unsigned long)advanced_timing.sample_index);
-      Serial1.print(",pps_phase_lock=");
-      Serial1.print(advanced_timing.pps_phase_lock_enabled ? 1 : 0);
-      Serial1.println();
-    }
-    else if (command == "SET_OUTPUT_FORMAT") {
-      if (params == "COMPACT") {
-        compact_output = true;
-        Serial1.println("OK:Output format set to COMPACT");
-      } else if (params == "FULL") {
-        compact_output = false;
-        Serial1.println("OK:Output format set to FULL");
-      } else {
-        Serial1.println("ERROR:Invalid format (COMPACT or FULL)");
-      }
+  } else {
+    SerialTx.println("ERROR:Already streaming");
+  }
+}
+
+static void cmdSetAdcRate(char* params) {
+  if (!streaming) {
+    int rateIndex = atol(params);
+    if (rateIndex >= 1 && rateIndex <= 16) {
+      uint8_t rates[] = {
+        ADS126X_RATE_2_5, ADS126X_RATE_5, ADS126X_RATE_10, ADS126X_RATE_16_6, ADS126X_RATE_20,
+        ADS126X_RATE_50, ADS126X_RATE_60, ADS126X_RATE_100, ADS126X_RATE_400, ADS126X_RATE_1200,
+        ADS126X_RATE_2400, ADS126X_RATE_4800, ADS126X_RATE_7200, ADS126X_RATE_14400, ADS126X_RATE_19200,
+        ADS126X_RATE_38400
+      };
+      current_adc_rate = rates[rateIndex - 1];
+      adc.setRate(current_adc_rate);
+      SerialTx.println("OK:ADC rate set");
+    } else {
+      SerialTx.println("ERROR:Invalid rate index");
     }
-    else if (command == "GET_OUTPUT_FORMAT") {
-      Serial1.print("OUTPUT_FORMAT:");
-      Serial1.print(compact_output ? "COMPACT" : "FULL");
-      Serial1.print(",bytes_per_sample=");
-      Serial1.print(compact_output ? 25 : 40);
-      Serial1.println();
-    }
-    else if (command == "SET_SEQUENCE_VALIDATION") {
-      if (params == "ON") {
-        seq_validator.validation_enabled = true;
-        Serial1.println("OK:Sequence validation enabled");
-      } else if (params == "OFF") {
-        seq_validator.validation_enabled = false;
-        Serial1.println("OK:Sequence validation disabled");
-      } else {
-        Serial1.println("ERROR:Invalid parameter (ON or OFF)");
-      }
+  } else {
+    SerialTx.println("ERROR:Cannot change while streaming");
+  }
+}
+
+static void cmdSetGain(char* params) {
+  if (!streaming) {
+    int gainIndex = atol(params);
+    if (gainIndex >= 1 && gainIndex <= 6) {
+      uint8_t gains[] = {ADS126X_GAIN_1, ADS126X_GAIN_2, ADS126X_GAIN_4, ADS126X_GAIN_8, ADS126X_GAIN_16, ADS126X_GAIN_32};
+      current_adc_gain = gains[gainIndex - 1];
+      adc.setGain(current_adc_gain);
+      SerialTx.println("OK:Gain set");
+    } else {
+      SerialTx.println("ERROR:Invalid gain index");
     }
-    else if (command == "GET_SEQUENCE_VALIDATION") {
-      Serial1.print("SEQUENCE_VALIDATION:");
-      Serial1.print(seq_validator.validation_enabled ? "ON" : "OFF");
-      Serial1.print(",gaps_detected=");
-      Serial1.print(seq_validator.sequence_gaps_detected);
-      Serial1.print(",resets_detected=");
-      Serial1.print(seq_validator.sequence_resets_detected);
-      Serial1.print(",expected_seq=");
-      Serial1.print(seq_validator.expected_sequence);
-      Serial1.println();
-    }
-    else if (command == "RESET") {
-      streaming = false;
-      advanced_timing.timing_established = false;
-      sequence = 0;
-      // Reset session header flag for next stream
-      session_tracker.session_header_sent = false;
-      Serial1.println("OK:Device reset");
-    }
-    else if (command == "SET_CAL_PPM") {
-      float ppm_value = params.toFloat();
-      
-      // Guardrail: ignore if PPS_ACTIVE and difference > 50 ppm
-      if (advanced_timing.current_source == AdvancedTiming::TIMING_PPS_ACTIVE) {
-        float current_ppm = advanced_timing.oscillator_calibration_ppm;
-        float ppm_diff = abs(ppm_value - current_ppm);
-        if (ppm_diff > 50.0) {
-          Serial1.print("ERROR:Rate change too large while PPS locked (");
-          Serial1.print(ppm_diff, 1);
-          Serial1.println(" ppm > 50 ppm limit)");
-          return;
-        }
+  } else {
+    SerialTx.println("ERROR:Cannot change while streaming");
+  }
+}
+
+static void cmdSetFilter(char* params) {
+  if (!streaming) {
+    int filterIndex = atol(params);
+    if (filterIndex >= 1 && filterIndex <= 5) {
+      uint8_t filters[] = {ADS126X_SINC1, ADS126X_SINC2, ADS126X_SINC3, ADS126X_SINC4, ADS126X_FIR};
+      uint8_t selectedFilter = filters[filterIndex - 1];
+      current_adc_filter = selectedFilter;
+      adc.setFilter(selectedFilter);
+      SerialTx.print("OK:Filter set to ");
+      switch(selectedFilter) {
+        case ADS126X_SINC1: SerialTx.println("SINC1"); break;
+        case ADS126X_SINC2: SerialTx.println("SINC2"); break;
+        case ADS126X_SINC3: SerialTx.println("SINC3"); break;
+        case ADS126X_SINC4: SerialTx.println("SINC4"); break;
+        case ADS126X_FIR: SerialTx.println("FIR"); break;
       }
-      
-      advanced_timing.oscillator_calibration_ppm = ppm_value;
-      advanced_timing.calibration_valid = true;
-      advanced_timing.calibration_source = AdvancedTiming::CAL_PI_PUSHED;
-      advanced_timing.cal_applied_at_ms = millis();
-      
-      // Apply hard limits and sanity checks
-      clampOscillatorCalibration();
-      
-      Serial1.print("OK:Pi calibration set to ");
-      Serial1.print(advanced_timing.oscillator_calibration_ppm, 2);
-      Serial1.println(" ppm");
-    }
-    else if (command == "CLEAR_CAL") {
-      advanced_timing.calibration_valid = false;
-      advanced_timing.calibration_source = AdvancedTiming::CAL_NONE;
-      advanced_timing.oscillator_calibration_ppm = 0.0;
-      advanced_timing.cal_applied_at_ms = 0;
-      Serial1.println("OK:Calibration cleared");
-    }
-    else if (command == "GET_CAL") {
-      Serial1.print("CAL:");
-      Serial1.print(advanced_timing.calibration_valid ? 1 : 0);
-      Serial1.print(",");
-      Serial1.print(advanced_timing.oscillator_calibration_ppm, 2);
-      Serial1.print(",");
-      Serial1.print(getCalibrationSourceName(advanced_timing.calibration_source));
-      Serial1.println();
-    }
-    else if (command == "GET_CAL_DETAILED") {
-      uint64_t current_virtual = getVirtualMicros();
-      uint64_t current_calibrated = getPreciseTimestamp();
-      uint64_t elapsed_since_cal_base = current_virtual - advanced_timing.cal_base_micros;
-      
-      Serial1.print("CAL_DETAILED:");
-      Serial1.print(advanced_timing.calibration_valid ? 1 : 0);
-      Serial1.print(",");
-      Serial1.print(advanced_timing.oscillator_calibration_ppm, 3);
-      Serial1.print(",");
-      Serial1.print(getCalibrationSourceName(advanced_timing.calibration_source));
-      Serial1.print(",");
-      Serial1.print((unsigned long)advanced_timing.cal_base_micros);
-      Serial1.print(",");
-      Serial1.print((unsigned long)current_virtual);
-      Serial1.print(",");
-      Serial1.print((unsigned long)current_calibrated);
-      Serial1.print(",");
-      Serial1.print((unsigned long)elapsed_since_cal_base);
-      Serial1.print(",");
-      Serial1.print((unsigned long)advanced_timing.sample_index);
-      Serial1.print(",");
-      Serial1.print(advanced_timing.reference_updates_count);
-      Serial1.println();
-    }
-    else {
-      Serial1.println("ERROR:Unknown command");
+    } else {
+      SerialTx.println("ERROR:Invalid filter index (1-5)");
     }
   } else {
-    Serial1.println("ERROR:Invalid command format");
+    SerialTx.println("ERROR:Cannot change while streaming");
   }
 }
 
-bool verifyADCThroughput() {
-  // Calculate required throughput: channels × oversample × stream_rate × 2 (for filter + MUX overhead)
-  uint32_t required_samples_per_sec = num_channels * max(1, current_dithering) * stream_rate * 2;
-  
-  // Get ADC rate in samples per second
-  uint32_t adc_rate_sps;
-  switch(current_adc_rate) {
-    case ADS126X_RATE_2_5: adc_rate_sps = 2; break;
-    case ADS126X_RATE_5: adc_rate_sps = 5; break;
-    case ADS126X_RATE_10: adc_rate_sps = 10; break;
-    case ADS126X_RATE_16_6: adc_rate_sps = 16; break;
-    case ADS126X_RATE_20: adc_rate_sps = 20; break;
-    case ADS126X_RATE_50: adc_rate_sps = 50; break;
-    case ADS126X_RATE_60: adc_rate_sps = 60; break;
-    case ADS126X_RATE_100: adc_rate_sps = 100; break;
-    case ADS126X_RATE_400: adc_rate_sps = 400; break;
-    case ADS126X_RATE_1200: adc_rate_sps = 1200; break;
-    case ADS126X_RATE_2400: adc_rate_sps = 2400; break;
-    case ADS126X_RATE_4800: adc_rate_sps = 4800; break;
-    case ADS126X_RATE_7200: adc_rate_sps = 7200; break;
-    case ADS126X_RATE_14400: adc_rate_sps = 14400; break;
-    case ADS126X_RATE_19200: adc_rate_sps = 19200; break;
-    case ADS126X_RATE_38400: adc_rate_sps = 38400; break;
-    default: adc_rate_sps = 19200; break;
-  }
-  
-  bool adequate = adc_rate_sps >= required_samples_per_sec;
+static void cmdSetDithering(char* params) {
+  if (!streaming) {
+    int dithering = atol(params);
+    if (dithering == 0 || dithering == 2 || dithering == 3 || dithering == 4) {
+      current_dithering = dithering;
+      SerialTx.print("OK:Dithering set to ");
+      if (dithering == 0) {
+        SerialTx.println("OFF");
+      } else {
+        SerialTx.print(dithering);
+        SerialTx.println("x oversampling");
+      }
+    } else {
+      SerialTx.println("ERROR:Invalid dithering value (0, 2, 3, or 4)");
+    }
+  } else {
+    SerialTx.println("ERROR:Cannot change while streaming");
+  }
+}
+
+static void cmdGetDithering(char*) {
+  SerialTx.print("DITHERING:");
+  SerialTx.print(current_dithering);
+  SerialTx.print(",");
+  if (current_dithering == 0) {
+    SerialTx.println("OFF");
+  } else {
+    SerialTx.print(current_dithering);
+    SerialTx.println("x oversampling");
+  }
+}
+
+static void cmdSetDecimation(char* params) {
+  if (!streaming) {
+    int ratio = atol(params);
+    bool valid = (ratio == 0);
+    for (uint8_t log2 = DECIMATION_MIN_LOG2; log2 <= DECIMATION_MAX_LOG2; log2++) {
+      valid = valid || (ratio == (1 << log2));
+    }
+    if (valid) {
+      decimation_ratio = (uint8_t)ratio;
+      resetDecimation();
+      if (ratio == 0) {
+        SerialTx.println("OK:Decimation OFF (dithering average)");
+      } else {
+        SerialTx.print("OK:Decimation set to ");
+        SerialTx.print(ratio);
+        SerialTx.println("x (CIC3 + FIR compensation)");
+      }
+    } else {
+      SerialTx.println("ERROR:Invalid decimation ratio (0, 4, 8, 16, 32 or 64)");
+    }
+  } else {
+    SerialTx.println("ERROR:Cannot change while streaming");
+  }
+}
+
+static void cmdGetDecimation(char*) {
+  SerialTx.print("DECIMATION:");
+  SerialTx.print(decimation_ratio);
+  if (decimation_ratio == 0) {
+    SerialTx.println(",OFF");
+    return;
+  }
+  // CIC delay is order x (R - 1) / 2 reads; the symmetric FIR adds (taps - 1) / 2 samples
+  uint32_t r = decimation_ratio;
+  uint64_t delay_half_reads = (uint64_t)CIC_ORDER * (r - 1) + (uint64_t)(COMP_FIR_TAPS - 1) * r;
+  SerialTx.print(",order=");
+  SerialTx.print(CIC_ORDER);
+  SerialTx.print(",taps=");
+  SerialTx.print(COMP_FIR_TAPS);
+  SerialTx.print(",group_delay_us=");
+  SerialTx.print((uint32_t)(delay_half_reads * advanced_timing.sample_interval_us / (2 * r)));
+  SerialTx.print(",warmup=");
+  SerialTx.println(decimator.warmup);
+}
+
+static void cmdGetFilter(char*) {
+  SerialTx.print("FILTER:");
+  SerialTx.print((int)current_adc_filter);
+  SerialTx.print(",");
+  switch(current_adc_filter) {
+    case ADS126X_SINC1: SerialTx.println("SINC1"); break;
+    case ADS126X_SINC2: SerialTx.println("SINC2"); break;
+    case ADS126X_SINC3: SerialTx.println("SINC3"); break;
+    case ADS126X_SINC4: SerialTx.println("SINC4"); break;
+    case ADS126X_FIR: SerialTx.println("FIR"); break;
+  }
+}
+
+static void cmdSetChannels(char* params) {
+  if (!streaming) {
+    int channels = atol(params);
+    if (channels >= 1 && channels <= MAX_ACQ_CHANNELS) {
+      num_channels = channels;
+      SerialTx.println("OK:Channels set");
+    } else {
+      SerialTx.println("ERROR:Invalid channel count");
+    }
+  } else {
+    SerialTx.println("ERROR:Cannot change while streaming");
+  }
+}
+
+static bool parseChannelPair(const char* text, ChannelPair& pair) {
+  // "<pos>-<neg>", inputs 0-9 = AIN0-AIN9 and 10 = AINCOM
+  char* end;
+  long pos = strtol(text, &end, 10);
+  if (end == text || *end != '-') {
+    return false;
+  }
+  const char* neg_text = end + 1;
+  long neg = strtol(neg_text, &end, 10);
+  if (end == neg_text || *end != '\0') {
+    return false;
+  }
+  if (pos < 0 || pos > ADS126X_INPUT_AINCOM || neg < 0 || neg > ADS126X_INPUT_AINCOM || pos == neg) {
+    return false;
+  }
+  pair.pos = (uint8_t)pos;
+  pair.neg = (uint8_t)neg;
+  return true;
+}
+
+static void cmdSetChannelMap(char* params) {
+  if (streaming) {
+    SerialTx.println("ERROR:Cannot change while streaming");
+    return;
+  }
+  // Parse into a copy: a bad entry leaves the active map untouched
+  ChannelPair table[MAX_ACQ_CHANNELS];
+  memcpy(table, channel_table, sizeof(table));
+  uint8_t count = 0;
+  char* field = params;
+  while (field != nullptr) {
+    char* next = splitParam(field, ',');
+    if (count >= MAX_ACQ_CHANNELS || !parseChannelPair(field, table[count])) {
+      SerialTx.println("ERROR:Use SET_CHANNEL_MAP:<pos>-<neg>[,<pos>-<neg>...] (1-5 pairs, inputs 0-10, 10 = AINCOM)");
+      return;
+    }
+    count++;
+    field = next;
+  }
+  memcpy(channel_table, table, sizeof(channel_table));
+  num_channels = count;
+  SerialTx.print("OK:Channel map set, ");
+  SerialTx.print(count);
+  SerialTx.println(" channels");
+}
+
+static void cmdGetChannelMap(char*) {
+  // All slots are listed; only the first `channels` are acquired
+  SerialTx.print("CHANNEL_MAP:channels=");
+  SerialTx.print(num_channels);
+  for (uint8_t ch = 0; ch < MAX_ACQ_CHANNELS; ch++) {
+    SerialTx.print(",ch");
+    SerialTx.print(ch + 1);
+    SerialTx.print("=");
+    SerialTx.print(channel_table[ch].pos);
+    SerialTx.print("-");
+    SerialTx.print(channel_table[ch].neg);
+  }
+  SerialTx.println();
+}
+
+static void cmdSetAcquisition(char* params) {
+  if (!streaming) {
+    if (strcmp(params, "POLLED") == 0) {
+      acquisition_mode = ACQ_POLLED;
+      SerialTx.println("OK:Acquisition set to POLLED");
+    } else if (strcmp(params, "DMA") == 0) {
+      acquisition_mode = ACQ_DRDY_DMA;
+      SerialTx.println("OK:Acquisition set to DMA");
+    } else if (strcmp(params, "SCAN") == 0) {
+      acquisition_mode = ACQ_SCAN;
+      SerialTx.println("OK:Acquisition set to SCAN");
+    } else {
+      SerialTx.println("ERROR:Invalid acquisition mode (POLLED, DMA or SCAN)");
+    }
+  } else {
+    SerialTx.println("ERROR:Cannot change while streaming");
+  }
+}
+
+static void cmdGetAcquisition(char*) {
+  SerialTx.print("ACQUISITION:");
+  SerialTx.print(getAcquisitionModeName());
+  SerialTx.print(",adc2=");
+  SerialTx.print(scan_adc2_enabled ? 1 : 0);
+  SerialTx.print(",conversions=");
+  SerialTx.print(adc_monitor.total_conversions);
+  SerialTx.print(",deadline_misses=");
+  SerialTx.print(adc_monitor.deadline_misses);
+  SerialTx.print(",checksum_errors=");
+  SerialTx.print(adc_monitor.checksum_errors);
+  SerialTx.print(",min_conversion_us=");
+  SerialTx.print(adc_monitor.min_conversion_time_us);
+  SerialTx.print(",max_conversion_us=");
+  SerialTx.print(adc_monitor.max_conversion_time_us);
+  SerialTx.print(",sample_acquisition_us=");
+  SerialTx.print(adc_monitor.sample_acquisition_us);
+  SerialTx.print(",reads_per_sec=");
+  if (adc_monitor.sample_acquisition_us > 0) {
+    uint32_t reads = num_channels * getReadsPerChannel();
+    SerialTx.print((uint32_t)((uint64_t)reads * 1000000ULL / adc_monitor.sample_acquisition_us));
+  } else {
+    SerialTx.print(0);
+  }
+  SerialTx.println();
+}
+
+static void cmdSelfTest(char* params) {
+  if (strcmp(params, "ABORT") == 0) {
+    if (selftest.phase == SELFTEST_IDLE) {
+      SerialTx.println("ERROR:SELFTEST not running");
+      return;
+    }
+    finishSelfTest(false);
+    SerialTx.println("OK:SELFTEST aborted, limits cleared");
+    return;
+  }
+  if (selftest.phase != SELFTEST_IDLE) {
+    SerialTx.println("ERROR:SELFTEST already running");
+    return;
+  }
+  if (streaming || advanced_timing.waiting_for_sync_start) {
+    SerialTx.println("ERROR:Cannot run while streaming");
+    return;
+  }
+  int seconds = (*params == '\0') ? SELFTEST_DEFAULT_STEP_MS / 1000 : atoi(params);
+  if (seconds < 1 || seconds > 10) {
+    SerialTx.println("ERROR:Use SELFTEST[:<seconds per step, 1-10>] or SELFTEST:ABORT");
+    return;
+  }
+  SerialTx.print("OK:SELFTEST started, up to ");
+  SerialTx.print(SELFTEST_CELLS * SELFTEST_RATE_COUNT);
+  SerialTx.print(" steps of ");
+  SerialTx.print(seconds);
+  SerialTx.println(" s");
+  SerialTx.println("SELFTEST_COLUMNS:channels,reads,format,rate_hz,samples,jitter_max_us,jitter_mean_us,drdy_max_us,drdy_mean_us,tx_peak,drops,result");
+  beginSelfTest((uint16_t)(seconds * 1000));
+}
+
+static void cmdGetSelfTest(char*) {
+  SerialTx.print("SELFTEST_LIMITS:valid=");
+  SerialTx.print(selftest.valid ? 1 : 0);
+  if (!selftest.valid) {
+    SerialTx.println(selftest.phase != SELFTEST_IDLE ? ",running=1" : ",running=0");
+    return;
+  }
+  SerialTx.print(",adc_rate=");
+  SerialTx.print(selftest.adc_rate);
+  SerialTx.print(",filter=");
+  SerialTx.print(selftest.adc_filter);
+  SerialTx.print(",acquisition=");
+  SerialTx.print(selftest.acquisition);
+  SerialTx.print(",scheduler=");
+  SerialTx.print(selftest.scheduler == SCHED_TIMER ? "TIMER" : "LOOP");
+  SerialTx.print(",transport=");
+  SerialTx.print(selftest.usb ? "USB" : "UART");
+  SerialTx.print(",step_ms=");
+  SerialTx.println(selftest.step_ms);
+  // One line per channels x reads: pass/fail rate per format, 0 = no such rate in the sweep
+  const char* const names[SELFTEST_FORMAT_COUNT] = {"FULL", "BINARY", "BATCH"};
+  uint8_t cell = 0;
+  for (uint8_t c = 0; c < SELFTEST_CHANNEL_COUNT; c++) {
+    for (uint8_t r = 0; r < SELFTEST_READS_COUNT; r++) {
+      SerialTx.print("SELFTEST_LIMIT:channels=");
+      SerialTx.print(SELFTEST_CHANNELS[c]);
+      SerialTx.print(",reads=");
+      SerialTx.print(SELFTEST_READS[r].reads);
+      for (uint8_t f = 0; f < SELFTEST_FORMAT_COUNT; f++, cell++) {
+        SerialTx.print(",");
+        SerialTx.print(names[f]);
+        SerialTx.print("=");
+        SerialTx.print(selftest.limits[cell].pass_hz);
+        SerialTx.print("/");
+        SerialTx.print(selftest.limits[cell].fail_hz);
+      }
+      SerialTx.println();
+    }
+  }
+}
+
+static void cmdSetScanAdc2(char* params) {
+  if (!streaming) {
+    if (strcmp(params, "ON") == 0) {
+      scan_adc2_enabled = true;
+      SerialTx.println("OK:SCAN ADC2 enabled (last channel on ADC2)");
+    } else if (strcmp(params, "OFF") == 0) {
+      scan_adc2_enabled = false;
+      SerialTx.println("OK:SCAN ADC2 disabled");
+    } else {
+      SerialTx.println("ERROR:Invalid ADC2 setting (ON or OFF)");
+    }
+  } else {
+    SerialTx.println("ERROR:Cannot change while streaming");
+  }
+}
+
+static void cmdSetScheduler(char* params) {
+  if (!streaming) {
+    if (strcmp(params, "LOOP") == 0) {
+      scheduler_mode = SCHED_LOOP;
+      SerialTx.println("OK:Scheduler set to LOOP");
+    } else if (strcmp(params, "TIMER") == 0) {
+      scheduler_mode = SCHED_TIMER;
+      SerialTx.println("OK:Scheduler set to TIMER");
+    } else {
+      SerialTx.println("ERROR:Invalid scheduler (LOOP or TIMER)");
+    }
+  } else {
+    SerialTx.println("ERROR:Cannot change while streaming");
+  }
+}
+
+static void cmdGetScheduler(char*) {
+  SerialTx.print("SCHEDULER:");
+  SerialTx.print(scheduler_mode == SCHED_TIMER ? "TIMER" : "LOOP");
+  SerialTx.print(",running=");
+  SerialTx.print(sample_timer.running ? 1 : 0);
+  SerialTx.print(",prescaler=");
+  SerialTx.print(sample_timer.prescaler_div);
+  SerialTx.print(",period_counts=");
+  SerialTx.print((double)sample_timer.period_q32 / 4294967296.0, 4);
+  SerialTx.print(",ticks=");
+  SerialTx.print(sample_timer.ticks);
+  SerialTx.print(",overruns=");
+  SerialTx.print(sample_timer.overruns);
+  SerialTx.println();
+}
+
+static void cmdSetPreciseInterval(char* params) {
+  unsigned long interval_us = atol(params);
+  if (interval_us >= 9900 && interval_us <= 10100) {
+    float new_rate = 1000000.0 / interval_us;
+    
+    // Check if rate change is allowed (bounded host nudges)
+    if (isRateChangeAllowed(new_rate)) {
+      advanced_timing.sample_interval_us = interval_us;
+      stream_rate = new_rate;
+      
+      SerialTx.print("OK:Precise interval set to ");
+      SerialTx.print(interval_us);
+      SerialTx.print("μs (");
+      SerialTx.print(new_rate, 3);
+      SerialTx.println("Hz)");
+    }
+  } else {
+    SerialTx.println("ERROR:Invalid interval (9900-10100 μs)");
+  }
+}
+
+static void cmdStartStream(char* params) {
+  if (!streaming) {
+    float rate = (float)atof(params);
+    high_rate.enabled = false;
+    if (rate > 1000) {
+      // High-rate mode is validated, including its throughput limit, before the stream is accepted
+      if (!prepareHighRateStream(rate)) {
+        return;
+      }
+      stream_rate = rate;
+      advanced_timing.sample_interval_us = (uint64_t)(1000000.0 / rate);
+    } else if (rate > 0) {
+      if (!checkSelfTestLimits(rate)) {
+        return;
+      }
+      // Check if rate change is allowed (bounded host nudges)
+      if (isRateChangeAllowed(rate)) {
+        stream_rate = rate;
+        advanced_timing.sample_interval_us = (uint64_t)(1000000.0 / rate);
+      } else {
+        return;  // Rate change rejected
+      }
+    } else if (!checkSelfTestLimits(stream_rate)) {
+      return;
+    }
+    
+    sequence = 0;
+    establishSamplingTiming();
+    streaming = true;
+    sendSessionHeader();
+    
+    SerialTx.print("OK:Streaming started at ");
+    SerialTx.print(stream_rate);
+    SerialTx.print("Hz with ");
+    SerialTx.print(getTimingSourceName(advanced_timing.current_source));
+    SerialTx.println(" timing");
+  } else {
+    SerialTx.println("ERROR:Already streaming");
+  }
+}
+
+static void cmdStartStreamPps(char* params) {
+  if (!streaming) {
+    char* wait_param = splitParam(params, ',');
+    if (wait_param != nullptr) {
+      float rate = (float)atof(params);
+      int pps_wait = atoi(wait_param);
+      if (rate > 0 && rate <= 1000 && pps_wait >= 1 && pps_wait <= 5) {
+        if (!checkSelfTestLimits(rate)) {
+          return;
+        }
+        stream_rate = rate;
+        advanced_timing.sample_interval_us = (uint64_t)(1000000.0 / rate);
+        advanced_timing.sync_on_pps = true;
+        advanced_timing.pps_countdown = (uint8_t)pps_wait;
+        advanced_timing.epoch_start_pending = false;
+        advanced_timing.waiting_for_sync_start = true;
+        SerialTx.print("OK:Waiting for ");
+        SerialTx.print(pps_wait);
+        SerialTx.println(" PPS edges to start");
+      } else {
+        SerialTx.println("ERROR:Invalid rate or PPS wait count (1-5)");
+      }
+    } else {
+      SerialTx.println("ERROR:Invalid PPS start parameters");
+    }
+  } else {
+    SerialTx.println("ERROR:Already streaming");
+  }
+}
+
+static void cmdSetPpsEpoch(char* params) {
+  // Labels the next PPS edge with a second every node agrees on (e.g. Unix/GPS seconds); processPPS
+  // carries the label forward one second per edge. Sent mid-second so the next edge is unambiguous.
+  if (params[0] < '0' || params[0] > '9') {
+    SerialTx.println("ERROR:Invalid PPS epoch (seconds)");
+    return;
+  }
+  uint32_t since_pps_ms = millis() - advanced_timing.last_pps_time;
+  if (!advanced_timing.pps_valid || advanced_timing.current_source != AdvancedTiming::TIMING_PPS_ACTIVE) {
+    SerialTx.println("ERROR:PPS epoch needs active PPS");
+    return;
+  }
+  if (since_pps_ms < 100 || since_pps_ms > 900) {
+    SerialTx.println("ERROR:PPS epoch too close to an edge - send it mid-second");
+    return;
+  }
+  advanced_timing.pps_epoch_next = strtoul(params, nullptr, 10);
+  advanced_timing.pps_epoch_label_pending = true;
+  SerialTx.print("OK:Next PPS edge is epoch ");
+  SerialTx.println(advanced_timing.pps_epoch_next);
+}
+
+static void cmdStartStreamEpoch(char* params) {
+  // Every node given the same <second>,<rate> starts on the same labelled edge, so sample n of any
+  // node is taken at <second> + n / rate and records merge by index
+  if (streaming) {
+    SerialTx.println("ERROR:Already streaming");
+    return;
+  }
+  char* rate_param = splitParam(params, ',');
+  if (rate_param == nullptr || params[0] < '0' || params[0] > '9') {
+    SerialTx.println("ERROR:Invalid epoch start parameters");
+    return;
+  }
+  uint32_t start_second = strtoul(params, nullptr, 10);
+  int rate = atoi(rate_param);
+  if (rate < 1 || rate > 1000) {
+    SerialTx.println("ERROR:Epoch start needs an integer rate (1-1000 Hz)");
+    return;
+  }
+  if (!advanced_timing.pps_epoch_valid) {
+    SerialTx.println("ERROR:PPS epoch not labelled (SET_PPS_EPOCH)");
+    return;
+  }
+  int32_t lead_s = (int32_t)(start_second - advanced_timing.pps_epoch);
+  if (lead_s < 1 || lead_s > 600) {
+    SerialTx.print("ERROR:Epoch start must be 1-600s ahead (current epoch ");
+    SerialTx.print(advanced_timing.pps_epoch);
+    SerialTx.println(")");
+    return;
+  }
+  if (!checkSelfTestLimits((float)rate)) {
+    return;
+  }
+  high_rate.enabled = false;
+  stream_rate = (float)rate;
+  advanced_timing.sample_interval_us = (uint64_t)(1000000.0 / rate);
+  advanced_timing.sync_on_pps = true;
+  advanced_timing.pps_countdown = 0;
+  advanced_timing.epoch_start_second = start_second;
+  advanced_timing.epoch_start_pending = true;
+  advanced_timing.waiting_for_sync_start = true;
+  SerialTx.print("OK:Waiting for PPS epoch ");
+  SerialTx.print(start_second);
+  SerialTx.print(" (");
+  SerialTx.print(lead_s);
+  SerialTx.println("s) to start");
+}
+
+static void cmdStopStream(char*) {
+  stopStreaming();
+  LOG_DEBUG("Generated ", advanced_timing.samples_generated, " samples");
+  SerialTx.println("OK:Streaming stopped");
+}
+
+void stopStreaming() {
+  streaming = false;
+  stopSampleTimer();
+  stopDrdyAcquisition();
+  adc_monitor.sample_acquisition_us = 0;  // Re-measure for the next configuration
+  resetDecimation();  // Next stream starts from empty filter state
+  high_rate.enabled = false;
+  flushSampleBatch();
+  advanced_timing.timing_established = false;
+  // Clear any pending sync states
+  advanced_timing.sync_on_pps = false;
+  advanced_timing.pps_countdown = 0;
+  advanced_timing.waiting_for_sync_start = false;
+  advanced_timing.epoch_start_pending = false;
+  advanced_timing.epoch_started = false;
+  // Reset session header flag for next stream
+  session_tracker.session_header_sent = false;
+}
+
+static void cmdGetStatus(char*) {
+  SerialTx.print("STATUS:streaming=");
+  SerialTx.print(streaming ? 1 : 0);
+  SerialTx.print(",samples_generated=");
+  SerialTx.print(advanced_timing.samples_generated);
+  SerialTx.print(",stream_rate=");
+  SerialTx.print(stream_rate);
+  SerialTx.print(",channels=");
+  SerialTx.print(num_channels);
+  SerialTx.print(",filter=");
+  SerialTx.print((int)current_adc_filter);
+  SerialTx.print(",sequence=");
+  SerialTx.print(sequence);
+  SerialTx.print(",timing_source=");
+  SerialTx.print((int)advanced_timing.current_source);
+  SerialTx.print(",timing_accuracy_us=");
+  SerialTx.print(advanced_timing.timing_accuracy_us, 1);
+  SerialTx.print(",pps_valid=");
+  SerialTx.print(advanced_timing.pps_valid ? 1 : 0);
+  SerialTx.print(",pps_count=");
+  SerialTx.print(advanced_timing.pps_count);
+  SerialTx.print(",wraparounds=");
+  SerialTx.print(advanced_timing.micros_wraparound_count);
+  SerialTx.print(",seq_wraparounds=");
+  SerialTx.print((unsigned long)(advanced_timing.samples_generated >> 16));  // Calculate: samples/65536
+  SerialTx.print(",ref_updates=");
+  SerialTx.print(advanced_timing.reference_updates_count);
+  SerialTx.print(",buffer_overflows=");
+  SerialTx.print(serial_monitor.buffer_overflows);
+  SerialTx.print(",samples_skipped=");
+  SerialTx.print(serial_monitor.samples_skipped_due_to_overflow);
+  SerialTx.print(",buffer_available=");
+  SerialTx.print(SerialTx.availableForWrite());
+  SerialTx.print(",tx_ring_used=");
+  SerialTx.print(SerialTx.used());
+  SerialTx.print(",tx_ring_hwm=");
+  SerialTx.print(SerialTx.highWaterMark());
+  SerialTx.print(",tx_ring_size=");
+  SerialTx.print(TX_RING_SIZE);
+  SerialTx.print(",seq_gaps=");
+  SerialTx.print(seq_validator.sequence_gaps_detected);
+  SerialTx.print(",seq_resets=");
+  SerialTx.print(seq_validator.sequence_resets_detected);
+  SerialTx.print(",calibration_ppm=");
+  SerialTx.print(advanced_timing.oscillator_calibration_ppm, 2);
+  SerialTx.print(",calibration_source=");
+  SerialTx.print(advanced_timing.calibration_source == AdvancedTiming::CAL_NONE ? "NONE" :
+               advanced_timing.calibration_source == AdvancedTiming::CAL_PPS_LIVE ? "PPS_LIVE" :
+               advanced_timing.calibration_source == AdvancedTiming::CAL_PI_PUSHED ? "PI_PUSHED" :
+               advanced_timing.calibration_source == AdvancedTiming::CAL_FLASH ? "FLASH" : "UNKNOWN");
+  SerialTx.print(",calibration_valid=");
+  SerialTx.print(advanced_timing.calibration_valid ? 1 : 0);
+  SerialTx.print(",last_pps_micros=");
+  SerialTx.print((unsigned long)advanced_timing.last_pps_micros);  // Low word, as before the 64-bit timebase
+  SerialTx.print(",acq_mode=");
+  SerialTx.print(getAcquisitionModeName());
+  SerialTx.print(",adc_checksum_errors=");
+  SerialTx.print(adc_monitor.checksum_errors);
+  SerialTx.print(",scheduler=");
+  SerialTx.print(scheduler_mode == SCHED_TIMER ? "TIMER" : "LOOP");
+  SerialTx.print(",timer_ticks=");
+  SerialTx.print(sample_timer.ticks);
+  SerialTx.print(",timer_overruns=");
+  SerialTx.print(sample_timer.overruns);
+  SerialTx.print(",high_rate=");
+  SerialTx.print(high_rate.enabled ? 1 : 0);
+  SerialTx.print(",high_rate_overruns=");
+  SerialTx.print(high_rate.overruns);
+  SerialTx.print(",events_sent=");
+  SerialTx.print(events_sent);
+  SerialTx.print(",transport=");
+  SerialTx.print(transport_usb ? "USB" : "UART");
+  SerialTx.print(",stat_interval_ms=");
+  SerialTx.print(advanced_timing.stat_interval_ms);
+  SerialTx.print(",stat_frames=");
+  SerialTx.print(stat_beacon.frames_sent);
+  SerialTx.print(",reliable=");
+  SerialTx.print(reliable.enabled ? 1 : 0);
+  SerialTx.print(",frames_resent=");
+  SerialTx.print(reliable.frames_resent);
+  SerialTx.print(",frames_evicted=");
+  SerialTx.print(reliable.frames_evicted);
+  SerialTx.print(",idle_sleeps=");
+  SerialTx.print(idle_sleep.sleeps);
+  SerialTx.print(",idle_timer_wakes=");
+  SerialTx.print(idle_sleep.timer_wakes);
+  SerialTx.print(",idle_pct=");
+  SerialTx.print(100.0f * (float)idle_sleep.slept_us / (float)(getVirtualMicros() + 1), 1);
+  SerialTx.println();
+}
+
+static void cmdGetTimingStatus(char*) {
+  SerialTx.print("TIMING:source=");
+  SerialTx.print(getTimingSourceName(advanced_timing.current_source));
+  SerialTx.print(",accuracy_us=");
+  SerialTx.print(advanced_timing.timing_accuracy_us, 1);
+  SerialTx.print(",pps_valid=");
+  SerialTx.print(advanced_timing.pps_valid ? 1 : 0);
+  SerialTx.print(",pps_count=");
+  SerialTx.print(advanced_timing.pps_count);
+  SerialTx.print(",pps_epoch=");
+  SerialTx.print(advanced_timing.pps_epoch);
+  SerialTx.print(",pps_epoch_valid=");
+  SerialTx.print(advanced_timing.pps_epoch_valid ? 1 : 0);
+  SerialTx.print(",calibration_ppm=");
+  SerialTx.print(advanced_timing.oscillator_calibration_ppm, 3);
+  SerialTx.print(",calibration_valid=");
+  SerialTx.print(advanced_timing.calibration_valid ? 1 : 0);
+  SerialTx.print(",wraparounds=");
+  SerialTx.print(advanced_timing.micros_wraparound_count);
+  SerialTx.print(",seq_wraparounds=");
+  SerialTx.print((unsigned long)(advanced_timing.samples_generated >> 16));  // Calculate: samples/65536
+  SerialTx.print(",ref_updates=");
+  SerialTx.print(advanced_timing.reference_updates_count);
+  SerialTx.print(",sample_index=");
+  SerialTx.print((unsigned long)advanced_timing.sample_index);
+  SerialTx.print(",pps_phase_lock=");
+  SerialTx.print(advanced_timing.pps_phase_lock_enabled ? 1 : 0);
+  SerialTx.print(",pps_capture=");
+  SerialTx.print(advanced_timing.pps_capture_hw ? "TCC" : "ISR");
+  SerialTx.print(",pps_interval_counts=");
+  SerialTx.print((unsigned long)advanced_timing.last_pps_interval_counts);
+  SerialTx.print(",pps_capture_latency=");
+  SerialTx.print(advanced_timing.pps_capture_latency);
+  SerialTx.print(",pps_filter=");
+  SerialTx.print(getPpsFilterStateName(pps_filter.state));
+  SerialTx.print(",phase_sigma_us=");
+  SerialTx.print(sqrtf(pps_filter.p00), 3);
+  SerialTx.print(",freq_sigma_ppm=");
+  SerialTx.print(sqrtf(pps_filter.p11), 4);
+  SerialTx.print(",innovation_us=");
+  SerialTx.print(pps_filter.innovation_us, 2);
+  SerialTx.print(",pps_outliers=");
+  SerialTx.print(pps_filter.outliers);
+  SerialTx.println();
+}
+
+static void cmdSetOutputFormat(char* params) {
+  if (strcmp(params, "COMPACT") == 0) {
+    flushSampleBatch();
+    output_format = OUTPUT_COMPACT;
+    SerialTx.println("OK:Output format set to COMPACT");
+  } else if (strcmp(params, "FULL") == 0) {
+    flushSampleBatch();
+    output_format = OUTPUT_FULL;
+    SerialTx.println("OK:Output format set to FULL");
+  } else if (strcmp(params, "BINARY") == 0) {
+    flushSampleBatch();
+    output_format = OUTPUT_BINARY;
+    SerialTx.println("OK:Output format set to BINARY");
+  } else if (strcmp(params, "BATCH") == 0) {
+    output_format = OUTPUT_BATCH;
+    SerialTx.print("OK:Output format set to BATCH (");
+    SerialTx.print(sample_batch.size);
+    SerialTx.println(" samples per frame)");
+  } else if (strcmp(params, "COMPRESSED") == 0) {
+    output_format = OUTPUT_COMPRESSED;
+    SerialTx.print("OK:Output format set to COMPRESSED (");
+    SerialTx.print(sample_batch.size);
+    SerialTx.println(" samples per frame)");
+  } else {
+    SerialTx.println("ERROR:Invalid format (COMPACT, FULL, BINARY, BATCH or COMPRESSED)");
+  }
+  if (output_format != OUTPUT_BATCH && output_format != OUTPUT_COMPRESSED) {
+    epoch_stamps.active = false;  // Slots only fit batch frames; later samples carry us again
+  }
+}
+
+static void cmdSetBatchSize(char* params) {
+  int batch_size = atol(params);
+  if (batch_size >= 1 && batch_size <= MAX_BATCH_SAMPLES) {
+    flushSampleBatch();
+    sample_batch.size = (uint8_t)batch_size;
+    SerialTx.print("OK:Batch size set to ");
+    SerialTx.println(batch_size);
+  } else {
+    SerialTx.println("ERROR:Invalid batch size (1-50)");
+  }
+}
+
+static void cmdGetOutputFormat(char*) {
+  SerialTx.print("OUTPUT_FORMAT:");
+  SerialTx.print(output_format == OUTPUT_COMPRESSED ? "COMPRESSED" :
+                output_format == OUTPUT_BATCH ? "BATCH" :
+                output_format == OUTPUT_BINARY ? "BINARY" :
+                output_format == OUTPUT_COMPACT ? "COMPACT" : "FULL");
+  SerialTx.print(",bytes_per_sample=");
+  SerialTx.print(getBytesPerSample());
+  SerialTx.print(",batch_size=");
+  SerialTx.print(sample_batch.size);
+  SerialTx.print(",compressed_pct=");
+  SerialTx.print(sample_batch.raw_bytes > 0 ?
+                 (uint32_t)((uint64_t)sample_batch.packed_bytes * 100 / sample_batch.raw_bytes) : 100);
+  SerialTx.println();
+}
+
+static void cmdBinaryMode(char* params) {
+  // Alias used by HostTimingSeismicAcquisition.enable_binary_mode()
+  if (strcmp(params, "ON") == 0) {
+    flushSampleBatch();
+    output_format = OUTPUT_BINARY;
+    SerialTx.println("OK:Binary mode enabled");
+  } else if (strcmp(params, "OFF") == 0) {
+    flushSampleBatch();
+    output_format = OUTPUT_FULL;
+    SerialTx.println("OK:Binary mode disabled");
+  } else {
+    SerialTx.println("ERROR:Invalid parameter (ON or OFF)");
+  }
+}
+
+static void cmdSetSequenceValidation(char* params) {
+  if (strcmp(params, "ON") == 0) {
+    seq_validator.validation_enabled = true;
+    SerialTx.println("OK:Sequence validation enabled");
+  } else if (strcmp(params, "OFF") == 0) {
+    seq_validator.validation_enabled = false;
+    SerialTx.println("OK:Sequence validation disabled");
+  } else {
+    SerialTx.println("ERROR:Invalid parameter (ON or OFF)");
+  }
+}
+
+static void cmdSetStatInterval(char* params) {
+  long interval_ms = atol(params);
+  if (interval_ms == 0 || (interval_ms >= 100 && interval_ms <= 60000)) {
+    advanced_timing.stat_interval_ms = (uint32_t)interval_ms;
+    stat_beacon.records_since_keyframe = 0;
+    SerialTx.print("OK:Stat interval set to ");
+    SerialTx.print(interval_ms);
+    SerialTx.println(interval_ms == 0 ? " ms (beacon off)" : " ms");
+  } else {
+    SerialTx.println("ERROR:Invalid stat interval (0 or 100-60000 ms)");
+  }
+}
+
+static void cmdSetTimestampMode(char* params) {
+  if (streaming) {
+    SerialTx.println("ERROR:Stop streaming before changing the timestamp mode");
+    return;
+  }
+  if (strcmp(params, "MICROS") == 0) {
+    timestamp_mode = TIMESTAMP_MICROS;
+    SerialTx.println("OK:Timestamp mode set to MICROS");
+  } else if (strcmp(params, "EPOCH") == 0) {
+    timestamp_mode = TIMESTAMP_EPOCH;
+    SerialTx.println("OK:Timestamp mode set to EPOCH (grid slots + correction records)");
+  } else {
+    SerialTx.println("ERROR:Invalid timestamp mode (MICROS or EPOCH)");
+  }
+}
+
+static void cmdGetTimestampMode(char*) {
+  SerialTx.print("TIMESTAMP_MODE:");
+  SerialTx.print(timestamp_mode == TIMESTAMP_EPOCH ? "EPOCH" : "MICROS");
+  SerialTx.print(",active=");
+  SerialTx.print(epoch_stamps.active ? 1 : 0);
+  SerialTx.print(",epoch0=");
+  SerialTx.print(epoch_stamps.epoch0);
+  SerialTx.print(",slot=");
+  SerialTx.print((unsigned long)advanced_timing.grid_slot);
+  SerialTx.print(",corrections_sent=");
+  SerialTx.print(epoch_stamps.corrections_sent);
+  SerialTx.println();
+}
+
+static bool parseSampleIndex(const char* text, uint32_t& value) {
+  // Full uint32 range (atol saturates past 2^31); rejects empty or trailing text
+  char* end;
+  value = strtoul(text, &end, 10);
+  return end != text && *end == '\0';
+}
+
+// ACK/NACK are sent by the host's receive path several times a second: silent unless malformed
+static void cmdAck(char* params) {
+  uint32_t index;
+  if (!parseSampleIndex(params, index)) {
+    SerialTx.println("ERROR:Invalid ACK (ACK:<next sample index>)");
+    return;
+  }
+  releaseFrames(index);
+}
+
+static void cmdNack(char* params) {
+  char* count_param = splitParam(params, ',');
+  uint32_t index;
+  uint32_t count = 1;
+  if (!parseSampleIndex(params, index) ||
+      (count_param != nullptr && (!parseSampleIndex(count_param, count) || count == 0))) {
+    SerialTx.println("ERROR:Invalid NACK (NACK:<sample index>[,<count>])");
+    return;
+  }
+  reliable.nacks_received++;
+  requestResend(index, count);
+}
+
+static void cmdSetReliable(char* params) {
+  if (strcmp(params, "ON") == 0) {
+    if (!reliable.enabled) {
+      resetReliableWindow();  // Frames sent before now were never retained
+    }
+    reliable.enabled = true;
+    SerialTx.print("OK:Reliable delivery on (");
+    SerialTx.print(RELIABLE_WINDOW_BYTES);
+    SerialTx.println(output_format == OUTPUT_FULL || output_format == OUTPUT_COMPACT ?
+                     " byte window; applies to binary formats only)" : " byte window)");
+  } else if (strcmp(params, "OFF") == 0) {
+    reliable.enabled = false;
+    resetReliableWindow();
+    SerialTx.println("OK:Reliable delivery off");
+  } else {
+    SerialTx.println("ERROR:Invalid reliable mode (ON or OFF)");
+  }
+}
+
+static void cmdGetReliable(char*) {
+  SerialTx.print("RELIABLE:enabled=");
+  SerialTx.print(reliable.enabled ? 1 : 0);
+  SerialTx.print(",window_bytes=");
+  SerialTx.print(RELIABLE_WINDOW_BYTES);
+  SerialTx.print(",frames_held=");
+  SerialTx.print(reliable.stored);
+  SerialTx.print(",acked_index=");
+  SerialTx.print(reliable.acked_index);
+  SerialTx.print(",stored=");
+  SerialTx.print(reliable.frames_stored);
+  SerialTx.print(",resent=");
+  SerialTx.print(reliable.frames_resent);
+  SerialTx.print(",deferred=");
+  SerialTx.print(reliable.frames_deferred);
+  SerialTx.print(",evicted=");
+  SerialTx.print(reliable.frames_evicted);
+  SerialTx.print(",nacks=");
+  SerialTx.print(reliable.nacks_received);
+  SerialTx.println();
+}
+
+static void cmdSetTrigger(char* params) {
+  // SET_TRIGGER:<sta_s>,<lta_s>,<on_ratio>,<off_ratio>[,<channel>] or SET_TRIGGER:OFF
+  if (streaming) {
+    SerialTx.println("ERROR:Stop streaming before changing the event trigger");
+    return;
+  }
+  if (strcmp(params, "OFF") == 0) {
+    event_trigger.configured = false;
+    SerialTx.println("OK:Event trigger off");
+    return;
+  }
+  char* lta_param = splitParam(params, ',');
+  char* on_param = lta_param ? splitParam(lta_param, ',') : nullptr;
+  char* off_param = on_param ? splitParam(on_param, ',') : nullptr;
+  char* channel_param = off_param ? splitParam(off_param, ',') : nullptr;
+  if (off_param == nullptr) {
+    SerialTx.println("ERROR:Use SET_TRIGGER:<sta_s>,<lta_s>,<on_ratio>,<off_ratio>[,<channel>] or OFF");
+    return;
+  }
+  float sta_s = (float)atof(params);
+  float lta_s = (float)atof(lta_param);
+  float on_ratio = (float)atof(on_param);
+  float off_ratio = (float)atof(off_param);
+  int channel = channel_param ? atoi(channel_param) : 1;
+  if (sta_s <= 0.0f || lta_s <= sta_s || lta_s > 600.0f) {
+    SerialTx.println("ERROR:Invalid STA/LTA windows (0 < sta_s < lta_s <= 600)");
+    return;
+  }
+  if (off_ratio < 1.0f || on_ratio <= off_ratio || on_ratio > 100.0f) {
+    SerialTx.println("ERROR:Invalid trigger ratios (1 <= off_ratio < on_ratio <= 100)");
+    return;
+  }
+  if (channel < 1 || channel > MAX_ACQ_CHANNELS) {
+    SerialTx.println("ERROR:Invalid trigger channel (1-5)");
+    return;
+  }
+  event_trigger.sta_s = sta_s;
+  event_trigger.lta_s = lta_s;
+  event_trigger.on_ratio = on_ratio;
+  event_trigger.off_ratio = off_ratio;
+  event_trigger.channel = (uint8_t)(channel - 1);
+  event_trigger.configured = true;
+  SerialTx.print("OK:Event trigger STA ");
+  SerialTx.print(sta_s, 2);
+  SerialTx.print(" s / LTA ");
+  SerialTx.print(lta_s, 1);
+  SerialTx.print(" s, on ");
+  SerialTx.print(on_ratio, 2);
+  SerialTx.print(", off ");
+  SerialTx.print(off_ratio, 2);
+  SerialTx.print(", channel ");
+  SerialTx.println(channel);
+}
+
+static void cmdSetTriggerWindow(char* params) {
+  // SET_TRIGGER_WINDOW:<pre_samples>,<post_samples>,<decimation>
+  if (streaming) {
+    SerialTx.println("ERROR:Stop streaming before changing the event trigger");
+    return;
+  }
+  char* post_param = splitParam(params, ',');
+  char* decimation_param = post_param ? splitParam(post_param, ',') : nullptr;
+  if (decimation_param == nullptr) {
+    SerialTx.println("ERROR:Use SET_TRIGGER_WINDOW:<pre_samples>,<post_samples>,<decimation>");
+    return;
+  }
+  long pre = atol(params);
+  long post = atol(post_param);
+  long decimation = atol(decimation_param);
+  if (pre < 0 || pre > TRIGGER_PRE_RING_SIZE || post < 0 || post > 65535 || decimation < 1 || decimation > 1000) {
+    SerialTx.print("ERROR:Invalid trigger window (pre 0-");
+    SerialTx.print(TRIGGER_PRE_RING_SIZE);
+    SerialTx.println(", post 0-65535, decimation 1-1000)");
+    return;
+  }
+  event_trigger.pre_samples = (uint16_t)pre;
+  event_trigger.post_samples = (uint16_t)post;
+  event_trigger.decimation = (uint16_t)decimation;
+  SerialTx.print("OK:Trigger window ");
+  SerialTx.print(pre);
+  SerialTx.print(" pre / ");
+  SerialTx.print(post);
+  SerialTx.print(" post samples, continuous stream decimated by ");
+  SerialTx.println(decimation);
+}
+
+static void cmdGetTrigger(char*) {
+  const EventTrigger& t = event_trigger;
+  int64_t lta_q24 = t.lta_q24 > (1LL << 24) ? t.lta_q24 : (1LL << 24);
+  SerialTx.print("TRIGGER:configured=");
+  SerialTx.print(t.configured ? 1 : 0);
+  SerialTx.print(",active=");
+  SerialTx.print(t.active ? 1 : 0);
+  SerialTx.print(",state=");
+  SerialTx.print(t.state == TRIGGER_EVENT ? "EVENT" : t.state == TRIGGER_POST ? "POST" : "IDLE");
+  SerialTx.print(",sta_s=");
+  SerialTx.print(t.sta_s, 2);
+  SerialTx.print(",lta_s=");
+  SerialTx.print(t.lta_s, 1);
+  SerialTx.print(",on=");
+  SerialTx.print(t.on_ratio, 2);
+  SerialTx.print(",off=");
+  SerialTx.print(t.off_ratio, 2);
+  SerialTx.print(",channel=");
+  SerialTx.print(t.channel + 1);
+  SerialTx.print(",pre=");
+  SerialTx.print(t.pre_samples);
+  SerialTx.print(",post=");
+  SerialTx.print(t.post_samples);
+  SerialTx.print(",decimation=");
+  SerialTx.print(t.decimation);
+  SerialTx.print(",ratio=");
+  SerialTx.print((float)t.sta_q24 / (float)lta_q24, 2);
+  SerialTx.print(",warmup=");
+  SerialTx.print(t.warmup);
+  SerialTx.print(",events=");
+  SerialTx.print(t.events);
+  SerialTx.println();
+}
+
+static void cmdGetSequenceValidation(char*) {
+  SerialTx.print("SEQUENCE_VALIDATION:");
+  SerialTx.print(seq_validator.validation_enabled ? "ON" : "OFF");
+  SerialTx.print(",gaps_detected=");
+  SerialTx.print(seq_validator.sequence_gaps_detected);
+  SerialTx.print(",resets_detected=");
+  SerialTx.print(seq_validator.sequence_resets_detected);
+  SerialTx.print(",expected_seq=");
+  SerialTx.print(seq_validator.expected_sequence);
+  SerialTx.println();
+}
+
+static void cmdReset(char*) {
+  streaming = false;
+  stopSampleTimer();
+  stopDrdyAcquisition();
+  adc_monitor.sample_acquisition_us = 0;  // Re-measure for the next configuration
+  resetDecimation();  // Next stream starts from empty filter state
+  high_rate.enabled = false;
+  sample_batch.count = 0;  // Discard partial frame
+  SerialTx.resetHighWaterMark();
+  advanced_timing.timing_established = false;
+  sequence = 0;
+  // Reset session header flag for next stream
+  session_tracker.session_header_sent = false;
+  SerialTx.println("OK:Device reset");
+}
+
+static void cmdSetCalPpm(char* params) {
+  float ppm_value = (float)atof(params);
+  
+  // Guardrail: ignore if PPS_ACTIVE and difference > 50 ppm
+  if (advanced_timing.current_source == AdvancedTiming::TIMING_PPS_ACTIVE) {
+    float current_ppm = advanced_timing.oscillator_calibration_ppm;
+    float ppm_diff = abs(ppm_value - current_ppm);
+    if (ppm_diff > 50.0) {
+      SerialTx.print("ERROR:Rate change too large while PPS locked (");
+      SerialTx.print(ppm_diff, 1);
+      SerialTx.println(" ppm > 50 ppm limit)");
+      return;
+    }
+  }
+  
+  advanced_timing.oscillator_calibration_ppm = ppm_value;
+  advanced_timing.calibration_valid = true;
+  advanced_timing.calibration_source = AdvancedTiming::CAL_PI_PUSHED;
+  advanced_timing.cal_applied_at_ms = millis();
+  
+  // Apply hard limits and sanity checks
+  clampOscillatorCalibration();
+  
+  SerialTx.print("OK:Pi calibration set to ");
+  SerialTx.print(advanced_timing.oscillator_calibration_ppm, 2);
+  SerialTx.println(" ppm");
+}
+
+static void cmdClearCal(char* params) {
+  // CLEAR_CAL:FLASH also erases the saved records, so the next boot starts uncalibrated
+  bool erase_flash = strcmp(params, "FLASH") == 0;
+  if (erase_flash && streaming) {
+    SerialTx.println("ERROR:Stop streaming before erasing the flash calibration");
+    return;
+  }
+  if (erase_flash) {
+    eraseCalibrationFlash();
+  }
+  advanced_timing.calibration_valid = false;
+  advanced_timing.calibration_source = AdvancedTiming::CAL_NONE;
+  advanced_timing.oscillator_calibration_ppm = 0.0;
+  advanced_timing.cal_applied_at_ms = 0;
+  resetPpsFilter();  // Reacquire from the next edge without the old rate
+  resetTempCompTable();
+  SerialTx.println(erase_flash ? "OK:Calibration cleared (flash records erased)" : "OK:Calibration cleared");
+}
+
+static void cmdSaveCal(char*) {
+  // Write the live calibration on the next safe window, skipping the rate limits once
+  if (!advanced_timing.calibration_valid) {
+    SerialTx.println("ERROR:No valid calibration to save");
+    return;
+  }
+  cal_store.save_requested = true;
+  SerialTx.print("OK:Calibration save queued (");
+  SerialTx.print(advanced_timing.oscillator_calibration_ppm, 3);
+  SerialTx.println(" ppm)");
+}
+
+static void cmdGetCalFlash(char*) {
+  SerialTx.print("CAL_FLASH:valid=");
+  SerialTx.print(cal_store.newest_page >= 0 ? 1 : 0);
+  if (cal_store.newest_page >= 0) {
+    SerialTx.print(",ppm=");
+    SerialTx.print(cal_store.newest.ppm, 3);
+    SerialTx.print(",temp_coeff=");
+    SerialTx.print(cal_store.newest.temp_coefficient_ppm_per_c, 4);
+    SerialTx.print(",ref_temp=");
+    SerialTx.print(cal_store.newest.reference_temp_c, 1);
+    SerialTx.print(",temp_comp=");
+    SerialTx.print((cal_store.newest.flags & CAL_FLASH_FLAG_TEMP_COMP) ? 1 : 0);
+    SerialTx.print(",confidence_pps=");
+    SerialTx.print(cal_store.newest.confidence_pps);
+    SerialTx.print(",source=");
+    SerialTx.print(getCalibrationSourceName(cal_store.newest.source));
+    SerialTx.print(",sequence=");
+    SerialTx.print(cal_store.newest.sequence);
+    SerialTx.print(",page=");
+    SerialTx.print(cal_store.newest_page);
+  }
+  SerialTx.print(",restored=");
+  SerialTx.print(cal_store.restored ? 1 : 0);
+  SerialTx.print(",pending=");
+  SerialTx.print(cal_store.write_pending || cal_store.save_requested ? 1 : 0);
+  SerialTx.print(",pages=");
+  SerialTx.print(CAL_FLASH_PAGES);
+  SerialTx.print(",saves=");
+  SerialTx.print(cal_store.saves);
+  SerialTx.print(",erases=");
+  SerialTx.print(cal_store.erases);
+  SerialTx.print(",verify_failures=");
+  SerialTx.print(cal_store.verify_failures);
+  SerialTx.println();
+}
+
+static void cmdGetTempComp(char*) {
+  // Summary line, then one line per bin that has seen locked PPS
+  SerialTx.print("TEMP_COMP:temp_c=");
+  SerialTx.print(advanced_timing.current_temp_c, 2);
+  SerialTx.print(",sensor=");
+  SerialTx.print(temp_sensor.available ? 1 : 0);
+  SerialTx.print(",reads=");
+  SerialTx.print(temp_sensor.reads);
+  SerialTx.print(",ref_temp=");
+  SerialTx.print(advanced_timing.reference_temp_c, 2);
+  SerialTx.print(",coeff=");
+  SerialTx.print(advanced_timing.temp_coefficient_ppm_per_c, 4);
+  SerialTx.print(",enabled=");
+  SerialTx.print(advanced_timing.temp_compensation_enabled ? 1 : 0);
+  SerialTx.print(",bins=");
+  SerialTx.print(temp_comp.qualified);
+  SerialTx.print(",holdover=");
+  SerialTx.print(temp_comp.holdover_active ? 1 : 0);
+  SerialTx.print(",correction_ppm=");
+  SerialTx.print(temp_comp.holdover_active ? temp_comp.applied_correction_ppm : 0.0f, 3);
+  SerialTx.println();
+  for (int bin = 0; bin < TEMP_COMP_BINS; bin++) {
+    if (temp_comp.samples[bin] == 0) continue;
+    SerialTx.print("TEMP_BIN:");
+    SerialTx.print(TEMP_COMP_MIN_C + ((float)bin + 0.5f) * TEMP_COMP_BIN_C, 1);
+    SerialTx.print(",ppm=");
+    SerialTx.print(temp_comp.ppm[bin], 3);
+    SerialTx.print(",samples=");
+    SerialTx.print(temp_comp.samples[bin]);
+    SerialTx.println();
+  }
+  SerialTx.println("OK:Temperature table reported");
+}
+
+static void cmdGetCal(char*) {
+  SerialTx.print("CAL:");
+  SerialTx.print(advanced_timing.calibration_valid ? 1 : 0);
+  SerialTx.print(",");
+  SerialTx.print(advanced_timing.oscillator_calibration_ppm, 2);
+  SerialTx.print(",");
+  SerialTx.print(getCalibrationSourceName(advanced_timing.calibration_source));
+  SerialTx.println();
+}
+
+static void cmdGetCalDetailed(char*) {
+  uint64_t current_virtual = getVirtualMicros();
+  uint64_t current_calibrated = getPreciseTimestamp();
+  uint64_t elapsed_since_cal_base = current_virtual - advanced_timing.cal_base_micros;
+  
+  SerialTx.print("CAL_DETAILED:");
+  SerialTx.print(advanced_timing.calibration_valid ? 1 : 0);
+  SerialTx.print(",");
+  SerialTx.print(advanced_timing.oscillator_calibration_ppm, 3);
+  SerialTx.print(",");
+  SerialTx.print(getCalibrationSourceName(advanced_timing.calibration_source));
+  SerialTx.print(",");
+  SerialTx.print((unsigned long)advanced_timing.cal_base_micros);
+  SerialTx.print(",");
+  SerialTx.print((unsigned long)current_virtual);
+  SerialTx.print(",");
+  SerialTx.print((unsigned long)current_calibrated);
+  SerialTx.print(",");
+  SerialTx.print((unsigned long)elapsed_since_cal_base);
+  SerialTx.print(",");
+  SerialTx.print((unsigned long)advanced_timing.sample_index);
+  SerialTx.print(",");
+  SerialTx.print(advanced_timing.reference_updates_count);
+  SerialTx.println();
+}
+
+#if PROFILE_HOT_PATH
+void profileRecord(uint8_t stage, uint32_t cycles) {
+  // Bucket by whole microseconds: cycles * (2^16 / 48) >> 16 avoids a software divide
+  uint32_t clamped = min(cycles, (uint32_t)3000000);
+  uint32_t us = (clamped * (65536 / (F_CPU / 1000000))) >> 16;
+  uint8_t bucket = (us == 0) ? 0 : (uint8_t)(32 - __builtin_clz(us));
+  if (bucket >= PROFILE_BUCKETS) {
+    bucket = PROFILE_BUCKETS - 1;
+  }
+  hot_path_profile.histogram[stage][bucket]++;
+  hot_path_profile.count[stage]++;
+  hot_path_profile.total_cycles[stage] += cycles;
+  if (cycles > hot_path_profile.max_cycles[stage]) {
+    hot_path_profile.max_cycles[stage] = cycles;
+  }
+}
+
+static void cmdGetProfile(char*) {
+  // One line per stage; hist lists bucket counts (bucket 0: < 1 us, k: [2^(k-1), 2^k) us)
+  const uint32_t cycles_per_us = F_CPU / 1000000;
+  for (uint8_t stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+    uint32_t count = hot_path_profile.count[stage];
+    SerialTx.print("PROFILE:");
+    SerialTx.print(PROFILE_STAGE_NAMES[stage]);
+    SerialTx.print(",count=");
+    SerialTx.print(count);
+    SerialTx.print(",avg_us=");
+    SerialTx.print(count > 0 ? (float)hot_path_profile.total_cycles[stage] / count / cycles_per_us : 0.0f, 2);
+    SerialTx.print(",max_us=");
+    SerialTx.print((float)hot_path_profile.max_cycles[stage] / cycles_per_us, 2);
+    SerialTx.print(",hist=");
+    for (uint8_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+      if (bucket > 0) {
+        SerialTx.print("/");
+      }
+      SerialTx.print(hot_path_profile.histogram[stage][bucket]);
+    }
+    SerialTx.println();
+  }
+  SerialTx.println("OK:Profile reported");
+}
+
+static void cmdResetProfile(char*) {
+  noInterrupts();
+  memset(&hot_path_profile, 0, sizeof(hot_path_profile));
+  interrupts();
+  SerialTx.println("OK:Profile reset");
+}
+#endif
+
+struct CommandEntry {
+  const char* name;
+  void (*handler)(char* params);
+};
+
+// Sorted in strcmp() order for the binary search in processLine()
+const CommandEntry COMMAND_TABLE[] = {
+  {"ACK", cmdAck},
+  {"BINARY_MODE", cmdBinaryMode},
+  {"CLEAR_CAL", cmdClearCal},
+  {"GET_ACQUISITION", cmdGetAcquisition},
+  {"GET_CAL", cmdGetCal},
+  {"GET_CAL_DETAILED", cmdGetCalDetailed},
+  {"GET_CAL_FLASH", cmdGetCalFlash},
+  {"GET_CHANNEL_MAP", cmdGetChannelMap},
+  {"GET_DECIMATION", cmdGetDecimation},
+  {"GET_DITHERING", cmdGetDithering},
+  {"GET_FILTER", cmdGetFilter},
+  {"GET_OUTPUT_FORMAT", cmdGetOutputFormat},
+#if PROFILE_HOT_PATH
+  {"GET_PROFILE", cmdGetProfile},
+#endif
+  {"GET_RELIABLE", cmdGetReliable},
+  {"GET_SCHEDULER", cmdGetScheduler},
+  {"GET_SELFTEST", cmdGetSelfTest},
+  {"GET_SEQUENCE_VALIDATION", cmdGetSequenceValidation},
+  {"GET_STATUS", cmdGetStatus},
+  {"GET_TEMP_COMP", cmdGetTempComp},
+  {"GET_TIMESTAMP_MODE", cmdGetTimestampMode},
+  {"GET_TIMING_STATUS", cmdGetTimingStatus},
+  {"GET_TRIGGER", cmdGetTrigger},
+  {"NACK", cmdNack},
+  {"RESET", cmdReset},
+#if PROFILE_HOT_PATH
+  {"RESET_PROFILE", cmdResetProfile},
+#endif
+  {"SAVE_CAL", cmdSaveCal},
+  {"SELFTEST", cmdSelfTest},
+  {"SET_ACQUISITION", cmdSetAcquisition},
+  {"SET_ADC_RATE", cmdSetAdcRate},
+  {"SET_BATCH_SIZE", cmdSetBatchSize},
+  {"SET_CAL_PPM", cmdSetCalPpm},
+  {"SET_CHANNELS", cmdSetChannels},
+  {"SET_CHANNEL_MAP", cmdSetChannelMap},
+  {"SET_DECIMATION", cmdSetDecimation},
+  {"SET_DITHERING", cmdSetDithering},
+  {"SET_FILTER", cmdSetFilter},
+  {"SET_GAIN", cmdSetGain},
+  {"SET_OUTPUT_FORMAT", cmdSetOutputFormat},
+  {"SET_PPS_EPOCH", cmdSetPpsEpoch},
+  {"SET_PRECISE_INTERVAL", cmdSetPreciseInterval},
+  {"SET_RELIABLE", cmdSetReliable},
+  {"SET_SCAN_ADC2", cmdSetScanAdc2},
+  {"SET_SCHEDULER", cmdSetScheduler},
+  {"SET_SEQUENCE_VALIDATION", cmdSetSequenceValidation},
+  {"SET_STAT_INTERVAL", cmdSetStatInterval},
+  {"SET_TIMESTAMP_MODE", cmdSetTimestampMode},
+  {"SET_TRIGGER", cmdSetTrigger},
+  {"SET_TRIGGER_WINDOW", cmdSetTriggerWindow},
+  {"START_STREAM", cmdStartStream},
+  {"START_STREAM_EPOCH", cmdStartStreamEpoch},
+  {"START_STREAM_PPS", cmdStartStreamPps},
+  {"START_STREAM_SYNC", cmdStartStreamSync},
+  {"STOP_STREAM", cmdStopStream},
+};
+const uint8_t COMMAND_COUNT = sizeof(COMMAND_TABLE) / sizeof(COMMAND_TABLE[0]);
+
+char* splitParam(char* params, char separator) {
+  // Terminate the first field in place; returns the remainder, or nullptr when the
+  // separator is missing or the first field is empty
+  char* sep = strchr(params, separator);
+  if (sep == nullptr || sep == params) {
+    return nullptr;
+  }
+  *sep = '\0';
+  return sep + 1;
+}
+
+void processLine(char* line) {
+  // Trim in place
+  while (isspace((unsigned char)*line)) {
+    line++;
+  }
+  char* tail = line + strlen(line);
+  while (tail > line && isspace((unsigned char)tail[-1])) {
+    *--tail = '\0';
+  }
+  
+  char* params = splitParam(line, ':');
+  if (params == nullptr) {
+    SerialTx.println("ERROR:Invalid command format");
+    return;
+  }
+  
+  // The sweep owns the stream settings: only queries, ACK/NACK and SELFTEST:ABORT get through
+  if (selftest.phase != SELFTEST_IDLE && strncmp(line, "GET_", 4) != 0 && strcmp(line, "ACK") != 0 &&
+      strcmp(line, "NACK") != 0 && strcmp(line, "SELFTEST") != 0) {
+    SerialTx.println("ERROR:SELFTEST running (SELFTEST:ABORT stops it)");
+    return;
+  }
+  
+  // Bounded lookup: at most log2(COMMAND_COUNT) compares for any command
+  uint8_t low = 0;
+  uint8_t high = COMMAND_COUNT;
+  while (low < high) {
+    uint8_t mid = (uint8_t)((low + high) / 2);
+    int order = strcmp(line, COMMAND_TABLE[mid].name);
+    if (order == 0) {
+      COMMAND_TABLE[mid].handler(params);
+      return;
+    }
+    if (order < 0) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+  SerialTx.println("ERROR:Unknown command");
+}
+
+bool verifyADCThroughput() {
+  if (high_rate.enabled) {
+    // High-rate streams: checked once before the start command is accepted
+    uint32_t limit_hz = getHighRateLimitHz();
+    bool sustainable = high_rate.rate_hz <= limit_hz;
+    if (!sustainable) {
+      SerialTx.print("WARNING:High-rate throughput inadequate - limit: ");
+      SerialTx.print(limit_hz);
+      SerialTx.print(" Hz (adc: ");
+      SerialTx.print(getAdcRateSps());
+      SerialTx.print(transport_usb ? " SPS, usb batch size: " : " SPS, uart batch size: ");
+      SerialTx.print(sample_batch.size);
+      SerialTx.print("), requested: ");
+      SerialTx.print(high_rate.rate_hz);
+      SerialTx.println(" Hz");
+    }
+    return sustainable;
+  }
+  
+  // Time one sample's reads take: measured once the current stream has produced samples,
+  // otherwise estimated from the data rate and the filter settling after each mux restart
+  uint32_t interval_us = (uint32_t)advanced_timing.sample_interval_us;
+  uint32_t required_us = adc_monitor.sample_acquisition_us;
+  bool measured = required_us > 0;
+  
+  if (!measured) {
+    uint32_t reads = num_channels * getReadsPerChannel();
+    uint32_t settle_conversions;
+    switch (current_adc_filter) {
+      case ADS126X_SINC1: settle_conversions = 1; break;
+      case ADS126X_SINC2: settle_conversions = 2; break;
+      case ADS126X_SINC3: settle_conversions = 3; break;
+      case ADS126X_SINC4: settle_conversions = 4; break;
+      default: settle_conversions = 4; break;  // FIR
+    }
+    uint32_t conversion_us = 1000000UL / getAdcRateSps();
+    required_us = reads * settle_conversions * conversion_us;
+  }
+  
+  bool adequate = required_us <= interval_us;
+  
+  if (!adequate && !adc_monitor.throughput_warning_sent) {
+    SerialTx.print("WARNING:ADC throughput inadequate - required: ");
+    SerialTx.print(required_us);
+    SerialTx.print(measured ? " us per sample (measured), interval: " : " us per sample (estimated), interval: ");
+    SerialTx.print(interval_us);
+    SerialTx.println(" us");
+    adc_monitor.throughput_warning_sent = true;
+  } else if (adequate && adc_monitor.throughput_warning_sent) {
+    adc_monitor.throughput_warning_sent = false;
+  }
+  
+  return adequate;
+}
+
+uint32_t getAdcRateSps() {
+  switch(current_adc_rate) {
+    case ADS126X_RATE_2_5: return 2;
+    case ADS126X_RATE_5: return 5;
+    case ADS126X_RATE_10: return 10;
+    case ADS126X_RATE_16_6: return 16;
+    case ADS126X_RATE_20: return 20;
+    case ADS126X_RATE_50: return 50;
+    case ADS126X_RATE_60: return 60;
+    case ADS126X_RATE_100: return 100;
+    case ADS126X_RATE_400: return 400;
+    case ADS126X_RATE_1200: return 1200;
+    case ADS126X_RATE_2400: return 2400;
+    case ADS126X_RATE_4800: return 4800;
+    case ADS126X_RATE_7200: return 7200;
+    case ADS126X_RATE_14400: return 14400;
+    case ADS126X_RATE_19200: return 19200;
+    case ADS126X_RATE_38400: return 38400;
+    default: return 19200;
+  }
+}
+
+long readADC(int pos_pin, int neg_pin) {
+  adc.setInputPins(pos_pin, neg_pin);
+  
+  uint32_t startTime = micros();
+  uint32_t timeout_us = 10000; // 10ms timeout
+  
+  // Wait for DRDY with timeout
+  PROFILE_BEGIN(PROFILE_DRDY_WAIT);
+  while(digitalRead(drdy_pin) == HIGH) {
+    if (micros() - startTime > timeout_us) {
+      adc_monitor.deadline_misses++;
+      PROFILE_END(PROFILE_DRDY_WAIT);
+      return 0;
+    }
+  }
+  PROFILE_END(PROFILE_DRDY_WAIT);
+  
+  recordConversionTime(micros() - startTime);
+  
+  PROFILE_BEGIN(PROFILE_SPI_READ);
+  long value = adc.readADC1();
+  PROFILE_END(PROFILE_SPI_READ);
+  return value;
+}
+
+void recordSampleAcquisitionTime(uint32_t acquisition_us) {
+  // 1/8 exponential average of the per-sample read time (first sample seeds it)
+  if (adc_monitor.sample_acquisition_us == 0) {
+    adc_monitor.sample_acquisition_us = acquisition_us;
+  } else {
+    int32_t delta = (int32_t)acquisition_us - (int32_t)adc_monitor.sample_acquisition_us;
+    adc_monitor.sample_acquisition_us = (uint32_t)((int32_t)adc_monitor.sample_acquisition_us + delta / 8);
+  }
+}
+
+void recordConversionTime(uint32_t conversion_time) {
+  adc_monitor.total_conversions++;
+  if (selftest.measuring) {
+    if (conversion_time > selftest.drdy_max_us) {
+      selftest.drdy_max_us = conversion_time;
+    }
+    selftest.drdy_total_us += conversion_time;
+    selftest.drdy_count++;
+  }
+  
+  // Track conversion timing statistics
+  if (adc_monitor.total_conversions == 1) {
+    adc_monitor.min_conversion_time_us = conversion_time;
+    adc_monitor.max_conversion_time_us = conversion_time;
+  } else {
+    if (conversion_time > adc_monitor.max_conversion_time_us) {
+      adc_monitor.max_conversion_time_us = conversion_time;
+    }
+    if (conversion_time < adc_monitor.min_conversion_time_us) {
+      adc_monitor.min_conversion_time_us = conversion_time;
+    }
+  }
+}
+
+void dmacInit() {
+  if (dmac_initialized) {
+    return;
+  }
+  
+  PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+  PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+  
+  DMAC->CTRL.reg &= ~DMAC_CTRL_DMAENABLE;
+  DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+  while (DMAC->CTRL.reg & DMAC_CTRL_SWRST);
+  
+  DMAC->BASEADDR.reg = (uint32_t)dmac_descriptors;
+  DMAC->WRBADDR.reg = (uint32_t)dmac_writeback;
+  DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+  
+  NVIC_SetPriority(DMAC_IRQn, 1);
+  NVIC_EnableIRQ(DMAC_IRQn);
+  dmac_initialized = true;
+}
+
+void dmacConfigureChannel(uint8_t channel, uint8_t trigger_source) {
+  // One beat per peripheral trigger; transfer-complete interrupt enabled for every channel.
+  // CHID selects the channel window shared with the DMAC ISR, so keep this atomic.
+  noInterrupts();
+  DMAC->CHID.reg = DMAC_CHID_ID(channel);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+  while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST);
+  DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(trigger_source) | DMAC_CHCTRLB_TRIGACT_BEAT;
+  DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL;
+  interrupts();
+}
+
+void DmaTxRing::begin() {
+#if TX_RING_DMA
+  if (transport_usb) {
+    return;  // Drained by drainUsb(); the USB peripheral moves the packets itself
+  }
+  dmacInit();
+  dmacConfigureChannel(DMAC_CH_UART_TX, TX_UART_DMAC_TRIGGER);
+#endif
+}
+
+size_t DmaTxRing::write(const uint8_t* data, size_t length) {
+#if TX_RING_DMA
+  size_t remaining = length;
+  while (remaining > 0) {
+    // Ring holds at most TX_RING_SIZE - 1 bytes; wait for the DMA to drain if full
+    uint16_t space = (TX_RING_SIZE - 1) - used();
+    if (space == 0) {
+      kick();
+      if (transport_usb && used() == TX_RING_SIZE - 1) {
+        // Host holds DTR but stopped reading: SerialUSB timed out without taking a byte, so the
+        // rest of this write is dropped instead of stalling loop() until the host reads again
+        serial_monitor.buffer_overflows++;
+        serial_monitor.last_overflow_time = millis();
+        break;
+      }
+      continue;
+    }
+    uint16_t contiguous = TX_RING_SIZE - head;
+    uint16_t chunk = remaining < space ? (uint16_t)remaining : space;
+    if (chunk > contiguous) chunk = contiguous;
+    memcpy(buffer + head, data, chunk);
+    head = (head + chunk) & (TX_RING_SIZE - 1);
+    data += chunk;
+    remaining -= chunk;
+  }
+  
+  uint16_t occupancy = used();
+  if (occupancy > high_water_mark) {
+    high_water_mark = occupancy;
+  }
+  kick();
+  return length - remaining;
+#else
+  return transport_port->write(data, length);
+#endif
+}
+
+int DmaTxRing::availableForWrite() {
+#if TX_RING_DMA
+  return (TX_RING_SIZE - 1) - used();
+#else
+  return transport_port->availableForWrite();
+#endif
+}
+
+void DmaTxRing::kick() {
+  // Start a transfer of the contiguous pending region if the channel is idle.
+  // Called from both the main loop and DMAC_Handler, so save/restore PRIMASK.
+  // USB output only ever runs from the main loop and waits for a full bulk here.
+  if (transport_usb) {
+    drainUsb(USB_TX_BULK_SIZE);
+    return;
+  }
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint16_t pending = used();
+  if (!dma_active && pending > 0) {
+    uint16_t contiguous = TX_RING_SIZE - tail;
+    uint16_t chunk = pending < contiguous ? pending : contiguous;
+    
+    DmacDescriptor& desc = dmac_descriptors[DMAC_CH_UART_TX];
+    desc.BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_BLOCKACT_NOACT |
+                      DMAC_BTCTRL_SRCINC;
+    desc.BTCNT.reg = chunk;
+    desc.SRCADDR.reg = (uint32_t)(buffer + tail + chunk);
+    desc.DSTADDR.reg = (uint32_t)&TX_UART_SERCOM->USART.DATA.reg;
+    desc.DESCADDR.reg = 0;
+    
+    dma_length = chunk;
+    dma_active = true;
+    DMAC->CHID.reg = DMAC_CHID_ID(DMAC_CH_UART_TX);
+    DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+  }
+  __set_PRIMASK(primask);
+}
+
+void DmaTxRing::poll() {
+#if TX_RING_DMA
+  if (transport_usb) {
+    drainUsb(1);
+  }
+#endif
+}
+
+void DmaTxRing::drainUsb(uint16_t min_bytes) {
+  // Contiguous pending bytes go out in writes of up to USB_TX_BULK_SIZE; SerialUSB splits them
+  // into 64-byte packets. Without a host holding the port open (DTR) output is discarded, the
+  // same as an unconnected UART line, so a full ring never blocks the main loop.
+  if (!SerialUSB.dtr()) {
+    tail = head;
+    return;
+  }
+  uint16_t pending = used();
+  while (pending > 0 && pending >= min_bytes) {
+    uint16_t contiguous = TX_RING_SIZE - tail;
+    uint16_t chunk = pending < contiguous ? pending : contiguous;
+    if (chunk > USB_TX_BULK_SIZE) chunk = USB_TX_BULK_SIZE;
+    size_t sent = SerialUSB.write(buffer + tail, chunk);
+    if (sent == 0) {
+      break;  // Endpoint timed out; retried on the next write or poll
+    }
+    tail = (tail + sent) & (TX_RING_SIZE - 1);
+    pending = used();
+  }
+}
+
+void DmaTxRing::onDmaComplete() {
+  // Runs in DMAC_Handler: release the sent chunk and chain the next one
+  tail = (tail + dma_length) & (TX_RING_SIZE - 1);
+  dma_length = 0;
+  dma_active = false;
+  kick();
+}
+
+void startSpiDma(const uint8_t* tx, volatile uint8_t* rx, uint8_t length) {
+  // Full-duplex SPI: the RX channel finishes after the last byte has been clocked in,
+  // so its completion is the point where chip select may be released.
+  // Incrementing addresses point one past the end of the buffer (DMAC convention).
+  DmacDescriptor& rx_desc = dmac_descriptors[DMAC_CH_SPI_RX];
+  rx_desc.BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_BLOCKACT_NOACT |
+                       (rx ? DMAC_BTCTRL_DSTINC : 0);
+  rx_desc.BTCNT.reg = length;
+  rx_desc.SRCADDR.reg = (uint32_t)&ADC_SPI_SERCOM->SPI.DATA.reg;
+  rx_desc.DSTADDR.reg = rx ? (uint32_t)(rx + length) : (uint32_t)&drdy_acq.rx_discard;
+  rx_desc.DESCADDR.reg = 0;
+  
+  DmacDescriptor& tx_desc = dmac_descriptors[DMAC_CH_SPI_TX];
+  tx_desc.BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_BLOCKACT_NOACT |
+                       DMAC_BTCTRL_SRCINC;
+  tx_desc.BTCNT.reg = length;
+  tx_desc.SRCADDR.reg = (uint32_t)(tx + length);
+  tx_desc.DSTADDR.reg = (uint32_t)&ADC_SPI_SERCOM->SPI.DATA.reg;
+  tx_desc.DESCADDR.reg = 0;
+  
+  DMAC->CHID.reg = DMAC_CHID_ID(DMAC_CH_SPI_RX);
+  DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+  DMAC->CHID.reg = DMAC_CHID_ID(DMAC_CH_SPI_TX);
+  DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+}
+
+static void beginMuxWrite(uint8_t channel) {
+  // Writing INPMUX restarts the ADS1263 conversion on the new input pair
+  drdy_acq.state = DrdyDmaAcquisition::STATE_MUXING;
+  drdy_acq.mux_tx[0] = ADS126X_CMD_WREG | ADS126X_REG_INPMUX;
+  drdy_acq.mux_tx[1] = 0x00;  // Write one register
+  drdy_acq.mux_tx[2] = drdy_acq.mux[channel];
+  digitalWrite(chip_select, LOW);
+  startSpiDma(drdy_acq.mux_tx, nullptr, sizeof(drdy_acq.mux_tx));
+}
+
+static inline void queueHighRateRead(int32_t value) {
+  if (high_rate.group_reads == 0) {
+    high_rate.group_drdy_us = high_rate.last_drdy_us;
+  }
+  high_rate.group_sum += value;
+  if (++high_rate.group_reads < high_rate.reads_per_sample) {
+    return;
+  }
+  
+  uint8_t next = (high_rate.head + 1) & (HIGH_RATE_QUEUE_SIZE - 1);
+  if (next == high_rate.tail) {
+    high_rate.overruns++;
+  } else {
+    high_rate.sum[high_rate.head] = high_rate.group_sum;
+    high_rate.drdy_us[high_rate.head] = high_rate.group_drdy_us;
+    high_rate.head = next;
+  }
+  high_rate.group_sum = 0;
+  high_rate.group_reads = 0;
+}
+
+static void onSpiDmaComplete() {
+  digitalWrite(chip_select, HIGH);
+  
+  if (drdy_acq.abort_requested) {
+    drdy_acq.abort_requested = false;
+    drdy_acq.state = DrdyDmaAcquisition::STATE_IDLE;
+    return;
+  }
+  
+  if (drdy_acq.state == DrdyDmaAcquisition::STATE_MUXING) {
+    drdy_acq.conversion_start_us = micros();
+    drdy_acq.state = DrdyDmaAcquisition::STATE_WAIT_DRDY;
+    return;
+  }
+  
+  // rx[0] is clocked during the command byte, rx[1] is STATUS, then the result (MSB first),
+  // rx[6] is the checksum (sum + 0x9B). RDATA1: rx[2..5] 32-bit; RDATA2: rx[2..4] 24-bit, rx[5] pad
+  const volatile uint8_t* r = drdy_acq.rx;
+  uint8_t checksum = (uint8_t)(r[2] + r[3] + r[4] + r[5] + 0x9B);
+  if (checksum != r[6]) {
+    adc_monitor.checksum_errors++;
+  }
+  
+  if (drdy_acq.state == DrdyDmaAcquisition::STATE_READING_ADC2) {
+    // Sign-extend the 24-bit ADC2 result; weighted like an averaged ADC1 channel
+    int32_t value2 = (int32_t)(((uint32_t)r[2] << 24) | ((uint32_t)r[3] << 16) | ((uint32_t)r[4] << 8)) >> 8;
+    drdy_acq.sum[drdy_acq.channels - 1] = value2 * drdy_acq.oversample;
+    drdy_acq.state = DrdyDmaAcquisition::STATE_IDLE;
+    drdy_acq.ready_at_us = micros();
+    drdy_acq.sample_ready = true;
+    return;
+  }
+  
+  if (drdy_acq.state != DrdyDmaAcquisition::STATE_READING) {
+    return;
+  }
+  
+  int32_t value = (int32_t)(((uint32_t)r[2] << 24) | ((uint32_t)r[3] << 16) | ((uint32_t)r[4] << 8) | r[5]);
+  
+  if (high_rate.running) {
+    // Same input stays selected: the next conversion is already running
+    queueHighRateRead(value);
+    drdy_acq.state = DrdyDmaAcquisition::STATE_WAIT_DRDY;
+    return;
+  }
+  
+  uint8_t channel = drdy_acq.step % drdy_acq.adc1_channels;
+  drdy_acq.sum[channel] += value;
+  if (decimator.ratio_log2 > 0) {
+    cicIntegrate(decimator.ch[channel], value);
+  }
+  recordConversionTime(micros() - drdy_acq.conversion_start_us);
+  drdy_acq.step++;
+  
+  if (drdy_acq.step >= drdy_acq.step_count) {
+    if (drdy_acq.adc2) {
+      // ADC2 free-runs on its channel; take its latest result to close the sample
+      drdy_acq.state = DrdyDmaAcquisition::STATE_READING_ADC2;
+      drdy_acq.read_length = ADS126X_READ_LENGTH;
+      digitalWrite(chip_select, LOW);
+      startSpiDma(drdy_acq.tx_adc2, drdy_acq.rx, ADS126X_READ_LENGTH);
+      return;
+    }
+    drdy_acq.state = DrdyDmaAcquisition::STATE_IDLE;
+    drdy_acq.ready_at_us = micros();
+    drdy_acq.sample_ready = true;
+  } else if (drdy_acq.adc1_channels == 1 || drdy_acq.read_length == ADS126X_SCAN_FRAME_LENGTH) {
+    // The next conversion is already running: same input, or the INPMUX write that ended this frame
+    drdy_acq.conversion_start_us = micros();
+    drdy_acq.state = DrdyDmaAcquisition::STATE_WAIT_DRDY;
+  } else {
+    beginMuxWrite(drdy_acq.step % drdy_acq.adc1_channels);
+  }
+}
+
+extern "C" void DMAC_Handler(void) {
+  uint8_t channel = DMAC->INTPEND.bit.ID;
+  DMAC->CHID.reg = DMAC_CHID_ID(channel);
+  uint8_t flags = DMAC->CHINTFLAG.reg;
+  DMAC->CHINTFLAG.reg = flags;
+  
+  if (!(flags & DMAC_CHINTFLAG_TCMPL)) {
+    return;
+  }
+  if (channel == DMAC_CH_SPI_RX) {
+    PROFILE_BEGIN(PROFILE_DMA_ISR);
+    onSpiDmaComplete();
+    PROFILE_END(PROFILE_DMA_ISR);
+  } else if (channel == DMAC_CH_UART_TX) {
+    SerialTx.onDmaComplete();
+  }
+}
+
+void drdy_interrupt() {
+  if (drdy_acq.state != DrdyDmaAcquisition::STATE_WAIT_DRDY) {
+    return;  // Conversion of a channel we already moved away from
+  }
+  drdy_acq.state = DrdyDmaAcquisition::STATE_READING;
+  high_rate.last_drdy_us = timebaseMicros32();
+  
+  uint8_t length = ADS126X_READ_LENGTH;
+  if (drdy_acq.scan && drdy_acq.adc1_channels > 1 && drdy_acq.step + 1 < drdy_acq.step_count) {
+    // Append the next channel's INPMUX write to this read: its conversion starts as the frame ends
+    drdy_acq.tx[ADS126X_READ_LENGTH + 2] = drdy_acq.mux[(drdy_acq.step + 1) % drdy_acq.adc1_channels];
+    length = ADS126X_SCAN_FRAME_LENGTH;
+  }
+  drdy_acq.read_length = length;
+  digitalWrite(chip_select, LOW);
+  startSpiDma(drdy_acq.tx, drdy_acq.rx, length);
+}
+
+static void writeAdsBytes(const uint8_t* bytes, uint8_t length) {
+  // Blocking register/command write, only used while the DMA engine is idle
+  digitalWrite(chip_select, LOW);
+  for (uint8_t i = 0; i < length; i++) {
+    SPI.transfer(bytes[i]);
+  }
+  digitalWrite(chip_select, HIGH);
+}
+
+void startDrdyAcquisition() {
+  dmacInit();
+  dmacConfigureChannel(DMAC_CH_SPI_RX, ADC_SPI_DMAC_RX_TRIGGER);
+  dmacConfigureChannel(DMAC_CH_SPI_TX, ADC_SPI_DMAC_TX_TRIGGER);
+  
+  drdy_acq.channels = (uint8_t)num_channels;
+  drdy_acq.scan = (acquisition_mode == ACQ_SCAN);
+  drdy_acq.adc2 = drdy_acq.scan && scan_adc2_enabled && drdy_acq.channels > 1;
+  drdy_acq.adc1_channels = drdy_acq.adc2 ? drdy_acq.channels - 1 : drdy_acq.channels;
+  drdy_acq.oversample = getReadsPerChannel();
+  drdy_acq.step_count = drdy_acq.adc1_channels * drdy_acq.oversample;
+  for (uint8_t i = 0; i < MAX_ACQ_CHANNELS; i++) {
+    drdy_acq.mux[i] = (uint8_t)((channel_table[i].pos << 4) | channel_table[i].neg);
+  }
+  // Channel list is fixed for the stream: RDATA1 frame plus the (SCAN) INPMUX write behind it
+  memset(drdy_acq.tx, 0, sizeof(drdy_acq.tx));
+  drdy_acq.tx[0] = ADS126X_CMD_RDATA1;
+  drdy_acq.tx[ADS126X_READ_LENGTH] = ADS126X_CMD_WREG | ADS126X_REG_INPMUX;
+  drdy_acq.tx[ADS126X_READ_LENGTH + 1] = 0x00;  // Write one register
+  memset(drdy_acq.tx_adc2, 0, sizeof(drdy_acq.tx_adc2));
+  drdy_acq.tx_adc2[0] = ADS126X_CMD_RDATA2;
+  drdy_acq.read_length = 0;
+  
+  if (drdy_acq.adc2) {
+    // ADC2 converts the last channel continuously in parallel with the ADC1 scan
+    const uint8_t adc2_setup[] = {
+      (uint8_t)(ADS126X_CMD_WREG | ADS126X_REG_ADC2CFG), 0x01,  // ADC2CFG and ADC2MUX
+      ADS126X_ADC2CFG_800SPS, drdy_acq.mux[drdy_acq.channels - 1]
+    };
+    const uint8_t start2 = ADS126X_CMD_START2;
+    writeAdsBytes(adc2_setup, sizeof(adc2_setup));
+    writeAdsBytes(&start2, 1);
+  }
+  
+  drdy_acq.state = DrdyDmaAcquisition::STATE_IDLE;
+  drdy_acq.pending = false;
+  drdy_acq.sample_ready = false;
+  drdy_acq.abort_requested = false;
+  attachInterrupt(digitalPinToInterrupt(drdy_pin), drdy_interrupt, FALLING);
+  
+  LOG_DEBUG(drdy_acq.scan ? "SCAN acquisition armed (" : "DRDY/DMA acquisition armed (", drdy_acq.adc1_channels, " ch x ", drdy_acq.oversample, drdy_acq.adc2 ? " reads per sample, +1 ch on ADC2)" : " reads per sample)");
+}
+
+void stopDrdyAcquisition() {
+  if (drdy_acq.channels == 0) {
+    return;  // Engine was never started for this stream
+  }
+  
+  detachInterrupt(digitalPinToInterrupt(drdy_pin));
+  noInterrupts();
+  drdy_acq.state = DrdyDmaAcquisition::STATE_IDLE;
+  drdy_acq.abort_requested = false;
+  DMAC->CHID.reg = DMAC_CHID_ID(DMAC_CH_SPI_TX);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  DMAC->CHID.reg = DMAC_CHID_ID(DMAC_CH_SPI_RX);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  interrupts();
+  digitalWrite(chip_select, HIGH);
+  
+  if (drdy_acq.adc2) {
+    const uint8_t stop2 = ADS126X_CMD_STOP2;
+    writeAdsBytes(&stop2, 1);
+    drdy_acq.adc2 = false;
+  }
+  
+  drdy_acq.pending = false;
+  drdy_acq.sample_ready = false;
+  drdy_acq.channels = 0;
+  high_rate.running = false;
+}
+
+void armDrdySample(uint64_t timestamp) {
+  if (drdy_acq.channels == 0) {
+    startDrdyAcquisition();
+  }
+  
+  if (drdy_acq.pending) {
+    // Previous sample still converting when its successor's slot arrived
+    adc_monitor.deadline_misses++;
+    completeDrdySample();
+  }
+  
+  noInterrupts();
+  drdy_acq.step = 0;
+  for (uint8_t i = 0; i < MAX_ACQ_CHANNELS; i++) {
+    drdy_acq.sum[i] = 0;
+  }
+  drdy_acq.sample_ready = false;
+  drdy_acq.pending = true;
+  drdy_acq.armed_at_us = micros();
+  drdy_acq.pending_timestamp = timestamp;
+  beginMuxWrite(0);
+  interrupts();
+}
+
+void serviceDrdyAcquisition() {
+  if (drdy_acq.sample_ready) {
+    completeDrdySample();
+    return;
+  }
+  
+  // Same 10 ms per-read budget as readADC()
+  if (micros() - drdy_acq.armed_at_us > 10000UL * drdy_acq.step_count) {
+    adc_monitor.deadline_misses++;
+    completeDrdySample();
+  }
+}
+
+void completeDrdySample() {
+  if (!drdy_acq.sample_ready) {
+    // Stop the sequence; a transfer already in flight completes within a few microseconds
+    noInterrupts();
+    if (drdy_acq.state == DrdyDmaAcquisition::STATE_WAIT_DRDY) {
+      drdy_acq.state = DrdyDmaAcquisition::STATE_IDLE;
+    } else if (drdy_acq.state != DrdyDmaAcquisition::STATE_IDLE) {
+      drdy_acq.abort_requested = true;
+    }
+    interrupts();
+    uint32_t spin_start = micros();
+    while (drdy_acq.state != DrdyDmaAcquisition::STATE_IDLE && (micros() - spin_start) < 100);
+  }
+  
+  if (drdy_acq.sample_ready) {
+    recordSampleAcquisitionTime(drdy_acq.ready_at_us - drdy_acq.armed_at_us);
+  }
+  
+  // Missing reads count as zero, matching the readADC() timeout behaviour
+  long values[MAX_ACQ_CHANNELS] = {0};
+  for (uint8_t ch = 0; ch < drdy_acq.channels; ch++) {
+    values[ch] = (long)(drdy_acq.sum[ch] / drdy_acq.oversample);
+  }
+  applyDecimation(values, drdy_acq.adc1_channels);
+  drdy_acq.pending = false;
+  drdy_acq.sample_ready = false;
+  
+  emitSample(drdy_acq.pending_timestamp, values);
+}
+
+void startHighRateAcquisition() {
+  if (drdy_acq.channels == 0) {
+    startDrdyAcquisition();
+  }
+  
+  noInterrupts();
+  high_rate.head = 0;
+  high_rate.tail = 0;
+  high_rate.group_sum = 0;
+  high_rate.group_reads = 0;
+  high_rate.overruns = 0;
+  high_rate.overruns_reported = 0;
+  high_rate.anchor_index = 0;
+  high_rate.running = true;
+  drdy_acq.pending = false;
+  beginMuxWrite(0);  // Conversions then free-run on channel 1 and every DRDY is read
+  interrupts();
+  
+  LOG_DEBUG("High-rate acquisition started (", getAdcRateSps(), " SPS / ", high_rate.reads_per_sample, " reads per sample)");
+}
+
+void serviceHighRateStream() {
+  // Drain everything queued since the last pass (several samples per loop() at kHz rates)
+  while (high_rate.tail != high_rate.head) {
+    uint8_t slot = high_rate.tail;
+    int64_t sum = high_rate.sum[slot];
+    uint32_t drdy_us = high_rate.drdy_us[slot];
+    high_rate.tail = (slot + 1) & (HIGH_RATE_QUEUE_SIZE - 1);
+    
+    if (sample_batch.count == 0) {
+      // New frame: anchor on its first sample's DRDY edge, mapped onto the virtual timeline
+      uint64_t now_virtual = getVirtualMicros();
+      uint64_t drdy_virtual = now_virtual - (uint32_t)((uint32_t)now_virtual - drdy_us);
+      high_rate.anchor_timestamp = getPreciseTimestampAt(drdy_virtual);
+      high_rate.anchor_index = 0;
+    }
+    uint64_t timestamp = high_rate.anchor_timestamp +
+                         (((uint64_t)high_rate.anchor_index * high_rate.interval_q32) >> 32);
+    high_rate.anchor_index++;
+    
+    long values[MAX_ACQ_CHANNELS] = {(long)(sum / high_rate.reads_per_sample)};
+    emitSample(timestamp, values);
+  }
   
-  if (!adequate && !adc_monitor.throughput_warning_sent) {
-    Serial1.print("WARNING:ADC throughput inadequate - required: ");
-    Serial1.print(required_samples_per_sec);
-    Serial1.print(" sps, available: ");
-    Serial1.print(adc_rate_sps);
-    Serial1.println(" sps");
-    adc_monitor.throughput_warning_sent = true;
-  } else if (adequate && adc_monitor.throughput_warning_sent) {
-    adc_monitor.throughput_warning_sent = false;
+  uint32_t overruns = high_rate.overruns;
+  if (overruns != high_rate.overruns_reported) {
+    reportSkippedSamples(overruns - high_rate.overruns_reported);
+    high_rate.overruns_reported = overruns;
   }
+}
+
+static uint32_t nextSampleTimerPeriod() {
+  // Integer part of the next period; the fraction is carried so N/N+1 periods average out
+  int64_t step = (int64_t)sample_timer.period_q32 + (int64_t)sample_timer.frac_acc;
+  if (sample_timer.adjust_remaining > 0) {
+    step += sample_timer.adjust_q32;
+    sample_timer.adjust_remaining--;
+  }
+  sample_timer.frac_acc = (uint32_t)step;
+  uint32_t counts = (uint32_t)(step >> 32);
+  if (counts > SAMPLE_TIMER_MAX_COUNT) counts = SAMPLE_TIMER_MAX_COUNT;
+  if (counts < 2) counts = 2;
+  return counts;
+}
+
+static void queueSampleTick(uint32_t tick_micros) {
+  uint8_t next = (uint8_t)((sample_timer.tick_head + 1) % SAMPLE_TICK_QUEUE_SIZE);
+  uint32_t slot = sample_timer.slots_fired++;
+  if (next == sample_timer.tick_tail) {
+    sample_timer.overruns++;
+    return;
+  }
+  sample_timer.tick_micros[sample_timer.tick_head] = tick_micros;
+  sample_timer.tick_slot[sample_timer.tick_head] = slot;
+  sample_timer.tick_head = next;
+  sample_timer.ticks++;
+}
+
+static void updateSampleTimerPeriod() {
+  // Same Q32.32 interval as the loop scheduler (nominal * (1 - ppm/1e6)), in timer counts
+  refreshTimingScales();
+  uint64_t period_q32 = (advanced_timing.effective_interval_q32 >> sample_timer.prescaler_shift) *
+                        (SAMPLE_TIMER_CLOCK_HZ / 1000000UL);
   
-  return adequate;
+  noInterrupts();
+  sample_timer.period_q32 = period_q32;
+  interrupts();
+  sample_timer.applied_ppm = advanced_timing.oscillator_calibration_ppm;
+  sample_timer.applied_interval_us = advanced_timing.sample_interval_us;
 }
 
-long readADC(int pos_pin, int neg_pin) {
-  adc.setInputPins(pos_pin, neg_pin);
+extern "C" void TCC1_Handler(void) {
+  SAMPLE_TIMER->INTFLAG.reg = TCC_INTFLAG_OVF;
+  queueSampleTick(timebaseMicros32());
+  // PERB is loaded at the next overflow, so this programs the period after the one now running
+  SAMPLE_TIMER->PERB.reg = nextSampleTimerPeriod() - 1;
+}
+
+void startSampleTimer() {
+  // Smallest prescaler that keeps the period (plus calibration/phase headroom) in 24 bits
+  static const uint8_t divider_shifts[] = {0, 1, 2, 3, 4, 6, 8, 10};
+  uint64_t nominal_counts = advanced_timing.sample_interval_us * (SAMPLE_TIMER_CLOCK_HZ / 1000000UL);
+  uint8_t index = 0;
+  while (index < 7 && (nominal_counts >> divider_shifts[index]) > SAMPLE_TIMER_MAX_COUNT - (SAMPLE_TIMER_MAX_COUNT >> 4)) {
+    index++;
+  }
+  if ((nominal_counts >> divider_shifts[index]) > SAMPLE_TIMER_MAX_COUNT - (SAMPLE_TIMER_MAX_COUNT >> 4)) {
+    SerialTx.println("WARNING:Sample interval too long for TCC1 - using LOOP scheduler");
+    scheduler_mode = SCHED_LOOP;
+    return;
+  }
+  sample_timer.prescaler = index;
+  sample_timer.prescaler_shift = divider_shifts[index];
+  sample_timer.prescaler_div = (uint16_t)(1u << divider_shifts[index]);
+  sample_timer.frac_acc = 0;
+  sample_timer.adjust_q32 = 0;
+  sample_timer.adjust_remaining = 0;
+  sample_timer.tick_head = 0;
+  sample_timer.tick_tail = 0;
+  sample_timer.slots_fired = 0;
+  updateSampleTimerPeriod();
   
-  uint32_t startTime = micros();
-  uint32_t timeout_us = 10000; // 10ms timeout
+  PM->APBCMASK.reg |= PM_APBCMASK_TCC1;
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID_TCC0_TCC1 | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_CLKEN;
+  while (GCLK->STATUS.bit.SYNCBUSY);
   
-  // Wait for DRDY with timeout
-  while(digitalRead(drdy_pin) == HIGH) {
-    if (micros() - startTime > timeout_us) {
-      adc_monitor.deadline_misses++;
-      return 0;
-    }
+  SAMPLE_TIMER->CTRLA.reg = TCC_CTRLA_SWRST;
+  while (SAMPLE_TIMER->SYNCBUSY.bit.SWRST);
+  SAMPLE_TIMER->CTRLA.reg = TCC_CTRLA_PRESCALER(sample_timer.prescaler) | TCC_CTRLA_PRESCSYNC_PRESC;
+  SAMPLE_TIMER->WAVE.reg = TCC_WAVE_WAVEGEN_NFRQ;
+  while (SAMPLE_TIMER->SYNCBUSY.bit.WAVE);
+  
+  // Shorten the first period by how late we are, so tick 1 lands on the scheduled grid
+  uint32_t first = nextSampleTimerPeriod();
+  uint64_t late_us = (uint64_t)((long long)getVirtualMicros() - (long long)advanced_timing.next_sample_micros);
+  uint64_t late_counts = ((late_us % advanced_timing.sample_interval_us) *
+                          (SAMPLE_TIMER_CLOCK_HZ / 1000000UL)) >> sample_timer.prescaler_shift;
+  if (late_counts + 2 < first) {
+    first -= (uint32_t)late_counts;
   }
+  SAMPLE_TIMER->PER.reg = first - 1;
+  while (SAMPLE_TIMER->SYNCBUSY.bit.PER);
+  SAMPLE_TIMER->PERB.reg = nextSampleTimerPeriod() - 1;
+  while (SAMPLE_TIMER->SYNCBUSY.bit.PERB);
   
-  uint32_t conversion_time = micros() - startTime;
-  adc_monitor.total_conversions++;
+  SAMPLE_TIMER->INTENSET.reg = TCC_INTENSET_OVF;
+  NVIC_ClearPendingIRQ(TCC1_IRQn);
+  NVIC_SetPriority(TCC1_IRQn, 0);
+  NVIC_EnableIRQ(TCC1_IRQn);
   
-  // Track conversion timing statistics
-  if (adc_monitor.total_conversions == 1) {
-    adc_monitor.min_conversion_time_us = conversion_time;
-    adc_monitor.max_conversion_time_us = conversion_time;
-  } else {
-    if (conversion_time > adc_monitor.max_conversion_time_us) {
-      adc_monitor.max_conversion_time_us = conversion_time;
+  // Tick 0 is the start itself
+  noInterrupts();
+  SAMPLE_TIMER->CTRLA.reg |= TCC_CTRLA_ENABLE;
+  queueSampleTick(timebaseMicros32());
+  interrupts();
+  while (SAMPLE_TIMER->SYNCBUSY.bit.ENABLE);
+  sample_timer.running = true;
+  
+  LOG_DEBUG("TCC1 sample timer started (prescaler ", sample_timer.prescaler_div, ", ", LogFloat((double)sample_timer.period_q32 / 4294967296.0, 3), " counts/sample)");
+}
+
+void stopSampleTimer() {
+  if (!sample_timer.running) {
+    return;
+  }
+  NVIC_DisableIRQ(TCC1_IRQn);
+  SAMPLE_TIMER->CTRLA.reg &= ~TCC_CTRLA_ENABLE;
+  while (SAMPLE_TIMER->SYNCBUSY.bit.ENABLE);
+  SAMPLE_TIMER->INTFLAG.reg = TCC_INTFLAG_OVF;
+  NVIC_ClearPendingIRQ(TCC1_IRQn);
+  sample_timer.running = false;
+  sample_timer.tick_tail = sample_timer.tick_head;  // Drop ticks not yet consumed
+}
+
+void serviceSampleTimer() {
+  if (!sample_timer.running) {
+    // Start at the first scheduler slot, exactly like the loop scheduler would
+    if (advanced_timing.next_sample_micros == 0) {
+      advanced_timing.next_sample_micros = advanced_timing.timing_base_micros;
     }
-    if (conversion_time < adc_monitor.min_conversion_time_us) {
-      adc_monitor.min_conversion_time_us = conversion_time;
+    if ((long long)getVirtualMicros() - (long long)advanced_timing.next_sample_micros < 0) {
+      return;
+    }
+    startSampleTimer();
+    if (!sample_timer.running) {
+      return;
     }
   }
   
-  return adc.readADC1();
+  // Re-derive the period when calibration or the interval changed
+  if (sample_timer.applied_ppm != advanced_timing.oscillator_calibration_ppm ||
+      sample_timer.applied_interval_us != advanced_timing.sample_interval_us) {
+    updateSampleTimerPeriod();
+  }
+  
+  // Hand PPS phase corrections from processPPS() to the period dither
+  if (advanced_timing.phase_alignment_active && advanced_timing.phase_adjust_samples_remaining > 0) {
+    // Arithmetic shift: the divider is a power of two
+    int64_t adjust_q32 = (advanced_timing.per_sample_phase_adjust_q32 * (int64_t)(SAMPLE_TIMER_CLOCK_HZ / 1000000UL)) >>
+                         sample_timer.prescaler_shift;
+    noInterrupts();
+    sample_timer.adjust_q32 = adjust_q32;
+    sample_timer.adjust_remaining = advanced_timing.phase_adjust_samples_remaining;
+    interrupts();
+    advanced_timing.phase_alignment_active = false;
+    advanced_timing.per_sample_phase_adjust_q32 = 0;
+    advanced_timing.phase_adjust_samples_remaining = 0;
+    advanced_timing.phase_error_us = 0.0;
+  }
+  
+  while (sample_timer.tick_tail != sample_timer.tick_head) {
+    uint32_t tick_raw = sample_timer.tick_micros[sample_timer.tick_tail];
+    uint32_t tick_slot = sample_timer.tick_slot[sample_timer.tick_tail];
+    sample_timer.tick_tail = (uint8_t)((sample_timer.tick_tail + 1) % SAMPLE_TICK_QUEUE_SIZE);
+    // Timer slots are grid slots: dropped ticks advance the grid like loop-scheduler skips
+    advanced_timing.grid_slot += (uint32_t)(tick_slot - (uint32_t)advanced_timing.grid_slot);
+    
+    // Widen the ISR's low-word stamp against a full read (it may predate a low-word wrap)
+    uint64_t now_virtual = getVirtualMicros();
+    uint64_t tick_virtual = now_virtual - (uint32_t)((uint32_t)now_virtual - tick_raw);
+    
+    if (advanced_timing.sample_index >= advanced_timing.reference_update_interval) {
+      updateTimingReference();
+      // Keep the phase-lock grid anchored on a real tick rather than the service time
+      advanced_timing.timing_base_micros = tick_virtual;
+      advanced_timing.timing_base_virtual_micros = tick_virtual;
+    }
+    PROFILE_BEGIN(PROFILE_TIMESTAMP);
+    uint64_t precise_timestamp = epoch_stamps.active ? stampEpochSlot(tick_virtual) : getPreciseTimestampAt(tick_virtual);
+    PROFILE_END(PROFILE_TIMESTAMP);
+    acquireSample(precise_timestamp);
+    
+    // Mirror the next tick into the scheduler slot, the grid the PPS lock and the flash window read
+    advanced_timing.next_sample_micros = tick_virtual + (advanced_timing.effective_interval_q32 >> 32);
+    advanced_timing.phase_acc_q32 = (uint32_t)advanced_timing.effective_interval_q32;
+  }
 }
 
 void sendSessionHeader() {
@@ -1853,87 +4461,207 @@ void sendSessionHeader() {
   
   // Generate new stream_id for this session
   session_tracker.stream_id = millis();
+  beginEpochStamps();
+  beginEventTrigger();
+  selectAcquisitionKernel();
+  verifyADCThroughput();  // Estimate for the new stream; the health beacon re-checks measured times
+  resetReliableWindow();
   
   // Send session header with metadata
-  Serial1.print("SESSION:");
-  Serial1.print(session_tracker.boot_id);
-  Serial1.print(",");
-  Serial1.print(session_tracker.stream_id);
-  Serial1.print(",");
-  Serial1.print(stream_rate);
-  Serial1.print(",");
-  Serial1.print(num_channels);
-  Serial1.print(",");
-  Serial1.print(current_adc_filter);
-  Serial1.print(",");
-  Serial1.print(current_adc_gain);
-  Serial1.print(",");
-  Serial1.print(current_dithering);
-  Serial1.print(",");
-  Serial1.print(getTimingSourceName(advanced_timing.current_source));
-  Serial1.print(",");
-  Serial1.print(advanced_timing.oscillator_calibration_ppm, 2);
-  Serial1.println();
+  SerialTx.print("SESSION:");
+  SerialTx.print(session_tracker.boot_id);
+  SerialTx.print(",");
+  SerialTx.print(session_tracker.stream_id);
+  SerialTx.print(",");
+  SerialTx.print(stream_rate);
+  SerialTx.print(",");
+  SerialTx.print(num_channels);
+  SerialTx.print(",");
+  SerialTx.print(current_adc_filter);
+  SerialTx.print(",");
+  SerialTx.print(current_adc_gain);
+  SerialTx.print(",");
+  SerialTx.print(current_dithering);
+  SerialTx.print(",");
+  SerialTx.print(getTimingSourceName(advanced_timing.current_source));
+  SerialTx.print(",");
+  SerialTx.print(advanced_timing.oscillator_calibration_ppm, 2);
+  SerialTx.println();
   
   session_tracker.session_header_sent = true;
 }
 
-void clampOscillatorCalibration() {
-  // Hard limits and sanity checks: clamp oscillator_calibration_ppm to ±500 ppm
-  // Most crystal oscillators are within ±100 ppm, but uncalibrated can be ±250-500 ppm
-  if (advanced_timing.oscillator_calibration_ppm > 500.0) {
-    Serial1.print("WARNING:Oscillator calibration clamped from ");
-    Serial1.print(advanced_timing.oscillator_calibration_ppm, 2);
-    Serial1.println(" ppm to 500 ppm");
-    advanced_timing.oscillator_calibration_ppm = 500.0;
-  } else if (advanced_timing.oscillator_calibration_ppm < -500.0) {
-    Serial1.print("WARNING:Oscillator calibration clamped from ");
-    Serial1.print(advanced_timing.oscillator_calibration_ppm, 2);
-    Serial1.println(" ppm to -500 ppm");
-    advanced_timing.oscillator_calibration_ppm = -500.0;
+void beginEpochStamps() {
+  // EPOCH mode applies to scheduler-paced batch streams at integer rates; high-rate streams are
+  // paced by the free-running ADC and keep their DRDY-anchored us timestamps
+  uint16_t slots = (uint16_t)stream_rate;
+  epoch_stamps.active = timestamp_mode == TIMESTAMP_EPOCH && !high_rate.enabled &&
+                        (output_format == OUTPUT_BATCH || output_format == OUTPUT_COMPRESSED) &&
+                        slots > 0 && (float)slots == stream_rate;
+  if (timestamp_mode == TIMESTAMP_EPOCH && !epoch_stamps.active) {
+    SerialTx.println("WARNING:EPOCH timestamps need BATCH/COMPRESSED output and an integer rate <= 1000 Hz - using MICROS");
+  }
+  epoch_stamps.started = false;
+  epoch_stamps.slots_per_epoch = slots;
+  epoch_stamps.pending_reason = CORRECTION_NONE;
+}
+
+uint64_t stampEpochSlot(uint64_t slot_virtual) {
+  // Returns the grid slot of the sample being taken. The calibrated time is only computed for a
+  // slot that opens a correction record (slot_virtual: its virtual us, 0 = now).
+  bool phase_adjusting = advanced_timing.phase_alignment_active || sample_timer.adjust_remaining > 0;
+  if (!epoch_stamps.started) {
+    epoch_stamps.started = true;
+    epoch_stamps.epoch0 = advanced_timing.epoch_started ? advanced_timing.epoch_start_second : advanced_timing.pps_count;
+    epoch_stamps.pending_reason = CORRECTION_STREAM_START;
+  } else if (advanced_timing.current_source != epoch_stamps.last_source) {
+    epoch_stamps.pending_reason = CORRECTION_SOURCE_CHANGE;
+  } else if (advanced_timing.calibration_source != epoch_stamps.last_calibration_source) {
+    epoch_stamps.pending_reason = CORRECTION_CALIBRATION_CHANGE;
+  } else if (epoch_stamps.last_phase_adjusting && !phase_adjusting) {
+    epoch_stamps.pending_reason = CORRECTION_PHASE_ALIGNED;
+  }
+  epoch_stamps.last_source = (uint8_t)advanced_timing.current_source;
+  epoch_stamps.last_calibration_source = (uint8_t)advanced_timing.calibration_source;
+  epoch_stamps.last_phase_adjusting = phase_adjusting;
+  
+  uint64_t slot = advanced_timing.grid_slot;
+  if (epoch_stamps.pending_reason != CORRECTION_NONE) {
+    uint64_t timestamp = slot_virtual != 0 ? getPreciseTimestampAt(slot_virtual) : getPreciseTimestamp();
+    sendCorrection(epoch_stamps.pending_reason, slot, timestamp);
+  }
+  return slot;
+}
+
+void sendCorrection(uint8_t reason, uint64_t slot, uint64_t timestamp) {
+  // CORRECTION record (layout in protocol_codec.h): the time of one slot, valid until the next record.
+  // A record that does not fit the TX ring stays pending and is retried on the next slot.
+  if (checkSerialBufferOverflow(FRAME_HEADER_SIZE + CORRECTION_PAYLOAD_SIZE)) return;
+  float calibration_ppb = advanced_timing.oscillator_calibration_ppm * 1000.0f;
+  writeCorrectionRecord(correction_frame_buffer + FRAME_HEADER_SIZE, reason, (uint8_t)advanced_timing.current_source,
+                        quantizeAccuracy(advanced_timing.timing_accuracy_us), epoch_stamps.epoch0,
+                        epoch_stamps.slots_per_epoch, slot, timestamp,
+                        (int32_t)(calibration_ppb + (calibration_ppb >= 0.0f ? 0.5f : -0.5f)));
+  uint16_t frame_length = finalizeFrame(correction_frame_buffer, CORRECTION_PAYLOAD_SIZE);
+  SerialTx.write(correction_frame_buffer, frame_length);
+  epoch_stamps.pending_reason = CORRECTION_NONE;
+  epoch_stamps.corrections_sent++;
+}
+
+void startStreamingAtPps() {
+  // processPPS() finished the START_STREAM_PPS countdown (or reached the START_STREAM_EPOCH edge)
+  // and aligned the scheduler to this edge
+  sequence = 0;
+  streaming = true;
+  sendSessionHeader();
+  SerialTx.print("OK:Streaming started at PPS with ");
+  SerialTx.print(stream_rate);
+  if (advanced_timing.epoch_started) {
+    SerialTx.print("Hz, epoch ");
+    SerialTx.println(advanced_timing.epoch_start_second);
+  } else {
+    SerialTx.println("Hz");
   }
 }
 
+void sendStatFrame(uint32_t pps_age_ms) {
+  // STAT record (layout in protocol_codec.h): keyframe every STAT_KEYFRAME_INTERVAL, else changed fields only
+  uint32_t values[STAT_FIELD_COUNT];
+  float calibration_ppb = advanced_timing.oscillator_calibration_ppm * 1000.0f;
+  values[STAT_SOURCE] = advanced_timing.current_source;
+  values[STAT_ACCURACY] = quantizeAccuracy(advanced_timing.timing_accuracy_us);
+  values[STAT_CALIBRATION_PPB] = (uint32_t)(int32_t)(calibration_ppb + (calibration_ppb >= 0.0f ? 0.5f : -0.5f));
+  values[STAT_FLAGS] = (advanced_timing.pps_valid ? 0x01 : 0) | (advanced_timing.calibration_valid ? 0x02 : 0) |
+                       ((uint32_t)advanced_timing.calibration_source << 2);
+  values[STAT_PPS_AGE_MS] = pps_age_ms;
+  values[STAT_MICROS_WRAPS] = advanced_timing.micros_wraparound_count;
+  values[STAT_BUFFER_OVERFLOWS] = serial_monitor.buffer_overflows;
+  values[STAT_SAMPLES_SKIPPED] = serial_monitor.samples_skipped_due_to_overflow;
+  values[STAT_BOOT_ID] = session_tracker.boot_id;
+  values[STAT_STREAM_ID] = session_tracker.stream_id;
+  values[STAT_DEADLINE_MISSES] = adc_monitor.deadline_misses;
+  values[STAT_SAMPLE_INDEX] = (uint32_t)advanced_timing.sample_index;
+  values[STAT_REFERENCE_UPDATES] = advanced_timing.reference_updates_count;
+  values[STAT_TX_RING_HWM] = SerialTx.highWaterMark();
+  values[STAT_CHECKSUM_ERRORS] = adc_monitor.checksum_errors;
+  values[STAT_ACQUISITION_US] = adc_monitor.sample_acquisition_us;
+  values[STAT_HIGH_RATE_OVERRUNS] = high_rate.overruns;
+  values[STAT_TIMER_OVERRUNS] = sample_timer.overruns;
+  values[STAT_EVENTS_SENT] = events_sent;
+#if PROFILE_HOT_PATH
+  values[STAT_PROFILE_LOOP_MAX_US] = hot_path_profile.max_cycles[PROFILE_LOOP] / (F_CPU / 1000000);
+  values[STAT_PROFILE_SAMPLE_MAX_US] = hot_path_profile.max_cycles[PROFILE_SAMPLE] / (F_CPU / 1000000);
+#else
+  values[STAT_PROFILE_LOOP_MAX_US] = 0;
+  values[STAT_PROFILE_SAMPLE_MAX_US] = 0;
+#endif
+
+  bool keyframe = stat_beacon.records_since_keyframe == 0;
+  uint8_t payload_len = encodeStatRecord(stat_frame_buffer + FRAME_HEADER_SIZE, stat_beacon.seq, values,
+                                         stat_beacon.last_values, keyframe);
+  // Dropped records are already counted as overflows; the next one starts from the same baseline
+  if (checkSerialBufferOverflow(FRAME_HEADER_SIZE + payload_len)) return;
+
+  stat_beacon.seq++;
+  uint16_t frame_length = finalizeFrame(stat_frame_buffer, payload_len);
+  SerialTx.write(stat_frame_buffer, frame_length);  // One ring write, drained by the DMAC
+
+  memcpy(stat_beacon.last_values, values, sizeof(values));
+  stat_beacon.records_since_keyframe = (stat_beacon.records_since_keyframe + 1) % STAT_KEYFRAME_INTERVAL;
+  stat_beacon.frames_sent++;
+}
+
 void sendHealthBeacon() {
   unsigned long current_time = millis();
   
-  // Check if it's time to send STAT line (1 Hz)
-  if (current_time - advanced_timing.last_stat_time >= advanced_timing.stat_interval_ms) {
+  // Check if it's time to send the beacon (SET_STAT_INTERVAL, 0 = off)
+  if (advanced_timing.stat_interval_ms != 0 &&
+      current_time - advanced_timing.last_stat_time >= advanced_timing.stat_interval_ms) {
     unsigned long pps_age_ms = current_time - advanced_timing.last_pps_time;
+    advanced_timing.last_stat_time = current_time;
+    if (streaming && !advanced_timing.waiting_for_sync_start) {
+      verifyADCThroughput();
+    }
     
-    Serial1.print("STAT:");
-    Serial1.print(getTimingSourceName(advanced_timing.current_source));
-    Serial1.print(",");
-    Serial1.print(advanced_timing.timing_accuracy_us, 1);
-    Serial1.print(",");
-    Serial1.print(advanced_timing.oscillator_calibration_ppm, 2);
-    Serial1.print(",");
-    Serial1.print(advanced_timing.pps_valid ? 1 : 0);
-    Serial1.print(",");
-    Serial1.print(pps_age_ms);
-    Serial1.print(",");
-    Serial1.print(advanced_timing.calibration_valid ? 1 : 0);
-    Serial1.print(",");
-    Serial1.print(getCalibrationSourceName(advanced_timing.calibration_source));
-    Serial1.print(",");
-    Serial1.print(advanced_timing.micros_wraparound_count);
-    Serial1.print(",");
-    Serial1.print(serial_monitor.buffer_overflows);
-    Serial1.print(",");
-    Serial1.print(serial_monitor.samples_skipped_due_to_overflow);
-    Serial1.print(",");
-    Serial1.print(session_tracker.boot_id);
-    Serial1.print(",");
-    Serial1.print(session_tracker.stream_id);
-    Serial1.print(",");
-    Serial1.print(adc_monitor.deadline_misses);
-    Serial1.print(",");
-    Serial1.print((unsigned long)advanced_timing.sample_index);
-    Serial1.print(",");
-    Serial1.print(advanced_timing.reference_updates_count);
-    Serial1.println();
+    if (output_format == OUTPUT_BINARY || output_format == OUTPUT_BATCH || output_format == OUTPUT_COMPRESSED) {
+      sendStatFrame(pps_age_ms);
+      return;
+    }
+    stat_beacon.records_since_keyframe = 0;  // Binary records resume with a keyframe
     
-    advanced_timing.last_stat_time = current_time;
+    SerialTx.print("STAT:");
+    SerialTx.print(getTimingSourceName(advanced_timing.current_source));
+    SerialTx.print(",");
+    SerialTx.print(advanced_timing.timing_accuracy_us, 1);
+    SerialTx.print(",");
+    SerialTx.print(advanced_timing.oscillator_calibration_ppm, 2);
+    SerialTx.print(",");
+    SerialTx.print(advanced_timing.pps_valid ? 1 : 0);
+    SerialTx.print(",");
+    SerialTx.print(pps_age_ms);
+    SerialTx.print(",");
+    SerialTx.print(advanced_timing.calibration_valid ? 1 : 0);
+    SerialTx.print(",");
+    SerialTx.print(getCalibrationSourceName(advanced_timing.calibration_source));
+    SerialTx.print(",");
+    SerialTx.print(advanced_timing.micros_wraparound_count);
+    SerialTx.print(",");
+    SerialTx.print(serial_monitor.buffer_overflows);
+    SerialTx.print(",");
+    SerialTx.print(serial_monitor.samples_skipped_due_to_overflow);
+    SerialTx.print(",");
+    SerialTx.print(session_tracker.boot_id);
+    SerialTx.print(",");
+    SerialTx.print(session_tracker.stream_id);
+    SerialTx.print(",");
+    SerialTx.print(adc_monitor.deadline_misses);
+    SerialTx.print(",");
+    SerialTx.print((unsigned long)advanced_timing.sample_index);
+    SerialTx.print(",");
+    SerialTx.print(advanced_timing.reference_updates_count);
+    SerialTx.print(",");
+    SerialTx.print(SerialTx.highWaterMark());
+    SerialTx.println();
   }
 }
 
@@ -1946,17 +4674,17 @@ bool isRateChangeAllowed(float new_rate) {
   
   if (pps_locked && rate_change_ppm > 50) {
     // Reject large rate changes while PPS-locked
-    Serial1.print("ERROR:Rate change too large while PPS locked (");
-    Serial1.print(rate_change_ppm, 1);
-    Serial1.println(" ppm > 50 ppm limit)");
+    SerialTx.print("ERROR:Rate change too large while PPS locked (");
+    SerialTx.print(rate_change_ppm, 1);
+    SerialTx.println(" ppm > 50 ppm limit)");
     return false;
   }
   
   // Allow small changes (e.g., 0.1%) for intentional experiments
   if (rate_change_ppm > 1000) {  // 0.1% = 1000 ppm
-    Serial1.print("WARNING:Large rate change detected (");
-    Serial1.print(rate_change_ppm, 1);
-    Serial1.println(" ppm)");
+    SerialTx.print("WARNING:Large rate change detected (");
+    SerialTx.print(rate_change_ppm, 1);
+    SerialTx.println(" ppm)");
   }
   
   return true;
@@ -1967,10 +4695,10 @@ void sendBootHeader() {
     return;  // Already sent
   }
   
-  Serial1.print("BOOT:device=XIAO-1234,boot_id=");
-  Serial1.print(session_tracker.boot_id);
-  Serial1.print(",fw=");
-  Serial1.println(FIRMWARE_VERSION);
+  SerialTx.print("BOOT:device=XIAO-1234,boot_id=");
+  SerialTx.print(session_tracker.boot_id);
+  SerialTx.print(",fw=");
+  SerialTx.println(FIRMWARE_VERSION);
   
   session_tracker.boot_header_sent = true;
 }
@@ -1980,49 +4708,689 @@ const char* getCalibrationSourceName(int source) {
     case AdvancedTiming::CAL_NONE: return "NONE";
     case AdvancedTiming::CAL_PPS_LIVE: return "PPS_LIVE";
     case AdvancedTiming::CAL_PI_PUSHED: return "PI_PUSHED";
+    case AdvancedTiming::CAL_FLASH: return "FLASH";
     default: return "UNKNOWN";
   }
 }
 
-float readInternalTemperature() {
-  // Read internal temperature sensor (if available on the MCU)
-  // This is a placeholder - actual implementation depends on MCU type
-  // For SAMD21/SAMD51, you might use ADC to read internal temperature sensor
+// ============================================================================
+// Temperature sensing and holdover compensation table
+// ============================================================================
+
+void setupTemperatureSensor() {
+  temp_sensor.available = false;
+  temp_sensor.converting = false;
+  temp_sensor.discard_next = true;
+  temp_sensor.last_start_ms = 0;
+  temp_sensor.reads = 0;
+  
+  // Factory temperature log: sensor ADC codes and 1 V reference error at room and hot
+  const volatile uint32_t* temp_log = (const volatile uint32_t*)NVMCTRL_TEMP_LOG;
+  uint32_t low = temp_log[0];
+  uint32_t high = temp_log[1];
+  temp_sensor.room_temp_c = (float)(low & 0xFF) + (float)((low >> 8) & 0xF) / 10.0f;
+  temp_sensor.hot_temp_c = (float)((low >> 12) & 0xFF) + (float)((low >> 20) & 0xF) / 10.0f;
+  temp_sensor.room_int1v = 1.0f - (float)(int8_t)(low >> 24) / 1000.0f;
+  temp_sensor.hot_int1v = 1.0f - (float)(int8_t)(high & 0xFF) / 1000.0f;
+  temp_sensor.room_adc = (float)((high >> 8) & 0xFFF);
+  temp_sensor.hot_adc = (float)((high >> 20) & 0xFFF);
+  if (temp_sensor.hot_temp_c <= temp_sensor.room_temp_c || temp_sensor.hot_adc <= temp_sensor.room_adc) {
+    // Blank log: datasheet typicals (0.667 V at 25 °C, 2.4 mV/°C)
+    temp_sensor.room_temp_c = 25.0f;
+    temp_sensor.hot_temp_c = 85.0f;
+    temp_sensor.room_int1v = 1.0f;
+    temp_sensor.hot_int1v = 1.0f;
+    temp_sensor.room_adc = 0.667f * 4095.0f;
+    temp_sensor.hot_adc = (0.667f + 60.0f * 0.0024f) * 4095.0f;
+  }
+  
+  // The ADC is otherwise unused (the ADS1263 does the acquisition). The core's init() already
+  // loaded its linearity/bias calibration; reconfigure it for the temperature channel only.
+  PM->APBCMASK.reg |= PM_APBCMASK_ADC;
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID_ADC | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_CLKEN;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  SYSCTRL->VREF.reg |= SYSCTRL_VREF_TSEN;
+  ADC->CTRLA.reg = 0;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->REFCTRL.reg = ADC_REFCTRL_REFSEL_INT1V;
+  ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM_16 | ADC_AVGCTRL_ADJRES(4);  // 12-bit mean of 16
+  ADC->SAMPCTRL.reg = ADC_SAMPCTRL_SAMPLEN(63);                          // High-impedance source
+  ADC->CTRLB.reg = ADC_CTRLB_PRESCALER_DIV512 | ADC_CTRLB_RESSEL_16BIT;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->INPUTCTRL.reg = ADC_INPUTCTRL_MUXPOS_TEMP | ADC_INPUTCTRL_MUXNEG_GND | ADC_INPUTCTRL_GAIN_1X;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+  ADC->CTRLA.reg = ADC_CTRLA_ENABLE;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  temp_sensor.available = true;
+}
+
+static float convertTemperature(uint16_t adc_code) {
+  // Two-point calibration, refined once for the 1 V reference error at the coarse temperature
+  float span_c = temp_sensor.hot_temp_c - temp_sensor.room_temp_c;
+  float room_v = temp_sensor.room_adc * temp_sensor.room_int1v / 4095.0f;
+  float hot_v = temp_sensor.hot_adc * temp_sensor.hot_int1v / 4095.0f;
+  float coarse_c = temp_sensor.room_temp_c + span_c * ((float)adc_code / 4095.0f - room_v) / (hot_v - room_v);
+  float int1v = temp_sensor.room_int1v +
+                (temp_sensor.hot_int1v - temp_sensor.room_int1v) * (coarse_c - temp_sensor.room_temp_c) / span_c;
+  return temp_sensor.room_temp_c + span_c * ((float)adc_code * int1v / 4095.0f - room_v) / (hot_v - room_v);
+}
+
+void serviceTemperatureSensor() {
+  // One conversion per TEMP_READ_INTERVAL_MS; the conversion (~7 ms) runs while loop() goes on
+  if (!temp_sensor.available) {
+    return;
+  }
+  if (!temp_sensor.converting) {
+    if (millis() - temp_sensor.last_start_ms < TEMP_READ_INTERVAL_MS || ADC->STATUS.bit.SYNCBUSY) {
+      return;
+    }
+    temp_sensor.last_start_ms = millis();
+    ADC->SWTRIG.reg = ADC_SWTRIG_START;
+    temp_sensor.converting = true;
+    return;
+  }
+  if (!(ADC->INTFLAG.reg & ADC_INTFLAG_RESRDY)) {
+    return;
+  }
+  uint16_t adc_code = (uint16_t)ADC->RESULT.reg;  // Clears RESRDY
+  temp_sensor.converting = false;
+  if (temp_sensor.discard_next) {
+    temp_sensor.discard_next = false;
+    return;
+  }
   
-  // Placeholder: return a reasonable temperature
-  // In a real implementation, you would:
-  // 1. Enable internal temperature sensor
-  // 2. Read ADC value
-  // 3. Convert to temperature using MCU-specific formula
+  float temp_c = convertTemperature(adc_code);
+  if (temp_sensor.reads == 0) {
+    advanced_timing.current_temp_c = temp_c;
+  } else {
+    advanced_timing.current_temp_c += TEMP_FILTER_ALPHA * (temp_c - advanced_timing.current_temp_c);
+  }
+  temp_sensor.reads++;
+  updateTemperatureCompensation();
+}
+
+void resetTempCompTable() {
+  memset(&temp_comp, 0, sizeof(temp_comp));
+}
+
+static float tempCompBinCentre(int bin) {
+  return TEMP_COMP_MIN_C + ((float)bin + 0.5f) * TEMP_COMP_BIN_C;
+}
+
+static void rebuildTempCompCurve() {
+  // Weighted least-squares slope over the qualified bins, then the curve through their means
+  float sw = 0, st = 0, sp = 0, stt = 0, stp = 0;
+  uint8_t qualified = 0;
+  for (int i = 0; i < TEMP_COMP_BINS; i++) {
+    if (temp_comp.samples[i] < TEMP_COMP_MIN_SAMPLES) continue;
+    float w = (float)temp_comp.samples[i];
+    float t = tempCompBinCentre(i);
+    sw += w;
+    st += w * t;
+    sp += w * temp_comp.ppm[i];
+    stt += w * t * t;
+    stp += w * t * temp_comp.ppm[i];
+    qualified++;
+  }
+  temp_comp.qualified = qualified;
+  if (qualified < 2) {
+    return;
+  }
+  float denom = sw * stt - st * st;
+  if (denom > 0) {
+    advanced_timing.temp_coefficient_ppm_per_c = (sw * stp - st * sp) / denom;
+    advanced_timing.temp_compensation_enabled = true;
+  }
   
-  return 25.0;  // Placeholder temperature
+  // Gaps between qualified bins are interpolated; beyond the ends the curve follows the slope
+  float slope_per_bin = advanced_timing.temp_coefficient_ppm_per_c * TEMP_COMP_BIN_C;
+  int prev = -1;
+  for (int i = 0; i < TEMP_COMP_BINS; i++) {
+    if (temp_comp.samples[i] < TEMP_COMP_MIN_SAMPLES) continue;
+    temp_comp.curve[i] = temp_comp.ppm[i];
+    for (int j = prev + 1; j < i; j++) {
+      temp_comp.curve[j] = prev < 0
+        ? temp_comp.ppm[i] + slope_per_bin * (float)(j - i)
+        : temp_comp.ppm[prev] + (temp_comp.ppm[i] - temp_comp.ppm[prev]) * (float)(j - prev) / (float)(i - prev);
+    }
+    prev = i;
+  }
+  for (int j = prev + 1; j < TEMP_COMP_BINS; j++) {
+    temp_comp.curve[j] = temp_comp.ppm[prev] + slope_per_bin * (float)(j - prev);
+  }
+}
+
+static float tempCompCurve(float temp_c) {
+  // Linear between bin centres, on the slope outside the table
+  float pos = (temp_c - TEMP_COMP_MIN_C) / TEMP_COMP_BIN_C - 0.5f;
+  float slope_per_bin = advanced_timing.temp_coefficient_ppm_per_c * TEMP_COMP_BIN_C;
+  if (pos <= 0.0f) {
+    return temp_comp.curve[0] + slope_per_bin * pos;
+  }
+  if (pos >= (float)(TEMP_COMP_BINS - 1)) {
+    return temp_comp.curve[TEMP_COMP_BINS - 1] + slope_per_bin * (pos - (float)(TEMP_COMP_BINS - 1));
+  }
+  int bin = (int)pos;
+  float fraction = pos - (float)bin;
+  return temp_comp.curve[bin] + fraction * (temp_comp.curve[bin + 1] - temp_comp.curve[bin]);
+}
+
+static bool tempCompCorrection(float from_c, float to_c, float& correction_ppm) {
+  // The learned table when it spans two bins, else the linear coefficient (flash or earlier fit)
+  if (temp_comp.qualified >= 2) {
+    correction_ppm = tempCompCurve(to_c) - tempCompCurve(from_c);
+    return true;
+  }
+  if (advanced_timing.temp_compensation_enabled) {
+    correction_ppm = advanced_timing.temp_coefficient_ppm_per_c * (to_c - from_c);
+    return true;
+  }
+  return false;
 }
 
 void updateTemperatureCompensation() {
-  // Update temperature compensation for holdover mode
-  if (!advanced_timing.temp_compensation_enabled) {
+  // Called once per temperature read, never from the per-loop path
+  float temp_c = advanced_timing.current_temp_c;
+  
+  if (advanced_timing.current_source == AdvancedTiming::TIMING_PPS_ACTIVE) {
+    temp_comp.holdover_active = false;
+    if (pps_filter.state != PPS_FILTER_LOCKED ||
+        advanced_timing.calibration_source != AdvancedTiming::CAL_PPS_LIVE) {
+      return;
+    }
+    int bin = (int)floorf((temp_c - TEMP_COMP_MIN_C) / TEMP_COMP_BIN_C);
+    if (bin < 0 || bin >= TEMP_COMP_BINS) {
+      return;
+    }
+    if (temp_comp.samples[bin] < TEMP_COMP_MAX_WEIGHT) {
+      temp_comp.samples[bin]++;
+    }
+    temp_comp.ppm[bin] += (advanced_timing.oscillator_calibration_ppm - temp_comp.ppm[bin]) / (float)temp_comp.samples[bin];
+    temp_comp.learned++;
+    advanced_timing.reference_temp_c = temp_c;  // The live calibration is valid at this temperature
+    if (temp_comp.samples[bin] >= TEMP_COMP_MIN_SAMPLES) {
+      rebuildTempCompCurve();
+    }
+    return;
+  }
+  
+  // Holdover (PPS_HOLDOVER or INTERNAL_CAL): correct relative to the rate at the transition
+  if (advanced_timing.current_source == AdvancedTiming::TIMING_INTERNAL_RAW) {
+    return;
+  }
+  bool retuned_elsewhere = temp_comp.holdover_active &&
+    advanced_timing.oscillator_calibration_ppm != temp_comp.holdover_base_ppm + temp_comp.applied_correction_ppm;
+  if (!temp_comp.holdover_active || retuned_elsewhere) {
+    // SET_CAL_PPM during holdover, or entry: a restored or learned value carries its temperature
+    bool reference_known = !retuned_elsewhere && (temp_comp.learned > 0 || cal_store.restored);
+    temp_comp.holdover_base_ppm = advanced_timing.oscillator_calibration_ppm;
+    temp_comp.holdover_base_temp_c = reference_known ? advanced_timing.reference_temp_c : temp_c;
+    temp_comp.applied_correction_ppm = 0.0f;
+    temp_comp.holdover_active = true;
+  }
+  
+  float correction_ppm;
+  if (!tempCompCorrection(temp_comp.holdover_base_temp_c, temp_c, correction_ppm) ||
+      fabs(correction_ppm - temp_comp.applied_correction_ppm) < TEMP_COMP_MIN_STEP_PPM) {
     return;
   }
+  retuneOscillatorCalibration(temp_comp.holdover_base_ppm + correction_ppm);
+  // Record what was actually applied (after clamping), so the next pass sees no outside change
+  temp_comp.applied_correction_ppm = advanced_timing.oscillator_calibration_ppm - temp_comp.holdover_base_ppm;
+  LOG_DEBUG("Temperature compensation: ", LogFloat(temp_c, 1), "°C, correction ", LogFloat(temp_comp.applied_correction_ppm, 3), " ppm");
+}
+// ============================================================================
+// Calibration persistence (flash log of CalFlashRecord pages)
+// ============================================================================
+
+static void readCalFlashPage(uint8_t page, CalFlashRecord& record) {
+  // Volatile reads: the area is const in the image but rewritten at run time
+  const volatile uint32_t* src = (const volatile uint32_t*)(cal_flash_area + page * CAL_FLASH_PAGE_BYTES);
+  uint32_t* dst = (uint32_t*)&record;
+  for (uint8_t i = 0; i < CAL_FLASH_PAGE_BYTES / 4; i++) {
+    dst[i] = src[i];
+  }
+}
+
+static bool calFlashRecordValid(const CalFlashRecord& record) {
+  return record.magic == CAL_FLASH_MAGIC &&
+         record.crc == crc16Ccitt((const uint8_t*)&record, sizeof(record) - sizeof(record.crc)) &&
+         fabs(record.ppm) <= 500.0f;  // Also rejects NaN
+}
+
+static bool calFlashPagesBlank(uint8_t first_page, uint8_t end_page) {
+  const volatile uint32_t* words = (const volatile uint32_t*)(cal_flash_area + first_page * CAL_FLASH_PAGE_BYTES);
+  uint16_t count = (uint16_t)(end_page - first_page) * (CAL_FLASH_PAGE_BYTES / 4);
+  for (uint16_t i = 0; i < count; i++) {
+    if (words[i] != 0xFFFFFFFF) return false;
+  }
+  return true;
+}
+
+static void nvmWaitReady() {
+  while (!NVMCTRL->INTFLAG.bit.READY);
+}
+
+static void nvmEraseRow(uint8_t row) {
+  nvmWaitReady();
+  NVMCTRL->ADDR.reg = (uint32_t)(cal_flash_area + row * CAL_FLASH_ROW_BYTES) / 2;  // ADDR counts 16-bit words
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_ER;
+  nvmWaitReady();
+}
+
+static void nvmWritePage(uint8_t page, const CalFlashRecord& record) {
+  volatile uint32_t* dst = (volatile uint32_t*)(cal_flash_area + page * CAL_FLASH_PAGE_BYTES);
+  const uint32_t* src = (const uint32_t*)&record;
+  NVMCTRL->CTRLB.reg |= NVMCTRL_CTRLB_MANW;  // Commit on the WP command, not on the last buffer write
+  nvmWaitReady();
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_PBC;
+  nvmWaitReady();
+  for (uint8_t i = 0; i < CAL_FLASH_PAGE_BYTES / 4; i++) {
+    dst[i] = src[i];  // Page buffer; the address of these writes selects the page
+  }
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_WP;
+  nvmWaitReady();
+}
+
+bool restoreFlashCalibration() {
+  cal_store.newest_page = -1;
+  cal_store.restored = false;
+  cal_store.save_requested = false;
+  cal_store.write_pending = false;
+  cal_store.erase_pending = false;
+  cal_store.target_page = 0;
+  cal_store.last_save_ms = millis();
+  cal_store.saves = 0;
+  cal_store.erases = 0;
+  cal_store.verify_failures = 0;
   
-  float new_temp = readInternalTemperature();
-  float temp_change = new_temp - advanced_timing.reference_temp_c;
+  CalFlashRecord record;
+  for (uint8_t page = 0; page < CAL_FLASH_PAGES; page++) {
+    readCalFlashPage(page, record);
+    if (calFlashRecordValid(record) &&
+        (cal_store.newest_page < 0 || record.sequence > cal_store.newest.sequence)) {
+      cal_store.newest = record;
+      cal_store.newest_page = page;
+    }
+  }
+  if (cal_store.newest_page < 0) {
+    return false;
+  }
   
-  // Apply temperature compensation to oscillator calibration
-  float temp_correction = temp_change * advanced_timing.temp_coefficient_ppm_per_c;
+  advanced_timing.oscillator_calibration_ppm = cal_store.newest.ppm;
+  advanced_timing.calibration_valid = true;
+  advanced_timing.calibration_source = AdvancedTiming::CAL_FLASH;
+  advanced_timing.cal_applied_at_ms = millis();
+  advanced_timing.temp_coefficient_ppm_per_c = cal_store.newest.temp_coefficient_ppm_per_c;
+  advanced_timing.reference_temp_c = cal_store.newest.reference_temp_c;
+  advanced_timing.temp_compensation_enabled = (cal_store.newest.flags & CAL_FLASH_FLAG_TEMP_COMP) != 0;
+  advanced_timing.current_source = AdvancedTiming::TIMING_INTERNAL_CAL;
+  advanced_timing.timing_accuracy_us = 10.0;
+  cal_store.restored = true;
+  return true;
+}
+
+static bool calibrationSaveDue() {
+  if (!advanced_timing.calibration_valid) return false;
+  if (cal_store.save_requested) return true;
+  if (millis() - cal_store.last_save_ms < CAL_FLASH_MIN_INTERVAL_S * 1000UL) return false;
   
-  // Only apply if we're in CAL mode (holdover without PPS)
-  if (advanced_timing.current_source == AdvancedTiming::TIMING_INTERNAL_CAL) {
-    advanced_timing.oscillator_calibration_ppm += temp_correction;
-    
-    // Clamp the result
-    clampOscillatorCalibration();
-    
-    Serial1.print("DEBUG:Temperature compensation applied: ");
-    Serial1.print(temp_change, 1);
-    Serial1.print("°C, correction: ");
-    Serial1.print(temp_correction, 2);
-    Serial1.println(" ppm");
+  // Only values worth a warm start: a settled PPS estimate or the Pi's stored one
+  if (advanced_timing.calibration_source == AdvancedTiming::CAL_PPS_LIVE) {
+    if (!advanced_timing.pps_valid || advanced_timing.pps_count < CAL_FLASH_MIN_PPS) return false;
+  } else if (advanced_timing.calibration_source != AdvancedTiming::CAL_PI_PUSHED) {
+    return false;
+  }
+  if (cal_store.newest_page < 0) return true;
+  
+  uint8_t flags = advanced_timing.temp_compensation_enabled ? CAL_FLASH_FLAG_TEMP_COMP : 0;
+  return fabs(advanced_timing.oscillator_calibration_ppm - cal_store.newest.ppm) >= CAL_FLASH_MIN_CHANGE_PPM ||
+         fabs(advanced_timing.temp_coefficient_ppm_per_c - cal_store.newest.temp_coefficient_ppm_per_c) > 0.001f ||
+         flags != cal_store.newest.flags;
+}
+
+static bool calibrationFlashWindowOpen(uint32_t stall_us) {
+  // Interrupt handlers cannot fetch code during the stall: keep it clear of the next sample
+  // and, when PPS is stamped in its ISR rather than captured, of the next PPS edge
+  if (advanced_timing.pps_valid && !advanced_timing.pps_capture_hw &&
+      millis() - advanced_timing.last_pps_time > 800) {
+    return false;
+  }
+  if (advanced_timing.waiting_for_sync_start) return false;
+  if (!streaming) return true;
+  if (high_rate.enabled) return false;
+  return (long long)advanced_timing.next_sample_micros - (long long)getVirtualMicros() > (long long)stall_us;
+}
+
+void serviceCalibrationStore() {
+  if (!cal_store.write_pending) {
+    if (!calibrationSaveDue()) return;
+    // Next page of the log; erase its row unless the rest of the row is still blank
+    uint8_t page = cal_store.newest_page < 0 ? 0 : (uint8_t)((cal_store.newest_page + 1) % CAL_FLASH_PAGES);
+    uint8_t row_end = (uint8_t)((page / CAL_FLASH_PAGES_PER_ROW + 1) * CAL_FLASH_PAGES_PER_ROW);
+    cal_store.target_page = page;
+    cal_store.erase_pending = !calFlashPagesBlank(page, row_end);
+    cal_store.write_pending = true;
+  }
+  
+  if (cal_store.erase_pending) {
+    if (!calibrationFlashWindowOpen(CAL_FLASH_ERASE_US)) return;
+    nvmEraseRow(cal_store.target_page / CAL_FLASH_PAGES_PER_ROW);
+    cal_store.erases++;
+    cal_store.erase_pending = false;
+    return;  // The write gets its own window
+  }
+  
+  if (!advanced_timing.calibration_valid) {
+    cal_store.write_pending = false;  // CLEAR_CAL while waiting
+    cal_store.save_requested = false;
+    return;
+  }
+  if (!calibrationFlashWindowOpen(CAL_FLASH_WRITE_US)) return;
+  
+  // Values are taken now, not when the save became due
+  CalFlashRecord record;
+  memset(&record, 0xFF, sizeof(record));
+  record.magic = CAL_FLASH_MAGIC;
+  record.sequence = cal_store.newest_page < 0 ? 1 : cal_store.newest.sequence + 1;
+  record.ppm = advanced_timing.oscillator_calibration_ppm;
+  record.temp_coefficient_ppm_per_c = advanced_timing.temp_coefficient_ppm_per_c;
+  record.reference_temp_c = advanced_timing.reference_temp_c;
+  record.source = (uint8_t)advanced_timing.calibration_source;
+  if (advanced_timing.calibration_source == AdvancedTiming::CAL_PPS_LIVE) {
+    record.confidence_pps = advanced_timing.pps_count;
+  } else if (advanced_timing.calibration_source == AdvancedTiming::CAL_FLASH) {
+    record.confidence_pps = cal_store.newest.confidence_pps;
+    record.source = cal_store.newest.source;
+  } else {
+    record.confidence_pps = 0;
   }
+  record.flags = advanced_timing.temp_compensation_enabled ? CAL_FLASH_FLAG_TEMP_COMP : 0;
+  record.crc = crc16Ccitt((const uint8_t*)&record, sizeof(record) - sizeof(record.crc));
   
-  advanced_timing.current_temp_c = new_temp;
-}
\ No newline at end of file
+  nvmWritePage(cal_store.target_page, record);
+  cal_store.write_pending = false;
+  cal_store.save_requested = false;
+  cal_store.last_save_ms = millis();
+  
+  CalFlashRecord written;
+  readCalFlashPage(cal_store.target_page, written);
+  if (memcmp(&written, &record, sizeof(record)) != 0) {
+    // Keep the previous record; the next save erases this page's row first
+    cal_store.verify_failures++;
+    SerialTx.print("WARNING:Calibration flash write failed verify at page ");
+    SerialTx.println(cal_store.target_page);
+    return;
+  }
+  cal_store.newest = record;
+  cal_store.newest_page = cal_store.target_page;
+  cal_store.saves++;
+  LOG_DEBUG("Calibration saved to flash: ", LogFloat(record.ppm, 3), " ppm, page ", cal_store.target_page);
+}
+
+void eraseCalibrationFlash() {
+  for (uint8_t row = 0; row < CAL_FLASH_ROWS; row++) {
+    nvmEraseRow(row);
+  }
+  cal_store.erases += CAL_FLASH_ROWS;
+  cal_store.newest_page = -1;
+  cal_store.write_pending = false;
+  cal_store.erase_pending = false;
+  cal_store.save_requested = false;
+}
+
+static uint8_t selfTestFormatIndex(uint8_t format) {
+  switch (format) {
+    case OUTPUT_BINARY: return 1;
+    case OUTPUT_BATCH:
+    case OUTPUT_COMPRESSED: return 2;  // Packed frames are never larger than the plain batch
+    default: return 0;                 // COMPACT lines are shorter than FULL
+  }
+}
+
+bool checkSelfTestLimits(float rate) {
+  // Rejects a start the last sweep measured to overrun. The cell used is the nearest tested one
+  // at or above the configuration; settings the sweep did not cover pass unchecked.
+  SelfTest& st = selftest;
+  if (!st.valid || st.adc_rate != current_adc_rate || st.adc_filter != current_adc_filter ||
+      st.acquisition != acquisition_mode || st.scheduler != scheduler_mode || st.usb != transport_usb) {
+    return true;
+  }
+  uint8_t reads = getReadsPerChannel();
+  uint8_t c = 0;
+  while (c < SELFTEST_CHANNEL_COUNT && SELFTEST_CHANNELS[c] < num_channels) c++;
+  uint8_t r = 0;
+  while (r < SELFTEST_READS_COUNT && SELFTEST_READS[r].reads < reads) r++;
+  if (c == SELFTEST_CHANNEL_COUNT || r == SELFTEST_READS_COUNT) {
+    return true;
+  }
+  const SelfTestCell& limit = st.limits[(c * SELFTEST_READS_COUNT + r) * SELFTEST_FORMAT_COUNT +
+                                        selfTestFormatIndex(output_format)];
+  if (limit.fail_hz != 0 && rate >= limit.fail_hz) {
+    SerialTx.print("ERROR:Rate exceeds SELFTEST limit - overran at ");
+    SerialTx.print(limit.fail_hz);
+    SerialTx.print(" Hz, sustained ");
+    SerialTx.print(limit.pass_hz);
+    SerialTx.println(" Hz for this configuration");
+    return false;
+  }
+  if (rate > limit.pass_hz) {
+    SerialTx.print("WARNING:Rate above the highest SELFTEST pass (");
+    SerialTx.print(limit.pass_hz);
+    SerialTx.println(" Hz) for this configuration");
+  }
+  return true;
+}
+
+static void startSelfTestStep() {
+  SelfTest& st = selftest;
+  uint8_t c = st.cell / (SELFTEST_READS_COUNT * SELFTEST_FORMAT_COUNT);
+  uint8_t r = (st.cell / SELFTEST_FORMAT_COUNT) % SELFTEST_READS_COUNT;
+  uint8_t f = st.cell % SELFTEST_FORMAT_COUNT;
+  uint16_t rate = SELFTEST_RATES_HZ[st.rate_index];
+  
+  num_channels = SELFTEST_CHANNELS[c];
+  current_dithering = SELFTEST_READS[r].dithering;
+  decimation_ratio = SELFTEST_READS[r].decimation;
+  resetDecimation();
+  output_format = SELFTEST_FORMATS[f];
+  stream_rate = rate;
+  advanced_timing.sample_interval_us = 1000000UL / rate;
+  high_rate.enabled = false;
+  
+  sequence = 0;
+  establishSamplingTiming();
+  streaming = true;
+  sendSessionHeader();
+  
+  st.phase = SELFTEST_RUNNING;
+  st.measuring = false;
+  st.step_start_ms = millis();
+}
+
+static void beginSelfTestMeasurement() {
+  SelfTest& st = selftest;
+  st.have_instant = false;
+  st.jitter_max_us = 0;
+  st.jitter_total_us = 0;
+  st.jitter_count = 0;
+  st.drdy_max_us = 0;
+  st.drdy_total_us = 0;
+  st.drdy_count = 0;
+  st.start_slot = advanced_timing.grid_slot;
+  st.start_emitted = advanced_timing.samples_generated;
+  st.start_skipped = serial_monitor.samples_skipped_due_to_overflow;
+  st.start_misses = adc_monitor.deadline_misses;
+  SerialTx.resetHighWaterMark();
+  st.measuring = true;
+}
+
+static uint32_t selfTestDrops() {
+  // Grid slots without an emitted sample (one may still be in flight on the DMA engines),
+  // plus samples the output path skipped for a full TX ring
+  uint32_t slots = (uint32_t)(advanced_timing.grid_slot - selftest.start_slot);
+  uint32_t emitted = advanced_timing.samples_generated - selftest.start_emitted;
+  uint32_t lost = slots > emitted + 1 ? slots - emitted - 1 : 0;
+  return lost + (serial_monitor.samples_skipped_due_to_overflow - selftest.start_skipped);
+}
+
+void recordSelfTestInstant() {
+  // Period jitter at the start of each sample's reads; a skipped slot is a drop, not jitter
+  uint64_t now = getVirtualMicros();
+  if (selftest.have_instant) {
+    uint32_t interval = (uint32_t)(advanced_timing.effective_interval_q32 >> 32);
+    uint32_t period = (uint32_t)(now - selftest.last_instant_us);
+    uint32_t slots = interval > 0 ? (period + interval / 2) / interval : 1;
+    if (slots == 0) slots = 1;
+    int32_t error = (int32_t)(period - slots * interval);
+    uint32_t magnitude = (uint32_t)(error < 0 ? -error : error);
+    if (magnitude > selftest.jitter_max_us) {
+      selftest.jitter_max_us = magnitude;
+    }
+    selftest.jitter_total_us += magnitude;
+    selftest.jitter_count++;
+  }
+  selftest.last_instant_us = now;
+  selftest.have_instant = true;
+}
+
+static void endSelfTestStep() {
+  SelfTest& st = selftest;
+  uint32_t drops = selfTestDrops();
+  uint32_t misses = adc_monitor.deadline_misses - st.start_misses;
+  uint32_t samples = advanced_timing.samples_generated - st.start_emitted;
+  uint16_t tx_peak = SerialTx.highWaterMark();
+  uint32_t interval_us = (uint32_t)advanced_timing.sample_interval_us;
+  st.measuring = false;
+  stopStreaming();
+  
+  // Sustained: every slot sampled and sent, no DRDY timeout, the grid held to half an interval
+  // and the ring never reached the reserve kept for responses
+  bool passed = samples > 0 && drops == 0 && misses == 0 && st.jitter_max_us < interval_us / 2 &&
+                tx_peak < TX_RING_SIZE - TX_RING_RESERVE;
+  uint16_t rate = SELFTEST_RATES_HZ[st.rate_index];
+  SelfTestCell& limit = st.limits[st.cell];
+  if (passed) {
+    limit.pass_hz = rate;
+  } else {
+    limit.fail_hz = rate;
+  }
+  st.steps++;
+  
+  SerialTx.print("SELFTEST:");
+  SerialTx.print(num_channels);
+  SerialTx.print(",");
+  SerialTx.print(getReadsPerChannel());
+  SerialTx.print(",");
+  SerialTx.print(output_format == OUTPUT_BINARY ? "BINARY" : output_format == OUTPUT_BATCH ? "BATCH" : "FULL");
+  SerialTx.print(",");
+  SerialTx.print(rate);
+  SerialTx.print(",");
+  SerialTx.print(samples);
+  SerialTx.print(",");
+  SerialTx.print(st.jitter_max_us);
+  SerialTx.print(",");
+  SerialTx.print(st.jitter_count > 0 ? (uint32_t)(st.jitter_total_us / st.jitter_count) : 0);
+  SerialTx.print(",");
+  SerialTx.print(st.drdy_max_us);
+  SerialTx.print(",");
+  SerialTx.print(st.drdy_count > 0 ? (uint32_t)(st.drdy_total_us / st.drdy_count) : 0);
+  SerialTx.print(",");
+  SerialTx.print(tx_peak);
+  SerialTx.print(",");
+  SerialTx.print(drops + misses);
+  SerialTx.println(passed ? ",PASS" : ",FAIL");
+  
+  // A failed rate ends its cell: the higher rates would only overrun further
+  if (passed && st.rate_index + 1 < SELFTEST_RATE_COUNT) {
+    st.rate_index++;
+  } else {
+    st.cell++;
+    st.rate_index = 0;
+  }
+  st.phase = SELFTEST_DRAINING;
+  st.step_start_ms = millis();
+}
+
+void beginSelfTest(uint16_t step_ms) {
+  SelfTest& st = selftest;
+  st.saved_rate = stream_rate;
+  st.saved_interval_us = advanced_timing.sample_interval_us;
+  st.saved_channels = num_channels;
+  st.saved_dithering = current_dithering;
+  st.saved_decimation = decimation_ratio;
+  st.saved_format = output_format;
+  st.saved_trigger = event_trigger.configured;
+  event_trigger.configured = false;  // Decimated trigger output would hide the real TX load
+  flushSampleBatch();
+  
+  memset(st.limits, 0, sizeof(st.limits));
+  st.valid = false;
+  st.step_ms = step_ms;
+  st.cell = 0;
+  st.rate_index = 0;
+  st.steps = 0;
+  st.adc_rate = current_adc_rate;
+  st.adc_filter = current_adc_filter;
+  st.acquisition = acquisition_mode;
+  st.scheduler = scheduler_mode;
+  st.usb = transport_usb;
+  st.phase = SELFTEST_DRAINING;  // First step starts once the responses above are out
+  st.step_start_ms = millis();
+}
+
+void finishSelfTest(bool completed) {
+  SelfTest& st = selftest;
+  if (streaming) {
+    st.measuring = false;
+    stopStreaming();
+  }
+  num_channels = st.saved_channels;
+  current_dithering = st.saved_dithering;
+  decimation_ratio = st.saved_decimation;
+  resetDecimation();
+  output_format = st.saved_format;
+  stream_rate = st.saved_rate;
+  advanced_timing.sample_interval_us = st.saved_interval_us;
+  event_trigger.configured = st.saved_trigger;
+  st.valid = completed;
+  st.phase = SELFTEST_IDLE;
+}
+
+void serviceSelfTest() {
+  SelfTest& st = selftest;
+  if (st.phase == SELFTEST_IDLE) {
+    return;
+  }
+  uint32_t elapsed_ms = millis() - st.step_start_ms;
+  
+  if (st.phase == SELFTEST_DRAINING) {
+    // Each step starts from an empty ring, so its peak and drops are its own
+    if (SerialTx.used() > 0 && elapsed_ms < SELFTEST_DRAIN_TIMEOUT_MS) {
+      return;
+    }
+    if (st.cell < SELFTEST_CELLS) {
+      startSelfTestStep();
+      return;
+    }
+    finishSelfTest(true);
+    SerialTx.print("OK:SELFTEST complete, ");
+    SerialTx.print(st.steps);
+    SerialTx.println(" steps");
+    cmdGetSelfTest(nullptr);
+    return;
+  }
+  
+  if (!st.measuring) {
+    if (elapsed_ms >= SELFTEST_SETTLE_MS) {
+      beginSelfTestMeasurement();
+    }
+    return;
+  }
+  // An overrun settles the step early; the rest of the interval would add nothing
+  bool overran = selfTestDrops() > 0 || adc_monitor.deadline_misses != st.start_misses;
+  if (overran || elapsed_ms >= SELFTEST_SETTLE_MS + st.step_ms) {
+    endSelfTestStep();
+  }
+}
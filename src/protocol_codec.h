@@ -0,0 +1,520 @@
+// Wire protocol codec: the frame envelope and every binary record the firmware sends (SAMPLE,
+// BATCH, COMPRESSED, EVENT, STAT, CORRECTION). Header-only and free of hardware access, so the
+// firmware encodes with it and the native host decoder (native/frame_decoder.cpp) decodes with
+// it - the layouts below are the one definition of the format. host_timing_acquisition.py keeps
+// a pure-Python decoder for hosts without the native library; it must follow this file.
+//
+// All multi-byte fields are little-endian. Encoders write a payload at frame + FRAME_HEADER_SIZE
+// and finalizeFrame() adds the envelope in front of it.
+#ifndef PROTOCOL_CODEC_H
+#define PROTOCOL_CODEC_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Envelope: sync(4) = AA 55 CC 33, length(2), crc16(2, CRC-16/XMODEM over the payload), payload
+const uint8_t FRAME_SYNC[4] = {0xAA, 0x55, 0xCC, 0x33};
+const uint8_t FRAME_HEADER_SIZE = 8;
+
+// Record types (first payload byte)
+const uint8_t FRAME_TYPE_SAMPLE = 0x01;
+const uint8_t FRAME_TYPE_BATCH = 0x02;
+const uint8_t FRAME_TYPE_COMPRESSED = 0x03;
+const uint8_t FRAME_TYPE_EVENT = 0x10;       // Timing events that survive LOG_LEVEL_OFF builds
+const uint8_t FRAME_TYPE_STAT = 0x11;        // Binary health beacon (replaces the STAT line in binary formats)
+const uint8_t FRAME_TYPE_CORRECTION = 0x12;  // Slot -> time mapping for EPOCH timestamps
+
+const uint8_t PROTOCOL_MAX_CHANNELS = 15;    // Channel count travels in a nibble
+
+static inline void putU16LE(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void putU32LE(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void putU64LE(uint8_t* p, uint64_t v) {
+  putU32LE(p, (uint32_t)v);
+  putU32LE(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint16_t getU16LE(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t getU32LE(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t getU64LE(const uint8_t* p) {
+  return (uint64_t)getU32LE(p) | ((uint64_t)getU32LE(p + 4) << 32);
+}
+
+// CRC-16/XMODEM (poly 0x1021, init 0x0000) - same as binascii.crc_hqx(data, 0) on the host.
+// Nibble table keeps flash usage at 32 bytes while avoiding the 8-iteration bit loop.
+static inline uint16_t crc16Ccitt(const uint8_t* data, uint16_t length) {
+  static const uint16_t crc_nibble_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+  };
+  uint16_t crc = 0x0000;
+  for (uint16_t i = 0; i < length; i++) {
+    crc = (crc << 4) ^ crc_nibble_table[(crc >> 12) ^ (data[i] >> 4)];
+    crc = (crc << 4) ^ crc_nibble_table[(crc >> 12) ^ (data[i] & 0x0F)];
+  }
+  return crc;
+}
+
+static inline uint16_t finalizeFrame(uint8_t* frame, uint16_t payload_length) {
+  // Payload has already been written at frame + FRAME_HEADER_SIZE
+  memcpy(frame, FRAME_SYNC, sizeof(FRAME_SYNC));
+  putU16LE(frame + 4, payload_length);
+  putU16LE(frame + 6, crc16Ccitt(frame + FRAME_HEADER_SIZE, payload_length));
+  return FRAME_HEADER_SIZE + payload_length;
+}
+
+static inline uint16_t quantizeAccuracy(float accuracy) {
+  // 0.1 us units, saturating
+  float accuracy_tenths = accuracy * 10.0f;
+  return accuracy_tenths >= 65535.0f ? 65535 : (uint16_t)accuracy_tenths;
+}
+
+template <typename T>
+static inline uint8_t* writeChannelValues(uint8_t* p, const T* values, uint8_t channels) {
+  // int32 x channels; returns the end of the values
+  for (uint8_t ch = 0; ch < channels; ch++) {
+    putU32LE(p, (uint32_t)values[ch]);
+    p += 4;
+  }
+  return p;
+}
+
+// ---------------------------------------------------------------------------------------------
+// SAMPLE record, 16 + 4*channels bytes:
+//   [0]     type = FRAME_TYPE_SAMPLE
+//   [1-4]   sample index since stream start (uint32; the host's gap check is one subtraction)
+//   [5-8]   stream_id (uint32, as in the SESSION line)
+//   [9-12]  timestamp (uint32, low 32 bits of us - same as the ASCII line)
+//   [13]    timing_source (low nibble) | channel count (high nibble)
+//   [14-15] accuracy in 0.1 us units (uint16, saturating)
+//   [16..]  channel values (int32 x channels)
+const uint8_t SAMPLE_HEADER_SIZE = 16;
+
+static inline uint8_t* writeSampleHeader(uint8_t* p, uint32_t index, uint32_t stream_id, uint32_t timestamp,
+                                         uint8_t timing_source, uint8_t channels, uint16_t accuracy_q) {
+  p[0] = FRAME_TYPE_SAMPLE;
+  putU32LE(p + 1, index);
+  putU32LE(p + 5, stream_id);
+  putU32LE(p + 9, timestamp);
+  p[13] = (uint8_t)((timing_source & 0x0F) | (channels << 4));
+  putU16LE(p + 14, accuracy_q);
+  return p + SAMPLE_HEADER_SIZE;
+}
+
+// ---------------------------------------------------------------------------------------------
+// BATCH record, 22-byte header then per-sample entries:
+//   [0]     type = FRAME_TYPE_BATCH
+//   [1-4]   sample index of first sample (uint32, consecutive within the frame)
+//   [5-8]   stream_id (uint32)
+//   [9]     sample count
+//   [10]    timing_source (low nibble) | channel count (high nibble)
+//   [11]    flags (BATCH_FLAG_*)
+//   [12-13] accuracy in 0.1 us units (uint16, saturating)
+//   [14-21] anchor timestamp of first sample (uint64, full virtual us; grid slot if SLOT_STAMPS)
+//   entry:  delta us (slots) from previous sample (uint16, or uint32 if wide; 0 for first)
+//           channel values (int32 x channels)
+const uint8_t BATCH_HEADER_SIZE = 22;
+const uint8_t BATCH_COUNT_OFFSET = 9;
+const uint8_t BATCH_FLAG_WIDE_DELTAS = 0x01;  // Deltas are uint32 instead of uint16
+const uint8_t BATCH_FLAG_SLOT_STAMPS = 0x02;  // Anchor and deltas count grid slots (EPOCH mode), not us
+const uint8_t BATCH_FLAG_DECIMATED = 0x04;    // Event trigger: continuous stream at stream rate / decimation
+const uint8_t BATCH_FLAG_EVENT = 0x08;        // Event trigger: full-rate trigger window samples
+
+static inline void writeBatchHeader(uint8_t* p, uint32_t first_index, uint32_t stream_id, uint8_t timing_source,
+                                    uint8_t channels, uint8_t flags, uint16_t accuracy_q, uint64_t anchor) {
+  p[0] = FRAME_TYPE_BATCH;
+  putU32LE(p + 1, first_index);
+  putU32LE(p + 5, stream_id);
+  p[BATCH_COUNT_OFFSET] = 0;
+  p[10] = (uint8_t)((timing_source & 0x0F) | (channels << 4));
+  p[11] = flags;
+  putU16LE(p + 12, accuracy_q);
+  putU64LE(p + 14, anchor);
+}
+
+static inline uint8_t* writeBatchDelta(uint8_t* p, uint8_t flags, uint32_t delta) {
+  if (flags & BATCH_FLAG_WIDE_DELTAS) {
+    putU32LE(p, delta);
+    return p + 4;
+  }
+  putU16LE(p, (uint16_t)delta);
+  return p + 2;
+}
+
+// ---------------------------------------------------------------------------------------------
+// COMPRESSED record: the 22-byte batch header with type = FRAME_TYPE_COMPRESSED, then
+//   [22..]  channel values of the first sample (int32 x channels)
+//   [+0]    word count W (uint8)
+//   [+1..]  W data words (uint32), then W packing codes, two per byte (low nibble first)
+// The words carry, for every later sample, the change of its timestamp delta (the first is
+// the delta itself) followed by each channel's first difference, all modulo 2^32. A word
+// with code n holds n items of 32 / n bits, two's complement, first item in the top bits.
+// Differences restart from the frame's own first sample, so a lost frame never affects the next.
+const uint8_t STEIM_MAX_ITEMS_PER_WORD = 7;  // Codes 1-7: code items of 32 / code bits per word
+const uint8_t STEIM_MAX_WORDS = 255;         // Word count is a uint8
+
+static inline uint8_t signedBitWidth(int32_t value) {
+  // Two's complement bits needed to hold value (1 for 0 and -1)
+  uint32_t magnitude = (value < 0) ? ~(uint32_t)value : (uint32_t)value;
+  return (magnitude == 0) ? 1 : (uint8_t)(33 - __builtin_clz(magnitude));
+}
+
+static inline uint16_t compressBatchRecord(const uint8_t* raw, uint16_t raw_length, uint8_t* out) {
+  // Packs the BATCH record raw (raw_length bytes) into out, which must hold raw_length bytes.
+  // Returns the payload length, or 0 when packing does not beat the raw batch record.
+  uint8_t count = raw[BATCH_COUNT_OFFSET];
+  uint8_t channels = raw[10] >> 4;
+  uint8_t delta_size = (raw[11] & BATCH_FLAG_WIDE_DELTAS) ? 4 : 2;
+  uint8_t stride = delta_size + 4 * channels;
+  uint16_t item_count = (count > 0) ? (uint16_t)(count - 1) * (1 + channels) : 0;
+  if (item_count == 0) {
+    return 0;
+  }
+
+  memcpy(out, raw, BATCH_HEADER_SIZE);
+  out[0] = FRAME_TYPE_COMPRESSED;
+  const uint8_t* entry = raw + BATCH_HEADER_SIZE;
+  memcpy(out + BATCH_HEADER_SIZE, entry + delta_size, 4 * channels);
+
+  // Field 0 is the timestamp delta, fields 1..channels the channel values
+  uint32_t previous[1 + PROTOCOL_MAX_CHANNELS] = {0};
+  for (uint8_t ch = 0; ch < channels; ch++) {
+    previous[1 + ch] = getU32LE(entry + delta_size + 4 * ch);
+  }
+  entry += stride;
+
+  uint8_t* word_count = out + BATCH_HEADER_SIZE + 4 * channels;
+  uint8_t* p = word_count + 1;
+  uint8_t codes[(STEIM_MAX_WORDS + 1) / 2];
+  uint8_t words = 0;
+
+  int32_t window[STEIM_MAX_ITEMS_PER_WORD];
+  uint8_t width[STEIM_MAX_ITEMS_PER_WORD];
+  uint8_t filled = 0;
+  uint8_t field = 0;
+  uint16_t generated = 0;
+
+  while (generated < item_count || filled > 0) {
+    while (filled < STEIM_MAX_ITEMS_PER_WORD && generated < item_count) {
+      uint32_t value = (field == 0)
+          ? ((delta_size == 4) ? getU32LE(entry) : getU16LE(entry))
+          : getU32LE(entry + delta_size + 4 * (field - 1));
+      window[filled] = (int32_t)(value - previous[field]);
+      width[filled] = signedBitWidth(window[filled]);
+      previous[field] = value;
+      filled++;
+      generated++;
+      if (++field > channels) {
+        field = 0;
+        entry += stride;
+      }
+    }
+
+    // Largest group whose widest item fits the group's bit width (code 1 always fits)
+    uint8_t n = filled;
+    uint8_t widest = 0;
+    for (uint8_t j = 0; j < n; j++) {
+      if (width[j] > widest) widest = width[j];
+    }
+    while (n > 1 && widest > 32 / n) {
+      n--;
+      widest = 0;
+      for (uint8_t j = 0; j < n; j++) {
+        if (width[j] > widest) widest = width[j];
+      }
+    }
+
+    // Give up once the raw record is no longer beaten
+    if ((uint16_t)(p - out) + 4 + (words + 2) / 2 >= raw_length || words == STEIM_MAX_WORDS) {
+      return 0;
+    }
+    uint32_t word;
+    if (n == 1) {
+      word = (uint32_t)window[0];
+    } else {
+      uint8_t bits = 32 / n;
+      uint32_t mask = ((uint32_t)1 << bits) - 1;
+      word = 0;
+      for (uint8_t j = 0; j < n; j++) {
+        word = (word << bits) | ((uint32_t)window[j] & mask);
+      }
+      word <<= 32 - n * bits;
+    }
+    putU32LE(p, word);
+    p += 4;
+    if (words & 1) {
+      codes[words >> 1] |= (uint8_t)(n << 4);
+    } else {
+      codes[words >> 1] = n;
+    }
+    words++;
+
+    filled -= n;
+    for (uint8_t j = 0; j < filled; j++) {
+      window[j] = window[j + n];
+      width[j] = width[j + n];
+    }
+  }
+
+  *word_count = words;
+  memcpy(p, codes, (words + 1) / 2);
+  p += (words + 1) / 2;
+  return (uint16_t)(p - out);
+}
+
+// ---------------------------------------------------------------------------------------------
+// EVENT record, 18 bytes:
+//   [0]     type = FRAME_TYPE_EVENT
+//   [1]     event code (EventCode, timing_core.h)
+//   [2-9]   virtual time us (uint64, same timebase as batch anchors)
+//   [10-13] a (int32)
+//   [14-17] b (int32)
+const uint8_t EVENT_PAYLOAD_SIZE = 18;
+
+static inline void writeEventRecord(uint8_t* p, uint8_t code, uint64_t us, int32_t a, int32_t b) {
+  p[0] = FRAME_TYPE_EVENT;
+  p[1] = code;
+  putU64LE(p + 2, us);
+  putU32LE(p + 10, (uint32_t)a);
+  putU32LE(p + 14, (uint32_t)b);
+}
+
+// ---------------------------------------------------------------------------------------------
+// CORRECTION record, 31 bytes:
+//   [0]     type = FRAME_TYPE_CORRECTION
+//   [1]     reason (CORRECTION_* or the EventCode that moved the grid)
+//   [2]     timing source
+//   [3-4]   accuracy in 0.1 us units (uint16, saturating)
+//   [5-8]   epoch0: PPS epoch of slot 0 (uint32)
+//   [9-10]  slots per epoch (uint16, the stream rate)
+//   [11-18] slot (uint64)
+//   [19-26] calibrated timestamp of that slot (uint64 us, the MICROS-mode value)
+//   [27-30] oscillator calibration (int32 ppb)
+// Later slots are timestamp + (n - slot) / slots_per_epoch seconds until the next record.
+const uint8_t CORRECTION_PAYLOAD_SIZE = 31;
+const uint8_t CORRECTION_STREAM_START = 0;         // Reasons 1-0x7F are the triggering EventCode
+const uint8_t CORRECTION_SOURCE_CHANGE = 0x80;
+const uint8_t CORRECTION_CALIBRATION_CHANGE = 0x81;
+const uint8_t CORRECTION_PHASE_ALIGNED = 0x82;     // A spread-out phase adjustment has finished
+
+static inline void writeCorrectionRecord(uint8_t* p, uint8_t reason, uint8_t timing_source, uint16_t accuracy_q,
+                                         uint32_t epoch0, uint16_t slots_per_epoch, uint64_t slot,
+                                         uint64_t timestamp, int32_t calibration_ppb) {
+  p[0] = FRAME_TYPE_CORRECTION;
+  p[1] = reason;
+  p[2] = timing_source;
+  putU16LE(p + 3, accuracy_q);
+  putU32LE(p + 5, epoch0);
+  putU16LE(p + 9, slots_per_epoch);
+  putU64LE(p + 11, slot);
+  putU64LE(p + 19, timestamp);
+  putU32LE(p + 27, (uint32_t)calibration_ppb);
+}
+
+// ---------------------------------------------------------------------------------------------
+// STAT record: fixed-width fields behind a change mask, so counters that did not move since the
+// previous record cost nothing. Field ids are mask bit positions.
+//   [0]    type = FRAME_TYPE_STAT
+//   [1]    record sequence (uint8, lets the host detect a lost delta record)
+//   [2-5]  change mask (uint32): bit n set = StatField n follows; bit 31 = keyframe (all fields)
+//   [6-]   the flagged fields in id order, STAT_FIELD_SIZES[id] bytes each
+enum StatField : uint8_t {
+  STAT_SOURCE = 0,            // u8  AdvancedTiming::TimingSource
+  STAT_ACCURACY,              // u16 0.1 us, saturating
+  STAT_CALIBRATION_PPB,       // i32 oscillator calibration (ppb)
+  STAT_FLAGS,                 // u8  pps_valid | calibration_valid << 1 | calibration_source << 2
+  STAT_PPS_AGE_MS,            // u32
+  STAT_MICROS_WRAPS,          // u32
+  STAT_BUFFER_OVERFLOWS,      // u32
+  STAT_SAMPLES_SKIPPED,       // u32
+  STAT_BOOT_ID,               // u32
+  STAT_STREAM_ID,             // u32
+  STAT_DEADLINE_MISSES,       // u32
+  STAT_SAMPLE_INDEX,          // u32 low 32 bits
+  STAT_REFERENCE_UPDATES,     // u32
+  STAT_TX_RING_HWM,           // u16 bytes
+  STAT_CHECKSUM_ERRORS,       // u32 ADS1263 checksum mismatches (DMA/SCAN engines)
+  STAT_ACQUISITION_US,        // u32 smoothed per-sample acquisition time
+  STAT_HIGH_RATE_OVERRUNS,    // u32
+  STAT_TIMER_OVERRUNS,        // u32 TCC1 ticks dropped
+  STAT_EVENTS_SENT,           // u32
+  STAT_PROFILE_LOOP_MAX_US,   // u32 0 when built with PROFILE_HOT_PATH=0
+  STAT_PROFILE_SAMPLE_MAX_US, // u32
+  STAT_FIELD_COUNT
+};
+const uint8_t STAT_FIELD_SIZES[STAT_FIELD_COUNT] = {1, 2, 4, 1, 4, 4, 4, 4, 4, 4, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4};
+const uint8_t STAT_HEADER_SIZE = 6;                      // type, record seq, mask (u32)
+const uint8_t STAT_MAX_PAYLOAD = STAT_HEADER_SIZE + 74;  // Keyframe: sum of STAT_FIELD_SIZES
+const uint32_t STAT_MASK_KEYFRAME = 0x80000000UL;        // Record carries every field
+
+static inline uint8_t encodeStatRecord(uint8_t* p, uint8_t seq, const uint32_t* values, const uint32_t* previous,
+                                       bool keyframe) {
+  // Delta records carry the fields that differ from previous[]; returns the payload length
+  uint8_t* field = p + STAT_HEADER_SIZE;
+  uint32_t mask = keyframe ? STAT_MASK_KEYFRAME : 0;
+  for (uint8_t id = 0; id < STAT_FIELD_COUNT; id++) {
+    if (!keyframe && values[id] == previous[id]) continue;
+    mask |= 1UL << id;
+    if (STAT_FIELD_SIZES[id] == 1) {
+      *field = (uint8_t)values[id];
+    } else if (STAT_FIELD_SIZES[id] == 2) {
+      putU16LE(field, (uint16_t)values[id]);
+    } else {
+      putU32LE(field, values[id]);
+    }
+    field += STAT_FIELD_SIZES[id];
+  }
+  p[0] = FRAME_TYPE_STAT;
+  p[1] = seq;
+  putU32LE(p + 2, mask);
+  return (uint8_t)(field - p);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Sample record decoding (native host decoder). SAMPLE, BATCH and COMPRESSED records share one
+// header view: a SAMPLE record is a one-sample batch anchored on its 32-bit timestamp.
+struct SampleRecordHeader {
+  uint8_t type;
+  uint32_t first_index;
+  uint32_t stream_id;
+  uint8_t count;
+  uint8_t timing_source;
+  uint8_t channels;
+  uint8_t flags;                // BATCH_FLAG_* (0 for SAMPLE records)
+  uint16_t accuracy_q;
+  uint64_t anchor;
+};
+
+static inline bool parseSampleRecordHeader(const uint8_t* payload, uint16_t length, SampleRecordHeader& h) {
+  if (length < 1) {
+    return false;
+  }
+  h.type = payload[0];
+  if (h.type == FRAME_TYPE_SAMPLE) {
+    if (length < SAMPLE_HEADER_SIZE) return false;
+    h.first_index = getU32LE(payload + 1);
+    h.stream_id = getU32LE(payload + 5);
+    h.count = 1;
+    h.timing_source = payload[13] & 0x0F;
+    h.channels = payload[13] >> 4;
+    h.flags = 0;
+    h.accuracy_q = getU16LE(payload + 14);
+    h.anchor = getU32LE(payload + 9);
+    return length >= SAMPLE_HEADER_SIZE + 4 * h.channels;
+  }
+  if (h.type != FRAME_TYPE_BATCH && h.type != FRAME_TYPE_COMPRESSED) {
+    return false;
+  }
+  if (length < BATCH_HEADER_SIZE) return false;
+  h.first_index = getU32LE(payload + 1);
+  h.stream_id = getU32LE(payload + 5);
+  h.count = payload[BATCH_COUNT_OFFSET];
+  h.timing_source = payload[10] & 0x0F;
+  h.channels = payload[10] >> 4;
+  h.flags = payload[11];
+  h.accuracy_q = getU16LE(payload + 12);
+  h.anchor = getU64LE(payload + 14);
+  return true;
+}
+
+template <typename Sink>
+static inline bool decodeSampleRecord(const uint8_t* payload, uint16_t length, const SampleRecordHeader& h,
+                                      Sink& sink) {
+  // Calls sink(i, stamp, values) for each sample i of the record, stamp in us (slots with
+  // BATCH_FLAG_SLOT_STAMPS). A malformed record is rejected before the first call.
+  int32_t values[PROTOCOL_MAX_CHANNELS];
+  uint8_t channels = h.channels;
+  if (h.type == FRAME_TYPE_SAMPLE) {
+    for (uint8_t ch = 0; ch < channels; ch++) {
+      values[ch] = (int32_t)getU32LE(payload + SAMPLE_HEADER_SIZE + 4 * ch);
+    }
+    sink(0, h.anchor, (const int32_t*)values);
+    return true;
+  }
+
+  uint64_t stamp = h.anchor;
+  if (h.type == FRAME_TYPE_BATCH) {
+    uint8_t delta_size = (h.flags & BATCH_FLAG_WIDE_DELTAS) ? 4 : 2;
+    uint16_t stride = delta_size + 4 * channels;
+    if ((uint32_t)BATCH_HEADER_SIZE + (uint32_t)h.count * stride > length) {
+      return false;
+    }
+    const uint8_t* entry = payload + BATCH_HEADER_SIZE;
+    for (uint8_t i = 0; i < h.count; i++, entry += stride) {
+      stamp += (delta_size == 4) ? getU32LE(entry) : getU16LE(entry);
+      for (uint8_t ch = 0; ch < channels; ch++) {
+        values[ch] = (int32_t)getU32LE(entry + delta_size + 4 * ch);
+      }
+      sink(i, stamp, (const int32_t*)values);
+    }
+    return true;
+  }
+
+  // COMPRESSED: check the word stream holds exactly the expected items before emitting any
+  uint16_t first_end = BATCH_HEADER_SIZE + 4 * channels;
+  if (h.count == 0 || length < first_end + 1) {
+    return false;
+  }
+  uint8_t words = payload[first_end];
+  const uint8_t* word_data = payload + first_end + 1;
+  const uint8_t* codes = word_data + 4 * words;
+  if ((uint32_t)(codes - payload) + (words + 1) / 2 > length) {
+    return false;
+  }
+  uint32_t item_count = 0;
+  for (uint8_t w = 0; w < words; w++) {
+    uint8_t code = (codes[w >> 1] >> (4 * (w & 1))) & 0x0F;
+    if (code < 1 || code > STEIM_MAX_ITEMS_PER_WORD) {
+      return false;
+    }
+    item_count += code;
+  }
+  if (item_count != (uint32_t)(h.count - 1) * (1 + channels)) {
+    return false;
+  }
+
+  for (uint8_t ch = 0; ch < channels; ch++) {
+    values[ch] = (int32_t)getU32LE(payload + BATCH_HEADER_SIZE + 4 * ch);
+  }
+  sink(0, stamp, (const int32_t*)values);
+  uint32_t delta = 0;
+  uint8_t field = 0;
+  uint8_t sample = 1;
+  for (uint8_t w = 0; w < words; w++) {
+    uint8_t code = (codes[w >> 1] >> (4 * (w & 1))) & 0x0F;
+    uint8_t bits = 32 / code;
+    uint32_t word = getU32LE(word_data + 4 * w);
+    for (uint8_t j = 0; j < code; j++) {
+      // Item j sits in the top bits first; shift it to the top, then sign-extend back down
+      int32_t item = (int32_t)(word << (j * bits)) >> (32 - bits);
+      if (field == 0) {
+        delta += (uint32_t)item;  // Differences are modulo 2^32
+        stamp += delta;
+      } else {
+        values[field - 1] = (int32_t)((uint32_t)values[field - 1] + (uint32_t)item);
+      }
+      if (++field > channels) {
+        field = 0;
+        sink(sample++, stamp, (const int32_t*)values);
+      }
+    }
+  }
+  return true;
+}
+
+#endif  // PROTOCOL_CODEC_H
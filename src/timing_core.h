@@ -0,0 +1,962 @@
+// Timing core: virtual micros, PPS discipline, calibrated timestamps
+// and the fractional sample scheduler, kept free of hardware access so the same code runs in
+// the firmware and in the host replay harness (bench/timing_replay.cpp).
+//
+// Included once, after the includer has provided:
+//   clock    timingMicros() (uint64_t, monotonic, never wraps), timingMillis() (uint32_t, wraps)
+//            timingEnterCritical() / timingExitCritical() around ISR-shared state
+//   output   SerialTx (print/println), LOG_DEBUG / LOG_TRACE (logging.h), sendEvent()
+//   profile  PROFILE_BEGIN / PROFILE_END
+//   stream   streaming, stream_rate, PPS_INPUT_PIN, PPS_TIMER_CLOCK_HZ
+//   hooks    startStreamingAtPps()
+// Millis-domain state is uint32_t rather than unsigned long, so 32-bit wrap behaves the same
+// on a 64-bit host as on the SAMD21.
+#ifndef TIMING_CORE_H
+#define TIMING_CORE_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Event records (FRAME_TYPE_EVENT); the meaning of the two int32 arguments depends on the code
+enum EventCode : uint8_t {
+  EVENT_PPS_LOCK_ADJUST = 1,   // a = phase error us, b = samples the correction is spread over
+  EVENT_PPS_PHASE_NUDGE = 2,   // a = phase error us, b = samples
+  EVENT_CLOCK_RESET = 3,       // Retired: the monotonic timebase cannot reset (code kept for decoders)
+  EVENT_SLOTS_SKIPPED = 4,     // a = sample slots jumped over
+  EVENT_REFERENCE_UPDATE = 5,  // a = reference updates so far, b = samples since the last one
+  EVENT_MICROS_WRAP = 6,       // a = low-word wraps of the timebase so far (informational)
+  EVENT_TRIGGER_ON = 7,        // a = sample index of the window's first sample, b = STA/LTA ratio Q8
+  EVENT_TRIGGER_OFF = 8,       // a = sample index after the window, b = samples in the window
+  EVENT_PPS_EPOCH_LOST = 9,    // a = last PPS epoch label (SET_PPS_EPOCH needed again)
+};
+
+// Advanced timing system with PPS support
+struct AdvancedTiming {
+    // PPS Management
+    const int PPS_PIN = PPS_INPUT_PIN;  // PPS input pin
+    volatile bool pps_received;
+    volatile uint64_t pps_micros;   // Timebase micros at the latest PPS edge
+    uint64_t last_pps_micros;  // Track previous PPS time for interval calculation
+    uint32_t last_pps_time;
+    uint32_t pps_count;
+    bool pps_valid;
+    uint32_t pps_timeout_ms;
+    bool pps_capture_hw;                    // Edges captured by TCC0 via EVSYS (else timebase read in ISR)
+    volatile uint32_t pps_timer_overflows;  // TCC0 24-bit wraps (upper bits of the edge count)
+    volatile uint64_t pps_edge_count;       // 48 MHz count at the latest PPS edge
+    volatile uint32_t pps_capture_latency;  // Counts from the edge to the capture ISR (diagnostic)
+    uint64_t last_pps_edge_count;
+    uint64_t last_pps_interval_counts;      // Counts between the last two edges (48e6 nominal)
+    
+    // Timing Sources
+    enum TimingSource {
+        TIMING_PPS_ACTIVE = 0,      // GPS PPS working (±1μs)
+        TIMING_PPS_HOLDOVER = 1,    // Recent PPS, using prediction (±10μs)
+        TIMING_INTERNAL_CAL = 2,    // Internal osc with PPS calibration (±100μs)
+        TIMING_INTERNAL_RAW = 3     // Raw internal (±1ms, emergency)
+    } current_source;
+    
+    // Calibration Data
+    enum CalibrationSource {
+        CAL_NONE = 0,           // No calibration applied
+        CAL_PPS_LIVE = 1,       // Calibration from active PPS measurements
+        CAL_PI_PUSHED = 2,      // Calibration pushed from Pi
+        CAL_FLASH = 3           // Calibration restored from flash at boot
+    } calibration_source;
+    
+    float oscillator_calibration_ppm;   // PPM correction (from PPS or Pi)
+    uint64_t cal_base_micros;          // Timebase micros when calibration established
+    uint64_t cal_base_calibrated;      // Calibrated time at cal_base_micros (held across re-anchoring)
+    uint32_t cal_base_millis;      // millis() when calibration established
+    uint32_t cal_sample_count;          // Samples since calibration
+    bool calibration_valid;
+    bool cal_base_initialized;          // Track if cal_base_micros has been permanently set
+    uint32_t cal_applied_at_ms;    // When calibration was applied (for diagnostics)
+    
+    // Timebase diagnostics
+    uint32_t micros_wraparound_count;   // Low-word wraps of the 64-bit timebase (now >> 32)
+    // NOTE: sequence_wraparounds calculated as (samples_generated >> 16) to avoid hot-path overhead
+    
+    // Overflow Protection - NEW
+    uint64_t reference_update_interval; // How often to update timing reference (samples)
+    uint64_t last_reference_update_sample; // Sample index of last reference update
+    uint64_t timing_base_virtual_micros; // Virtual micros when timing was established
+    uint32_t reference_updates_count;    // Number of reference updates performed
+    
+    // Precision State (Modified for overflow protection)
+  uint64_t sample_interval_us;        // Sample interval in microseconds
+  double   effective_interval_us;     // PPS-disciplined effective interval (diagnostics only)
+  uint64_t effective_interval_q32;    // PPS-disciplined effective interval (Q32.32 us)
+  uint32_t phase_acc_q32;             // Fractional microsecond accumulator (Q0.32)
+  int32_t  calibration_q40;           // oscillator_calibration_ppm / 1e6 as a signed Q0.40 fraction (±1953 ppm)
+  float    calibration_scale_ppm;     // ppm the integer scales were derived from
+  uint64_t calibration_scale_interval_us; // sample_interval_us the integer scales were derived from
+  uint64_t next_sample_micros;        // Next scheduled sample time (virtual micros)
+  uint64_t grid_slot;                 // Scheduler slot of the next sample since the grid was established (skips included)
+    uint64_t timing_base_micros;        // Timing base for sampling (now 64-bit)
+  bool timing_established;
+    uint32_t samples_generated;
+    uint64_t sample_index;
+    
+    // Phase alignment (gentle nudge) to PPS after start
+    bool started_on_pps;                 // Whether streaming started exactly at a PPS edge
+    bool phase_nudge_applied;            // Whether we've already nudged once after PPS became available
+    bool phase_alignment_active;         // Currently applying per-sample phase adjustment
+    double phase_error_us;               // Total phase error to correct (signed)
+    int64_t per_sample_phase_adjust_q32; // Adjustment added per sample (signed, Q32.32 us)
+    uint32_t phase_adjust_samples_remaining; // How many samples left to apply adjustment
+    bool pps_phase_lock_enabled;          // Continuously lock phase to PPS when available
+    
+    // Synchronized start support
+    bool sync_start_enabled;
+    uint32_t sync_delay_ms;
+    uint32_t sync_start_time;
+    bool waiting_for_sync_start;
+    uint64_t sync_start_target_us;   // Absolute virtual micros target for start
+    // PPS-locked start support
+    bool sync_on_pps;
+    uint8_t pps_countdown;
+    // PPS epoch labels (SET_PPS_EPOCH) and epoch-aligned start (START_STREAM_EPOCH)
+    bool pps_epoch_valid;            // pps_epoch labels the last counted edge
+    uint32_t pps_epoch;              // Host-agreed second (e.g. GPS/Unix seconds) of the last counted edge
+    uint64_t pps_epoch_micros;       // Virtual micros of that edge
+    bool pps_epoch_label_pending;    // Apply pps_epoch_next to the next edge
+    uint32_t pps_epoch_next;
+    bool epoch_start_pending;        // Start streaming on the edge labelled epoch_start_second
+    uint32_t epoch_start_second;
+    bool epoch_started;              // Current stream began on epoch_start_second
+    
+    // Quality Metrics
+    float timing_accuracy_us;       // Current estimated accuracy
+    uint32_t pps_miss_count;       // Consecutive missed PPS
+    uint32_t last_sync_time;   // Last successful sync
+    
+    // Health beacon (1 Hz STAT line)
+    uint32_t last_stat_time;   // Last health beacon (STAT line or frame) sent
+    uint32_t stat_interval_ms;      // Health beacon interval (1000ms = 1Hz, 0 = off; SET_STAT_INTERVAL)
+    
+    // Temperature-aware calibration
+    float temp_coefficient_ppm_per_c;  // PPM change per degree C
+    float reference_temp_c;            // Reference temperature for calibration
+    float current_temp_c;              // Current temperature
+    bool temp_compensation_enabled;    // Enable temperature compensation
+} advanced_timing;
+
+// PPS discipline: two-state Kalman filter (edge phase, timebase rate error) updated once per edge.
+// State and gains are fixed point so the phase never loses sub-microsecond resolution; the 2x2
+// covariance is float, which is cheap at 1 Hz even without an FPU.
+#ifndef PPS_FILTER_Q_PHASE
+#define PPS_FILTER_Q_PHASE 1e-4f         // White phase noise of the timebase, us^2 per second
+#endif
+#ifndef PPS_FILTER_Q_FREQ
+#define PPS_FILTER_Q_FREQ 4e-6f          // Frequency random walk, ppm^2 per second (crystal wander)
+#endif
+#define PPS_FILTER_R_ISR 1.0f            // Edge noise, us^2, when the ISR reads the timebase
+#define PPS_FILTER_R_CAPTURE 0.0025f     // Edge noise, us^2, with TCC0 capture (1/48 us counts)
+#define PPS_FILTER_R_MAX 400.0f          // Bound on the adaptive edge noise
+#define PPS_FILTER_PRIOR_PPM 500.0f      // Rate prior without a calibration (crystal tolerance)
+#define PPS_FILTER_PRIOR_CAL_PPM 2.0f    // Rate prior seeded from a flash or pushed calibration
+#define PPS_FILTER_LOCK_PHASE_US 2.0f    // LOCKED once phase sigma and rate sigma are below these
+#define PPS_FILTER_LOCK_FREQ_PPM 0.05f
+#define PPS_FILTER_GATE_SIGMA 5.0f       // Locked edges further than this from the prediction are outliers
+#define PPS_FILTER_MAX_REJECTS 3         // Consecutive rejected edges before the filter restarts
+#define PPS_FILTER_MAX_OFF_GRID_S 0.1    // Edge interval this far from whole seconds is a glitch
+#define PPS_FILTER_ACCURACY_FLOOR_US 0.5f
+
+enum PpsFilterState : uint8_t {
+  PPS_FILTER_IDLE = 0,        // No edge yet (or cleared)
+  PPS_FILTER_ACQUIRING = 1,   // Tracking, covariance still above the lock thresholds
+  PPS_FILTER_LOCKED = 2       // Converged; innovation gate active
+};
+
+struct PpsFilter {
+  uint8_t state;
+  uint64_t edge_q16;          // Filtered timebase time of the latest edge, Q48.16 us
+  int64_t freq_q32;           // Timebase rate error, Q32.32 ppm (positive = timebase fast)
+  uint64_t edge_calibrated;   // Calibrated time of the latest edge (whole seconds apart)
+  float p00, p01, p11;        // Covariance: phase us^2, phase x rate us*ppm, rate ppm^2
+  float r;                    // Edge measurement noise, us^2 (adapted once locked)
+  float innovation_us;        // Latest measured minus predicted edge
+  bool frequency_known;       // Rate estimate survives a phase restart
+  uint64_t anchor_q16;        // HW capture: edge counts are measured from this edge
+  uint64_t anchor_count;
+  uint8_t rejects;            // Consecutive rejected edges
+  uint32_t updates;
+  uint32_t outliers;
+  uint32_t restarts;
+  uint32_t accuracy_bucket;   // ppsFilterAccuracyUs() cache (250 ms buckets since the edge)
+  float accuracy_us;
+} pps_filter;
+
+
+void initTimingCore();
+void updateTimingSource();
+uint64_t getVirtualMicros();  // NEW: Continuous virtual time
+uint64_t getPreciseTimestamp();
+uint64_t getPreciseTimestampAt(uint64_t virtual_micros);
+void processPPS();
+uint64_t calculateCalibratedTimestamp(uint64_t virtual_micros);
+void refreshTimingScales();
+int64_t mulQ40(int64_t value, int32_t fraction_q40);
+int64_t mulQ30(int64_t value, int32_t fraction_q30);
+void resetPpsFilter();
+bool updatePpsFilter(uint64_t pps_micros, uint64_t pps_edge_count);
+float ppsFilterAccuracyUs(uint32_t since_edge_ms);
+long long ppsGridPhaseErrorUs();
+const char* getPpsFilterStateName(uint8_t state);
+int64_t planPhaseAdjustment(long long signed_phase_us, uint32_t planned_samples, uint32_t& samples_needed);
+void establishSamplingTiming();
+void updateTimingReference();
+void advanceSampleSchedule(long long late_us);
+void countEmittedSample();
+const char* getTimingSourceName(int source);
+void clampOscillatorCalibration();
+void retuneOscillatorCalibration(float ppm);
+
+void initTimingCore() {
+  // Initialize timing state
+  advanced_timing.last_pps_edge_count = 0;
+  advanced_timing.last_pps_interval_counts = 0;
+  advanced_timing.pps_received = false;
+  advanced_timing.pps_valid = false;
+  advanced_timing.last_pps_micros = 0;
+  advanced_timing.last_pps_time = 0;  // ✅ CRITICAL: Initialize to prevent garbage value
+  advanced_timing.pps_timeout_ms = 2000;  // 2 second PPS timeout
+  advanced_timing.current_source = AdvancedTiming::TIMING_INTERNAL_RAW;
+  advanced_timing.oscillator_calibration_ppm = 0.0;
+  advanced_timing.timing_accuracy_us = 1000.0;   // 1ms initial accuracy
+  advanced_timing.pps_miss_count = 0;
+  advanced_timing.pps_count = 0;
+  advanced_timing.calibration_valid = false;
+  advanced_timing.cal_base_initialized = false;  // FIXED: Initialize calibration base flag
+  advanced_timing.cal_base_micros = 0;
+  advanced_timing.cal_base_calibrated = 0;
+  advanced_timing.calibration_source = AdvancedTiming::CAL_NONE;
+  advanced_timing.cal_applied_at_ms = 0;
+  
+  // Initialize timebase diagnostics
+  advanced_timing.micros_wraparound_count = (uint32_t)(timingMicros() >> 32);
+  // NOTE: sequence_wraparounds calculated on-demand from samples_generated
+  
+  // Initialize overflow protection - NEW
+  advanced_timing.reference_update_interval = 1000000ULL;  // Update every 1M samples (~2.8 hours at 100Hz)
+  advanced_timing.last_reference_update_sample = 0;
+  advanced_timing.timing_base_virtual_micros = 0;
+  advanced_timing.reference_updates_count = 0;
+  
+  // Initialize precision timing
+  advanced_timing.sample_interval_us = 10000; // 100Hz default
+  advanced_timing.effective_interval_us = (double)advanced_timing.sample_interval_us;
+  advanced_timing.effective_interval_q32 = advanced_timing.sample_interval_us << 32;
+  advanced_timing.phase_acc_q32 = 0;
+  advanced_timing.calibration_q40 = 0;
+  advanced_timing.calibration_scale_ppm = 0.0;
+  advanced_timing.calibration_scale_interval_us = advanced_timing.sample_interval_us;
+  advanced_timing.timing_base_micros = 0;
+  advanced_timing.timing_established = false;
+  advanced_timing.samples_generated = 0;
+  advanced_timing.sample_index = 0;
+  advanced_timing.next_sample_micros = 0;
+  advanced_timing.grid_slot = 0;
+  
+  // Initialize synchronized start
+  advanced_timing.sync_start_enabled = false;
+  advanced_timing.sync_delay_ms = 0;
+  advanced_timing.sync_start_time = 0;
+  advanced_timing.waiting_for_sync_start = false;
+  advanced_timing.sync_start_target_us = 0;
+  advanced_timing.sync_on_pps = false;
+  advanced_timing.pps_countdown = 0;
+  advanced_timing.pps_epoch_valid = false;
+  advanced_timing.pps_epoch = 0;
+  advanced_timing.pps_epoch_micros = 0;
+  advanced_timing.pps_epoch_label_pending = false;
+  advanced_timing.pps_epoch_next = 0;
+  advanced_timing.epoch_start_pending = false;
+  advanced_timing.epoch_start_second = 0;
+  advanced_timing.epoch_started = false;
+  
+  // Initialize PPS alignment state
+  advanced_timing.started_on_pps = false;
+  advanced_timing.phase_nudge_applied = false;
+  advanced_timing.phase_alignment_active = false;
+  advanced_timing.phase_error_us = 0.0;
+  advanced_timing.per_sample_phase_adjust_q32 = 0;
+  advanced_timing.phase_adjust_samples_remaining = 0;
+  advanced_timing.pps_phase_lock_enabled = true;
+  
+  // Initialize health beacon
+  advanced_timing.last_stat_time = 0;
+  advanced_timing.stat_interval_ms = 1000;  // 1 Hz
+  
+  // Initialize temperature-aware calibration
+  advanced_timing.temp_coefficient_ppm_per_c = 0.0;  // Fitted from the firmware temperature table
+  advanced_timing.reference_temp_c = 25.0;            // Reference temperature
+  advanced_timing.current_temp_c = 25.0;              // Current temperature
+  advanced_timing.temp_compensation_enabled = false;  // Disabled until learned
+  
+  resetPpsFilter();
+}
+
+void updateTimingSource() {
+  uint32_t current_millis = timingMillis();
+  
+  // The timebase cannot miss a wrap or run backward; the low-word wrap is only reported
+  uint32_t timebase_wraps = (uint32_t)(timingMicros() >> 32);
+  if (timebase_wraps != advanced_timing.micros_wraparound_count) {
+    advanced_timing.micros_wraparound_count = timebase_wraps;
+    sendEvent(EVENT_MICROS_WRAP, (int32_t)timebase_wraps, 0);
+  }
+  
+  // Check for new PPS
+  if (advanced_timing.pps_received) {
+    PROFILE_BEGIN(PROFILE_PPS);
+    processPPS();
+    PROFILE_END(PROFILE_PPS);
+    advanced_timing.pps_received = false;
+  }
+  
+  // Determine current timing source based on explicit thresholds
+  uint32_t time_since_pps = current_millis - advanced_timing.last_pps_time;
+  
+  // Explicit state machine thresholds as specified
+  if (advanced_timing.pps_valid && time_since_pps < 1500) {
+    // ACTIVE: last_pps_age < 1.5s
+    advanced_timing.current_source = AdvancedTiming::TIMING_PPS_ACTIVE;
+    // Filter phase uncertainty, extrapolated from the last edge
+    advanced_timing.timing_accuracy_us = pps_filter.state != PPS_FILTER_IDLE ? ppsFilterAccuracyUs(time_since_pps) : 1.0;
+    advanced_timing.pps_miss_count = 0;
+  }
+  else if (advanced_timing.pps_valid && time_since_pps < 60000) {
+    // HOLDOVER: 1.5s < last_pps_age < 60s (no PPS but have oscillator_calibration_ppm)
+    advanced_timing.current_source = AdvancedTiming::TIMING_PPS_HOLDOVER;
+    // Freeze ppm in holdover, slowly increase accuracy_us
+    // oscillator_calibration_ppm remains frozen at last good value
+    // The filter's rate uncertainty grows the error quadratically; the old +0.1μs per second is the fallback
+    advanced_timing.timing_accuracy_us = pps_filter.state != PPS_FILTER_IDLE ? ppsFilterAccuracyUs(time_since_pps)
+                                                                             : 1.0 + (time_since_pps / 1000.0) * 0.1;
+    advanced_timing.pps_miss_count++;
+  }
+  else if (advanced_timing.calibration_valid && time_since_pps < 300000) {
+    // CAL: 60s < last_pps_age < 300s (or if temp change > threshold)
+    advanced_timing.current_source = AdvancedTiming::TIMING_INTERNAL_CAL;
+    // Keep the last ppm and slowly increase accuracy_us
+    advanced_timing.timing_accuracy_us = 10.0 + (time_since_pps / 1000.0) * 0.3;  // +0.3μs per second
+  }
+  else {
+    // RAW: last_pps_age > 300s (or if temp change > threshold)
+    advanced_timing.current_source = AdvancedTiming::TIMING_INTERNAL_RAW;
+    advanced_timing.timing_accuracy_us = 1000.0;
+    
+    // Alert about timing degradation (only once per event)
+    static bool degradation_warned = false;
+    
+    if (advanced_timing.pps_valid && !degradation_warned) {
+      SerialTx.print("WARNING:GPS PPS lost for ");
+      SerialTx.print(time_since_pps / 1000);
+      SerialTx.println("s - timing accuracy degraded");
+      advanced_timing.pps_valid = false;
+      degradation_warned = true;
+    }
+  }
+}
+
+uint64_t getVirtualMicros() {
+  // The 64-bit timebase is already continuous: no offset, wrap heuristic or shared write-back
+  return timingMicros();
+}
+
+uint64_t getPreciseTimestamp() {
+  // Timebase micros are continuous since boot
+  return getPreciseTimestampAt(getVirtualMicros());
+}
+
+uint64_t getPreciseTimestampAt(uint64_t virtual_micros) {
+  switch (advanced_timing.current_source) {
+    case AdvancedTiming::TIMING_PPS_ACTIVE:
+    case AdvancedTiming::TIMING_PPS_HOLDOVER:
+    case AdvancedTiming::TIMING_INTERNAL_CAL:
+      // Use calibrated timestamp with virtual time
+      return calculateCalibratedTimestamp(virtual_micros);
+      
+    case AdvancedTiming::TIMING_INTERNAL_RAW:
+    default:
+      // Return virtual micros for continuity
+      return virtual_micros;
+  }
+}
+
+// Carry the host's second label from edge to edge. Only edges landing within 100ms of a whole
+// number of seconds after the last counted one are counted, so a glitch edge cannot shift the label.
+// Returns true when this edge carries a label.
+bool labelPpsEdge(uint64_t pps_micros) {
+  if (advanced_timing.pps_epoch_label_pending) {
+    advanced_timing.pps_epoch_label_pending = false;
+    advanced_timing.pps_epoch = advanced_timing.pps_epoch_next;
+    advanced_timing.pps_epoch_micros = pps_micros;
+    advanced_timing.pps_epoch_valid = true;
+    return true;
+  }
+  if (!advanced_timing.pps_epoch_valid) {
+    return false;
+  }
+  uint64_t elapsed_us = pps_micros - advanced_timing.pps_epoch_micros;
+  if (elapsed_us > 1000000000ULL) {
+    // Oscillator drift could exceed half a second across a gap this long
+    advanced_timing.pps_epoch_valid = false;
+    sendEvent(EVENT_PPS_EPOCH_LOST, (int32_t)advanced_timing.pps_epoch, 0);
+    return false;
+  }
+  uint32_t seconds = (uint32_t)((elapsed_us + 500000ULL) / 1000000ULL);
+  int64_t residual_us = (int64_t)elapsed_us - (int64_t)seconds * 1000000LL;
+  if (seconds == 0 || residual_us > 100000 || residual_us < -100000) {
+    return false;
+  }
+  advanced_timing.pps_epoch += seconds;
+  advanced_timing.pps_epoch_micros = pps_micros;
+  return true;
+}
+
+void processPPS() {
+  timingEnterCritical();
+  uint64_t pps_micros = advanced_timing.pps_micros;
+  uint64_t pps_edge_count = advanced_timing.pps_edge_count;
+  timingExitCritical();
+  uint32_t current_millis = timingMillis();
+  
+  advanced_timing.pps_count++;
+  
+  // Debug: Confirm processPPS is called
+  if (advanced_timing.pps_count % 20 == 0) {
+    LOG_TRACE("processPPS called, count=", advanced_timing.pps_count);
+  }
+
+  // ===================================================================
+  // CRITICAL FIX: Initialize state FIRST (before any early returns)
+  // This ensures calibration learning can start on the next PPS
+  // ===================================================================
+  bool first_pps = !advanced_timing.pps_valid;
+  bool epoch_edge = labelPpsEdge(pps_micros);
+  
+  // Update last_pps_micros BEFORE any early returns
+  advanced_timing.last_pps_micros = pps_micros;
+  if (advanced_timing.pps_capture_hw) {
+    advanced_timing.last_pps_interval_counts = pps_edge_count - advanced_timing.last_pps_edge_count;
+    advanced_timing.last_pps_edge_count = pps_edge_count;
+  }
+  advanced_timing.last_pps_time = current_millis;
+  
+  // Mark PPS as valid after first successful pulse
+  if (first_pps) {
+    advanced_timing.pps_valid = true;
+    advanced_timing.calibration_valid = true;  // Enable calibration learning
+    LOG_DEBUG("GPS PPS acquired - count: ", advanced_timing.pps_count);
+  }
+  
+  // ===================================================================
+  // Frequency and phase: one filter update per edge (calibration, timestamp anchor, accuracy)
+  // ===================================================================
+  bool edge_accepted = updatePpsFilter(pps_micros, pps_edge_count);
+  
+  // ===================================================================
+  // Handle PPS-locked start countdown or epoch start (can return early now)
+  // ===================================================================
+  bool start_now = false;
+  if (advanced_timing.sync_on_pps && advanced_timing.epoch_start_pending && !streaming) {
+    if (!advanced_timing.pps_epoch_valid ||
+        (epoch_edge && (int32_t)(advanced_timing.pps_epoch - advanced_timing.epoch_start_second) > 0)) {
+      // Labels lost, or the start edge went by uncounted: starting late would break the shared grid
+      advanced_timing.epoch_start_pending = false;
+      advanced_timing.sync_on_pps = false;
+      advanced_timing.waiting_for_sync_start = false;
+      SerialTx.print("ERROR:PPS epoch start missed (epoch ");
+      SerialTx.print(advanced_timing.epoch_start_second);
+      SerialTx.println(")");
+    } else if (epoch_edge && advanced_timing.pps_epoch == advanced_timing.epoch_start_second) {
+      advanced_timing.epoch_start_pending = false;
+      advanced_timing.epoch_started = true;
+      start_now = true;
+    }
+  } else if (advanced_timing.sync_on_pps && advanced_timing.pps_countdown > 0) {
+    start_now = (--advanced_timing.pps_countdown == 0);
+  }
+  if (start_now) {
+    // Begin streaming exactly at this PPS edge (the filtered one, free of capture jitter)
+    uint64_t edge_micros = (pps_filter.edge_q16 + 0x8000) >> 16;
+    advanced_timing.timing_base_micros = edge_micros;
+    advanced_timing.next_sample_micros = edge_micros;
+    advanced_timing.phase_acc_q32 = 0;
+    advanced_timing.grid_slot = 0;
+    advanced_timing.timing_established = true;
+    advanced_timing.waiting_for_sync_start = false;
+    advanced_timing.sync_on_pps = false;
+    advanced_timing.started_on_pps = true;
+    startStreamingAtPps();
+    return;  // ✅ Safe to return - state already updated
+  }
+  
+  if (!edge_accepted) {
+    return;  // Glitch or outlier: the filter coasted through this second
+  }
+  
+  if (advanced_timing.pps_count % 20 == 0) {
+    LOG_TRACE("PPS filter: ppm=", LogFloat(advanced_timing.oscillator_calibration_ppm, 3), ", innovation=", LogFloat(pps_filter.innovation_us, 2), "us, phase_sigma=", LogFloat(sqrtf(pps_filter.p00), 3), "us, ", getPpsFilterStateName(pps_filter.state));
+  }
+  
+  // Always update these
+  advanced_timing.pps_valid = true;
+  advanced_timing.calibration_valid = true;
+  advanced_timing.last_pps_time = current_millis;
+
+  // If we are already streaming (not started on PPS) and this is the first time PPS becomes valid,
+  // gently nudge sampling phase to align with PPS without changing long-term rate.
+  if (streaming && advanced_timing.timing_established && !advanced_timing.started_on_pps && !advanced_timing.phase_nudge_applied) {
+    if (advanced_timing.sample_interval_us > 0) {
+      long long signed_phase = ppsGridPhaseErrorUs();
+
+      // If small (< 20us), ignore
+      if (signed_phase > 20 || signed_phase < -20) {
+        // Spread correction over up to 200 samples, capped at ±20 μs/sample
+        uint32_t samples_needed = 0;
+        int64_t per_sample = planPhaseAdjustment(signed_phase, 200, samples_needed);
+
+        advanced_timing.phase_error_us = (double)signed_phase;
+        advanced_timing.per_sample_phase_adjust_q32 = per_sample;
+        advanced_timing.phase_adjust_samples_remaining = samples_needed;
+        advanced_timing.phase_alignment_active = true;
+        advanced_timing.phase_nudge_applied = true; // only once
+
+        LOG_TRACE("Applying phase nudge to PPS: error=", (long)signed_phase, "us over ", (uint32_t)samples_needed, " samples (~", LogFloat((double)samples_needed * (double)advanced_timing.sample_interval_us / 1000.0, 1), " ms)");
+        sendEvent(EVENT_PPS_PHASE_NUDGE, (int32_t)signed_phase, (int32_t)samples_needed);
+      }
+    }
+  }
+
+  // Continuous PPS phase lock: at each PPS, compute current phase error and correct it gradually.
+  // The filter owns the frequency, so only the residual offset of the grid is left to correct.
+  if (streaming && advanced_timing.timing_established && advanced_timing.pps_phase_lock_enabled) {
+    if (advanced_timing.sample_interval_us > 0) {
+      long long signed_phase2 = ppsGridPhaseErrorUs();
+
+      // Small hysteresis to avoid chattering
+      if (signed_phase2 > 5 || signed_phase2 < -5) {
+        // Spread over approximately one second worth of samples
+        uint32_t samples_per_second = (uint32_t)(stream_rate + 0.5f);
+        if (samples_per_second == 0) samples_per_second = 1;
+
+        // Tight clamp for continuous lock
+        uint32_t samples_needed2 = 0;
+        int64_t per_sample2 = planPhaseAdjustment(signed_phase2, samples_per_second, samples_needed2);
+
+        advanced_timing.phase_error_us = (double)signed_phase2;
+        advanced_timing.per_sample_phase_adjust_q32 = per_sample2;
+        advanced_timing.phase_adjust_samples_remaining = samples_needed2;
+        advanced_timing.phase_alignment_active = true;
+
+        LOG_TRACE("PPS lock adjust: phase=", (long)signed_phase2, "us over ", (uint32_t)samples_needed2, " samples");
+        sendEvent(EVENT_PPS_LOCK_ADJUST, (int32_t)signed_phase2, (int32_t)samples_needed2);
+      }
+    }
+  }
+}
+
+void resetPpsFilter() {
+  pps_filter.state = PPS_FILTER_IDLE;
+  pps_filter.edge_q16 = 0;
+  pps_filter.freq_q32 = 0;
+  pps_filter.edge_calibrated = 0;
+  pps_filter.p00 = 0.0f;
+  pps_filter.p01 = 0.0f;
+  pps_filter.p11 = 0.0f;
+  pps_filter.r = PPS_FILTER_R_ISR;
+  pps_filter.innovation_us = 0.0f;
+  pps_filter.anchor_q16 = 0;
+  pps_filter.anchor_count = 0;
+  pps_filter.rejects = 0;
+  pps_filter.frequency_known = false;
+  pps_filter.updates = 0;
+  pps_filter.outliers = 0;
+  pps_filter.restarts = 0;
+  pps_filter.accuracy_bucket = 0xFFFFFFFF;
+  pps_filter.accuracy_us = 1.0f;
+}
+
+static void anchorPpsCalibration() {
+  // Re-anchor calculateCalibratedTimestamp() on the filtered edge, T(v) = T_edge + (v - edge)(1 + ppm),
+  // so a new ppm never rotates the timeline around an old base
+  advanced_timing.cal_base_micros = pps_filter.edge_q16 >> 16;
+  advanced_timing.cal_base_calibrated = pps_filter.edge_calibrated - ((pps_filter.edge_q16 & 0xFFFF) >= 0x8000 ? 1 : 0);
+  advanced_timing.cal_base_millis = timingMillis();
+  advanced_timing.cal_base_initialized = true;
+  pps_filter.accuracy_bucket = 0xFFFFFFFF;  // Covariance changed
+}
+
+static void seedPpsFilter(uint64_t measured_q16, uint64_t pps_edge_count) {
+  // Phase restarts on this edge; its calibrated time continues the current timeline
+  uint64_t edge_micros = measured_q16 >> 16;
+  pps_filter.edge_calibrated = calculateCalibratedTimestamp(edge_micros);
+  pps_filter.edge_q16 = measured_q16;
+  pps_filter.anchor_q16 = measured_q16;
+  pps_filter.anchor_count = pps_edge_count;
+  pps_filter.r = advanced_timing.pps_capture_hw ? PPS_FILTER_R_CAPTURE : PPS_FILTER_R_ISR;
+  pps_filter.p00 = pps_filter.r;
+  pps_filter.p01 = 0.0f;
+  if (!pps_filter.frequency_known) {
+    // Frequency prior: the calibration in use (flash, pushed), else just the crystal tolerance
+    double ppm = 0.0;
+    float sigma = PPS_FILTER_PRIOR_PPM;
+    if (advanced_timing.calibration_valid && advanced_timing.calibration_source != AdvancedTiming::CAL_NONE) {
+      double c = advanced_timing.oscillator_calibration_ppm * 1e-6;
+      ppm = -c / (1.0 + c) * 1e6;
+      sigma = PPS_FILTER_PRIOR_CAL_PPM;
+    }
+    pps_filter.freq_q32 = (int64_t)(ppm * 4294967296.0);
+    pps_filter.p11 = sigma * sigma;
+  }
+  pps_filter.state = PPS_FILTER_ACQUIRING;
+  pps_filter.rejects = 0;
+  pps_filter.restarts++;
+  anchorPpsCalibration();
+}
+
+bool updatePpsFilter(uint64_t pps_micros, uint64_t pps_edge_count) {
+  // Two-state Kalman filter on the edge time: predict by whole seconds, correct by the innovation
+  uint64_t measured_q16 = pps_micros << 16;
+  if (advanced_timing.pps_capture_hw && pps_filter.state != PPS_FILTER_IDLE) {
+    // TCC0 and the timebase both count DFLL48M: edge counts place the edge to 1/48 us
+    const uint64_t counts_per_us = PPS_TIMER_CLOCK_HZ / 1000000UL;
+    uint64_t counts = pps_edge_count - pps_filter.anchor_count;
+    measured_q16 = pps_filter.anchor_q16 + ((counts / counts_per_us) << 16) + (((counts % counts_per_us) << 16) / counts_per_us);
+  }
+  if (pps_filter.state == PPS_FILTER_IDLE) {
+    seedPpsFilter(measured_q16, pps_edge_count);
+    return true;
+  }
+  
+  // Whole GPS seconds since the previous edge (several after lost pulses)
+  double us_per_second = 1e6 + (double)pps_filter.freq_q32 / 4294967296.0;
+  double seconds = (double)(int64_t)(measured_q16 - pps_filter.edge_q16) / 65536.0 / us_per_second;
+  int64_t n = (int64_t)floor(seconds + 0.5);
+  if (n < 1 || fabs(seconds - (double)n) > PPS_FILTER_MAX_OFF_GRID_S) {
+    SerialTx.print("WARNING:Invalid PPS interval: ");
+    SerialTx.print(seconds, 3);
+    SerialTx.println("s - ignoring edge");
+    pps_filter.outliers++;
+    if (++pps_filter.rejects >= PPS_FILTER_MAX_REJECTS) {
+      seedPpsFilter(measured_q16, pps_edge_count);  // Lost track of the second grid
+    }
+    return false;
+  }
+  
+  // Predict: n seconds of phase at the estimated rate; covariance grows with the clock noise
+  float dt = (float)n;
+  pps_filter.edge_q16 += (uint64_t)(n * ((1000000LL << 16) + (pps_filter.freq_q32 >> 16)));
+  pps_filter.edge_calibrated += (uint64_t)n * 1000000ULL;
+  float p00 = pps_filter.p00 + 2.0f * dt * pps_filter.p01 + dt * dt * pps_filter.p11 +
+              PPS_FILTER_Q_PHASE * dt + PPS_FILTER_Q_FREQ * dt * dt * dt / 3.0f;
+  float p01 = pps_filter.p01 + dt * pps_filter.p11 + PPS_FILTER_Q_FREQ * dt * dt / 2.0f;
+  float p11 = pps_filter.p11 + PPS_FILTER_Q_FREQ * dt;
+  
+  int64_t innovation_q16 = (int64_t)(measured_q16 - pps_filter.edge_q16);
+  float innovation = (float)innovation_q16 / 65536.0f;
+  float s = p00 + pps_filter.r;
+  pps_filter.innovation_us = innovation;
+  
+  // Gate single-second outliers once locked; after a gap the grown covariance admits the edge
+  if (pps_filter.state == PPS_FILTER_LOCKED && n == 1 &&
+      innovation * innovation > PPS_FILTER_GATE_SIGMA * PPS_FILTER_GATE_SIGMA * s) {
+    pps_filter.p00 = p00;
+    pps_filter.p01 = p01;
+    pps_filter.p11 = p11;
+    pps_filter.outliers++;
+    if (++pps_filter.rejects >= PPS_FILTER_MAX_REJECTS) {
+      seedPpsFilter(measured_q16, pps_edge_count);  // A real step, not noise
+    } else {
+      anchorPpsCalibration();  // Coast on the prediction for this second
+    }
+    return false;
+  }
+  pps_filter.rejects = 0;
+  
+  // Update: gains from the covariance (near least squares while uncertain, steady state once locked)
+  float k0 = p00 / s;
+  float k1 = p01 / s;
+  if (k1 > 1.99f) k1 = 1.99f;
+  if (k1 < -1.99f) k1 = -1.99f;
+  pps_filter.edge_q16 += (uint64_t)mulQ30(innovation_q16, (int32_t)(k0 * 1073741824.0f));
+  pps_filter.freq_q32 += mulQ30(innovation_q16, (int32_t)(k1 * 1073741824.0f)) * 65536;
+  pps_filter.p00 = (1.0f - k0) * p00;
+  pps_filter.p01 = (1.0f - k0) * p01;
+  pps_filter.p11 = p11 - k1 * p01;
+  if (pps_filter.p11 < 1e-9f) pps_filter.p11 = 1e-9f;
+  
+  // Track the real edge noise (ISR latency varies with the other interrupts) once locked
+  float r_floor = (advanced_timing.pps_capture_hw ? PPS_FILTER_R_CAPTURE : PPS_FILTER_R_ISR) * 0.25f;
+  if (pps_filter.state == PPS_FILTER_LOCKED) {
+    float observed = innovation * innovation - p00;
+    pps_filter.r = 0.95f * pps_filter.r + 0.05f * (observed > r_floor ? observed : r_floor);
+    if (pps_filter.r > PPS_FILTER_R_MAX) pps_filter.r = PPS_FILTER_R_MAX;
+  }
+  
+  pps_filter.frequency_known = true;
+  pps_filter.updates++;
+  pps_filter.state = (pps_filter.p00 < PPS_FILTER_LOCK_PHASE_US * PPS_FILTER_LOCK_PHASE_US &&
+                      pps_filter.p11 < PPS_FILTER_LOCK_FREQ_PPM * PPS_FILTER_LOCK_FREQ_PPM)
+                     ? PPS_FILTER_LOCKED : PPS_FILTER_ACQUIRING;
+  
+  // Calibration applied to timestamps and the scheduler: (1 + ppm/1e6) = 1 / (1 + rate error)
+  double rate_error = (double)pps_filter.freq_q32 / 4294967296.0 * 1e-6;
+  advanced_timing.oscillator_calibration_ppm = (float)(-rate_error / (1.0 + rate_error) * 1e6);
+  clampOscillatorCalibration();
+  if (advanced_timing.calibration_source != AdvancedTiming::CAL_PPS_LIVE) {
+    advanced_timing.cal_applied_at_ms = timingMillis();
+  }
+  advanced_timing.calibration_source = AdvancedTiming::CAL_PPS_LIVE;
+  anchorPpsCalibration();
+  return true;
+}
+
+float ppsFilterAccuracyUs(uint32_t since_edge_ms) {
+  // Two sigma of the phase extrapolated past the latest edge, recomputed every 250 ms at most
+  uint32_t bucket = since_edge_ms / 250;
+  if (bucket != pps_filter.accuracy_bucket) {
+    float t = (float)since_edge_ms / 1000.0f;
+    float variance = pps_filter.p00 + 2.0f * t * pps_filter.p01 + t * t * pps_filter.p11 +
+                     PPS_FILTER_Q_PHASE * t + PPS_FILTER_Q_FREQ * t * t * t / 3.0f;
+    pps_filter.accuracy_us = 2.0f * sqrtf(variance > 0.0f ? variance : 0.0f) + PPS_FILTER_ACCURACY_FLOOR_US;
+    pps_filter.accuracy_bucket = bucket;
+  }
+  return pps_filter.accuracy_us;
+}
+
+long long ppsGridPhaseErrorUs() {
+  // Filtered edge minus the next sample slot, modulo the effective (calibrated) interval, so a
+  // frequency correction never shows up as phase error for the lock to fight
+  refreshTimingScales();
+  int64_t interval_q16 = (int64_t)(advanced_timing.effective_interval_q32 >> 16);
+  if (interval_q16 <= 0) {
+    return 0;
+  }
+  uint64_t slot_q16 = (advanced_timing.next_sample_micros << 16) | (advanced_timing.phase_acc_q32 >> 16);
+  int64_t phase = (int64_t)(pps_filter.edge_q16 - slot_q16) % interval_q16;
+  if (phase < 0) phase += interval_q16;
+  if (phase > interval_q16 / 2) phase -= interval_q16;
+  return (long long)((phase + (phase < 0 ? -0x8000 : 0x8000)) / 0x10000);
+}
+
+const char* getPpsFilterStateName(uint8_t state) {
+  switch (state) {
+    case PPS_FILTER_IDLE: return "IDLE";
+    case PPS_FILTER_ACQUIRING: return "ACQUIRING";
+    case PPS_FILTER_LOCKED: return "LOCKED";
+    default: return "UNKNOWN";
+  }
+}
+
+uint64_t calculateCalibratedTimestamp(uint64_t virtual_micros) {
+  if (!advanced_timing.calibration_valid) {
+    return virtual_micros;
+  }
+  
+  // Elapsed time since the calibration base, on the one 64-bit timebase
+  int64_t elapsed_micros = (int64_t)(virtual_micros - advanced_timing.cal_base_micros);
+  
+  // Apply PPM correction: elapsed * (1 + ppm/1e6) with the ppm held as a Q0.40 fraction
+  // (1e-6 ppm resolution: < 0.1 us error after a day of elapsed time)
+  refreshTimingScales();
+  int64_t corrected_elapsed = elapsed_micros + mulQ40(elapsed_micros, advanced_timing.calibration_q40);
+  
+  return advanced_timing.cal_base_calibrated + (uint64_t)corrected_elapsed;
+}
+
+void refreshTimingScales() {
+  // Integer scale factors for the per-sample paths, re-derived only when their inputs change
+  if (advanced_timing.calibration_scale_ppm == advanced_timing.oscillator_calibration_ppm &&
+      advanced_timing.calibration_scale_interval_us == advanced_timing.sample_interval_us) {
+    return;
+  }
+  double fraction_q40 = advanced_timing.oscillator_calibration_ppm / 1e6 * 1099511627776.0;
+  if (fraction_q40 > 2147483647.0) fraction_q40 = 2147483647.0;
+  if (fraction_q40 < -2147483647.0) fraction_q40 = -2147483647.0;
+  advanced_timing.calibration_q40 = (int32_t)fraction_q40;
+  
+  // Scheduler interval in Q32.32 us: nominal * (1 - ppm/1e6)
+  int64_t interval_q32 = (int64_t)(advanced_timing.sample_interval_us << 32);
+  interval_q32 -= ((int64_t)advanced_timing.sample_interval_us * advanced_timing.calibration_q40) / 256;
+  advanced_timing.effective_interval_q32 = (uint64_t)interval_q32;
+  advanced_timing.effective_interval_us = (double)interval_q32 / 4294967296.0;
+  
+  advanced_timing.calibration_scale_ppm = advanced_timing.oscillator_calibration_ppm;
+  advanced_timing.calibration_scale_interval_us = advanced_timing.sample_interval_us;
+}
+
+int64_t mulQ40(int64_t value, int32_t fraction_q40) {
+  // value * fraction / 2^40 via 32-bit halves, so no 96-bit intermediate is needed (rounds toward zero)
+  bool negative = value < 0;
+  uint64_t magnitude = negative ? (uint64_t)(-value) : (uint64_t)value;
+  int64_t high = (int64_t)(magnitude >> 32) * fraction_q40;           // x 2^32 / 2^40 = / 2^8
+  int64_t low = (int64_t)(uint32_t)magnitude * fraction_q40;
+  int64_t product = high / 256 + low / 1099511627776LL;
+  return negative ? -product : product;
+}
+
+int64_t mulQ30(int64_t value, int32_t fraction_q30) {
+  // value * fraction / 2^30, split the same way as mulQ40 (filter gains: |fraction| < 2)
+  bool negative = value < 0;
+  uint64_t magnitude = negative ? (uint64_t)(-value) : (uint64_t)value;
+  int64_t high = (int64_t)(magnitude >> 32) * fraction_q30;           // x 2^32 / 2^30 = x 4
+  int64_t low = (int64_t)(uint32_t)magnitude * fraction_q30;
+  int64_t product = high * 4 + low / 1073741824LL;
+  return negative ? -product : product;
+}
+
+int64_t planPhaseAdjustment(long long signed_phase_us, uint32_t planned_samples, uint32_t& samples_needed) {
+  // Per-sample adjustment (Q32.32 us) capped at ±20 μs, and the sample count that delivers the full error
+  const int64_t limit_q32 = 20LL * 4294967296LL;
+  int64_t error_q32 = (int64_t)signed_phase_us * 4294967296LL;
+  int64_t per_sample = error_q32 / (int64_t)(planned_samples > 0 ? planned_samples : 1);
+  if (per_sample > limit_q32) per_sample = limit_q32;
+  if (per_sample < -limit_q32) per_sample = -limit_q32;
+  
+  uint64_t error_magnitude = (uint64_t)(error_q32 < 0 ? -error_q32 : error_q32);
+  uint64_t step_magnitude = (uint64_t)(per_sample < 0 ? -per_sample : per_sample);
+  samples_needed = step_magnitude > 0 ? (uint32_t)((error_magnitude + step_magnitude / 2) / step_magnitude) : 1;
+  if (samples_needed == 0) samples_needed = 1;
+  return per_sample;
+}
+
+void establishSamplingTiming() {
+  // Establish timing base for precise sampling intervals using virtual time
+  uint64_t current_virtual_micros = getVirtualMicros();
+  
+  // Start sampling at next interval boundary
+  uint32_t offset_us = (uint32_t)(current_virtual_micros % advanced_timing.sample_interval_us);
+  uint64_t next_boundary_micros = current_virtual_micros + (advanced_timing.sample_interval_us - offset_us);
+  
+  // Store both the 32-bit base and the full virtual time for overflow protection
+  advanced_timing.timing_base_micros = next_boundary_micros;
+  advanced_timing.timing_base_virtual_micros = next_boundary_micros;
+  advanced_timing.timing_established = true;
+  advanced_timing.samples_generated = 0;
+  advanced_timing.sample_index = 0;
+  advanced_timing.next_sample_micros = next_boundary_micros;
+  advanced_timing.grid_slot = 0;
+  advanced_timing.last_reference_update_sample = 0;
+  
+  LOG_DEBUG("Sampling established at ", stream_rate, "Hz with ", getTimingSourceName(advanced_timing.current_source), " timing (±", LogFloat(advanced_timing.timing_accuracy_us, 1), "μs) - overflow protected");
+}
+
+void updateTimingReference() {
+  // Periodic reference update to prevent overflow
+  // This resets the sample_index and timing_base to prevent arithmetic overflow
+  
+  uint64_t current_virtual_micros = getVirtualMicros();
+  
+  // Calculate the new timing base (where we are now in the sampling grid)
+  uint64_t samples_since_start = advanced_timing.sample_index;
+  
+  // CRITICAL FIX: Update calibration base to maintain calibration continuity
+  // This prevents the growing offset issue by keeping cal_base_micros current
+  if (advanced_timing.calibration_valid) {
+    // Calculate what the calibrated timestamp should be at this point
+    uint64_t current_calibrated_time = calculateCalibratedTimestamp(current_virtual_micros);
+    
+    // Update calibration base to current position to maintain continuity
+    advanced_timing.cal_base_micros = current_virtual_micros;
+    advanced_timing.cal_base_calibrated = current_calibrated_time;
+    advanced_timing.cal_base_millis = timingMillis();
+    
+    LOG_DEBUG("Calibration base updated to maintain continuity (calibrated_time=", (uint32_t)current_calibrated_time, ")");
+  }
+  
+  // Update the timing base to current position
+  advanced_timing.timing_base_micros = current_virtual_micros;
+  advanced_timing.timing_base_virtual_micros = current_virtual_micros;
+  advanced_timing.sample_index = 0;  // Reset sample index
+  advanced_timing.next_sample_micros = current_virtual_micros; // keep scheduler aligned
+  advanced_timing.last_reference_update_sample = samples_since_start;
+  advanced_timing.reference_updates_count++;
+  
+  LOG_TRACE("Timing reference updated (#", advanced_timing.reference_updates_count, ") after ", (uint32_t)samples_since_start, " samples - overflow prevented");
+  sendEvent(EVENT_REFERENCE_UPDATE, (int32_t)advanced_timing.reference_updates_count, (int32_t)samples_since_start);
+}
+
+const char* getTimingSourceName(int source) {
+  switch (source) {
+    case AdvancedTiming::TIMING_PPS_ACTIVE: return "PPS_ACTIVE";
+    case AdvancedTiming::TIMING_PPS_HOLDOVER: return "PPS_HOLDOVER";
+    case AdvancedTiming::TIMING_INTERNAL_CAL: return "INTERNAL_CAL";
+    case AdvancedTiming::TIMING_INTERNAL_RAW: return "INTERNAL_RAW";
+    default: return "UNKNOWN";
+  }
+}
+
+void clampOscillatorCalibration() {
+  // Hard limits and sanity checks: clamp oscillator_calibration_ppm to ±500 ppm
+  // Most crystal oscillators are within ±100 ppm, but uncalibrated can be ±250-500 ppm
+  if (advanced_timing.oscillator_calibration_ppm > 500.0) {
+    SerialTx.print("WARNING:Oscillator calibration clamped from ");
+    SerialTx.print(advanced_timing.oscillator_calibration_ppm, 2);
+    SerialTx.println(" ppm to 500 ppm");
+    advanced_timing.oscillator_calibration_ppm = 500.0;
+  } else if (advanced_timing.oscillator_calibration_ppm < -500.0) {
+    SerialTx.print("WARNING:Oscillator calibration clamped from ");
+    SerialTx.print(advanced_timing.oscillator_calibration_ppm, 2);
+    SerialTx.println(" ppm to -500 ppm");
+    advanced_timing.oscillator_calibration_ppm = -500.0;
+  }
+}
+
+void retuneOscillatorCalibration(float ppm) {
+  // Change the rate without moving the timeline: re-anchor the calibrated time at now first
+  if (advanced_timing.calibration_valid) {
+    uint64_t now = getVirtualMicros();
+    advanced_timing.cal_base_calibrated = calculateCalibratedTimestamp(now);
+    advanced_timing.cal_base_micros = now;
+  }
+  advanced_timing.oscillator_calibration_ppm = ppm;
+  clampOscillatorCalibration();
+}
+
+void advanceSampleSchedule(long long late_us) {
+  // Called once a slot has been sampled, late_us after next_sample_micros
+  // Skip-ahead: calculate how many slots we missed and jump over them
+  long long interval_whole = (long long)(advanced_timing.effective_interval_q32 >> 32);
+  advanced_timing.grid_slot++;
+  if (interval_whole > 0 && late_us >= interval_whole) {
+    long long missed_slots = late_us / interval_whole;
+    // Jump over missed slots to prevent burst catch-up
+    advanced_timing.next_sample_micros += (uint64_t)(missed_slots * interval_whole);
+    advanced_timing.grid_slot += (uint64_t)missed_slots;
+    LOG_TRACE("Skipped ", (uint32_t)missed_slots, " missed slots");
+    sendEvent(EVENT_SLOTS_SKIPPED, (int32_t)missed_slots, 0);
+  }
+
+  // Advance next time with fractional accumulator to keep long-term average exact
+  int64_t step = (int64_t)advanced_timing.effective_interval_q32 + (int64_t)advanced_timing.phase_acc_q32;
+  // Apply gentle phase alignment if active
+  if (advanced_timing.phase_alignment_active && advanced_timing.phase_adjust_samples_remaining > 0) {
+    step += advanced_timing.per_sample_phase_adjust_q32;
+    if (advanced_timing.phase_adjust_samples_remaining > 0) {
+      advanced_timing.phase_adjust_samples_remaining--;
+    }
+    if (advanced_timing.phase_adjust_samples_remaining == 0) {
+      advanced_timing.phase_alignment_active = false;
+      advanced_timing.per_sample_phase_adjust_q32 = 0;
+      advanced_timing.phase_error_us = 0.0;
+      LOG_DEBUG("Phase alignment completed");
+    }
+  }
+  advanced_timing.phase_acc_q32 = (uint32_t)step; // keep fractional part
+  advanced_timing.next_sample_micros += (uint64_t)(step >> 32);
+}
+
+void countEmittedSample() {
+  advanced_timing.samples_generated++;
+  advanced_timing.sample_index++;
+  
+  // NOTE: Wraparound tracking removed from hot path to avoid any timing impact
+  // Wraparounds are now calculated as: samples_generated / 65536
+}
+
+#endif  // TIMING_CORE_H
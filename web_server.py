@@ -571,7 +571,10 @@ def on_data(timestamp, sequence, values, timing_info=None):
                 'Value_y': calibrated_values[2] if len(calibrated_values) > 2 else 0.0,  # Channel 2 -> Y  
                 'Value_z': calibrated_values[0] if len(calibrated_values) > 0 else 0.0   # Channel 0 -> Z
             }
-        data_saver.save_seismic_sample(timestamp, sequence, processed_values, None, sample_fields)
+        stream_kind = timing_info.get('stream_kind') if timing_info else None
+        trigger_event = timing_info.get('trigger_event') if timing_info else None
+        data_saver.save_seismic_sample(timestamp, sequence, processed_values, None, sample_fields,
+                                       stream=stream_kind, trigger_event=trigger_event)
     
     # Log to CSV (legacy method for backward compatibility)
     log_data_to_csv(timestamp, sequence, values)